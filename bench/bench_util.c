@@ -0,0 +1,470 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "bench_util.h"
+
+#include <errno.h>
+#include <math.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/* =============================================
+ * clock
+ * ============================================= */
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* =============================================
+ * random numbers
+ * ============================================= */
+
+void bench_rng_seed(bench_rng_t *rng, uint64_t seed) {
+    // splitmix64 per evitare stati iniziali degeneri (lo stato non può essere 0)
+    uint64_t z = seed + 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+    rng->state = z ? z : 0x2545f4914f6cdd1dULL;
+}
+
+uint64_t bench_rng_next(bench_rng_t *rng) {
+    uint64_t x = rng->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    rng->state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+double bench_rng_double(bench_rng_t *rng) {
+    return (double)(bench_rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+uint64_t bench_rng_range(bench_rng_t *rng, uint64_t n) {
+    if (n == 0) return 0;
+    return bench_rng_next(rng) % n;
+}
+
+/* =============================================
+ * key choice
+ * ============================================= */
+
+static double zeta(uint64_t n, double theta) {
+    double sum = 0;
+    for (uint64_t i = 1; i <= n; i++) {
+        sum += 1.0 / pow((double)i, theta);
+    }
+    return sum;
+}
+
+// FNV-1a a 64 bit: sparpaglia i rank zipfian sull'intero keyspace (come lo "scrambled" di YCSB)
+static uint64_t fnv1a_u64(uint64_t value) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (int i = 0; i < 8; i++) {
+        h ^= (value >> (i * 8)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+int key_chooser_init(key_chooser_t *kc, const char *spec, uint64_t items) {
+    memset(kc, 0, sizeof(*kc));
+    kc->items = items ? items : 1;
+
+    if (strcmp(spec, "uniform") == 0) {
+        kc->type = KEY_DIST_UNIFORM;
+        return 0;
+    }
+
+    if (strcmp(spec, "latest") == 0) {
+        kc->type = KEY_DIST_LATEST;
+        spec = "zipf";
+    } else if (strncmp(spec, "zipf", 4) == 0) {
+        kc->type = KEY_DIST_ZIPF;
+    } else {
+        return -1;
+    }
+
+    kc->theta = 0.99;
+    if (spec[4] == ':') {
+        char *endptr;
+        kc->theta = strtod(spec + 5, &endptr);
+        if (*endptr != '\0') return -1;
+    } else if (spec[4] != '\0') {
+        return -1;
+    }
+    if (kc->theta <= 0 || kc->theta >= 1) return -1;
+
+    kc->alpha = 1.0 / (1.0 - kc->theta);
+    kc->zetan = zeta(kc->items, kc->theta);
+    kc->zeta2 = zeta(2, kc->theta);
+    kc->eta = (1 - pow(2.0 / (double)kc->items, 1 - kc->theta)) / (1 - kc->zeta2 / kc->zetan);
+    return 0;
+}
+
+uint64_t key_chooser_next(const key_chooser_t *kc, bench_rng_t *rng) {
+    if (kc->type == KEY_DIST_UNIFORM) return bench_rng_range(rng, kc->items);
+
+    double u = bench_rng_double(rng);
+    double uz = u * kc->zetan;
+    uint64_t rank;
+    if (uz < 1.0) {
+        rank = 0;
+    } else if (uz < 1.0 + pow(0.5, kc->theta)) {
+        rank = 1;
+    } else {
+        rank = (uint64_t)((double)kc->items * pow(kc->eta * u - kc->eta + 1, kc->alpha));
+    }
+    if (rank >= kc->items) rank = kc->items - 1;
+    if (kc->type == KEY_DIST_LATEST) return rank;
+    return fnv1a_u64(rank) % kc->items;
+}
+
+void key_chooser_describe(const key_chooser_t *kc, char *out, size_t out_size) {
+    if (kc->type == KEY_DIST_UNIFORM) {
+        snprintf(out, out_size, "uniform");
+    } else if (kc->type == KEY_DIST_LATEST) {
+        snprintf(out, out_size, "latest");
+    } else {
+        snprintf(out, out_size, "zipf(%.2f)", kc->theta);
+    }
+}
+
+/* =============================================
+ * value size distribution
+ * ============================================= */
+
+int size_dist_parse(size_dist_t *dist, const char *spec) {
+    memset(dist, 0, sizeof(*dist));
+    char *endptr;
+
+    if (strncmp(spec, "fixed:", 6) == 0) {
+        dist->type = SIZE_DIST_FIXED;
+        dist->min = dist->max = strtoul(spec + 6, &endptr, 10);
+        return (*endptr == '\0' && dist->min > 0) ? 0 : -1;
+    }
+    if (strncmp(spec, "uniform:", 8) == 0) {
+        dist->type = SIZE_DIST_UNIFORM;
+        dist->min = strtoul(spec + 8, &endptr, 10);
+        if (*endptr != '-') return -1;
+        dist->max = strtoul(endptr + 1, &endptr, 10);
+        return (*endptr == '\0' && dist->min > 0 && dist->max >= dist->min) ? 0 : -1;
+    }
+    if (strncmp(spec, "exp:", 4) == 0) {
+        dist->type = SIZE_DIST_EXP;
+        dist->mean = strtod(spec + 4, &endptr);
+        dist->min = 1;
+        dist->max = (size_t)(dist->mean * 16);
+        return (*endptr == '\0' && dist->mean >= 1) ? 0 : -1;
+    }
+    return -1;
+}
+
+size_t size_dist_next(const size_dist_t *dist, bench_rng_t *rng) {
+    switch (dist->type) {
+    case SIZE_DIST_UNIFORM:
+        return dist->min + bench_rng_range(rng, dist->max - dist->min + 1);
+    case SIZE_DIST_EXP: {
+        double u = bench_rng_double(rng);
+        size_t size = (size_t)(-dist->mean * log(1.0 - u)) + 1;
+        return size > dist->max ? dist->max : size;
+    }
+    case SIZE_DIST_FIXED:
+    default:
+        return dist->min;
+    }
+}
+
+void size_dist_describe(const size_dist_t *dist, char *out, size_t out_size) {
+    switch (dist->type) {
+    case SIZE_DIST_UNIFORM:
+        snprintf(out, out_size, "uniform:%zu-%zu", dist->min, dist->max);
+        break;
+    case SIZE_DIST_EXP:
+        snprintf(out, out_size, "exp:%.0f", dist->mean);
+        break;
+    case SIZE_DIST_FIXED:
+    default:
+        snprintf(out, out_size, "fixed:%zu", dist->min);
+    }
+}
+
+/* =============================================
+ * latency histogram
+ * ============================================= */
+
+static int hist_index(uint64_t value) {
+    if (value < HIST_SUB_COUNT) return (int)value;
+
+    int msb = 63 - __builtin_clzll(value);
+    int exponent = msb - HIST_SUB_BITS + 1;
+    if (exponent > HIST_MAX_EXP) return HIST_BUCKETS - 1;
+    int sub = (int)(value >> exponent); // [HIST_SUB_COUNT / 2, HIST_SUB_COUNT)
+    return exponent * HIST_SUB_COUNT + sub;
+}
+
+static uint64_t hist_value(int index) {
+    if (index < HIST_SUB_COUNT) return (uint64_t)index;
+
+    int exponent = index / HIST_SUB_COUNT;
+    uint64_t sub = (uint64_t)(index % HIST_SUB_COUNT);
+    // punto medio del bucket
+    return (sub << exponent) + ((1ULL << exponent) >> 1);
+}
+
+void hist_init(latency_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+void hist_record(latency_hist_t *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    h->sum += (double)value;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+void hist_merge(latency_hist_t *dst, const latency_hist_t *src) {
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        dst->counts[i] += src->counts[i];
+    }
+    dst->total += src->total;
+    dst->sum += src->sum;
+    if (src->min < dst->min) dst->min = src->min;
+    if (src->max > dst->max) dst->max = src->max;
+}
+
+uint64_t hist_percentile(const latency_hist_t *h, double percentile) {
+    if (h->total == 0) return 0;
+
+    uint64_t target = (uint64_t)ceil((percentile / 100.0) * (double)h->total);
+    if (target == 0) target = 1;
+
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += h->counts[i];
+        if (seen >= target) {
+            uint64_t value = hist_value(i);
+            if (value < h->min) return h->min;
+            return value > h->max ? h->max : value;
+        }
+    }
+    return h->max;
+}
+
+double hist_mean(const latency_hist_t *h) { return h->total ? h->sum / (double)h->total : 0; }
+
+void hist_print_us(FILE *out, const char *label, const latency_hist_t *h) {
+    if (h->total == 0) {
+        fprintf(out, "%-8s no samples\n", label);
+        return;
+    }
+    fprintf(out, "%-8s min %8.1f  p50 %8.1f  p90 %8.1f  p99 %8.1f  p99.9 %8.1f  max %8.1f  mean %8.1f\n",
+            label, h->min / 1000.0, hist_percentile(h, 50) / 1000.0,
+            hist_percentile(h, 90) / 1000.0, hist_percentile(h, 99) / 1000.0,
+            hist_percentile(h, 99.9) / 1000.0, h->max / 1000.0, hist_mean(h) / 1000.0);
+}
+
+void hist_print_json(FILE *out, const latency_hist_t *h) {
+    if (h->total == 0) {
+        fprintf(out, "{\"count\": 0}");
+        return;
+    }
+    fprintf(out,
+            "{\"count\": %llu, \"min\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, "
+            "\"p99_9\": %.3f, \"max\": %.3f, \"mean\": %.3f}",
+            (unsigned long long)h->total, h->min / 1000.0, hist_percentile(h, 50) / 1000.0,
+            hist_percentile(h, 90) / 1000.0, hist_percentile(h, 99) / 1000.0,
+            hist_percentile(h, 99.9) / 1000.0, h->max / 1000.0, hist_mean(h) / 1000.0);
+}
+
+/* =============================================
+ * RESP client helpers
+ * ============================================= */
+
+static int connect_unix(const char *path) {
+    struct sockaddr_un addr = {0};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "unix socket path too long: %s\n", path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        fprintf(stderr, "connect(%s): %s\n", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int bench_connect(const char *host, const char *port, int timeout_ms) {
+    // un host che inizia con '/' è il percorso di un socket Unix (PODCACHE_UNIX_SOCKET)
+    if (host[0] == '/') {
+        int fd = connect_unix(host);
+        if (fd >= 0 && timeout_ms > 0) {
+            struct timeval tv = {.tv_sec = timeout_ms / 1000,
+                                 .tv_usec = (timeout_ms % 1000) * 1000};
+            setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        }
+        return fd;
+    }
+
+    struct addrinfo hints = {0}, *res, *rp;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int rc = getaddrinfo(host, port, &hints, &res);
+    if (rc != 0) {
+        fprintf(stderr, "getaddrinfo(%s:%s): %s\n", host, port, gai_strerror(rc));
+        return -1;
+    }
+
+    int fd = -1;
+    for (rp = res; rp; rp = rp->ai_next) {
+        fd = socket(rp->ai_family, rp->ai_socktype, rp->ai_protocol);
+        if (fd == -1) continue;
+        if (connect(fd, rp->ai_addr, rp->ai_addrlen) == 0) break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (fd == -1) {
+        fprintf(stderr, "connect(%s:%s): %s\n", host, port, strerror(errno));
+        return -1;
+    }
+
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // un server bloccato non deve appendere il benchmark
+    if (timeout_ms > 0) {
+        struct timeval tv = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    }
+    return fd;
+}
+
+int bench_send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+void out_reserve(out_buffer_t *out, size_t extra) {
+    if (out->len + extra <= out->cap) return;
+    size_t cap = out->cap ? out->cap : 4096;
+    while (cap < out->len + extra) cap *= 2;
+    out->data = realloc(out->data, cap);
+    if (!out->data) {
+        perror("realloc");
+        exit(EXIT_FAILURE);
+    }
+    out->cap = cap;
+}
+
+void encode_command(out_buffer_t *out, int argc, const char *const *argv, const size_t *lens) {
+    out_reserve(out, 16);
+    out->len += (size_t)sprintf(out->data + out->len, "*%d\r\n", argc);
+    for (int i = 0; i < argc; i++) {
+        out_reserve(out, lens[i] + 32);
+        out->len += (size_t)sprintf(out->data + out->len, "$%zu\r\n", lens[i]);
+        memcpy(out->data + out->len, argv[i], lens[i]);
+        out->len += lens[i];
+        memcpy(out->data + out->len, "\r\n", 2);
+        out->len += 2;
+    }
+}
+
+// restituisce i byte consumati da una risposta completa, 0 se incompleta, -1 se non valida
+long parse_reply(const char *buf, size_t len, reply_kind_e *kind) {
+    if (len < 3) return 0;
+
+    const char *crlf = memchr(buf, '\r', len);
+    if (!crlf || (size_t)(crlf - buf) + 1 >= len) return 0;
+    size_t line_len = (size_t)(crlf - buf) + 2;
+
+    switch (buf[0]) {
+    case '+':
+    case ':':
+        *kind = REPLY_VALUE;
+        return (long)line_len;
+    case '-':
+        *kind = REPLY_ERROR;
+        return (long)line_len;
+    case '$': {
+        long bulk_len = strtol(buf + 1, NULL, 10);
+        if (bulk_len < 0) {
+            *kind = REPLY_NIL;
+            return (long)line_len;
+        }
+        if (line_len + (size_t)bulk_len + 2 > len) return 0;
+        *kind = REPLY_VALUE;
+        return (long)(line_len + (size_t)bulk_len + 2);
+    }
+    case '*': {
+        long count = strtol(buf + 1, NULL, 10);
+        size_t consumed = line_len;
+        *kind = count < 0 ? REPLY_NIL : REPLY_VALUE;
+        for (long i = 0; i < count; i++) {
+            reply_kind_e inner;
+            long n = parse_reply(buf + consumed, len - consumed, &inner);
+            if (n <= 0) return n;
+            consumed += (size_t)n;
+        }
+        return (long)consumed;
+    }
+    default:
+        return -1;
+    }
+}
+
+// legge una singola risposta (richiesta/risposta sincrona); i byte in eccesso restano in 'in'
+int read_reply(int fd, out_buffer_t *in, reply_kind_e *kind) {
+    for (;;) {
+        if (in->len > 0) {
+            long n = parse_reply(in->data, in->len, kind);
+            if (n < 0) return -1;
+            if (n > 0) {
+                memmove(in->data, in->data + n, in->len - (size_t)n);
+                in->len -= (size_t)n;
+                return 0;
+            }
+        }
+        out_reserve(in, 65536);
+        ssize_t r = recv(fd, in->data + in->len, in->cap - in->len, 0);
+        if (r <= 0) {
+            if (r < 0 && errno == EINTR) continue;
+            return -1;
+        }
+        in->len += (size_t)r;
+    }
+}
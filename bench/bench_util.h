@@ -0,0 +1,111 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/* =============================================
+ * clock
+ * ============================================= */
+uint64_t bench_now_ns(void);
+
+/* =============================================
+ * random numbers (xorshift64*, uno per thread)
+ * ============================================= */
+typedef struct {
+    uint64_t state;
+} bench_rng_t;
+
+void bench_rng_seed(bench_rng_t *rng, uint64_t seed);
+uint64_t bench_rng_next(bench_rng_t *rng);
+double bench_rng_double(bench_rng_t *rng); // [0, 1)
+uint64_t bench_rng_range(bench_rng_t *rng, uint64_t n); // [0, n)
+
+/* =============================================
+ * key choice: uniform, zipfian (YCSB, Gray et al.) o latest
+ * per "latest" key_chooser_next restituisce la distanza (zipfian) dall'ultima chiave inserita
+ * ============================================= */
+typedef enum { KEY_DIST_UNIFORM, KEY_DIST_ZIPF, KEY_DIST_LATEST } key_dist_e;
+
+typedef struct {
+    key_dist_e type;
+    uint64_t items;
+    double theta;
+    double alpha;
+    double zetan;
+    double eta;
+    double zeta2;
+} key_chooser_t;
+
+int key_chooser_init(key_chooser_t *kc, const char *spec, uint64_t items);
+uint64_t key_chooser_next(const key_chooser_t *kc, bench_rng_t *rng);
+void key_chooser_describe(const key_chooser_t *kc, char *out, size_t out_size);
+
+/* =============================================
+ * value size distribution: fixed:N, uniform:A-B, exp:MEAN
+ * ============================================= */
+typedef enum { SIZE_DIST_FIXED, SIZE_DIST_UNIFORM, SIZE_DIST_EXP } size_dist_e;
+
+typedef struct {
+    size_dist_e type;
+    size_t min;
+    size_t max;
+    double mean;
+} size_dist_t;
+
+int size_dist_parse(size_dist_t *dist, const char *spec);
+size_t size_dist_next(const size_dist_t *dist, bench_rng_t *rng);
+void size_dist_describe(const size_dist_t *dist, char *out, size_t out_size);
+
+/* =============================================
+ * latency histogram (log-linear, ~1.5% di errore relativo)
+ * ============================================= */
+#define HIST_SUB_BITS 6
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_EXP 48
+#define HIST_BUCKETS ((HIST_MAX_EXP + 1) * HIST_SUB_COUNT)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    double sum;
+} latency_hist_t;
+
+void hist_init(latency_hist_t *h);
+void hist_record(latency_hist_t *h, uint64_t value);
+void hist_merge(latency_hist_t *dst, const latency_hist_t *src);
+uint64_t hist_percentile(const latency_hist_t *h, double percentile);
+double hist_mean(const latency_hist_t *h);
+void hist_print_us(FILE *out, const char *label, const latency_hist_t *h);
+// oggetto JSON con count e percentili in microsecondi
+void hist_print_json(FILE *out, const latency_hist_t *h);
+
+/* =============================================
+ * RESP client helpers
+ * ============================================= */
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+} out_buffer_t;
+
+typedef enum { REPLY_VALUE, REPLY_NIL, REPLY_ERROR } reply_kind_e;
+
+// host che inizia con '/' = percorso di un socket Unix, port ignorata
+int bench_connect(const char *host, const char *port, int timeout_ms);
+int bench_send_all(int fd, const char *data, size_t len);
+void out_reserve(out_buffer_t *out, size_t extra);
+void encode_command(out_buffer_t *out, int argc, const char *const *argv, const size_t *lens);
+long parse_reply(const char *buf, size_t len, reply_kind_e *kind);
+int read_reply(int fd, out_buffer_t *in, reply_kind_e *kind);
+
+#endif //BENCH_UTIL_H
@@ -0,0 +1,417 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Simulatore offline: esegue una trace (PODCACHE_TRACE_FILE) contro pod_cache in modalità
+ * accounting (nessun valore copiato, nessuna scrittura su disco) per ogni combinazione di
+ * policy, partizioni e capacità richiesta, in parallelo, e stampa le curve di miss ratio.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "clogger.h"
+#include "pod_cache.h"
+#include "trace.h"
+
+#define SIM_MAX_LIST 64
+
+/* policy disponibili: il tier in memoria di pod_cache è sempre LRU, il disco è opzionale */
+typedef struct {
+    const char *name;
+    const char *description;
+    bool disk_tier;
+    unsigned disk_admission; // letture richieste per entrare nel tier su disco (0: tutte)
+} sim_policy_t;
+
+static const sim_policy_t policies[] = {
+    {"lru", "LRU memory tier, evictions demoted to the disk tier (server default)", true, 0},
+    {"lru-nodisk", "LRU memory tier only, evicted keys are dropped", false, 0},
+    {"lru-admit", "LRU memory tier, only keys read at least once demoted to disk", true, 1},
+    {"lru-admit2", "LRU memory tier, only keys read at least twice demoted to disk", true, 2},
+};
+#define POLICY_COUNT (sizeof(policies) / sizeof(policies[0]))
+
+typedef struct {
+    const sim_policy_t *policy;
+    unsigned partitions;
+    size_t capacity;
+
+    // risultati
+    uint64_t reads;
+    pod_cache_stats_t stats;
+    double seconds;
+    int failed;
+} sim_run_t;
+
+typedef struct {
+    const trace_file_t *trace;
+    size_t count;
+    sim_run_t *runs;
+    size_t run_count;
+    size_t next_run; // indice del prossimo run da eseguire (atomico)
+} sim_shared_t;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] TRACE\n"
+            "  -c, --capacities LIST  cache sizes, e.g. 16M,64M,256M,1G or 1M-1G (doubling)\n"
+            "                         (default 1M-1G; plain numbers are MB)\n"
+            "  -P, --partitions LIST  partition counts (default 1)\n"
+            "  -p, --policies LIST    policies (default lru), see -l\n"
+            "  -j, --jobs N           parallel simulations (default: online CPUs)\n"
+            "  -n, --limit N          use only the first N records\n"
+            "      --csv              CSV output\n"
+            "  -l, --list             list policies\n",
+            prog);
+}
+
+/* =============================================
+ * argument lists
+ * ============================================= */
+
+static int parse_size(const char *text, size_t *out) {
+    char *endptr;
+    double value = strtod(text, &endptr);
+    if (endptr == text || value <= 0) return -1;
+
+    double multiplier = 1024.0 * 1024.0;
+    switch (*endptr) {
+    case 'k':
+    case 'K':
+        multiplier = 1024.0;
+        endptr++;
+        break;
+    case 'm':
+    case 'M':
+        endptr++;
+        break;
+    case 'g':
+    case 'G':
+        multiplier = 1024.0 * 1024.0 * 1024.0;
+        endptr++;
+        break;
+    default:
+        break;
+    }
+    if (*endptr != '\0') return -1;
+    *out = (size_t)(value * multiplier);
+    return 0;
+}
+
+static int parse_capacities(const char *spec, size_t *out, int max) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    // intervallo A-B: raddoppi da A fino a B compreso
+    char *dash = strchr(buffer, '-');
+    if (dash && !strchr(buffer, ',')) {
+        *dash = '\0';
+        size_t from, to;
+        if (parse_size(buffer, &from) != 0 || parse_size(dash + 1, &to) != 0 || from > to) return -1;
+        int n = 0;
+        for (size_t c = from; c <= to && n < max; c *= 2) out[n++] = c;
+        return n;
+    }
+
+    int n = 0;
+    for (char *tok = strtok(buffer, ","); tok && n < max; tok = strtok(NULL, ",")) {
+        if (parse_size(tok, &out[n]) != 0) return -1;
+        n++;
+    }
+    return n;
+}
+
+static int parse_partitions(const char *spec, unsigned *out, int max) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    int n = 0;
+    for (char *tok = strtok(buffer, ","); tok && n < max; tok = strtok(NULL, ",")) {
+        char *endptr;
+        unsigned long value = strtoul(tok, &endptr, 10);
+        if (*endptr != '\0' || value == 0 || value > 65535) return -1;
+        out[n++] = (unsigned)value;
+    }
+    return n;
+}
+
+static int parse_policies(const char *spec, const sim_policy_t **out, int max) {
+    char buffer[256];
+    snprintf(buffer, sizeof(buffer), "%s", spec);
+
+    int n = 0;
+    for (char *tok = strtok(buffer, ","); tok && n < max; tok = strtok(NULL, ",")) {
+        const sim_policy_t *found = NULL;
+        for (size_t i = 0; i < POLICY_COUNT; i++) {
+            if (strcmp(policies[i].name, tok) == 0) found = &policies[i];
+        }
+        if (!found) {
+            fprintf(stderr, "unknown policy: %s\n", tok);
+            return -1;
+        }
+        out[n++] = found;
+    }
+    return n;
+}
+
+/* =============================================
+ * simulation
+ * ============================================= */
+
+static void format_key(char *out, uint64_t key_hash) {
+    static const char hex[] = "0123456789abcdef";
+    memcpy(out, "trace:", 6);
+    for (int i = 15; i >= 0; i--) {
+        out[6 + i] = hex[key_hash & 0xf];
+        key_hash >>= 4;
+    }
+    out[22] = '\0';
+}
+
+static void simulate(const trace_file_t *trace, size_t count, sim_run_t *run) {
+    pod_cache_t *cache = pod_cache_create_accounting(run->capacity, (u_short)run->partitions);
+    if (!cache) {
+        run->failed = 1;
+        return;
+    }
+    if (pod_cache_set_disk_admission(cache, run->policy->disk_admission) != 0) {
+        pod_cache_destroy(cache);
+        run->failed = 1;
+        return;
+    }
+
+    uint64_t start = bench_now_ns();
+    char key[32];
+    void *value;
+    size_t value_size;
+
+    for (size_t i = 0; i < count; i++) {
+        const trace_record_t *record = &trace->records[i];
+        format_key(key, record->key_hash);
+
+        switch (record->command) {
+        case RESP_GET:
+            run->reads++;
+            pod_cache_get(cache, key, &value, &value_size);
+            break;
+        case RESP_SET:
+            pod_cache_put(cache, key, NULL, record->value_size);
+            break;
+        case RESP_INCR:
+            // la dimensione del numero cambia di rado: si riscrive con la stessa dimensione
+            run->reads++;
+            if (pod_cache_get(cache, key, &value, &value_size) < 0) value_size = 1;
+            pod_cache_put(cache, key, NULL, value_size);
+            break;
+        case RESP_DEL:
+        case RESP_UNLINK:
+            pod_cache_evict(cache, key);
+            break;
+        default:
+            break;
+        }
+
+        // senza tier su disco le chiavi spostate sono semplicemente scartate
+        if (!run->policy->disk_tier && cache->disk_index->head) {
+            while (cache->disk_index->tail) lru_cache_remove_tail(cache->disk_index);
+        }
+    }
+
+    run->seconds = (double)(bench_now_ns() - start) / 1e9;
+    pod_cache_get_stats(cache, &run->stats);
+    pod_cache_destroy(cache);
+}
+
+static void *sim_worker(void *arg) {
+    sim_shared_t *shared = arg;
+    for (;;) {
+        size_t index = __atomic_fetch_add(&shared->next_run, 1, __ATOMIC_RELAXED);
+        if (index >= shared->run_count) break;
+        simulate(shared->trace, shared->count, &shared->runs[index]);
+    }
+    return NULL;
+}
+
+/* =============================================
+ * output
+ * ============================================= */
+
+static void format_capacity(char *out, size_t out_size, size_t capacity) {
+    if (capacity >= 1024ULL * 1024 * 1024 && capacity % (1024ULL * 1024 * 1024) == 0) {
+        snprintf(out, out_size, "%zuG", (size_t)(capacity / (1024ULL * 1024 * 1024)));
+    } else if (capacity >= 1024 * 1024 && capacity % (1024 * 1024) == 0) {
+        snprintf(out, out_size, "%zuM", capacity / (1024 * 1024));
+    } else {
+        snprintf(out, out_size, "%zuK", capacity / 1024);
+    }
+}
+
+static double ratio(uint64_t part, uint64_t total) {
+    return total ? (double)part / (double)total : 0.0;
+}
+
+static void print_results(const sim_run_t *runs, size_t run_count, bool csv) {
+    if (csv) {
+        printf("policy,partitions,capacity_bytes,reads,memory_hits,disk_hits,misses,"
+               "memory_miss_ratio,miss_ratio,demotions,promotions,disk_rejections,seconds\n");
+    } else {
+        printf("%-12s %5s %8s %12s %10s %10s %10s %10s\n", "policy", "parts", "capacity",
+               "reads", "mem-miss", "miss", "demotions", "seconds");
+    }
+
+    for (size_t i = 0; i < run_count; i++) {
+        const sim_run_t *run = &runs[i];
+        if (run->failed) {
+            fprintf(stderr, "simulation %s/%u/%zu failed\n", run->policy->name, run->partitions,
+                    run->capacity);
+            continue;
+        }
+        uint64_t lookups = run->stats.memory_hits + run->stats.disk_hits + run->stats.misses;
+        double memory_miss = 1.0 - ratio(run->stats.memory_hits, lookups);
+        double miss = ratio(run->stats.misses, lookups);
+
+        if (csv) {
+            printf("%s,%u,%zu,%llu,%llu,%llu,%llu,%.6f,%.6f,%llu,%llu,%llu,%.3f\n",
+                   run->policy->name, run->partitions, run->capacity,
+                   (unsigned long long)run->reads,
+                   (unsigned long long)run->stats.memory_hits,
+                   (unsigned long long)run->stats.disk_hits,
+                   (unsigned long long)run->stats.misses, memory_miss, miss,
+                   (unsigned long long)run->stats.demotions,
+                   (unsigned long long)run->stats.promotions,
+                   (unsigned long long)run->stats.disk_rejections, run->seconds);
+        } else {
+            char capacity[32];
+            format_capacity(capacity, sizeof(capacity), run->capacity);
+            printf("%-12s %5u %8s %12llu %9.2f%% %9.2f%% %10llu %10.2f\n", run->policy->name,
+                   run->partitions, capacity, (unsigned long long)run->reads, 100.0 * memory_miss,
+                   100.0 * miss, (unsigned long long)run->stats.demotions, run->seconds);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    static const struct option long_options[] = {
+        {"capacities", required_argument, NULL, 'c'},
+        {"partitions", required_argument, NULL, 'P'},
+        {"policies", required_argument, NULL, 'p'},
+        {"jobs", required_argument, NULL, 'j'},
+        {"limit", required_argument, NULL, 'n'},
+        {"csv", no_argument, NULL, 'C'},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    size_t capacities[SIM_MAX_LIST];
+    unsigned partitions[SIM_MAX_LIST];
+    const sim_policy_t *selected[SIM_MAX_LIST];
+    int capacity_count = parse_capacities("1M-1G", capacities, SIM_MAX_LIST);
+    int partition_count = parse_partitions("1", partitions, SIM_MAX_LIST);
+    int policy_count = parse_policies("lru", selected, SIM_MAX_LIST);
+    long jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t limit = 0;
+    bool csv = false;
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "c:P:p:j:n:lh", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'c':
+            capacity_count = parse_capacities(optarg, capacities, SIM_MAX_LIST);
+            break;
+        case 'P':
+            partition_count = parse_partitions(optarg, partitions, SIM_MAX_LIST);
+            break;
+        case 'p':
+            policy_count = parse_policies(optarg, selected, SIM_MAX_LIST);
+            break;
+        case 'j':
+            jobs = strtol(optarg, NULL, 10);
+            break;
+        case 'n':
+            limit = strtoull(optarg, NULL, 10);
+            break;
+        case 'C':
+            csv = true;
+            break;
+        case 'l':
+            for (size_t i = 0; i < POLICY_COUNT; i++) {
+                printf("%-12s %s\n", policies[i].name, policies[i].description);
+            }
+            return EXIT_SUCCESS;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (optind != argc - 1 || capacity_count <= 0 || partition_count <= 0 || policy_count <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (jobs < 1) jobs = 1;
+
+    clog_init(LOG_LEVEL_ERROR, NULL);
+
+    trace_file_t trace;
+    if (trace_file_open(&trace, argv[optind]) != 0) {
+        fprintf(stderr, "cannot read trace %s\n", argv[optind]);
+        return EXIT_FAILURE;
+    }
+
+    size_t run_count = (size_t)policy_count * (size_t)partition_count * (size_t)capacity_count;
+    sim_run_t *runs = calloc(run_count, sizeof(sim_run_t));
+    if (!runs) {
+        perror("calloc");
+        trace_file_close(&trace);
+        return EXIT_FAILURE;
+    }
+
+    size_t r = 0;
+    for (int p = 0; p < policy_count; p++) {
+        for (int n = 0; n < partition_count; n++) {
+            for (int c = 0; c < capacity_count; c++) {
+                runs[r].policy = selected[p];
+                runs[r].partitions = partitions[n];
+                runs[r].capacity = capacities[c];
+                r++;
+            }
+        }
+    }
+
+    sim_shared_t shared = {
+        .trace = &trace,
+        .count = limit && limit < trace.count ? (size_t)limit : trace.count,
+        .runs = runs,
+        .run_count = run_count,
+    };
+    if ((size_t)jobs > run_count) jobs = (long)run_count;
+
+    fprintf(stderr, "Simulating %zu records x %zu configurations on %ld threads\n", shared.count,
+            run_count, jobs);
+
+    uint64_t start = bench_now_ns();
+    pthread_t *threads = malloc((size_t)jobs * sizeof(pthread_t));
+    for (long i = 0; i < jobs; i++) {
+        pthread_create(&threads[i], NULL, sim_worker, &shared);
+    }
+    for (long i = 0; i < jobs; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    fprintf(stderr, "Done in %.2fs\n", (double)(bench_now_ns() - start) / 1e9);
+
+    print_results(runs, run_count, csv);
+
+    free(threads);
+    free(runs);
+    trace_file_close(&trace);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,472 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Benchmark del tier su disco: throughput e latenza di cas_put/cas_get/cas_evict e delle
+ * demotion/promotion end-to-end di pod_cache, sulla directory indicata (tmpfs, disco vero o
+ * un volume simulato con faultfs). Gli errori di I/O non interrompono il benchmark: vengono
+ * contati, così si vede come degrada la cache quando il volume è lento o pieno.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench_util.h"
+#include "cas.h"
+#include "clogger.h"
+#include "pod_cache.h"
+
+#define DB_MAX_THREADS 64
+
+typedef enum {
+    PHASE_CAS_PUT,
+    PHASE_CAS_GET,
+    PHASE_CAS_EVICT,
+    PHASE_DEMOTE,
+    PHASE_PROMOTE,
+    PHASE_COUNT
+} phase_e;
+
+static const char *phase_names[PHASE_COUNT] = {"cas_put", "cas_get", "cas_evict", "demote",
+                                               "promote"};
+
+typedef struct {
+    uint64_t ops;
+    uint64_t errors;
+    uint64_t bytes;
+    double seconds;
+    latency_hist_t latency;
+} phase_result_t;
+
+typedef struct {
+    int threads;
+    uint64_t keys;
+    size_t memory_mb;
+    size_t value_size;
+    const char *filter;
+    const char *json_path;
+    size_t demote_batch; // chiavi per demotion a gruppi
+    cas_sync_e sync;
+    disk_io_backend_e io; // motore di I/O del tier su disco
+} db_config_t;
+
+typedef struct {
+    phase_e phase;
+    int id;
+    const db_config_t *config;
+    cas_registry_t *registry;
+    pod_cache_t *cache;
+    const uint64_t *key_ids; // chiavi da usare, suddivise tra i thread
+    uint64_t key_count;
+    const char *value;
+    phase_result_t result;
+} db_worker_t;
+
+static void format_key(char *out, size_t out_size, uint64_t id) {
+    snprintf(out, out_size, "disk:%08llu", (unsigned long long)id);
+}
+
+/* =============================================
+ * worker
+ * ============================================= */
+
+static void *phase_worker(void *arg) {
+    db_worker_t *w = arg;
+    const db_config_t *config = w->config;
+    uint64_t from = w->key_count * (uint64_t)w->id / (uint64_t)config->threads;
+    uint64_t to = w->key_count * (uint64_t)(w->id + 1) / (uint64_t)config->threads;
+    char key[64];
+    char output_path[512];
+
+    for (uint64_t i = from; i < to; i++) {
+        format_key(key, sizeof(key), w->key_ids[i]);
+        void *buffer = NULL;
+        size_t size = 0;
+        int rc = 0;
+
+        uint64_t t0 = bench_now_ns();
+        switch (w->phase) {
+        case PHASE_CAS_PUT:
+            // come demote_tail: scrittura e registrazione del path
+            rc = cas_put(w->registry, key, (void *)w->value, config->value_size, output_path);
+            size = config->value_size;
+            break;
+        case PHASE_CAS_GET:
+            rc = cas_get(w->registry, key, &buffer, &size);
+            break;
+        case PHASE_CAS_EVICT:
+            rc = cas_evict(key, w->registry);
+            break;
+        case PHASE_DEMOTE:
+            // la partizione è piena: ogni put sposta su disco almeno un elemento
+            rc = pod_cache_put(w->cache, key, (void *)w->value, config->value_size) < 0 ? -1 : 0;
+            size = config->value_size;
+            break;
+        case PHASE_PROMOTE:
+            rc = pod_cache_get(w->cache, key, &buffer, &size) < 0 ? -1 : 0;
+            break;
+        default:
+            break;
+        }
+        uint64_t latency = bench_now_ns() - t0;
+        free(buffer);
+
+        w->result.ops++;
+        if (rc != 0) {
+            w->result.errors++;
+            continue;
+        }
+        w->result.bytes += size;
+        hist_record(&w->result.latency, latency);
+    }
+    return NULL;
+}
+
+static void run_phase(phase_e phase, const db_config_t *config, cas_registry_t *registry,
+                      pod_cache_t *cache, const uint64_t *key_ids, uint64_t key_count,
+                      const char *value, phase_result_t *out) {
+    db_worker_t workers[DB_MAX_THREADS];
+    pthread_t tids[DB_MAX_THREADS];
+
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < config->threads; i++) {
+        workers[i] = (db_worker_t){
+            .phase = phase,
+            .id = i,
+            .config = config,
+            .registry = registry,
+            .cache = cache,
+            .key_ids = key_ids,
+            .key_count = key_count,
+            .value = value,
+        };
+        hist_init(&workers[i].result.latency);
+        pthread_create(&tids[i], NULL, phase_worker, &workers[i]);
+    }
+
+    memset(out, 0, sizeof(*out));
+    hist_init(&out->latency);
+    for (int i = 0; i < config->threads; i++) {
+        pthread_join(tids[i], NULL);
+        out->ops += workers[i].result.ops;
+        out->errors += workers[i].result.errors;
+        out->bytes += workers[i].result.bytes;
+        hist_merge(&out->latency, &workers[i].result.latency);
+    }
+    out->seconds = (double)(bench_now_ns() - start) / 1e9;
+}
+
+static bool phase_selected(const db_config_t *config, phase_e phase) {
+    return !config->filter || strstr(phase_names[phase], config->filter) != NULL;
+}
+
+static void shuffle(uint64_t *ids, uint64_t count, bench_rng_t *rng) {
+    for (uint64_t i = count; i > 1; i--) {
+        uint64_t j = bench_rng_range(rng, i);
+        uint64_t tmp = ids[i - 1];
+        ids[i - 1] = ids[j];
+        ids[j] = tmp;
+    }
+}
+
+/* =============================================
+ * phases
+ * ============================================= */
+
+static void run_cas_phases(const db_config_t *config, const char *value, uint64_t *ids,
+                           bench_rng_t *rng, phase_result_t *results, bool *ran) {
+    cas_registry_t *registry = cas_create_registry();
+    if (!registry) {
+        fprintf(stderr, "cannot create CAS registry\n");
+        return;
+    }
+    cas_set_sync(registry, config->sync);
+    if (cas_set_io(registry, config->io) != 0) {
+        fprintf(stderr, "disk I/O backend not available\n");
+        cas_registry_destroy(registry);
+        return;
+    }
+    printf("cas: disk I/O on %s\n", cas_io_backend(registry));
+
+    for (uint64_t i = 0; i < config->keys; i++) ids[i] = i;
+    run_phase(PHASE_CAS_PUT, config, registry, NULL, ids, config->keys, value,
+              &results[PHASE_CAS_PUT]);
+    ran[PHASE_CAS_PUT] = true;
+
+    shuffle(ids, config->keys, rng);
+    if (phase_selected(config, PHASE_CAS_GET)) {
+        run_phase(PHASE_CAS_GET, config, registry, NULL, ids, config->keys, value,
+                  &results[PHASE_CAS_GET]);
+        ran[PHASE_CAS_GET] = true;
+    }
+    if (phase_selected(config, PHASE_CAS_EVICT)) {
+        run_phase(PHASE_CAS_EVICT, config, registry, NULL, ids, config->keys, value,
+                  &results[PHASE_CAS_EVICT]);
+        ran[PHASE_CAS_EVICT] = true;
+    }
+
+    cas_registry_destroy(registry);
+}
+
+static void run_cache_phases(const db_config_t *config, const char *value, uint64_t *ids,
+                             bench_rng_t *rng, phase_result_t *results, bool *ran) {
+    pod_cache_t *cache = pod_cache_create(MB_TO_BYTES(config->memory_mb), 1);
+    if (!cache) {
+        fprintf(stderr, "cannot create pod_cache\n");
+        return;
+    }
+    pod_cache_set_demote_batch(cache, config->demote_batch, POD_CACHE_DEMOTE_BATCH_BYTES);
+    pod_cache_set_disk_sync(cache, config->sync);
+    if (pod_cache_set_disk_io(cache, config->io) != 0) {
+        fprintf(stderr, "disk I/O backend not available\n");
+        pod_cache_destroy(cache);
+        return;
+    }
+
+    // riempie la memoria senza misurare, poi ogni put misurata causa una demotion
+    uint64_t resident = MB_TO_BYTES(config->memory_mb) / config->value_size;
+    for (uint64_t i = 0; i < resident; i++) {
+        char key[64];
+        format_key(key, sizeof(key), config->keys + i);
+        pod_cache_put(cache, key, (void *)value, config->value_size);
+    }
+
+    for (uint64_t i = 0; i < config->keys; i++) ids[i] = i;
+    run_phase(PHASE_DEMOTE, config, NULL, cache, ids, config->keys, value,
+              &results[PHASE_DEMOTE]);
+    ran[PHASE_DEMOTE] = true;
+
+    if (phase_selected(config, PHASE_PROMOTE)) {
+        // svuota la memoria: le chiavi rimaste esistono solo su disco e la promozione ha spazio
+        uint64_t total = config->keys + resident;
+        bool *evicted = calloc(total, sizeof(bool));
+        lru_cache_t *partition = cache->partitions[0];
+        pthread_mutex_lock(&partition->mutex);
+        while (partition->head) {
+            char key[64];
+            snprintf(key, sizeof(key), "%s", partition->head->key);
+            uint64_t id = strtoull(key + strlen("disk:"), NULL, 10);
+            if (id < total) evicted[id] = true;
+            pod_cache_evict(cache, key);
+        }
+        pthread_mutex_unlock(&partition->mutex);
+
+        uint64_t *disk_ids = malloc(total * sizeof(uint64_t));
+        uint64_t on_disk = 0;
+        for (uint64_t i = 0; i < total; i++) {
+            if (!evicted[i]) disk_ids[on_disk++] = i;
+        }
+        free(evicted);
+        shuffle(disk_ids, on_disk, rng);
+        // solo quante ne entrano in memoria, altrimenti la promozione non avviene
+        uint64_t promotable = resident > 0 ? resident - 1 : 0;
+        if (promotable > on_disk) promotable = on_disk;
+
+        run_phase(PHASE_PROMOTE, config, NULL, cache, disk_ids, promotable, value,
+                  &results[PHASE_PROMOTE]);
+        ran[PHASE_PROMOTE] = true;
+        free(disk_ids);
+
+        pod_cache_stats_t stats;
+        pod_cache_get_stats(cache, &stats);
+        printf("pod_cache: demotions %llu (%llu clean), promotions %llu, disk hits %llu, "
+               "misses %llu\n",
+               (unsigned long long)stats.demotions, (unsigned long long)stats.clean_demotions,
+               (unsigned long long)stats.promotions,
+               (unsigned long long)stats.disk_hits, (unsigned long long)stats.misses);
+    }
+    pod_cache_stats_t stats;
+    pod_cache_get_stats(cache, &stats);
+    printf("pod_cache: %llu demotion batches, %llu syncs\n",
+           (unsigned long long)stats.demote_batches, (unsigned long long)stats.disk_syncs);
+
+    pod_cache_destroy(cache);
+}
+
+/* =============================================
+ * output
+ * ============================================= */
+
+static void print_results(const phase_result_t *results, const bool *ran) {
+    printf("\n%-10s %8s %7s %10s %9s %9s %9s %9s %9s\n", "phase", "ops", "errors", "ops/s", "MB/s",
+           "p50 us", "p99 us", "p99.9 us", "max us");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (!ran[p]) continue;
+        const phase_result_t *r = &results[p];
+        printf("%-10s %8llu %7llu %10.0f %9.2f %9.1f %9.1f %9.1f %9.1f\n", phase_names[p],
+               (unsigned long long)r->ops, (unsigned long long)r->errors,
+               r->seconds > 0 ? (double)r->ops / r->seconds : 0.0,
+               r->seconds > 0 ? BYTES_TO_MB(r->bytes) / r->seconds : 0.0,
+               hist_percentile(&r->latency, 50) / 1000.0, hist_percentile(&r->latency, 99) / 1000.0,
+               hist_percentile(&r->latency, 99.9) / 1000.0, r->latency.max / 1000.0);
+    }
+}
+
+static int write_json(const db_config_t *config, const char *root, const phase_result_t *results,
+                      const bool *ran) {
+    bool to_stdout = strcmp(config->json_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : fopen(config->json_path, "w");
+    if (!out) {
+        perror(config->json_path);
+        return -1;
+    }
+
+    fprintf(out,
+            "{\n  \"tool\": \"podcache_diskbench\",\n  \"fsroot\": \"%s\",\n"
+            "  \"config\": {\"threads\": %d, \"keys\": %llu, \"value_size\": %zu, "
+            "\"memory_mb\": %zu},\n  \"phases\": {",
+            root, config->threads, (unsigned long long)config->keys, config->value_size,
+            config->memory_mb);
+    bool first = true;
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        if (!ran[p]) continue;
+        const phase_result_t *r = &results[p];
+        fprintf(out,
+                "%s\n    \"%s\": {\"ops\": %llu, \"errors\": %llu, \"ops_per_s\": %.1f, "
+                "\"mb_per_s\": %.3f, \"latency_us\": ",
+                first ? "" : ",", phase_names[p], (unsigned long long)r->ops,
+                (unsigned long long)r->errors, r->seconds > 0 ? (double)r->ops / r->seconds : 0.0,
+                r->seconds > 0 ? BYTES_TO_MB(r->bytes) / r->seconds : 0.0);
+        hist_print_json(out, &r->latency);
+        fprintf(out, "}");
+        first = false;
+    }
+    fprintf(out, "\n  }\n}\n");
+
+    if (!to_stdout) fclose(out);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -D, --dir PATH       disk tier root, as PODCACHE_FSROOT (default: PODCACHE_FSROOT)\n"
+            "  -n, --keys N         keys per phase (default 2000)\n"
+            "  -v, --value-size N   value size in bytes (default 4096)\n"
+            "  -m, --memory MB      memory tier for the demote/promote phases (default 1)\n"
+            "  -t, --threads N      threads per phase (default 1)\n"
+            "  -b, --batch N        keys per demotion batch (default 16, 1 = one at a time)\n"
+            "  -s, --sync POLICY    none or batch: one syncfs per cas_put / demotion batch\n"
+            "                       (default none)\n"
+            "  -i, --io BACKEND     disk I/O engine: auto, uring or threads (default auto;\n"
+            "                       use threads under faultfs, which cannot see io_uring)\n"
+            "  -f, --filter NAME    run only phases containing NAME (cas_put/demote always run\n"
+            "                       as setup for the phases after them)\n"
+            "      --json FILE      write results as JSON ('-' = stdout)\n"
+            "\n"
+            "Phases: cas_put, cas_get, cas_evict (CAS primitives), demote (pod_cache_put on a\n"
+            "full partition), promote (pod_cache_get of a key that lives only on disk).\n"
+            "Run under faultfs (LD_PRELOAD) to simulate a slow or full volume.\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    db_config_t config = {
+        .threads = 1,
+        .keys = 2000,
+        .memory_mb = 1,
+        .value_size = 4096,
+        .demote_batch = POD_CACHE_DEMOTE_BATCH_KEYS,
+        .sync = CAS_SYNC_NONE,
+        .io = DISK_IO_AUTO,
+    };
+    const char *dir = NULL;
+
+    static const struct option options[] = {
+        {"dir", required_argument, NULL, 'D'},
+        {"keys", required_argument, NULL, 'n'},
+        {"value-size", required_argument, NULL, 'v'},
+        {"memory", required_argument, NULL, 'm'},
+        {"threads", required_argument, NULL, 't'},
+        {"batch", required_argument, NULL, 'b'},
+        {"sync", required_argument, NULL, 's'},
+        {"io", required_argument, NULL, 'i'},
+        {"filter", required_argument, NULL, 'f'},
+        {"json", required_argument, NULL, 1},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "D:n:v:m:t:b:s:i:f:h", options, NULL)) != -1) {
+        switch (opt) {
+        case 'D': dir = optarg; break;
+        case 'n': config.keys = strtoull(optarg, NULL, 10); break;
+        case 'v': config.value_size = strtoul(optarg, NULL, 10); break;
+        case 'm': config.memory_mb = strtoul(optarg, NULL, 10); break;
+        case 't': config.threads = atoi(optarg); break;
+        case 'b': config.demote_batch = strtoul(optarg, NULL, 10); break;
+        case 's':
+            config.sync = strcmp(optarg, "batch") == 0 ? CAS_SYNC_BATCH : CAS_SYNC_NONE;
+            break;
+        case 'i':
+            config.io = strcmp(optarg, "uring") == 0     ? DISK_IO_URING
+                        : strcmp(optarg, "threads") == 0 ? DISK_IO_THREADS
+                                                         : DISK_IO_AUTO;
+            break;
+        case 'f': config.filter = optarg; break;
+        case 1: config.json_path = optarg; break;
+        default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (config.keys == 0 || config.value_size == 0 || config.memory_mb == 0 ||
+        config.threads < 1 || config.threads > DB_MAX_THREADS ||
+        config.value_size >= MB_TO_BYTES(config.memory_mb)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // cas.c concatena la radice e il nome della directory: serve la '/' finale
+    char root[512];
+    if (dir) {
+        size_t len = strlen(dir);
+        snprintf(root, sizeof(root), "%s%s", dir, len > 0 && dir[len - 1] == '/' ? "" : "/");
+        setenv("PODCACHE_FSROOT", root, 1);
+    } else {
+        const char *env_root = getenv("PODCACHE_FSROOT");
+        snprintf(root, sizeof(root), "%s", env_root ? env_root : "./");
+    }
+
+    clog_init(LOG_LEVEL_FATAL, NULL);
+
+    char *value = malloc(config.value_size);
+    uint64_t *ids = malloc(config.keys * sizeof(uint64_t));
+    if (!value || !ids) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (size_t i = 0; i < config.value_size; i++) value[i] = (char)('a' + i % 26);
+
+    bench_rng_t rng;
+    bench_rng_seed(&rng, 42);
+
+    printf("disk tier bench: root %s, %llu keys x %zu bytes, %d threads, memory tier %zu MB\n",
+           root, (unsigned long long)config.keys, config.value_size, config.threads,
+           config.memory_mb);
+
+    phase_result_t *results = calloc(PHASE_COUNT, sizeof(phase_result_t));
+    bool ran[PHASE_COUNT] = {false};
+
+    if (phase_selected(&config, PHASE_CAS_PUT) || phase_selected(&config, PHASE_CAS_GET) ||
+        phase_selected(&config, PHASE_CAS_EVICT)) {
+        run_cas_phases(&config, value, ids, &rng, results, ran);
+    }
+    if (phase_selected(&config, PHASE_DEMOTE) || phase_selected(&config, PHASE_PROMOTE)) {
+        run_cache_phases(&config, value, ids, &rng, results, ran);
+    }
+
+    print_results(results, ran);
+    int rc = EXIT_SUCCESS;
+    if (config.json_path && write_json(&config, root, results, ran) != 0) rc = EXIT_FAILURE;
+
+    free(results);
+    free(ids);
+    free(value);
+    return rc;
+}
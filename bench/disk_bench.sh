@@ -0,0 +1,112 @@
+#!/bin/bash
+
+# PodCache disk tier benchmark
+# Esegue podcache_diskbench su tmpfs, su un filesystem reale e su un volume simulato lento o
+# pieno (faultfs via LD_PRELOAD). Con --server ripete gli scenari lento/pieno end-to-end:
+# server sotto faultfs e podcache_loadgen, per vedere come degradano SET e GET.
+#
+# Usage: bench/disk_bench.sh [--build DIR] [--disk DIR] [--keys N] [--server] [--json-dir DIR]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="$SCRIPT_DIR/../build"
+DISK_DIR="${TMPDIR:-/tmp}"
+KEYS=2000
+RUN_SERVER=0
+JSON_DIR=""
+SERVER_PORT=6391
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --build) BUILD_DIR="$2"; shift 2 ;;
+        --disk) DISK_DIR="$2"; shift 2 ;;
+        --keys) KEYS="$2"; shift 2 ;;
+        --server) RUN_SERVER=1; shift ;;
+        --json-dir) JSON_DIR="$2"; shift 2 ;;
+        *) echo "unknown option: $1"; exit 1 ;;
+    esac
+done
+
+DISKBENCH="$BUILD_DIR/bench/podcache_diskbench"
+LOADGEN="$BUILD_DIR/bench/podcache_loadgen"
+FAULTFS="$BUILD_DIR/bench/libfaultfs.so"
+SERVER="$BUILD_DIR/podcache"
+
+if [ ! -x "$DISKBENCH" ] || [ ! -f "$FAULTFS" ]; then
+    echo "podcache_diskbench or libfaultfs.so not found in $BUILD_DIR, build the project first"
+    exit 1
+fi
+
+TMPFS_ROOT="/dev/shm/podcache-diskbench-$$"
+DISK_ROOT="$DISK_DIR/podcache-diskbench-$$"
+mkdir -p "$TMPFS_ROOT" "$DISK_ROOT"
+SERVER_PID=""
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -rf "$TMPFS_ROOT" "$DISK_ROOT"
+}
+trap cleanup EXIT
+
+# scenario: nome, directory, variabili faultfs (opzionali)
+run_scenario() {
+    local name="$1" root="$2"
+    shift 2
+    local json_args=()
+    [ -n "$JSON_DIR" ] && json_args=(--json "$JSON_DIR/diskbench-$name.json")
+
+    echo
+    echo "=== $name ($root) ==="
+    # faultfs intercetta solo le system call classiche: sotto lo shim niente io_uring
+    if [ $# -gt 0 ]; then
+        env FAULTFS_PREFIX="$root" "$@" LD_PRELOAD="$FAULTFS" \
+            "$DISKBENCH" -D "$root" -n "$KEYS" -i threads "${json_args[@]}"
+    else
+        "$DISKBENCH" -D "$root" -n "$KEYS" "${json_args[@]}"
+    fi
+}
+
+SLOW_ENV=(FAULTFS_IO_DELAY_US=500 FAULTFS_OPEN_DELAY_US=200 FAULTFS_SPIKE_RATE=0.01 FAULTFS_SPIKE_US=50000)
+# metà dei valori scritti dal benchmark trova spazio, poi il volume è pieno
+FULL_ENV=(FAULTFS_ENOSPC_AFTER=$((KEYS * 4096 / 2)))
+
+[ -n "$JSON_DIR" ] && mkdir -p "$JSON_DIR"
+
+run_scenario tmpfs "$TMPFS_ROOT"
+run_scenario disk "$DISK_ROOT"
+run_scenario slow "$DISK_ROOT" "${SLOW_ENV[@]}"
+run_scenario full "$DISK_ROOT" "${FULL_ENV[@]}"
+
+if [ "$RUN_SERVER" -eq 1 ]; then
+    if [ ! -x "$SERVER" ] || [ ! -x "$LOADGEN" ]; then
+        echo "podcache or podcache_loadgen not found in $BUILD_DIR"
+        exit 1
+    fi
+
+    # 2 MB di memoria e ~6 MB di dati: la maggior parte delle GET passa dal disco
+    run_server_scenario() {
+        local name="$1"
+        shift
+        echo
+        echo "=== server: $name ==="
+        env PODCACHE_SIZE=2 PODCACHE_SERVER_PORT=$SERVER_PORT PODCACHE_FSROOT="$DISK_ROOT/" \
+            PODCACHE_DISK_IO=threads FAULTFS_PREFIX="$DISK_ROOT" "$@" LD_PRELOAD="$FAULTFS" "$SERVER" > /dev/null 2>&1 &
+        SERVER_PID=$!
+        sleep 1
+        local json_args=()
+        [ -n "$JSON_DIR" ] && json_args=(--json "$JSON_DIR/server-$name.json")
+        "$LOADGEN" -p $SERVER_PORT -t 2 -c 4 -k 6000 -d fixed:1000 -r 0.8 -z uniform \
+            -T 10 --prefill "${json_args[@]}" || true
+        kill -INT "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        SERVER_PID=""
+    }
+
+    run_server_scenario baseline FAULTFS_IO_DELAY_US=0
+    run_server_scenario slow "${SLOW_ENV[@]}"
+    run_server_scenario full FAULTFS_ENOSPC_AFTER=5000000
+fi
@@ -0,0 +1,430 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Shim LD_PRELOAD per simulare un volume lento o pieno sotto il tier su disco, senza FUSE.
+ * Intercetta le chiamate di I/O (stdio e file descriptor) sui path che iniziano con
+ * FAULTFS_PREFIX e vi aggiunge ritardi, limiti di banda ed errori ENOSPC:
+ *
+ *   FAULTFS_PREFIX            path da colpire (obbligatorio, altrimenti lo shim non fa nulla)
+ *   FAULTFS_OPEN_DELAY_US     ritardo su open/fopen/mkdir
+ *   FAULTFS_IO_DELAY_US       ritardo su ogni read/write/fsync
+ *   FAULTFS_BANDWIDTH_KBPS    banda massima (KB/s) per le scritture e le letture
+ *   FAULTFS_SPIKE_RATE        probabilità (0-1) di un ritardo extra su una operazione
+ *   FAULTFS_SPIKE_US          durata del ritardo extra
+ *   FAULTFS_ENOSPC_AFTER      byte scrivibili prima che il volume risulti pieno
+ *   FAULTFS_ENOSPC_RATE       probabilità (0-1) che una scrittura fallisca con ENOSPC
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <time.h>
+#include <unistd.h>
+
+#define FAULTFS_MAX_FD 65536
+#define FAULTFS_MAX_STREAMS 1024
+
+typedef struct {
+    bool active;
+    char prefix[4096];
+    size_t prefix_len;
+    uint64_t open_delay_us;
+    uint64_t io_delay_us;
+    uint64_t bandwidth_kbps;
+    double spike_rate;
+    uint64_t spike_us;
+    int64_t enospc_after; // -1 = nessun limite
+    double enospc_rate;
+} faultfs_config_t;
+
+static faultfs_config_t config;
+static pthread_once_t init_once = PTHREAD_ONCE_INIT;
+static int64_t bytes_written = 0;
+
+// fd e stream aperti sotto il prefisso
+static uint8_t tracked_fds[FAULTFS_MAX_FD];
+static FILE *tracked_streams[FAULTFS_MAX_STREAMS];
+static pthread_mutex_t streams_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE *(*real_fopen)(const char *, const char *);
+static int (*real_fclose)(FILE *);
+static size_t (*real_fwrite)(const void *, size_t, size_t, FILE *);
+static size_t (*real_fread)(void *, size_t, size_t, FILE *);
+static int (*real_open)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_close)(int);
+static ssize_t (*real_write)(int, const void *, size_t);
+static ssize_t (*real_pwrite)(int, const void *, size_t, off_t);
+static ssize_t (*real_writev)(int, const struct iovec *, int);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_pread)(int, void *, size_t, off_t);
+static int (*real_fsync)(int);
+static int (*real_fdatasync)(int);
+static int (*real_mkdir)(const char *, mode_t);
+
+static uint64_t env_u64(const char *name) {
+    const char *value = getenv(name);
+    return value ? strtoull(value, NULL, 10) : 0;
+}
+
+static double env_double(const char *name) {
+    const char *value = getenv(name);
+    return value ? strtod(value, NULL) : 0.0;
+}
+
+static void faultfs_init(void) {
+    real_fopen = dlsym(RTLD_NEXT, "fopen");
+    real_fclose = dlsym(RTLD_NEXT, "fclose");
+    real_fwrite = dlsym(RTLD_NEXT, "fwrite");
+    real_fread = dlsym(RTLD_NEXT, "fread");
+    real_open = dlsym(RTLD_NEXT, "open");
+    real_openat = dlsym(RTLD_NEXT, "openat");
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_write = dlsym(RTLD_NEXT, "write");
+    real_pwrite = dlsym(RTLD_NEXT, "pwrite");
+    real_writev = dlsym(RTLD_NEXT, "writev");
+    real_read = dlsym(RTLD_NEXT, "read");
+    real_pread = dlsym(RTLD_NEXT, "pread");
+    real_fsync = dlsym(RTLD_NEXT, "fsync");
+    real_fdatasync = dlsym(RTLD_NEXT, "fdatasync");
+    real_mkdir = dlsym(RTLD_NEXT, "mkdir");
+
+    const char *prefix = getenv("FAULTFS_PREFIX");
+    if (!prefix || !*prefix) return;
+
+    snprintf(config.prefix, sizeof(config.prefix), "%s", prefix);
+    config.prefix_len = strlen(config.prefix);
+    config.open_delay_us = env_u64("FAULTFS_OPEN_DELAY_US");
+    config.io_delay_us = env_u64("FAULTFS_IO_DELAY_US");
+    config.bandwidth_kbps = env_u64("FAULTFS_BANDWIDTH_KBPS");
+    config.spike_rate = env_double("FAULTFS_SPIKE_RATE");
+    config.spike_us = env_u64("FAULTFS_SPIKE_US");
+    config.enospc_after =
+        getenv("FAULTFS_ENOSPC_AFTER") ? (int64_t)env_u64("FAULTFS_ENOSPC_AFTER") : -1;
+    config.enospc_rate = env_double("FAULTFS_ENOSPC_RATE");
+    config.active = true;
+
+    // niente stdio qui: fprintf passerebbe da write() mentre pthread_once è ancora in corso
+    char banner[512];
+    int len = snprintf(
+        banner, sizeof(banner),
+        "faultfs: prefix %s, open delay %lluus, io delay %lluus, bandwidth %llu KB/s, "
+        "spikes %.3f x %lluus, ENOSPC after %lld bytes, ENOSPC rate %.3f\n",
+        config.prefix, (unsigned long long)config.open_delay_us,
+        (unsigned long long)config.io_delay_us, (unsigned long long)config.bandwidth_kbps,
+        config.spike_rate, (unsigned long long)config.spike_us, (long long)config.enospc_after,
+        config.enospc_rate);
+    if (len > 0) {
+        size_t n = (size_t)len < sizeof(banner) ? (size_t)len : sizeof(banner) - 1;
+        real_write(STDERR_FILENO, banner, n);
+    }
+}
+
+static void ensure_init(void) { pthread_once(&init_once, faultfs_init); }
+
+/* =============================================
+ * helpers
+ * ============================================= */
+
+static double random_unit(void) {
+    static __thread uint64_t state = 0;
+    if (state == 0) {
+        state = (uint64_t)(uintptr_t)&state ^ (uint64_t)time(NULL) ^ 0x9e3779b97f4a7c15ULL;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return (double)((state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static void sleep_us(uint64_t us) {
+    if (us == 0) return;
+    struct timespec ts = {.tv_sec = (time_t)(us / 1000000),
+                          .tv_nsec = (long)(us % 1000000) * 1000};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+static bool path_matches(const char *path) {
+    if (!config.active || !path) return false;
+    if (path[0] == '/') return strncmp(path, config.prefix, config.prefix_len) == 0;
+
+    // path relativo: confronto sul path assoluto
+    char absolute[8192];
+    if (!getcwd(absolute, sizeof(absolute) - 1)) return false;
+    size_t len = strlen(absolute);
+    snprintf(absolute + len, sizeof(absolute) - len, "/%s", path);
+    return strncmp(absolute, config.prefix, config.prefix_len) == 0 ||
+           strncmp(path, config.prefix, config.prefix_len) == 0;
+}
+
+static void delay_io(size_t bytes) {
+    uint64_t us = config.io_delay_us;
+    if (config.bandwidth_kbps > 0) {
+        us += (uint64_t)bytes * 1000000ULL / (config.bandwidth_kbps * 1024);
+    }
+    if (config.spike_rate > 0 && random_unit() < config.spike_rate) us += config.spike_us;
+    sleep_us(us);
+}
+
+static void delay_open(void) {
+    uint64_t us = config.open_delay_us;
+    if (config.spike_rate > 0 && random_unit() < config.spike_rate) us += config.spike_us;
+    sleep_us(us);
+}
+
+// riserva 'bytes' nella quota; false se il volume è "pieno"
+static bool reserve_space(size_t bytes) {
+    if (config.enospc_rate > 0 && random_unit() < config.enospc_rate) return false;
+    if (config.enospc_after < 0) return true;
+    int64_t after = __atomic_add_fetch(&bytes_written, (int64_t)bytes, __ATOMIC_RELAXED);
+    if (after > config.enospc_after) {
+        __atomic_sub_fetch(&bytes_written, (int64_t)bytes, __ATOMIC_RELAXED);
+        return false;
+    }
+    return true;
+}
+
+static bool volume_full(void) {
+    return config.enospc_after >= 0 &&
+           __atomic_load_n(&bytes_written, __ATOMIC_RELAXED) >= config.enospc_after;
+}
+
+static bool fd_tracked(int fd) { return fd >= 0 && fd < FAULTFS_MAX_FD && tracked_fds[fd]; }
+
+static void track_fd(int fd, bool tracked) {
+    if (fd >= 0 && fd < FAULTFS_MAX_FD) tracked_fds[fd] = tracked;
+}
+
+static bool stream_tracked(FILE *fp) {
+    if (!config.active || !fp) return false;
+    pthread_mutex_lock(&streams_mutex);
+    bool found = false;
+    for (int i = 0; i < FAULTFS_MAX_STREAMS && !found; i++) found = tracked_streams[i] == fp;
+    pthread_mutex_unlock(&streams_mutex);
+    return found;
+}
+
+static void track_stream(FILE *fp, bool tracked) {
+    pthread_mutex_lock(&streams_mutex);
+    for (int i = 0; i < FAULTFS_MAX_STREAMS; i++) {
+        if (tracked && tracked_streams[i] == NULL) {
+            tracked_streams[i] = fp;
+            break;
+        }
+        if (!tracked && tracked_streams[i] == fp) {
+            tracked_streams[i] = NULL;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&streams_mutex);
+}
+
+/* =============================================
+ * stdio
+ * ============================================= */
+
+FILE *fopen(const char *path, const char *mode) {
+    ensure_init();
+    bool match = path_matches(path);
+    if (match) {
+        delay_open();
+        if (strpbrk(mode, "wa+") && volume_full()) {
+            errno = ENOSPC;
+            return NULL;
+        }
+    }
+    FILE *fp = real_fopen(path, mode);
+    if (fp && match) track_stream(fp, true);
+    return fp;
+}
+
+FILE *fopen64(const char *path, const char *mode) { return fopen(path, mode); }
+
+int fclose(FILE *fp) {
+    ensure_init();
+    if (stream_tracked(fp)) track_stream(fp, false);
+    return real_fclose(fp);
+}
+
+size_t fwrite(const void *ptr, size_t size, size_t nmemb, FILE *fp) {
+    ensure_init();
+    if (stream_tracked(fp)) {
+        delay_io(size * nmemb);
+        if (!reserve_space(size * nmemb)) {
+            errno = ENOSPC;
+            return 0;
+        }
+    }
+    return real_fwrite(ptr, size, nmemb, fp);
+}
+
+size_t fread(void *ptr, size_t size, size_t nmemb, FILE *fp) {
+    ensure_init();
+    if (stream_tracked(fp)) delay_io(size * nmemb);
+    return real_fread(ptr, size, nmemb, fp);
+}
+
+/* =============================================
+ * file descriptor
+ * ============================================= */
+
+static int after_open(int fd, bool match) {
+    if (fd >= 0 && match) track_fd(fd, true);
+    return fd;
+}
+
+int open(const char *path, int flags, ...) {
+    ensure_init();
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    bool match = path_matches(path);
+    if (match) {
+        delay_open();
+        if ((flags & (O_WRONLY | O_RDWR)) && volume_full()) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return after_open(real_open(path, flags, mode), match);
+}
+
+int open64(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    return open(path, flags, mode);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    ensure_init();
+    mode_t mode = 0;
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_list args;
+        va_start(args, flags);
+        mode = (mode_t)va_arg(args, int);
+        va_end(args);
+    }
+    // i path relativi a dirfd non sono risolvibili qui: si considerano solo quelli assoluti
+    bool match = path_matches(path) && path[0] == '/';
+    if (match) {
+        delay_open();
+        if ((flags & (O_WRONLY | O_RDWR)) && volume_full()) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return after_open(real_openat(dirfd, path, flags, mode), match);
+}
+
+int close(int fd) {
+    ensure_init();
+    track_fd(fd, false);
+    return real_close(fd);
+}
+
+ssize_t write(int fd, const void *buf, size_t count) {
+    ensure_init();
+    if (fd_tracked(fd)) {
+        delay_io(count);
+        if (!reserve_space(count)) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return real_write(fd, buf, count);
+}
+
+ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
+    ensure_init();
+    if (fd_tracked(fd)) {
+        delay_io(count);
+        if (!reserve_space(count)) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return real_pwrite(fd, buf, count, offset);
+}
+
+ssize_t pwrite64(int fd, const void *buf, size_t count, off_t offset) {
+    return pwrite(fd, buf, count, offset);
+}
+
+ssize_t writev(int fd, const struct iovec *iov, int iovcnt) {
+    ensure_init();
+    if (fd_tracked(fd)) {
+        size_t total = 0;
+        for (int i = 0; i < iovcnt; i++) total += iov[i].iov_len;
+        delay_io(total);
+        if (!reserve_space(total)) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return real_writev(fd, iov, iovcnt);
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+    ensure_init();
+    if (fd_tracked(fd)) delay_io(count);
+    return real_read(fd, buf, count);
+}
+
+ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
+    ensure_init();
+    if (fd_tracked(fd)) delay_io(count);
+    return real_pread(fd, buf, count, offset);
+}
+
+ssize_t pread64(int fd, void *buf, size_t count, off_t offset) {
+    return pread(fd, buf, count, offset);
+}
+
+int fsync(int fd) {
+    ensure_init();
+    if (fd_tracked(fd)) delay_io(0);
+    return real_fsync(fd);
+}
+
+int fdatasync(int fd) {
+    ensure_init();
+    if (fd_tracked(fd)) delay_io(0);
+    return real_fdatasync(fd);
+}
+
+int mkdir(const char *path, mode_t mode) {
+    ensure_init();
+    if (path_matches(path)) {
+        delay_open();
+        // una directory esistente dà comunque EEXIST, come su un volume pieno vero
+        if (volume_full() && access(path, F_OK) != 0) {
+            errno = ENOSPC;
+            return -1;
+        }
+    }
+    return real_mkdir(path, mode);
+}
@@ -0,0 +1,764 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Load generator multi-thread per PodCache: ogni thread gestisce più connessioni con poll(),
+ * invia batch di comandi in pipeline e misura la latenza di ogni risposta.
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+
+#define LOADGEN_RECV_CHUNK 65536
+#define LOADGEN_REPLY_TIMEOUT_MS 5000
+#define LOADGEN_KEY_PREFIX "key:"
+#define LOADGEN_SCAN_LENGTH 100
+
+/* operazioni logiche: una scan è una sequenza di GET, un read-modify-write è GET + SET */
+typedef enum { OP_READ, OP_UPDATE, OP_INSERT, OP_SCAN, OP_RMW, OP_COUNT } op_type_e;
+
+static const char *op_names[OP_COUNT] = {"read", "update", "insert", "scan", "rmw"};
+
+/* workload core di YCSB (Cooper et al.), adattati a GET/SET */
+typedef struct {
+    const char *name;
+    const char *description;
+    double mix[OP_COUNT];
+    const char *key_dist;
+} workload_t;
+
+static const workload_t workloads[] = {
+    {"A", "update heavy: 50% read, 50% update", {0.50, 0.50, 0, 0, 0}, "zipf:0.99"},
+    {"B", "read mostly: 95% read, 5% update", {0.95, 0.05, 0, 0, 0}, "zipf:0.99"},
+    {"C", "read only: 100% read", {1.00, 0, 0, 0, 0}, "zipf:0.99"},
+    {"D", "read latest: 95% read, 5% insert", {0.95, 0, 0.05, 0, 0}, "latest"},
+    {"E", "short ranges: 95% scan, 5% insert", {0, 0, 0.05, 0.95, 0}, "zipf:0.99"},
+    {"F", "read-modify-write: 50% read, 50% rmw", {0.50, 0, 0, 0, 0.50}, "zipf:0.99"},
+};
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+typedef struct {
+    const char *host;
+    const char *port;
+    int threads;
+    int connections;
+    int pipeline;
+    uint64_t requests;
+    double duration;
+    uint64_t keyspace;
+    double read_ratio;
+    uint64_t seed;
+    bool prefill;
+    const workload_t *workload; // NULL: mix GET/SET da read_ratio
+    double mix[OP_COUNT];
+    int scan_length;
+    int max_replies; // risposte massime per operazione logica
+    const char *json_path;
+    key_chooser_t keys;
+    size_dist_t sizes;
+} loadgen_config_t;
+
+typedef struct {
+    uint8_t op;        // op_type_e dell'operazione logica
+    bool is_get;       // la risposta è di una GET (conta hit/miss)
+    bool completes;    // ultima risposta dell'operazione: registra la latenza
+} pending_reply_t;
+
+typedef struct {
+    int fd;
+    char *rbuf;
+    size_t rlen;
+    size_t rcap;
+    int outstanding;
+    uint64_t batch_start_ns;
+    pending_reply_t *ops; // risposte attese, in ordine di invio
+    int op_head;
+} connection_t;
+
+typedef struct {
+    latency_hist_t latency[OP_COUNT];
+    uint64_t ops[OP_COUNT];
+    uint64_t gets;
+    uint64_t sets;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t errors;
+} thread_stats_t;
+
+typedef struct {
+    int id;
+    const loadgen_config_t *config;
+    thread_stats_t stats;
+    const char *value_pool;
+    bool failed;
+} thread_ctx_t;
+
+static uint64_t g_issued = 0;          // richieste assegnate (modalità -n)
+static uint64_t g_deadline_ns = 0;     // fine del test (modalità -T)
+static uint64_t g_insert_next = 0;     // prossimo id per gli insert (parte da keyspace)
+static size_t g_value_pool_size = 0;
+
+/* =============================================
+ * command encoding
+ * ============================================= */
+
+static void encode_get(out_buffer_t *out, const char *key, size_t key_len) {
+    const char *argv[] = {"GET", key};
+    const size_t lens[] = {3, key_len};
+    encode_command(out, 2, argv, lens);
+}
+
+static void encode_set(out_buffer_t *out, const char *key, size_t key_len, const char *value,
+                       size_t value_len) {
+    const char *argv[] = {"SET", key, value};
+    const size_t lens[] = {3, key_len, value_len};
+    encode_command(out, 3, argv, lens);
+}
+
+/* =============================================
+ * worker thread
+ * ============================================= */
+
+// assegna al chiamante fino a 'want' richieste, 0 quando il test è finito
+static int claim_requests(const loadgen_config_t *config, int want) {
+    if (config->duration > 0) {
+        return bench_now_ns() < g_deadline_ns ? want : 0;
+    }
+    uint64_t start = __atomic_fetch_add(&g_issued, (uint64_t)want, __ATOMIC_RELAXED);
+    if (start >= config->requests) return 0;
+    uint64_t left = config->requests - start;
+    return left < (uint64_t)want ? (int)left : want;
+}
+
+static op_type_e choose_op(const loadgen_config_t *config, bench_rng_t *rng) {
+    double u = bench_rng_double(rng);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (u < config->mix[op]) return (op_type_e)op;
+        u -= config->mix[op];
+    }
+    return OP_READ;
+}
+
+static uint64_t choose_key(const loadgen_config_t *config, bench_rng_t *rng) {
+    uint64_t id = key_chooser_next(&config->keys, rng);
+    if (config->keys.type != KEY_DIST_LATEST) return id;
+
+    // distanza dall'ultima chiave inserita
+    uint64_t last = __atomic_load_n(&g_insert_next, __ATOMIC_RELAXED) - 1;
+    return id > last ? 0 : last - id;
+}
+
+static void push_get(out_buffer_t *out, connection_t *conn, int *replies, uint64_t key_id,
+                     op_type_e op, bool completes) {
+    char key[64];
+    int key_len = snprintf(key, sizeof(key), LOADGEN_KEY_PREFIX "%llu", (unsigned long long)key_id);
+    encode_get(out, key, (size_t)key_len);
+    conn->ops[(*replies)++] = (pending_reply_t){.op = op, .is_get = true, .completes = completes};
+}
+
+static void push_set(thread_ctx_t *ctx, out_buffer_t *out, connection_t *conn, int *replies,
+                     bench_rng_t *rng, uint64_t key_id, op_type_e op) {
+    char key[64];
+    int key_len = snprintf(key, sizeof(key), LOADGEN_KEY_PREFIX "%llu", (unsigned long long)key_id);
+    size_t value_len = size_dist_next(&ctx->config->sizes, rng);
+    size_t offset = bench_rng_range(rng, g_value_pool_size - value_len + 1);
+    encode_set(out, key, (size_t)key_len, ctx->value_pool + offset, value_len);
+    conn->ops[(*replies)++] = (pending_reply_t){.op = op, .is_get = false, .completes = true};
+}
+
+static void build_batch(thread_ctx_t *ctx, connection_t *conn, bench_rng_t *rng, int count,
+                        out_buffer_t *out) {
+    const loadgen_config_t *config = ctx->config;
+    int replies = 0;
+
+    out->len = 0;
+    for (int i = 0; i < count; i++) {
+        op_type_e op = choose_op(config, rng);
+        switch (op) {
+        case OP_READ:
+            push_get(out, conn, &replies, choose_key(config, rng), op, true);
+            break;
+        case OP_UPDATE:
+            push_set(ctx, out, conn, &replies, rng, choose_key(config, rng), op);
+            break;
+        case OP_INSERT: {
+            uint64_t id = __atomic_fetch_add(&g_insert_next, 1, __ATOMIC_RELAXED);
+            push_set(ctx, out, conn, &replies, rng, id, op);
+            break;
+        }
+        case OP_SCAN: {
+            // MGET non è disponibile: la scan è una sequenza di GET consecutive in pipeline
+            uint64_t start = choose_key(config, rng);
+            int length = 1 + (int)bench_rng_range(rng, (uint64_t)config->scan_length);
+            for (int k = 0; k < length; k++) {
+                push_get(out, conn, &replies, start + (uint64_t)k, op, k == length - 1);
+            }
+            break;
+        }
+        case OP_RMW: {
+            // la SET segue la GET sulla stessa connessione, quindi il server le esegue in ordine
+            uint64_t id = choose_key(config, rng);
+            push_get(out, conn, &replies, id, op, false);
+            push_set(ctx, out, conn, &replies, rng, id, op);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    conn->op_head = 0;
+    conn->outstanding = replies;
+}
+
+static int drain_replies(thread_ctx_t *ctx, connection_t *conn, uint64_t now) {
+    size_t pos = 0;
+    while (conn->outstanding > 0 && pos < conn->rlen) {
+        reply_kind_e kind;
+        long n = parse_reply(conn->rbuf + pos, conn->rlen - pos, &kind);
+        if (n < 0) {
+            fprintf(stderr, "thread %d: invalid reply from server\n", ctx->id);
+            return -1;
+        }
+        if (n == 0) break;
+        pos += (size_t)n;
+
+        pending_reply_t reply = conn->ops[conn->op_head++];
+        conn->outstanding--;
+
+        if (kind == REPLY_ERROR) {
+            ctx->stats.errors++;
+        } else if (reply.is_get) {
+            ctx->stats.gets++;
+            if (kind == REPLY_NIL) {
+                ctx->stats.misses++;
+            } else {
+                ctx->stats.hits++;
+            }
+        } else {
+            ctx->stats.sets++;
+        }
+
+        if (reply.completes) {
+            ctx->stats.ops[reply.op]++;
+            hist_record(&ctx->stats.latency[reply.op], now - conn->batch_start_ns);
+        }
+    }
+
+    if (pos > 0) {
+        memmove(conn->rbuf, conn->rbuf + pos, conn->rlen - pos);
+        conn->rlen -= pos;
+    }
+    return 0;
+}
+
+static void *worker_thread(void *arg) {
+    thread_ctx_t *ctx = arg;
+    const loadgen_config_t *config = ctx->config;
+    int nconn = config->connections;
+
+    bench_rng_t rng;
+    bench_rng_seed(&rng, config->seed + (uint64_t)ctx->id * 7919);
+
+    connection_t *conns = calloc((size_t)nconn, sizeof(connection_t));
+    struct pollfd *pfds = calloc((size_t)nconn, sizeof(struct pollfd));
+    out_buffer_t out = {0};
+    if (!conns || !pfds) {
+        ctx->failed = true;
+        return NULL;
+    }
+
+    for (int i = 0; i < nconn; i++) {
+        conns[i].fd = bench_connect(config->host, config->port, LOADGEN_REPLY_TIMEOUT_MS);
+        conns[i].rcap = LOADGEN_RECV_CHUNK * 2;
+        conns[i].rbuf = malloc(conns[i].rcap);
+        conns[i].ops =
+            calloc((size_t)config->pipeline * (size_t)config->max_replies, sizeof(pending_reply_t));
+        if (conns[i].fd < 0 || !conns[i].rbuf || !conns[i].ops) {
+            ctx->failed = true;
+            goto done;
+        }
+    }
+
+    bool finished = false;
+    int active = nconn;
+    while (active > 0) {
+        // invia un nuovo batch su ogni connessione che ha ricevuto tutte le risposte
+        active = 0;
+        for (int i = 0; i < nconn; i++) {
+            connection_t *conn = &conns[i];
+            if (conn->outstanding == 0 && !finished) {
+                int count = claim_requests(config, config->pipeline);
+                if (count == 0) {
+                    finished = true;
+                } else {
+                    build_batch(ctx, conn, &rng, count, &out);
+                    conn->batch_start_ns = bench_now_ns();
+                    if (bench_send_all(conn->fd, out.data, out.len) != 0) {
+                        fprintf(stderr, "thread %d: send failed: %s\n", ctx->id, strerror(errno));
+                        ctx->failed = true;
+                        goto done;
+                    }
+                }
+            }
+            pfds[i].fd = conn->outstanding > 0 ? conn->fd : -1;
+            pfds[i].events = POLLIN;
+            pfds[i].revents = 0;
+            if (conn->outstanding > 0) active++;
+        }
+        if (active == 0) break;
+
+        int ready = poll(pfds, (nfds_t)nconn, LOADGEN_REPLY_TIMEOUT_MS);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            ctx->failed = true;
+            goto done;
+        }
+        if (ready == 0) {
+            fprintf(stderr, "thread %d: timed out waiting for replies\n", ctx->id);
+            ctx->failed = true;
+            goto done;
+        }
+
+        uint64_t now = bench_now_ns();
+        for (int i = 0; i < nconn && ready > 0; i++) {
+            if (!pfds[i].revents) continue;
+            ready--;
+
+            connection_t *conn = &conns[i];
+            if (conn->rcap - conn->rlen < LOADGEN_RECV_CHUNK) {
+                conn->rcap *= 2;
+                conn->rbuf = realloc(conn->rbuf, conn->rcap);
+                if (!conn->rbuf) {
+                    ctx->failed = true;
+                    goto done;
+                }
+            }
+            ssize_t n = recv(conn->fd, conn->rbuf + conn->rlen, conn->rcap - conn->rlen, 0);
+            if (n <= 0) {
+                fprintf(stderr, "thread %d: connection closed by server\n", ctx->id);
+                ctx->failed = true;
+                goto done;
+            }
+            conn->rlen += (size_t)n;
+            if (drain_replies(ctx, conn, now) != 0) {
+                ctx->failed = true;
+                goto done;
+            }
+        }
+    }
+
+done:
+    for (int i = 0; i < nconn; i++) {
+        if (conns[i].fd > 0) close(conns[i].fd);
+        free(conns[i].rbuf);
+        free(conns[i].ops);
+    }
+    free(conns);
+    free(pfds);
+    free(out.data);
+    return NULL;
+}
+
+/* =============================================
+ * prefill: scrive ogni chiave del keyspace una volta
+ * ============================================= */
+
+static int prefill_keyspace(const loadgen_config_t *config, const char *value_pool) {
+    int fd = bench_connect(config->host, config->port, LOADGEN_REPLY_TIMEOUT_MS);
+    if (fd < 0) return -1;
+
+    bench_rng_t rng;
+    bench_rng_seed(&rng, config->seed ^ 0xfeedULL);
+
+    out_buffer_t out = {0};
+    char key[64];
+    char *rbuf = malloc(LOADGEN_RECV_CHUNK);
+    size_t rlen = 0;
+    int rc = 0;
+    const uint64_t batch = 256;
+
+    for (uint64_t base = 0; base < config->keyspace && rc == 0; base += batch) {
+        uint64_t end = base + batch < config->keyspace ? base + batch : config->keyspace;
+        out.len = 0;
+        for (uint64_t id = base; id < end; id++) {
+            int key_len =
+                snprintf(key, sizeof(key), LOADGEN_KEY_PREFIX "%llu", (unsigned long long)id);
+            size_t value_len = size_dist_next(&config->sizes, &rng);
+            encode_set(&out, key, (size_t)key_len, value_pool, value_len);
+        }
+        if (bench_send_all(fd, out.data, out.len) != 0) {
+            rc = -1;
+            break;
+        }
+
+        uint64_t pending = end - base;
+        while (pending > 0) {
+            ssize_t n = recv(fd, rbuf + rlen, LOADGEN_RECV_CHUNK - rlen, 0);
+            if (n <= 0) {
+                rc = -1;
+                break;
+            }
+            rlen += (size_t)n;
+            size_t pos = 0;
+            reply_kind_e kind;
+            long consumed;
+            while (pending > 0 && (consumed = parse_reply(rbuf + pos, rlen - pos, &kind)) > 0) {
+                pos += (size_t)consumed;
+                pending--;
+            }
+            memmove(rbuf, rbuf + pos, rlen - pos);
+            rlen -= pos;
+        }
+    }
+
+    free(rbuf);
+    free(out.data);
+    close(fd);
+    return rc;
+}
+
+/* =============================================
+ * main
+ * ============================================= */
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -H, --host HOST          server host or unix socket path (default 127.0.0.1)\n"
+            "  -p, --port PORT          server port (default 6379)\n"
+            "  -t, --threads N          worker threads (default 4)\n"
+            "  -c, --connections N      connections per thread (default 8)\n"
+            "  -P, --pipeline N         operations in flight per connection (default 1)\n"
+            "  -n, --requests N         total operations (default 100000)\n"
+            "  -T, --duration SEC       run for SEC seconds instead of -n\n"
+            "  -k, --keyspace N         number of distinct keys / records (default 100000)\n"
+            "  -d, --value-size DIST    fixed:N | uniform:MIN-MAX | exp:MEAN (default fixed:100,\n"
+            "                           fixed:1000 with -w)\n"
+            "  -r, --read-ratio R       fraction of GET requests (default 0.9, ignored with -w)\n"
+            "  -z, --key-dist DIST      uniform | zipf[:THETA] | latest (default zipf:0.99)\n"
+            "  -s, --seed N             random seed (default 1)\n"
+            "  -w, --workload W         YCSB core workload A-F (implies --prefill)\n"
+            "      --scan-length N      maximum scan length for workload E (default 100)\n"
+            "      --prefill            SET every key once before the measured run\n"
+            "      --no-prefill         skip the load phase of a workload\n"
+            "      --json FILE          write machine-readable results to FILE ('-' = stdout)\n"
+            "  -l, --list-workloads     list the workloads\n",
+            prog);
+}
+
+static double mean_value_size(const size_dist_t *sizes) {
+    switch (sizes->type) {
+    case SIZE_DIST_UNIFORM:
+        return (double)(sizes->min + sizes->max) / 2.0;
+    case SIZE_DIST_EXP:
+        return sizes->mean;
+    case SIZE_DIST_FIXED:
+    default:
+        return (double)sizes->min;
+    }
+}
+
+static void json_escape_print(FILE *out, const char *text) {
+    fputc('"', out);
+    for (const char *c = text; *c; c++) {
+        if (*c == '"' || *c == '\\') fputc('\\', out);
+        fputc(*c, out);
+    }
+    fputc('"', out);
+}
+
+static int write_json(const loadgen_config_t *config, const thread_stats_t *total,
+                      const latency_hist_t *all, double elapsed, bool failed) {
+    bool to_stdout = strcmp(config->json_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : fopen(config->json_path, "w");
+    if (!out) {
+        perror(config->json_path);
+        return -1;
+    }
+
+    char key_desc[32], size_desc[48];
+    key_chooser_describe(&config->keys, key_desc, sizeof(key_desc));
+    size_dist_describe(&config->sizes, size_desc, sizeof(size_desc));
+
+    fprintf(out, "{\n  \"tool\": \"podcache_loadgen\",\n  \"timestamp\": %lld,\n",
+            (long long)time(NULL));
+    fprintf(out, "  \"workload\": ");
+    json_escape_print(out, config->workload ? config->workload->name : "custom");
+    fprintf(out, ",\n  \"config\": {\"host\": ");
+    json_escape_print(out, config->host);
+    fprintf(out, ", \"port\": ");
+    json_escape_print(out, config->port);
+    fprintf(out,
+            ", \"threads\": %d, \"connections\": %d, \"pipeline\": %d, \"records\": %llu, "
+            "\"key_dist\": \"%s\", \"value_size\": \"%s\", \"seed\": %llu, \"prefill\": %s},\n",
+            config->threads, config->connections, config->pipeline,
+            (unsigned long long)config->keyspace, key_desc, size_desc,
+            (unsigned long long)config->seed, config->prefill ? "true" : "false");
+
+    uint64_t ops = all->total;
+    fprintf(out,
+            "  \"results\": {\"ok\": %s, \"ops\": %llu, \"elapsed_s\": %.3f, \"throughput\": %.1f, "
+            "\"gets\": %llu, \"hits\": %llu, \"misses\": %llu, \"hit_ratio\": %.4f, \"sets\": %llu, "
+            "\"errors\": %llu},\n",
+            failed ? "false" : "true", (unsigned long long)ops, elapsed,
+            elapsed > 0 ? (double)ops / elapsed : 0.0, (unsigned long long)total->gets,
+            (unsigned long long)total->hits, (unsigned long long)total->misses,
+            total->gets ? (double)total->hits / (double)total->gets : 0.0,
+            (unsigned long long)total->sets, (unsigned long long)total->errors);
+
+    fprintf(out, "  \"latency_us\": {\n    \"all\": ");
+    hist_print_json(out, all);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (config->mix[op] <= 0) continue;
+        fprintf(out, ",\n    \"%s\": ", op_names[op]);
+        hist_print_json(out, &total->latency[op]);
+    }
+    fprintf(out, "\n  }\n}\n");
+
+    if (!to_stdout) fclose(out);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    loadgen_config_t config = {
+        .host = "127.0.0.1",
+        .port = "6379",
+        .threads = 4,
+        .connections = 8,
+        .pipeline = 1,
+        .requests = 100000,
+        .duration = 0,
+        .keyspace = 100000,
+        .read_ratio = 0.9,
+        .seed = 1,
+        .prefill = false,
+        .scan_length = LOADGEN_SCAN_LENGTH,
+    };
+    const char *key_dist = NULL;
+    const char *value_size = NULL;
+    int prefill_option = -1; // -1: default del workload
+
+    static const struct option options[] = {
+        {"host", required_argument, NULL, 'H'},
+        {"port", required_argument, NULL, 'p'},
+        {"threads", required_argument, NULL, 't'},
+        {"connections", required_argument, NULL, 'c'},
+        {"pipeline", required_argument, NULL, 'P'},
+        {"requests", required_argument, NULL, 'n'},
+        {"duration", required_argument, NULL, 'T'},
+        {"keyspace", required_argument, NULL, 'k'},
+        {"value-size", required_argument, NULL, 'd'},
+        {"read-ratio", required_argument, NULL, 'r'},
+        {"key-dist", required_argument, NULL, 'z'},
+        {"seed", required_argument, NULL, 's'},
+        {"workload", required_argument, NULL, 'w'},
+        {"list-workloads", no_argument, NULL, 'l'},
+        {"prefill", no_argument, NULL, 1},
+        {"no-prefill", no_argument, NULL, 2},
+        {"json", required_argument, NULL, 3},
+        {"scan-length", required_argument, NULL, 4},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:t:c:P:n:T:k:d:r:z:s:w:lh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'H': config.host = optarg; break;
+        case 'p': config.port = optarg; break;
+        case 't': config.threads = atoi(optarg); break;
+        case 'c': config.connections = atoi(optarg); break;
+        case 'P': config.pipeline = atoi(optarg); break;
+        case 'n': config.requests = strtoull(optarg, NULL, 10); break;
+        case 'T': config.duration = atof(optarg); break;
+        case 'k': config.keyspace = strtoull(optarg, NULL, 10); break;
+        case 'd': value_size = optarg; break;
+        case 'r': config.read_ratio = atof(optarg); break;
+        case 'z': key_dist = optarg; break;
+        case 's': config.seed = strtoull(optarg, NULL, 10); break;
+        case 'w':
+            for (size_t i = 0; i < WORKLOAD_COUNT; i++) {
+                if (strcasecmp(optarg, workloads[i].name) == 0) config.workload = &workloads[i];
+            }
+            if (!config.workload) {
+                fprintf(stderr, "unknown workload: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'l':
+            for (size_t i = 0; i < WORKLOAD_COUNT; i++) {
+                printf("%s  %-40s keys %s\n", workloads[i].name, workloads[i].description,
+                       workloads[i].key_dist);
+            }
+            return EXIT_SUCCESS;
+        case 1: prefill_option = 1; break;
+        case 2: prefill_option = 0; break;
+        case 3: config.json_path = optarg; break;
+        case 4: config.scan_length = atoi(optarg); break;
+        default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    if (config.threads < 1 || config.connections < 1 || config.pipeline < 1 ||
+        config.keyspace < 1 || config.read_ratio < 0 || config.read_ratio > 1 ||
+        config.scan_length < 1) {
+        fprintf(stderr, "invalid arguments\n");
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // il workload fissa il mix di operazioni; distribuzione e dimensione restano sovrascrivibili
+    if (config.workload) {
+        memcpy(config.mix, config.workload->mix, sizeof(config.mix));
+        if (!key_dist) key_dist = config.workload->key_dist;
+        if (!value_size) value_size = "fixed:1000"; // 10 campi da 100 byte come YCSB
+        config.prefill = prefill_option != 0;
+    } else {
+        config.mix[OP_READ] = config.read_ratio;
+        config.mix[OP_UPDATE] = 1.0 - config.read_ratio;
+        config.prefill = prefill_option == 1;
+    }
+    if (!key_dist) key_dist = "zipf:0.99";
+    if (!value_size) value_size = "fixed:100";
+    config.max_replies = config.mix[OP_SCAN] > 0 ? config.scan_length : 2;
+    g_insert_next = config.keyspace;
+
+    if (key_chooser_init(&config.keys, key_dist, config.keyspace) != 0) {
+        fprintf(stderr, "invalid key distribution: %s\n", key_dist);
+        return EXIT_FAILURE;
+    }
+    if (size_dist_parse(&config.sizes, value_size) != 0) {
+        fprintf(stderr, "invalid value size distribution: %s\n", value_size);
+        return EXIT_FAILURE;
+    }
+
+    // con --json - lo stdout è riservato al JSON
+    FILE *report = config.json_path && strcmp(config.json_path, "-") == 0 ? stderr : stdout;
+
+    // pool di byte stampabili da cui ritagliare i valori (il server non accetta '\0')
+    g_value_pool_size = config.sizes.max * 2;
+    char *value_pool = malloc(g_value_pool_size);
+    if (!value_pool) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    bench_rng_t pool_rng;
+    bench_rng_seed(&pool_rng, config.seed);
+    for (size_t i = 0; i < g_value_pool_size; i++) {
+        value_pool[i] = (char)('a' + bench_rng_range(&pool_rng, 26));
+    }
+
+    char key_desc[32], size_desc[48];
+    key_chooser_describe(&config.keys, key_desc, sizeof(key_desc));
+    size_dist_describe(&config.sizes, size_desc, sizeof(size_desc));
+    fprintf(report, "podcache loadgen: %s:%s, %d threads x %d connections, pipeline %d\n",
+            config.host, config.port, config.threads, config.connections, config.pipeline);
+    if (config.workload) {
+        fprintf(report, "workload %s (%s)\n", config.workload->name, config.workload->description);
+    }
+    fprintf(report, "keyspace %llu (%s), values %s, dataset ~%.1f MB",
+            (unsigned long long)config.keyspace, key_desc, size_desc,
+            (double)config.keyspace * mean_value_size(&config.sizes) / (1024.0 * 1024.0));
+    if (!config.workload) fprintf(report, ", read ratio %.2f", config.read_ratio);
+    fprintf(report, ", seed %llu\n", (unsigned long long)config.seed);
+
+    if (config.prefill) {
+        uint64_t t0 = bench_now_ns();
+        if (prefill_keyspace(&config, value_pool) != 0) {
+            fprintf(stderr, "prefill failed\n");
+            free(value_pool);
+            return EXIT_FAILURE;
+        }
+        fprintf(report, "prefill: %llu keys in %.2f s\n", (unsigned long long)config.keyspace,
+                (bench_now_ns() - t0) / 1e9);
+    }
+
+    thread_ctx_t *ctxs = calloc((size_t)config.threads, sizeof(thread_ctx_t));
+    pthread_t *tids = calloc((size_t)config.threads, sizeof(pthread_t));
+    if (!ctxs || !tids) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+
+    uint64_t start = bench_now_ns();
+    if (config.duration > 0) g_deadline_ns = start + (uint64_t)(config.duration * 1e9);
+
+    for (int i = 0; i < config.threads; i++) {
+        ctxs[i].id = i;
+        ctxs[i].config = &config;
+        ctxs[i].value_pool = value_pool;
+        for (int op = 0; op < OP_COUNT; op++) hist_init(&ctxs[i].stats.latency[op]);
+        if (pthread_create(&tids[i], NULL, worker_thread, &ctxs[i]) != 0) {
+            perror("pthread_create");
+            return EXIT_FAILURE;
+        }
+    }
+
+    thread_stats_t *total = calloc(1, sizeof(thread_stats_t));
+    latency_hist_t *all = malloc(sizeof(latency_hist_t));
+    if (!total || !all) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    for (int op = 0; op < OP_COUNT; op++) hist_init(&total->latency[op]);
+    hist_init(all);
+
+    bool failed = false;
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(tids[i], NULL);
+        failed |= ctxs[i].failed;
+        for (int op = 0; op < OP_COUNT; op++) {
+            hist_merge(&total->latency[op], &ctxs[i].stats.latency[op]);
+            hist_merge(all, &ctxs[i].stats.latency[op]);
+            total->ops[op] += ctxs[i].stats.ops[op];
+        }
+        total->gets += ctxs[i].stats.gets;
+        total->sets += ctxs[i].stats.sets;
+        total->hits += ctxs[i].stats.hits;
+        total->misses += ctxs[i].stats.misses;
+        total->errors += ctxs[i].stats.errors;
+    }
+    double elapsed = (bench_now_ns() - start) / 1e9;
+
+    uint64_t completed = all->total;
+    fprintf(report, "operations: %llu in %.2f s -> %.0f ops/s\n", (unsigned long long)completed,
+            elapsed, elapsed > 0 ? completed / elapsed : 0);
+    fprintf(report,
+            "GET: %llu (hits %llu, misses %llu, hit ratio %.2f%%)  SET: %llu  errors: %llu\n",
+            (unsigned long long)total->gets, (unsigned long long)total->hits,
+            (unsigned long long)total->misses,
+            total->gets ? 100.0 * (double)total->hits / (double)total->gets : 0,
+            (unsigned long long)total->sets, (unsigned long long)total->errors);
+    fprintf(report, "latency (us):\n");
+    hist_print_us(report, "all", all);
+    for (int op = 0; op < OP_COUNT; op++) {
+        if (config.mix[op] > 0) hist_print_us(report, op_names[op], &total->latency[op]);
+    }
+
+    int rc = failed ? EXIT_FAILURE : EXIT_SUCCESS;
+    if (config.json_path && write_json(&config, total, all, elapsed, failed) != 0) {
+        rc = EXIT_FAILURE;
+    }
+
+    free(total);
+    free(all);
+    free(ctxs);
+    free(tids);
+    free(value_pool);
+    return rc;
+}
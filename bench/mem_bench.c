@@ -0,0 +1,577 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Benchmark di efficienza della memoria: carica N chiavi con le distribuzioni di dimensione
+ * richieste e confronta la memoria contabilizzata dalla cache (current_bytes_size) con quella
+ * effettivamente usata: byte vivi nell'heap (malloc_usable_size, tramite --wrap del linker),
+ * statistiche dell'allocatore e RSS del processo. Ogni configurazione gira in un processo
+ * figlio, così le misure non risentono delle configurazioni precedenti. Per confrontare gli
+ * allocatori basta lanciarlo con LD_PRELOAD (vedi bench/mem_bench.sh).
+ */
+
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "clogger.h"
+#include "lru_cache.h"
+#include "pod_cache.h"
+
+#define MEM_MAX_RUNS 32
+#define MEM_MAX_KEY 250
+
+/* =============================================
+ * live heap bytes (--wrap del linker)
+ * contano solo le allocazioni di podcache_lib e del benchmark, non quelle interne alla libc
+ * ============================================= */
+
+static size_t live_heap_bytes = 0;
+static uint64_t live_allocs = 0;
+
+#ifdef BENCH_TRACK_HEAP
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+void __real_free(void *ptr);
+
+static void *track_alloc(void *ptr) {
+    if (ptr) {
+        live_heap_bytes += malloc_usable_size(ptr);
+        live_allocs++;
+    }
+    return ptr;
+}
+
+void *__wrap_malloc(size_t size) {
+    return track_alloc(__real_malloc(size));
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    return track_alloc(__real_calloc(nmemb, size));
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    size_t old_size = ptr ? malloc_usable_size(ptr) : 0;
+    void *new_ptr = __real_realloc(ptr, size);
+    if (!new_ptr) return NULL;
+    live_heap_bytes -= old_size;
+    if (ptr) live_allocs--;
+    return track_alloc(new_ptr);
+}
+
+char *__wrap_strdup(const char *s) {
+    return track_alloc(__real_strdup(s));
+}
+
+void __wrap_free(void *ptr) {
+    if (ptr) {
+        live_heap_bytes -= malloc_usable_size(ptr);
+        live_allocs--;
+    }
+    __real_free(ptr);
+}
+#endif
+
+/* =============================================
+ * allocator detection and statistics (dlsym: nessuna dipendenza a link time)
+ * ============================================= */
+
+typedef int (*mallctl_fn)(const char *, void *, size_t *, void *, size_t);
+typedef int (*tc_property_fn)(const char *, size_t *);
+
+static const char *allocator_name(void) {
+    if (dlsym(RTLD_DEFAULT, "mallctl")) return "jemalloc";
+    if (dlsym(RTLD_DEFAULT, "MallocExtension_GetNumericProperty")) return "tcmalloc";
+    if (dlsym(RTLD_DEFAULT, "mi_version")) return "mimalloc";
+#ifdef __GLIBC__
+    return "glibc";
+#else
+    return "libc";
+#endif
+}
+
+// byte in uso secondo l'allocatore, 0 se non disponibile
+static size_t allocator_in_use(void) {
+    mallctl_fn mallctl = (mallctl_fn)dlsym(RTLD_DEFAULT, "mallctl");
+    if (mallctl) {
+        // le statistiche di jemalloc si aggiornano solo incrementando l'epoch
+        uint64_t epoch = 1;
+        size_t len = sizeof(epoch);
+        mallctl("epoch", &epoch, &len, &epoch, len);
+        size_t allocated = 0;
+        len = sizeof(allocated);
+        if (mallctl("stats.allocated", &allocated, &len, NULL, 0) == 0) return allocated;
+        return 0;
+    }
+    tc_property_fn tc_property =
+        (tc_property_fn)dlsym(RTLD_DEFAULT, "MallocExtension_GetNumericProperty");
+    if (tc_property) {
+        size_t allocated = 0;
+        if (tc_property("generic.current_allocated_bytes", &allocated)) return allocated;
+        return 0;
+    }
+    if (dlsym(RTLD_DEFAULT, "mi_version")) return 0;
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return info.uordblks + info.hblkhd;
+#else
+    return 0;
+#endif
+}
+
+static size_t rss_bytes(void) {
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (!f) return 0;
+    unsigned long size = 0, resident = 0;
+    int n = fscanf(f, "%lu %lu", &size, &resident);
+    fclose(f);
+    return n == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+/* =============================================
+ * layouts
+ * ============================================= */
+
+typedef enum { LAYOUT_POD, LAYOUT_LRU, LAYOUT_INDEX, LAYOUT_COUNT } layout_e;
+
+static const char *layout_names[LAYOUT_COUNT] = {"pod", "lru", "index"};
+static const char *layout_descriptions[LAYOUT_COUNT] = {
+    "pod_cache with P partitions, as used by the server",
+    "single lru_cache, no partitioning",
+    "pod_cache in accounting mode: keys and sizes only, no value copies",
+};
+
+typedef struct {
+    uint64_t keys;
+    size_dist_t key_dist;
+    size_dist_t value_dist;
+    size_t capacity; // 0 = abbastanza grande da non fare demotion
+    uint64_t seed;
+    const char *json_path;
+} mem_config_t;
+
+typedef struct {
+    layout_e layout;
+    int partitions;
+} mem_run_t;
+
+typedef struct {
+    int ok;
+    uint64_t keys_loaded;
+    uint64_t demotions;
+    size_t key_bytes;       // somma delle lunghezze delle chiavi
+    size_t value_bytes;     // somma delle dimensioni dei valori
+    size_t accounted_bytes; // current_bytes_size di tutte le partizioni
+    size_t bucket_bytes;    // array dei bucket delle hash table
+    size_t fixed_heap;      // heap allocato dalla creazione della cache vuota
+    size_t heap_bytes;      // heap allocato dal caricamento delle chiavi
+    uint64_t allocs;
+    size_t allocator_bytes; // variazione riportata dall'allocatore (0 = non disponibile)
+    size_t rss_bytes;       // variazione di RSS dalla creazione alla fine del caricamento
+    char allocator[16];
+} mem_result_t;
+
+static size_t make_key(char *out, uint64_t id, size_t length) {
+    int n = snprintf(out, MEM_MAX_KEY + 1, "k%llu:", (unsigned long long)id);
+    size_t len = (size_t)n;
+    if (length > MEM_MAX_KEY) length = MEM_MAX_KEY;
+    // il padding non rende le chiavi meno uniche: l'id viene prima
+    while (len < length) out[len++] = 'x';
+    out[len] = '\0';
+    return len;
+}
+
+static size_t auto_capacity(const mem_config_t *config, int partitions) {
+    // ogni partizione deve contenere la sua quota anche con una distribuzione sbilanciata
+    size_t per_partition = config->keys * config->value_dist.max / (size_t)partitions;
+    return (per_partition * 2 + MB_TO_BYTES(1)) * (size_t)partitions;
+}
+
+static void run_layout(const mem_config_t *config, const mem_run_t *run, mem_result_t *out) {
+    memset(out, 0, sizeof(*out));
+    snprintf(out->allocator, sizeof(out->allocator), "%s", allocator_name());
+
+    char *value = malloc(config->value_dist.max);
+    if (!value) return;
+    for (size_t i = 0; i < config->value_dist.max; i++) value[i] = (char)('a' + i % 26);
+    char key[MEM_MAX_KEY + 1];
+
+    size_t capacity = config->capacity ? config->capacity : auto_capacity(config, run->partitions);
+
+    size_t heap_start = live_heap_bytes;
+
+    pod_cache_t *pod = NULL;
+    lru_cache_t *lru = NULL;
+    switch (run->layout) {
+    case LAYOUT_POD: pod = pod_cache_create(capacity, (u_short)run->partitions); break;
+    case LAYOUT_INDEX: pod = pod_cache_create_accounting(capacity, (u_short)run->partitions); break;
+    case LAYOUT_LRU: lru = lru_cache_create(capacity); break;
+    default: break;
+    }
+    if (!pod && !lru) {
+        free(value);
+        return;
+    }
+    if (pod) {
+        for (int p = 0; p < pod->partition_count; p++) {
+            out->bucket_bytes += pod->partitions[p]->hash_table_size * sizeof(hash_node_t *);
+        }
+    } else {
+        out->bucket_bytes = lru->hash_table_size * sizeof(hash_node_t *);
+    }
+
+    out->fixed_heap = live_heap_bytes - heap_start;
+    size_t heap_loaded_from = live_heap_bytes;
+    uint64_t allocs_start = live_allocs;
+    size_t allocator_start = allocator_in_use();
+    size_t rss_start = rss_bytes();
+
+    bench_rng_t rng;
+    bench_rng_seed(&rng, config->seed);
+    for (uint64_t i = 0; i < config->keys; i++) {
+        size_t key_len = make_key(key, i, size_dist_next(&config->key_dist, &rng));
+        size_t value_size = size_dist_next(&config->value_dist, &rng);
+        void *v = run->layout == LAYOUT_INDEX ? NULL : value;
+        int rc = pod ? pod_cache_put(pod, key, v, value_size)
+                     : lru_cache_put(lru, key, v, value_size);
+        if (rc < 0) continue;
+        out->keys_loaded++;
+        out->key_bytes += key_len;
+        out->value_bytes += value_size;
+    }
+
+    out->heap_bytes = live_heap_bytes - heap_loaded_from;
+    out->allocs = live_allocs - allocs_start;
+    size_t allocator_end = allocator_in_use();
+    out->allocator_bytes = allocator_end > allocator_start ? allocator_end - allocator_start : 0;
+    size_t rss_end = rss_bytes();
+    out->rss_bytes = rss_end > rss_start ? rss_end - rss_start : 0;
+
+    if (pod) {
+        for (int p = 0; p < pod->partition_count; p++) {
+            out->accounted_bytes += pod->partitions[p]->current_bytes_size;
+        }
+        pod_cache_stats_t stats;
+        pod_cache_get_stats(pod, &stats);
+        out->demotions = stats.demotions;
+        pod_cache_destroy(pod);
+    } else {
+        out->accounted_bytes = lru->current_bytes_size;
+        lru_cache_destroy(lru);
+    }
+    free(value);
+    out->ok = 1;
+}
+
+// esegue la configurazione in un processo figlio e ne legge il risultato da una pipe
+static int run_forked(const mem_config_t *config, const mem_run_t *run, mem_result_t *out) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        perror("pipe");
+        return -1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        mem_result_t result;
+        run_layout(config, run, &result);
+        ssize_t written = write(fds[1], &result, sizeof(result));
+        _exit(written == (ssize_t)sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t n = read(fds[0], out, sizeof(*out));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (n != (ssize_t)sizeof(*out) || !WIFEXITED(status) || WEXITSTATUS(status) != 0 || !out->ok) {
+        return -1;
+    }
+    return 0;
+}
+
+/* =============================================
+ * report
+ * ============================================= */
+
+static double per_key(size_t bytes, const mem_result_t *r) {
+    return r->keys_loaded ? (double)bytes / (double)r->keys_loaded : 0.0;
+}
+
+static double signed_per_key(size_t a, size_t b, const mem_result_t *r) {
+    return r->keys_loaded ? ((double)a - (double)b) / (double)r->keys_loaded : 0.0;
+}
+
+// byte richiesti per chiave secondo le strutture di lru_cache: nodi e due copie della chiave
+static size_t structural_bytes(const mem_result_t *r) {
+    return r->keys_loaded * (sizeof(lru_node_t) + sizeof(hash_node_t)) +
+           2 * (r->key_bytes + r->keys_loaded);
+}
+
+static size_t stored_value_bytes(const mem_run_t *run, const mem_result_t *r) {
+    return run->layout == LAYOUT_INDEX ? 0 : r->value_bytes;
+}
+
+static void print_results(const mem_run_t *runs, const mem_result_t *results, int count) {
+    printf("\n%-6s %4s %-9s %9s %10s %10s %10s %10s %9s %9s %9s\n", "layout", "P", "allocator",
+           "keys", "acct MB", "heap MB", "alloc MB", "rss MB", "heap/key", "rss/key",
+           "ovh/key");
+    for (int i = 0; i < count; i++) {
+        const mem_result_t *r = &results[i];
+        if (!r->ok) {
+            printf("%-6s %4d failed\n", layout_names[runs[i].layout], runs[i].partitions);
+            continue;
+        }
+        char alloc_mb[16] = "-";
+        if (r->allocator_bytes) snprintf(alloc_mb, sizeof(alloc_mb), "%.2f",
+                                         BYTES_TO_MB(r->allocator_bytes));
+        // overhead: quanto costa ogni chiave oltre ai byte dei valori memorizzati
+        printf("%-6s %4d %-9s %9llu %10.2f %10.2f %10s %10.2f %9.1f %9.1f %9.1f\n",
+               layout_names[runs[i].layout], runs[i].partitions, r->allocator,
+               (unsigned long long)r->keys_loaded, BYTES_TO_MB(r->accounted_bytes),
+               BYTES_TO_MB(r->heap_bytes), alloc_mb, BYTES_TO_MB(r->rss_bytes),
+               per_key(r->heap_bytes, r), per_key(r->rss_bytes, r),
+               signed_per_key(r->rss_bytes, stored_value_bytes(&runs[i], r), r));
+    }
+
+    printf("\nper-key breakdown (bytes): values stored, key text, lru/hash nodes + key copies,\n"
+           "allocator slack (heap - requested), rss beyond heap, fixed (empty cache) amortized\n");
+    printf("%-6s %4s %9s %9s %9s %9s %9s %9s %8s\n", "layout", "P", "values", "key", "struct",
+           "slack", "rss-heap", "fixed", "allocs");
+    for (int i = 0; i < count; i++) {
+        const mem_result_t *r = &results[i];
+        if (!r->ok) continue;
+        size_t values = stored_value_bytes(&runs[i], r);
+        size_t requested = values + structural_bytes(r);
+        printf("%-6s %4d %9.1f %9.1f %9.1f %9.1f %9.1f %9.1f %8.2f\n",
+               layout_names[runs[i].layout], runs[i].partitions, per_key(values, r),
+               per_key(r->key_bytes, r), per_key(structural_bytes(r), r),
+               signed_per_key(r->heap_bytes, requested, r),
+               signed_per_key(r->rss_bytes, r->heap_bytes, r), per_key(r->fixed_heap, r),
+               r->keys_loaded ? (double)r->allocs / (double)r->keys_loaded : 0.0);
+        if (r->demotions) {
+            printf("       warning: %llu demotions, part of the data went to disk\n",
+                   (unsigned long long)r->demotions);
+        }
+    }
+}
+
+static int write_json(const mem_config_t *config, const mem_run_t *runs,
+                      const mem_result_t *results, int count) {
+    bool to_stdout = strcmp(config->json_path, "-") == 0;
+    FILE *out = to_stdout ? stdout : fopen(config->json_path, "w");
+    if (!out) {
+        perror(config->json_path);
+        return -1;
+    }
+    char key_desc[64], value_desc[64];
+    size_dist_describe(&config->key_dist, key_desc, sizeof(key_desc));
+    size_dist_describe(&config->value_dist, value_desc, sizeof(value_desc));
+    fprintf(out, "{\n  \"config\": {\"keys\": %llu, \"key_size\": \"%s\", \"value_size\": \"%s\"},\n"
+                 "  \"runs\": [",
+            (unsigned long long)config->keys, key_desc, value_desc);
+    bool first = true;
+    for (int i = 0; i < count; i++) {
+        const mem_result_t *r = &results[i];
+        if (!r->ok) continue;
+        fprintf(out,
+                "%s\n    {\"layout\": \"%s\", \"partitions\": %d, \"allocator\": \"%s\", "
+                "\"keys\": %llu, \"demotions\": %llu, \"key_bytes\": %zu, \"value_bytes\": %zu, "
+                "\"accounted_bytes\": %zu, \"bucket_bytes\": %zu, \"fixed_heap_bytes\": %zu, "
+                "\"heap_bytes\": %zu, \"allocator_bytes\": %zu, \"rss_bytes\": %zu, "
+                "\"allocs\": %llu, \"heap_per_key\": %.2f, \"rss_per_key\": %.2f, "
+                "\"overhead_per_key\": %.2f}",
+                first ? "" : ",", layout_names[runs[i].layout], runs[i].partitions, r->allocator,
+                (unsigned long long)r->keys_loaded, (unsigned long long)r->demotions,
+                r->key_bytes, r->value_bytes, r->accounted_bytes, r->bucket_bytes, r->fixed_heap,
+                r->heap_bytes, r->allocator_bytes, r->rss_bytes, (unsigned long long)r->allocs,
+                per_key(r->heap_bytes, r), per_key(r->rss_bytes, r),
+                signed_per_key(r->rss_bytes, stored_value_bytes(&runs[i], r), r));
+        first = false;
+    }
+    fprintf(out, "\n  ]\n}\n");
+    if (!to_stdout) fclose(out);
+    return 0;
+}
+
+/* =============================================
+ * main
+ * ============================================= */
+
+static int parse_layouts(const char *spec, bool *selected) {
+    char *copy = strdup(spec);
+    int found = 0;
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        int l;
+        for (l = 0; l < LAYOUT_COUNT; l++) {
+            if (strcmp(tok, layout_names[l]) == 0) break;
+        }
+        if (l == LAYOUT_COUNT) {
+            free(copy);
+            return -1;
+        }
+        selected[l] = true;
+        found++;
+    }
+    free(copy);
+    return found;
+}
+
+static int parse_partitions(const char *spec, int *out, int max) {
+    char *copy = strdup(spec);
+    int count = 0;
+    for (char *tok = strtok(copy, ","); tok && count < max; tok = strtok(NULL, ",")) {
+        int n = atoi(tok);
+        if (n < 1 || n > 20) {
+            free(copy);
+            return -1;
+        }
+        out[count++] = n;
+    }
+    free(copy);
+    return count;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -n, --keys N         keys to load (default 100000)\n"
+            "  -K, --key-size DIST  key length: fixed:N, uniform:A-B, exp:MEAN (default fixed:16)\n"
+            "  -d, --value-size DIST value size, same syntax (default fixed:100)\n"
+            "  -L, --layouts LIST   comma separated layouts (default pod,lru,index)\n"
+            "  -P, --partitions LIST partition counts for pod/index (default 1,8)\n"
+            "  -m, --memory MB      cache capacity (default: large enough to avoid demotion)\n"
+            "      --seed N         random seed (default 1)\n"
+            "      --json FILE      write results as JSON ('-' = stdout)\n"
+            "  -l, --list           list layouts and exit\n"
+            "Run under LD_PRELOAD=libjemalloc.so etc. to compare allocators.\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    mem_config_t config = {.keys = 100000, .seed = 1};
+    size_dist_parse(&config.key_dist, "fixed:16");
+    size_dist_parse(&config.value_dist, "fixed:100");
+    bool selected[LAYOUT_COUNT] = {true, true, true};
+    int partitions[16] = {1, 8};
+    int partition_count = 2;
+
+    static const struct option options[] = {
+        {"keys", required_argument, NULL, 'n'},
+        {"key-size", required_argument, NULL, 'K'},
+        {"value-size", required_argument, NULL, 'd'},
+        {"layouts", required_argument, NULL, 'L'},
+        {"partitions", required_argument, NULL, 'P'},
+        {"memory", required_argument, NULL, 'm'},
+        {"seed", required_argument, NULL, 1},
+        {"json", required_argument, NULL, 2},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "n:K:d:L:P:m:lh", options, NULL)) != -1) {
+        switch (opt) {
+        case 'n': config.keys = strtoull(optarg, NULL, 10); break;
+        case 'K':
+            if (size_dist_parse(&config.key_dist, optarg) != 0) {
+                fprintf(stderr, "invalid key size distribution: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'd':
+            if (size_dist_parse(&config.value_dist, optarg) != 0) {
+                fprintf(stderr, "invalid value size distribution: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'L':
+            memset(selected, 0, sizeof(selected));
+            if (parse_layouts(optarg, selected) <= 0) {
+                fprintf(stderr, "invalid layout list: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'P':
+            partition_count = parse_partitions(optarg, partitions, 16);
+            if (partition_count <= 0) {
+                fprintf(stderr, "invalid partition list: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'm': config.capacity = MB_TO_BYTES(strtoull(optarg, NULL, 10)); break;
+        case 1: config.seed = strtoull(optarg, NULL, 10); break;
+        case 2: config.json_path = optarg; break;
+        case 'l':
+            for (int l = 0; l < LAYOUT_COUNT; l++) {
+                printf("%-6s %s\n", layout_names[l], layout_descriptions[l]);
+            }
+            return EXIT_SUCCESS;
+        default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (config.keys == 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    clog_init(LOG_LEVEL_FATAL, NULL);
+
+    mem_run_t runs[MEM_MAX_RUNS];
+    int run_count = 0;
+    for (int l = 0; l < LAYOUT_COUNT; l++) {
+        if (!selected[l]) continue;
+        if (l == LAYOUT_LRU) {
+            runs[run_count++] = (mem_run_t){.layout = LAYOUT_LRU, .partitions = 1};
+            continue;
+        }
+        for (int p = 0; p < partition_count && run_count < MEM_MAX_RUNS; p++) {
+            runs[run_count++] = (mem_run_t){.layout = (layout_e)l, .partitions = partitions[p]};
+        }
+    }
+
+    char key_desc[64], value_desc[64];
+    size_dist_describe(&config.key_dist, key_desc, sizeof(key_desc));
+    size_dist_describe(&config.value_dist, value_desc, sizeof(value_desc));
+    printf("memory bench: %llu keys, key size %s, value size %s, allocator %s%s\n",
+           (unsigned long long)config.keys, key_desc, value_desc, allocator_name(),
+#ifdef BENCH_TRACK_HEAP
+           ""
+#else
+           " (heap tracking not available on this platform)"
+#endif
+    );
+
+    mem_result_t results[MEM_MAX_RUNS];
+    int failures = 0;
+    for (int i = 0; i < run_count; i++) {
+        if (run_forked(&config, &runs[i], &results[i]) != 0) {
+            results[i].ok = 0;
+            failures++;
+        }
+    }
+
+    print_results(runs, results, run_count);
+    if (config.json_path && write_json(&config, runs, results, run_count) != 0) failures++;
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# PodCache memory efficiency benchmark
+# Esegue podcache_membench con l'allocatore della libc e con ogni allocatore alternativo
+# trovato nel sistema (jemalloc, tcmalloc, mimalloc) caricato via LD_PRELOAD.
+# Gli argomenti dopo le opzioni dello script vengono passati a podcache_membench.
+#
+# Usage: bench/mem_bench.sh [--build DIR] [--json-dir DIR] [membench options...]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="$SCRIPT_DIR/../build"
+JSON_DIR=""
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --build) BUILD_DIR="$2"; shift 2 ;;
+        --json-dir) JSON_DIR="$2"; shift 2 ;;
+        *) break ;;
+    esac
+done
+
+MEMBENCH="$BUILD_DIR/bench/podcache_membench"
+if [ ! -x "$MEMBENCH" ]; then
+    echo "podcache_membench not found in $BUILD_DIR, build the project first"
+    exit 1
+fi
+
+[ -n "$JSON_DIR" ] && mkdir -p "$JSON_DIR"
+
+find_library() {
+    local name
+    for dir in /usr/lib/x86_64-linux-gnu /usr/lib/aarch64-linux-gnu /usr/lib64 /usr/lib \
+               /usr/local/lib /opt/homebrew/lib; do
+        for name in "$@"; do
+            if [ -e "$dir/$name" ]; then
+                echo "$dir/$name"
+                return
+            fi
+        done
+    done
+}
+
+run_allocator() {
+    local name="$1" preload="$2"
+    shift 2
+    local json_args=()
+    [ -n "$JSON_DIR" ] && json_args=(--json "$JSON_DIR/membench-$name.json")
+    echo
+    echo "=== $name ==="
+    if [ -n "$preload" ]; then
+        LD_PRELOAD="$preload" "$MEMBENCH" "${json_args[@]}" "$@"
+    else
+        "$MEMBENCH" "${json_args[@]}" "$@"
+    fi
+}
+
+run_allocator libc "" "$@"
+
+JEMALLOC=$(find_library libjemalloc.so.2 libjemalloc.so)
+TCMALLOC=$(find_library libtcmalloc_minimal.so.4 libtcmalloc.so.4 libtcmalloc_minimal.so)
+MIMALLOC=$(find_library libmimalloc.so.2 libmimalloc.so)
+
+[ -n "$JEMALLOC" ] && run_allocator jemalloc "$JEMALLOC" "$@"
+[ -n "$TCMALLOC" ] && run_allocator tcmalloc "$TCMALLOC" "$@"
+[ -n "$MIMALLOC" ] && run_allocator mimalloc "$MIMALLOC" "$@"
+
+if [ -z "$JEMALLOC$TCMALLOC$MIMALLOC" ]; then
+    echo
+    echo "no alternative allocator found (install libjemalloc2, libtcmalloc-minimal4 or libmimalloc2)"
+fi
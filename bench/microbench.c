@@ -0,0 +1,749 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Microbenchmark delle primitive interne (lru_cache, pod_cache, resp_parse, hash, cas).
+ * Per ogni benchmark riporta ns/op, allocazioni/op e throughput al variare dei thread.
+ */
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "cas.h"
+#include "clogger.h"
+#include "hash_func.h"
+#include "lru_cache.h"
+#include "pod_cache.h"
+#include "resp_parser.h"
+#include "shm_index.h"
+
+#define MB_KEYSPACE 100000
+#define MB_VALUE_SIZE 100
+#define MB_DISK_VALUE_SIZE 1024
+#define MB_MAX_THREADS 64
+#define MB_MAX_REPEAT 32
+
+/* =============================================
+ * allocation counting (--wrap del linker, solo Linux)
+ * ============================================= */
+
+static __thread uint64_t tls_allocs = 0;
+
+#ifdef BENCH_COUNT_ALLOCS
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+
+void *__wrap_malloc(size_t size) {
+    tls_allocs++;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size) {
+    tls_allocs++;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+    tls_allocs++;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s) {
+    tls_allocs++;
+    return __real_strdup(s);
+}
+#endif
+
+/* =============================================
+ * benchmark definitions
+ * ============================================= */
+
+typedef struct {
+    int threads;
+    uint64_t ops_per_thread;
+    char **keys;       // MB_KEYSPACE chiavi precalcolate
+    char *value;       // MB_DISK_VALUE_SIZE byte
+    lru_cache_t *lru;
+    pod_cache_t *pod;
+    cas_registry_t *cas;
+    char **extra_keys; // chiavi dedicate (threads * ops_per_thread)
+    shm_index_t *shm;        // indice pubblicato, lato server
+    shm_index_t *shm_reader; // stesso segmento aperto come un client
+} bench_shared_t;
+
+typedef struct {
+    const char *name;
+    uint64_t default_ops; // operazioni per thread
+    int (*setup)(bench_shared_t *shared);
+    void (*run)(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng);
+    void (*teardown)(bench_shared_t *shared);
+} microbench_t;
+
+static char **make_keys(const char *prefix, uint64_t count) {
+    char **keys = malloc(count * sizeof(char *));
+    if (!keys) return NULL;
+    char key[64];
+    for (uint64_t i = 0; i < count; i++) {
+        snprintf(key, sizeof(key), "%s%llu", prefix, (unsigned long long)i);
+        keys[i] = strdup(key);
+    }
+    return keys;
+}
+
+static void free_keys(char **keys, uint64_t count) {
+    if (!keys) return;
+    for (uint64_t i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+}
+
+static uint64_t extra_key_count(const bench_shared_t *shared) {
+    return (uint64_t)shared->threads * shared->ops_per_thread;
+}
+
+static int setup_extra_keys(bench_shared_t *shared) {
+    shared->extra_keys = make_keys("extra:", extra_key_count(shared));
+    return shared->extra_keys ? 0 : -1;
+}
+
+static void teardown_all(bench_shared_t *shared) {
+    if (shared->lru) lru_cache_destroy(shared->lru);
+    if (shared->pod) pod_cache_destroy(shared->pod);
+    if (shared->cas) cas_registry_destroy(shared->cas);
+    if (shared->shm_reader) shm_index_close(shared->shm_reader);
+    if (shared->shm) shm_index_destroy(shared->shm);
+    free_keys(shared->extra_keys, extra_key_count(shared));
+    shared->lru = NULL;
+    shared->pod = NULL;
+    shared->cas = NULL;
+    shared->extra_keys = NULL;
+    shared->shm = NULL;
+    shared->shm_reader = NULL;
+}
+
+/* --- lru_cache --- */
+
+static int setup_lru_empty(bench_shared_t *shared) {
+    shared->lru = lru_cache_create(MB_TO_BYTES(4096));
+    return shared->lru ? setup_extra_keys(shared) : -1;
+}
+
+static int setup_lru_filled(bench_shared_t *shared) {
+    if (setup_lru_empty(shared) != 0) return -1;
+    for (uint64_t i = 0; i < MB_KEYSPACE; i++) {
+        lru_cache_put(shared->lru, shared->keys[i], shared->value, MB_VALUE_SIZE);
+    }
+    for (uint64_t i = 0; i < extra_key_count(shared); i++) {
+        lru_cache_put(shared->lru, shared->extra_keys[i], shared->value, MB_VALUE_SIZE);
+    }
+    return 0;
+}
+
+static void run_lru_put(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)rng;
+    char **keys = shared->extra_keys + (uint64_t)thread_id * shared->ops_per_thread;
+    for (uint64_t i = 0; i < ops; i++) {
+        lru_cache_put(shared->lru, keys[i], shared->value, MB_VALUE_SIZE);
+    }
+}
+
+static void run_lru_get(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    void *value;
+    size_t size;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        if (lru_cache_get(shared->lru, key, &value, &size) == 0) free(value);
+    }
+}
+
+static void run_lru_evict(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)rng;
+    char **keys = shared->extra_keys + (uint64_t)thread_id * shared->ops_per_thread;
+    for (uint64_t i = 0; i < ops; i++) {
+        lru_cache_evict(shared->lru, keys[i]);
+    }
+}
+
+static void run_lru_remove_tail(bench_shared_t *shared, int thread_id, uint64_t ops,
+                                bench_rng_t *rng) {
+    (void)thread_id;
+    (void)rng;
+    for (uint64_t i = 0; i < ops; i++) {
+        lru_cache_remove_tail(shared->lru);
+    }
+}
+
+/* --- pod_cache --- */
+
+static int setup_pod_memory(bench_shared_t *shared) {
+    shared->pod = pod_cache_create(MB_TO_BYTES(1024), 8);
+    if (!shared->pod) return -1;
+    for (uint64_t i = 0; i < MB_KEYSPACE; i++) {
+        pod_cache_put(shared->pod, shared->keys[i], shared->value, MB_VALUE_SIZE);
+    }
+    return 0;
+}
+
+// cache piccola: ogni put sposta la coda della partizione su disco
+static int setup_pod_spill(bench_shared_t *shared) {
+    shared->pod = pod_cache_create(MB_TO_BYTES(1), 4);
+    if (!shared->pod) return -1;
+    for (uint64_t i = 0; i < 2048; i++) {
+        pod_cache_put(shared->pod, shared->keys[i], shared->value, MB_DISK_VALUE_SIZE);
+    }
+    return 0;
+}
+
+// la maggior parte delle chiavi è su disco: ogni get le promuove in memoria
+static int setup_pod_disk(bench_shared_t *shared) {
+    shared->pod = pod_cache_create(MB_TO_BYTES(1), 4);
+    if (!shared->pod) return -1;
+    for (uint64_t i = 0; i < 8192; i++) {
+        pod_cache_put(shared->pod, shared->keys[i], shared->value, MB_DISK_VALUE_SIZE);
+    }
+    return 0;
+}
+
+static void run_pod_put(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        pod_cache_put(shared->pod, key, shared->value, MB_VALUE_SIZE);
+    }
+}
+
+static void run_pod_put_spill(bench_shared_t *shared, int thread_id, uint64_t ops,
+                              bench_rng_t *rng) {
+    (void)thread_id;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[2048 + bench_rng_range(rng, MB_KEYSPACE - 2048)];
+        pod_cache_put(shared->pod, key, shared->value, MB_DISK_VALUE_SIZE);
+    }
+}
+
+static void run_pod_get(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    void *value;
+    size_t size;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        if (pod_cache_get(shared->pod, key, &value, &size) >= 0) free(value);
+    }
+}
+
+// lettura in place: nessuna copia né free del valore
+static void run_pod_borrow(bench_shared_t *shared, int thread_id, uint64_t ops,
+                           bench_rng_t *rng) {
+    (void)thread_id;
+    pod_cache_handle_t handle;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        if (pod_cache_borrow(shared->pod, key, &handle) == 0) pod_cache_release(&handle);
+    }
+}
+
+#define MB_BATCH 16
+
+// ops conta le chiavi, non i batch, per confrontare i ns/op con pod_cache_borrow
+static void run_pod_mget(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    const char *keys[MB_BATCH];
+    pod_cache_handle_t handles[MB_BATCH];
+    for (uint64_t i = 0; i < ops; i += MB_BATCH) {
+        for (int k = 0; k < MB_BATCH; k++) {
+            keys[k] = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        }
+        pod_cache_mget(shared->pod, MB_BATCH, keys, handles, NULL);
+        pod_cache_release_all(handles, MB_BATCH);
+    }
+}
+
+static void run_pod_get_disk(bench_shared_t *shared, int thread_id, uint64_t ops,
+                             bench_rng_t *rng) {
+    (void)thread_id;
+    void *value;
+    size_t size;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, 8192)];
+        if (pod_cache_get(shared->pod, key, &value, &size) >= 0) free(value);
+    }
+}
+
+/* --- shm_index --- */
+
+static void shm_publish_listener(pod_cache_event_e event, const char *key, const void *value,
+                                 size_t size, void *ctx) {
+    if (event == POD_CACHE_EVENT_PUT || event == POD_CACHE_EVENT_PROMOTE) {
+        shm_index_publish(ctx, key, strlen(key), value, size);
+    } else {
+        shm_index_remove(ctx, key, strlen(key));
+    }
+}
+
+// come il server con PODCACHE_SHM_NAME: ogni put viene pubblicata nel segmento
+static int setup_shm(bench_shared_t *shared) {
+    char name[64];
+    snprintf(name, sizeof(name), "/podcache-microbench-%d", (int)getpid());
+    shared->shm = shm_index_create(name, MB_TO_BYTES(64), 0600);
+    if (!shared->shm) return -1;
+    shared->pod = pod_cache_create(MB_TO_BYTES(1024), 8);
+    if (!shared->pod) return -1;
+    pod_cache_add_listener(shared->pod, shm_publish_listener, shared->shm);
+    for (uint64_t i = 0; i < MB_KEYSPACE; i++) {
+        pod_cache_put(shared->pod, shared->keys[i], shared->value, MB_VALUE_SIZE);
+    }
+    shared->shm_reader = shm_index_open(name);
+    return shared->shm_reader ? 0 : -1;
+}
+
+// lettura di un client nello stesso pod: nessun lock, nessuna syscall
+static void run_shm_get(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    char buf[MB_VALUE_SIZE];
+    size_t size;
+    for (uint64_t i = 0; i < ops; i++) {
+        const char *key = shared->keys[bench_rng_range(rng, MB_KEYSPACE)];
+        shm_index_get(shared->shm_reader, key, strlen(key), buf, sizeof(buf), &size);
+    }
+}
+
+// SET con la pubblicazione nel segmento: il costo aggiunto al percorso di scrittura
+static void run_shm_put(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    run_pod_put(shared, thread_id, ops, rng);
+}
+
+/* --- resp_parse --- */
+
+static const char *resp_samples[] = {
+    "*3\r\n$3\r\nSET\r\n$16\r\nuser:1000:profil\r\n$100\r\n"
+    "xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxx"
+    "xxxxxxxxxx\r\n",
+    "*2\r\n$3\r\nGET\r\n$16\r\nuser:1000:profil\r\n",
+    "*2\r\n$4\r\nINCR\r\n$12\r\npage:counter\r\n",
+    "*4\r\n$6\r\nCLIENT\r\n$7\r\nSETINFO\r\n$8\r\nLIB-NAME\r\n$5\r\njedis\r\n",
+};
+#define RESP_SAMPLES (sizeof(resp_samples) / sizeof(resp_samples[0]))
+
+static void run_resp_parse(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)shared;
+    (void)thread_id;
+    (void)rng;
+    size_t lengths[RESP_SAMPLES];
+    for (size_t i = 0; i < RESP_SAMPLES; i++) {
+        lengths[i] = strlen(resp_samples[i]);
+    }
+    for (uint64_t i = 0; i < ops; i++) {
+        resp_command_t cmd;
+        size_t s = i % RESP_SAMPLES;
+        if (resp_parse(resp_samples[s], lengths[s], &cmd) > 0) {
+            resp_decode_command(cmd.command);
+            resp_command_free(&cmd);
+        }
+    }
+}
+
+/* --- codifica delle risposte (interi e header delle bulk string) --- */
+
+static volatile size_t encode_sink;
+
+static void run_resp_encode(bench_shared_t *shared, int thread_id, uint64_t ops,
+                            bench_rng_t *rng) {
+    (void)shared;
+    (void)thread_id;
+    char buffer[RESP_INTEGER_MAX_LEN];
+    size_t total = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        // valori tipici: contatori e lunghezze dei valori
+        long long value = (long long)bench_rng_range(rng, 100000);
+        total += resp_encode_integer(buffer, (i & 1) ? ':' : '$', value);
+    }
+    encode_sink = total;
+}
+
+/* --- hashing --- */
+
+static volatile uint32_t hash_sink;
+
+static void run_hash(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    (void)rng;
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < ops; i++) {
+        acc ^= hash(shared->keys[i % MB_KEYSPACE]);
+    }
+    hash_sink = acc;
+}
+
+static void run_sha256(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    (void)rng;
+    char digest[65];
+    for (uint64_t i = 0; i < ops; i++) {
+        sha256_string(shared->keys[i % MB_KEYSPACE], digest);
+    }
+    hash_sink = (uint32_t)digest[0];
+}
+
+/* --- cas --- */
+
+static int setup_cas(bench_shared_t *shared) {
+    shared->cas = cas_create_registry();
+    return shared->cas ? setup_extra_keys(shared) : -1;
+}
+
+static int setup_cas_filled(bench_shared_t *shared) {
+    if (setup_cas(shared) != 0) return -1;
+    char path[512];
+    for (uint64_t i = 0; i < extra_key_count(shared); i++) {
+        if (cas_put(shared->cas, shared->extra_keys[i], shared->value, MB_DISK_VALUE_SIZE,
+                    path) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void run_cas_put(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)rng;
+    char **keys = shared->extra_keys + (uint64_t)thread_id * shared->ops_per_thread;
+    char path[512];
+    for (uint64_t i = 0; i < ops; i++) {
+        cas_put(shared->cas, keys[i], shared->value, MB_DISK_VALUE_SIZE, path);
+    }
+}
+
+static void run_cas_get(bench_shared_t *shared, int thread_id, uint64_t ops, bench_rng_t *rng) {
+    (void)thread_id;
+    void *value;
+    size_t size;
+    uint64_t count = extra_key_count(shared);
+    for (uint64_t i = 0; i < ops; i++) {
+        if (cas_get(shared->cas, shared->extra_keys[bench_rng_range(rng, count)], &value, &size) ==
+            0) {
+            free(value);
+        }
+    }
+}
+
+static const microbench_t benchmarks[] = {
+    {"lru_cache_put", 200000, setup_lru_empty, run_lru_put, teardown_all},
+    {"lru_cache_get", 500000, setup_lru_filled, run_lru_get, teardown_all},
+    {"lru_cache_evict", 100000, setup_lru_filled, run_lru_evict, teardown_all},
+    {"lru_cache_remove_tail", 100000, setup_lru_filled, run_lru_remove_tail, teardown_all},
+    {"pod_cache_put", 500000, setup_pod_memory, run_pod_put, teardown_all},
+    {"pod_cache_put_spill", 2000, setup_pod_spill, run_pod_put_spill, teardown_all},
+    {"pod_cache_get", 500000, setup_pod_memory, run_pod_get, teardown_all},
+    {"pod_cache_borrow", 500000, setup_pod_memory, run_pod_borrow, teardown_all},
+    {"pod_cache_mget", 500000, setup_pod_memory, run_pod_mget, teardown_all},
+    {"pod_cache_get_disk", 2000, setup_pod_disk, run_pod_get_disk, teardown_all},
+    {"shm_index_get", 2000000, setup_shm, run_shm_get, teardown_all},
+    {"pod_cache_put_shm", 500000, setup_shm, run_shm_put, teardown_all},
+    {"resp_parse", 1000000, NULL, run_resp_parse, NULL},
+    {"resp_encode_integer", 5000000, NULL, run_resp_encode, NULL},
+    {"hash", 5000000, NULL, run_hash, NULL},
+    {"sha256_string", 500000, NULL, run_sha256, NULL},
+    {"cas_put", 2000, setup_cas, run_cas_put, teardown_all},
+    {"cas_get", 5000, setup_cas_filled, run_cas_get, teardown_all},
+};
+#define BENCHMARK_COUNT (sizeof(benchmarks) / sizeof(benchmarks[0]))
+
+/* =============================================
+ * runner
+ * ============================================= */
+
+typedef struct {
+    const microbench_t *bench;
+    bench_shared_t *shared;
+    pthread_barrier_t *barrier;
+    int thread_id;
+    uint64_t ops;
+    uint64_t seed;
+    uint64_t allocs;
+    uint64_t end_ns;
+} worker_t;
+
+static void *bench_worker(void *arg) {
+    worker_t *w = arg;
+    bench_rng_t rng;
+    bench_rng_seed(&rng, w->seed + (uint64_t)w->thread_id);
+
+    pthread_barrier_wait(w->barrier);
+    uint64_t allocs_before = tls_allocs;
+    w->bench->run(w->shared, w->thread_id, w->ops, &rng);
+    w->allocs = tls_allocs - allocs_before;
+    w->end_ns = bench_now_ns();
+    return NULL;
+}
+
+typedef struct {
+    double ns_per_op;
+    double allocs_per_op;
+    double mops;
+} bench_result_t;
+
+static int run_benchmark(const microbench_t *bench, bench_shared_t *shared, int threads,
+                         uint64_t ops, uint64_t seed, bench_result_t *result) {
+    shared->threads = threads;
+    shared->ops_per_thread = ops;
+    if (bench->setup && bench->setup(shared) != 0) {
+        fprintf(stderr, "%s: setup failed\n", bench->name);
+        if (bench->teardown) bench->teardown(shared);
+        return -1;
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, (unsigned)threads + 1);
+
+    worker_t workers[MB_MAX_THREADS];
+    pthread_t tids[MB_MAX_THREADS];
+    for (int i = 0; i < threads; i++) {
+        workers[i] = (worker_t){.bench = bench,
+                                .shared = shared,
+                                .barrier = &barrier,
+                                .thread_id = i,
+                                .ops = ops,
+                                .seed = seed};
+        pthread_create(&tids[i], NULL, bench_worker, &workers[i]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    uint64_t start = bench_now_ns();
+    uint64_t end = start;
+    uint64_t allocs = 0;
+    for (int i = 0; i < threads; i++) {
+        pthread_join(tids[i], NULL);
+        allocs += workers[i].allocs;
+        if (workers[i].end_ns > end) end = workers[i].end_ns;
+    }
+    pthread_barrier_destroy(&barrier);
+
+    if (bench->teardown) bench->teardown(shared);
+
+    double total_ops = (double)ops * threads;
+    double elapsed = (double)(end - start);
+    // ns/op è il tempo medio visto da ogni thread, il throughput è aggregato
+    result->ns_per_op = elapsed * threads / total_ops;
+    result->allocs_per_op = (double)allocs / total_ops;
+    result->mops = total_ops / elapsed * 1000.0;
+    return 0;
+}
+
+static int parse_thread_list(const char *spec, int *out, int max) {
+    int count = 0;
+    char *copy = strdup(spec);
+    for (char *tok = strtok(copy, ","); tok && count < max; tok = strtok(NULL, ",")) {
+        int n = atoi(tok);
+        if (n < 1 || n > MB_MAX_THREADS) {
+            free(copy);
+            return -1;
+        }
+        out[count++] = n;
+    }
+    free(copy);
+    return count;
+}
+
+static bool excluded(const char *name, const char *exclude) {
+    if (!exclude) return false;
+    char *copy = strdup(exclude);
+    bool match = false;
+    for (char *tok = strtok(copy, ","); tok && !match; tok = strtok(NULL, ",")) {
+        match = *tok && strstr(name, tok) != NULL;
+    }
+    free(copy);
+    return match;
+}
+
+static void json_print_samples(FILE *out, const double *samples, int count) {
+    fputc('[', out);
+    for (int i = 0; i < count; i++) {
+        fprintf(out, "%s%.3f", i ? ", " : "", samples[i]);
+    }
+    fputc(']', out);
+}
+
+// una metrica nel formato letto da podcache_perfcmp
+static void json_print_metric(FILE *out, bool *first, const char *name, const char *unit,
+                              const char *better, const double *samples, int count) {
+    fprintf(out, "%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"better\": \"%s\", \"samples\": ",
+            *first ? "" : ",", name, unit, better);
+    json_print_samples(out, samples, count);
+    fputc('}', out);
+    *first = false;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  -t, --threads LIST   comma separated thread counts (default 1,2,4,8)\n"
+            "  -f, --filter TEXT    run only benchmarks whose name contains TEXT\n"
+            "  -x, --exclude LIST   skip benchmarks whose name contains any of the comma\n"
+            "                       separated words\n"
+            "  -s, --scale X        multiply the default operation counts by X (default 1)\n"
+            "  -r, --repeat N       run every benchmark N times, report the mean (default 1)\n"
+            "      --seed N         random seed (default 1)\n"
+            "      --json FILE      write every sample as JSON ('-' = stdout), for perf_compare\n"
+            "  -l, --list           list benchmarks and exit\n"
+            "Disk benchmarks write under PODCACHE_FSROOT (default ./)\n",
+            prog);
+}
+
+int main(int argc, char **argv) {
+    int thread_counts[16] = {1, 2, 4, 8};
+    int thread_count_len = 4;
+    const char *filter = NULL;
+    const char *exclude = NULL;
+    const char *json_path = NULL;
+    double scale = 1.0;
+    int repeat = 1;
+    uint64_t seed = 1;
+
+    static const struct option options[] = {
+        {"threads", required_argument, NULL, 't'},
+        {"filter", required_argument, NULL, 'f'},
+        {"exclude", required_argument, NULL, 'x'},
+        {"scale", required_argument, NULL, 's'},
+        {"repeat", required_argument, NULL, 'r'},
+        {"seed", required_argument, NULL, 1},
+        {"json", required_argument, NULL, 2},
+        {"list", no_argument, NULL, 'l'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:f:x:s:r:lh", options, NULL)) != -1) {
+        switch (opt) {
+        case 't':
+            thread_count_len = parse_thread_list(optarg, thread_counts, 16);
+            if (thread_count_len <= 0) {
+                fprintf(stderr, "invalid thread list: %s\n", optarg);
+                return EXIT_FAILURE;
+            }
+            break;
+        case 'f': filter = optarg; break;
+        case 'x': exclude = optarg; break;
+        case 's': scale = atof(optarg); break;
+        case 'r': repeat = atoi(optarg); break;
+        case 1: seed = strtoull(optarg, NULL, 10); break;
+        case 2: json_path = optarg; break;
+        case 'l':
+            for (size_t i = 0; i < BENCHMARK_COUNT; i++) {
+                printf("%s\n", benchmarks[i].name);
+            }
+            return EXIT_SUCCESS;
+        default: usage(argv[0]); return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+    if (scale <= 0) {
+        fprintf(stderr, "invalid scale\n");
+        return EXIT_FAILURE;
+    }
+    if (repeat < 1 || repeat > MB_MAX_REPEAT) {
+        fprintf(stderr, "invalid repeat count (1-%d)\n", MB_MAX_REPEAT);
+        return EXIT_FAILURE;
+    }
+
+    // con --json - lo stdout è riservato al JSON
+    bool json_to_stdout = json_path && strcmp(json_path, "-") == 0;
+    FILE *report = json_to_stdout ? stderr : stdout;
+    FILE *json = NULL;
+    if (json_path) {
+        json = json_to_stdout ? stdout : fopen(json_path, "w");
+        if (!json) {
+            perror(json_path);
+            return EXIT_FAILURE;
+        }
+        fprintf(json,
+                "{\n  \"tool\": \"podcache_microbench\",\n  \"timestamp\": %lld,\n"
+                "  \"config\": {\"scale\": %g, \"repeat\": %d, \"seed\": %llu},\n"
+                "  \"metrics\": [",
+                (long long)time(NULL), scale, repeat, (unsigned long long)seed);
+    }
+    bool json_first = true;
+
+    // i log della cache falsano le misure: solo errori
+    clog_init(LOG_LEVEL_ERROR, NULL);
+
+    bench_shared_t shared = {0};
+    shared.keys = make_keys("key:", MB_KEYSPACE);
+    shared.value = malloc(MB_DISK_VALUE_SIZE);
+    memset(shared.value, 'v', MB_DISK_VALUE_SIZE);
+
+#ifdef BENCH_COUNT_ALLOCS
+    const char *alloc_note = "";
+#else
+    const char *alloc_note = " (allocation counting not available on this platform)";
+#endif
+    fprintf(report, "%-24s %7s %12s %12s %12s%s\n", "benchmark", "threads", "ns/op",
+            "allocs/op", "Mops/s", alloc_note);
+
+    int failures = 0;
+    for (size_t b = 0; b < BENCHMARK_COUNT; b++) {
+        const microbench_t *bench = &benchmarks[b];
+        if (filter && !strstr(bench->name, filter)) continue;
+        if (excluded(bench->name, exclude)) continue;
+
+        uint64_t ops = (uint64_t)(bench->default_ops * scale);
+        if (ops == 0) ops = 1;
+
+        for (int t = 0; t < thread_count_len; t++) {
+            int threads = thread_counts[t];
+
+            // ogni ripetizione riparte da setup, così i campioni sono indipendenti
+            double ns_samples[MB_MAX_REPEAT], alloc_samples[MB_MAX_REPEAT];
+            bench_result_t mean = {0};
+            int done = 0;
+            for (int r = 0; r < repeat; r++) {
+                bench_result_t result;
+                if (run_benchmark(bench, &shared, threads, ops, seed, &result) != 0) break;
+                ns_samples[done] = result.ns_per_op;
+                alloc_samples[done] = result.allocs_per_op;
+                mean.ns_per_op += result.ns_per_op;
+                mean.allocs_per_op += result.allocs_per_op;
+                mean.mops += result.mops;
+                done++;
+            }
+            if (done < repeat) {
+                failures++;
+                continue;
+            }
+            fprintf(report, "%-24s %7d %12.1f %12.2f %12.3f\n", bench->name, threads,
+                    mean.ns_per_op / done, mean.allocs_per_op / done, mean.mops / done);
+            fflush(report);
+
+            if (json) {
+                char name[96];
+                snprintf(name, sizeof(name), "microbench/%s/t%d", bench->name, threads);
+                json_print_metric(json, &json_first, name, "ns/op", "lower", ns_samples, done);
+#ifdef BENCH_COUNT_ALLOCS
+                snprintf(name, sizeof(name), "microbench/%s/t%d/allocs", bench->name, threads);
+                json_print_metric(json, &json_first, name, "allocs/op", "lower", alloc_samples,
+                                  done);
+#endif
+            }
+        }
+    }
+
+    if (json) {
+        fprintf(json, "\n  ]\n}\n");
+        if (!json_to_stdout) fclose(json);
+    }
+
+    free_keys(shared.keys, MB_KEYSPACE);
+    free(shared.value);
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,468 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Confronto tra una baseline e una nuova esecuzione dei benchmark. Entrambi i file contengono
+ * una lista di metriche, ognuna con più campioni (ripetizioni): per ogni metrica si calcola la
+ * variazione della media e, con il t-test di Welch, se è statisticamente significativa.
+ * Una metrica è una regressione se peggiora più della soglia e il peggioramento è
+ * significativo al livello di confidenza scelto. Exit code: 0 ok, 1 regressione, 2 errore.
+ *
+ * Con --collect converte una serie di risultati JSON di podcache_loadgen (una ripetizione per
+ * file) nello stesso formato a metriche; con --merge unisce i campioni di più file a metriche
+ * (per esempio un processo podcache_microbench per ripetizione).
+ */
+
+#include <getopt.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PC_MAX_METRICS 512
+#define PC_MAX_SAMPLES 64
+#define PC_MAX_NAME 128
+
+typedef struct {
+    char name[PC_MAX_NAME];
+    char unit[24];
+    bool higher_is_better;
+    double samples[PC_MAX_SAMPLES];
+    int count;
+} metric_t;
+
+typedef struct {
+    metric_t *metrics;
+    int count;
+} metric_set_t;
+
+/* =============================================
+ * minimal JSON reading: solo il formato scritto dai nostri strumenti
+ * ============================================= */
+
+static char *read_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(f);
+        return NULL;
+    }
+    char *data = malloc((size_t)size + 1);
+    if (!data) {
+        fclose(f);
+        return NULL;
+    }
+    size_t n = fread(data, 1, (size_t)size, f);
+    fclose(f);
+    data[n] = '\0';
+    return data;
+}
+
+// posizione del valore associato a "key" tra from e to (to NULL = fine stringa)
+static const char *find_value(const char *from, const char *to, const char *key) {
+    char pattern[PC_MAX_NAME + 4];
+    snprintf(pattern, sizeof(pattern), "\"%s\"", key);
+    size_t len = strlen(pattern);
+    for (const char *p = strstr(from, pattern); p && (!to || p < to); p = strstr(p + 1, pattern)) {
+        const char *c = p + len;
+        while (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r') c++;
+        if (*c != ':') continue;
+        c++;
+        while (*c == ' ' || *c == '\t' || *c == '\n' || *c == '\r') c++;
+        return c;
+    }
+    return NULL;
+}
+
+static int copy_string(const char *value, char *out, size_t out_size) {
+    if (!value || *value != '"') return -1;
+    const char *end = strchr(value + 1, '"');
+    if (!end) return -1;
+    size_t len = (size_t)(end - value - 1);
+    if (len >= out_size) len = out_size - 1;
+    memcpy(out, value + 1, len);
+    out[len] = '\0';
+    return 0;
+}
+
+static int parse_metrics(const char *path, metric_set_t *set) {
+    char *data = read_file(path);
+    if (!data) return -1;
+
+    const char *list = find_value(data, NULL, "metrics");
+    if (!list || *list != '[') {
+        fprintf(stderr, "%s: no \"metrics\" list\n", path);
+        free(data);
+        return -1;
+    }
+
+    set->count = 0;
+    const char *p = list + 1;
+    while ((p = strchr(p, '{')) != NULL && set->count < PC_MAX_METRICS) {
+        const char *end = strchr(p, '}');
+        if (!end) break;
+        metric_t *m = &set->metrics[set->count];
+        memset(m, 0, sizeof(*m));
+        char better[16] = "lower";
+        if (copy_string(find_value(p, end, "name"), m->name, sizeof(m->name)) != 0) {
+            fprintf(stderr, "%s: metric without name\n", path);
+            free(data);
+            return -1;
+        }
+        copy_string(find_value(p, end, "unit"), m->unit, sizeof(m->unit));
+        copy_string(find_value(p, end, "better"), better, sizeof(better));
+        m->higher_is_better = strcmp(better, "higher") == 0;
+
+        const char *samples = find_value(p, end, "samples");
+        if (samples && *samples == '[') {
+            const char *c = samples + 1;
+            while (c < end && *c != ']' && m->count < PC_MAX_SAMPLES) {
+                char *next;
+                double v = strtod(c, &next);
+                if (next == c) break;
+                m->samples[m->count++] = v;
+                c = next;
+                while (*c == ',' || *c == ' ') c++;
+            }
+        }
+        set->count++;
+        p = end + 1;
+    }
+    free(data);
+    return 0;
+}
+
+/* =============================================
+ * statistics
+ * ============================================= */
+
+// t di Student a una coda, df 1..30; oltre si usa la normale
+static const double t_95[30] = {6.314, 2.920, 2.353, 2.132, 2.015, 1.943, 1.895, 1.860,
+                                1.833, 1.812, 1.796, 1.782, 1.771, 1.761, 1.753, 1.746,
+                                1.740, 1.734, 1.729, 1.725, 1.721, 1.717, 1.714, 1.711,
+                                1.708, 1.706, 1.703, 1.701, 1.699, 1.697};
+static const double t_99[30] = {31.821, 6.965, 4.541, 3.747, 3.365, 3.143, 2.998, 2.896,
+                                2.821,  2.764, 2.718, 2.681, 2.650, 2.624, 2.602, 2.583,
+                                2.567,  2.552, 2.539, 2.528, 2.518, 2.508, 2.500, 2.492,
+                                2.485,  2.479, 2.473, 2.467, 2.462, 2.457};
+
+static double t_critical(double df, int confidence) {
+    int d = (int)floor(df); // arrotondare per difetto è conservativo
+    if (d < 1) d = 1;
+    if (d > 30) return confidence == 99 ? 2.326 : 1.645;
+    return confidence == 99 ? t_99[d - 1] : t_95[d - 1];
+}
+
+static void mean_var(const metric_t *m, double *mean, double *var) {
+    double sum = 0;
+    for (int i = 0; i < m->count; i++) sum += m->samples[i];
+    *mean = m->count ? sum / m->count : 0;
+    double sq = 0;
+    for (int i = 0; i < m->count; i++) sq += (m->samples[i] - *mean) * (m->samples[i] - *mean);
+    *var = m->count > 1 ? sq / (m->count - 1) : 0;
+}
+
+typedef enum { VERDICT_OK, VERDICT_IMPROVED, VERDICT_REGRESSION, VERDICT_NOISE } verdict_e;
+
+static const char *verdict_names[] = {"ok", "improved", "REGRESSION", "ok (noise)"};
+
+typedef struct {
+    double base_mean;
+    double cur_mean;
+    double change;    // variazione relativa, > 0 = peggioramento
+    double ci;        // semi-ampiezza dell'intervallo di confidenza della variazione
+    bool significant;
+    verdict_e verdict;
+} comparison_t;
+
+static void compare_metric(const metric_t *base, const metric_t *cur, double threshold,
+                           int confidence, comparison_t *out) {
+    double base_var, cur_var;
+    mean_var(base, &out->base_mean, &base_var);
+    mean_var(cur, &out->cur_mean, &cur_var);
+
+    double delta = out->cur_mean - out->base_mean;
+    if (base->higher_is_better) delta = -delta;
+    double scale = fabs(out->base_mean) > 0 ? fabs(out->base_mean) : 1.0;
+    out->change = delta / scale;
+
+    // Welch: varianze diverse, campioni di dimensione diversa
+    double se2 = (base->count ? base_var / base->count : 0) + (cur->count ? cur_var / cur->count : 0);
+    double se = sqrt(se2);
+    if (se > 0 && base->count > 1 && cur->count > 1) {
+        double a = base_var / base->count, b = cur_var / cur->count;
+        double df = se2 * se2 / (a * a / (base->count - 1) + b * b / (cur->count - 1));
+        double t = t_critical(df, confidence);
+        out->ci = t * se / scale;
+        out->significant = fabs(delta) > t * se;
+    } else {
+        // un solo campione o metrica deterministica: conta solo la soglia
+        out->ci = 0;
+        out->significant = true;
+    }
+
+    if (out->change > threshold) {
+        out->verdict = out->significant ? VERDICT_REGRESSION : VERDICT_NOISE;
+    } else if (out->change < -threshold && out->significant) {
+        out->verdict = VERDICT_IMPROVED;
+    } else {
+        out->verdict = VERDICT_OK;
+    }
+}
+
+static const metric_t *find_metric(const metric_set_t *set, const char *name) {
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->metrics[i].name, name) == 0) return &set->metrics[i];
+    }
+    return NULL;
+}
+
+static int run_compare(const char *baseline_path, const char *current_path, double threshold,
+                       int confidence, bool verbose) {
+    metric_set_t base = {.metrics = calloc(PC_MAX_METRICS, sizeof(metric_t))};
+    metric_set_t cur = {.metrics = calloc(PC_MAX_METRICS, sizeof(metric_t))};
+    if (!base.metrics || !cur.metrics || parse_metrics(baseline_path, &base) != 0 ||
+        parse_metrics(current_path, &cur) != 0) {
+        free(base.metrics);
+        free(cur.metrics);
+        return 2;
+    }
+
+    printf("baseline %s vs %s (threshold %.1f%%, %d%% confidence)\n", baseline_path,
+           current_path, threshold * 100, confidence);
+    printf("%-44s %14s %14s %9s %9s  %s\n", "metric", "baseline", "current", "change", "+/-",
+           "verdict");
+
+    int regressions = 0, improved = 0, missing = 0;
+    for (int i = 0; i < base.count; i++) {
+        const metric_t *b = &base.metrics[i];
+        const metric_t *c = find_metric(&cur, b->name);
+        if (!c || c->count == 0) {
+            printf("%-44s %14s %14s %9s %9s  missing\n", b->name, "", "", "", "");
+            missing++;
+            continue;
+        }
+        comparison_t cmp;
+        compare_metric(b, c, threshold, confidence, &cmp);
+        if (cmp.verdict == VERDICT_REGRESSION) regressions++;
+        if (cmp.verdict == VERDICT_IMPROVED) improved++;
+        if (!verbose && cmp.verdict == VERDICT_OK) continue;
+        // change è orientato: positivo = peggio, qualunque sia la direzione della metrica
+        printf("%-44s %14.3f %14.3f %+8.1f%% %8.1f%%  %s\n", b->name, cmp.base_mean,
+               cmp.cur_mean, cmp.change * 100, cmp.ci * 100, verdict_names[cmp.verdict]);
+    }
+    for (int i = 0; i < cur.count; i++) {
+        if (!find_metric(&base, cur.metrics[i].name)) {
+            printf("%-44s %14s %14s %9s %9s  new (no baseline)\n", cur.metrics[i].name, "", "",
+                   "", "");
+        }
+    }
+
+    printf("%d metrics, %d regressions, %d improved, %d missing\n", base.count, regressions,
+           improved, missing);
+    free(base.metrics);
+    free(cur.metrics);
+    return regressions ? 1 : 0;
+}
+
+/* =============================================
+ * --collect: risultati di podcache_loadgen -> metriche
+ * ============================================= */
+
+static int loadgen_number(const char *data, const char *section, const char *sub,
+                          const char *key, double *out) {
+    const char *p = find_value(data, NULL, section);
+    if (p && sub) p = find_value(p, NULL, sub);
+    if (p) p = find_value(p, NULL, key);
+    if (!p) return -1;
+    char *end;
+    *out = strtod(p, &end);
+    return end == p ? -1 : 0;
+}
+
+typedef struct {
+    const char *suffix;
+    const char *unit;
+    const char *better;
+    const char *section;
+    const char *sub;
+    const char *key;
+} collect_field_t;
+
+static const collect_field_t collect_fields[] = {
+    {"throughput", "ops/s", "higher", "results", NULL, "throughput"},
+    {"p50", "us", "lower", "latency_us", "all", "p50"},
+    {"p99", "us", "lower", "latency_us", "all", "p99"},
+};
+#define COLLECT_FIELDS (sizeof(collect_fields) / sizeof(collect_fields[0]))
+
+static int run_collect(const char *prefix, int file_count, char **files) {
+    if (file_count > PC_MAX_SAMPLES) file_count = PC_MAX_SAMPLES;
+    double values[COLLECT_FIELDS][PC_MAX_SAMPLES];
+    int count = 0;
+    for (int i = 0; i < file_count; i++) {
+        char *data = read_file(files[i]);
+        if (!data) return 2;
+        double v;
+        // una ripetizione fallita non è un campione valido
+        const char *ok = find_value(data, NULL, "ok");
+        if (!ok || strncmp(ok, "true", 4) != 0) {
+            fprintf(stderr, "%s: run failed, skipped\n", files[i]);
+            free(data);
+            continue;
+        }
+        bool complete = true;
+        for (size_t f = 0; f < COLLECT_FIELDS; f++) {
+            const collect_field_t *field = &collect_fields[f];
+            if (loadgen_number(data, field->section, field->sub, field->key, &v) != 0) {
+                complete = false;
+                break;
+            }
+            values[f][count] = v;
+        }
+        free(data);
+        if (!complete) {
+            fprintf(stderr, "%s: not a podcache_loadgen result, skipped\n", files[i]);
+            continue;
+        }
+        count++;
+    }
+    if (count == 0) {
+        fprintf(stderr, "no valid results to collect\n");
+        return 2;
+    }
+
+    printf("{\n  \"tool\": \"podcache_perfcmp\",\n  \"metrics\": [");
+    for (size_t f = 0; f < COLLECT_FIELDS; f++) {
+        printf("%s\n    {\"name\": \"%s/%s\", \"unit\": \"%s\", \"better\": \"%s\", \"samples\": [",
+               f ? "," : "", prefix, collect_fields[f].suffix, collect_fields[f].unit,
+               collect_fields[f].better);
+        for (int i = 0; i < count; i++) printf("%s%.3f", i ? ", " : "", values[f][i]);
+        printf("]}");
+    }
+    printf("\n  ]\n}\n");
+    return 0;
+}
+
+/* =============================================
+ * --merge: più file a metriche -> un file, campioni in ordine
+ * ============================================= */
+
+/* i campioni di processi diversi includono la variabilità tra un'esecuzione e l'altra (layout
+ * della memoria, vicini rumorosi), che le ripetizioni nello stesso processo non vedono */
+static int run_merge(int file_count, char **files) {
+    metric_set_t merged = {.metrics = calloc(PC_MAX_METRICS, sizeof(metric_t))};
+    metric_set_t set = {.metrics = calloc(PC_MAX_METRICS, sizeof(metric_t))};
+    if (!merged.metrics || !set.metrics) {
+        free(merged.metrics);
+        free(set.metrics);
+        return 2;
+    }
+    for (int i = 0; i < file_count; i++) {
+        if (parse_metrics(files[i], &set) != 0) {
+            free(merged.metrics);
+            free(set.metrics);
+            return 2;
+        }
+        for (int j = 0; j < set.count; j++) {
+            const metric_t *m = &set.metrics[j];
+            metric_t *target = (metric_t *)find_metric(&merged, m->name);
+            if (!target) {
+                if (merged.count == PC_MAX_METRICS) continue;
+                target = &merged.metrics[merged.count++];
+                *target = *m;
+                target->count = 0;
+            }
+            for (int k = 0; k < m->count && target->count < PC_MAX_SAMPLES; k++) {
+                target->samples[target->count++] = m->samples[k];
+            }
+        }
+    }
+
+    printf("{\n  \"tool\": \"podcache_perfcmp\",\n  \"metrics\": [");
+    for (int i = 0; i < merged.count; i++) {
+        const metric_t *m = &merged.metrics[i];
+        printf("%s\n    {\"name\": \"%s\", \"unit\": \"%s\", \"better\": \"%s\", \"samples\": [",
+               i ? "," : "", m->name, m->unit, m->higher_is_better ? "higher" : "lower");
+        for (int k = 0; k < m->count; k++) printf("%s%.3f", k ? ", " : "", m->samples[k]);
+        printf("]}");
+    }
+    printf("\n  ]\n}\n");
+    free(merged.metrics);
+    free(set.metrics);
+    return 0;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] BASELINE.json CURRENT.json\n"
+            "       %s --collect NAME LOADGEN.json...\n"
+            "       %s --merge METRICS.json...\n"
+            "  -t, --threshold PCT  minimum worsening reported as regression (default 5)\n"
+            "  -c, --confidence N   95 or 99 (default 95)\n"
+            "  -v, --verbose        show unchanged metrics too\n"
+            "      --collect NAME   merge podcache_loadgen results (one per run) into metrics\n"
+            "                       NAME/throughput, NAME/p50, NAME/p99 on stdout\n"
+            "      --merge          concatenate the samples of several metric files on stdout\n"
+            "Exit status: 0 no regression, 1 regression, 2 error\n",
+            prog, prog, prog);
+}
+
+int main(int argc, char **argv) {
+    double threshold = 5.0;
+    int confidence = 95;
+    bool verbose = false;
+    const char *collect = NULL;
+    bool merge = false;
+
+    static const struct option options[] = {
+        {"threshold", required_argument, NULL, 't'},
+        {"confidence", required_argument, NULL, 'c'},
+        {"verbose", no_argument, NULL, 'v'},
+        {"collect", required_argument, NULL, 1},
+        {"merge", no_argument, NULL, 2},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:c:vh", options, NULL)) != -1) {
+        switch (opt) {
+        case 't': threshold = atof(optarg); break;
+        case 'c': confidence = atoi(optarg); break;
+        case 'v': verbose = true; break;
+        case 1: collect = optarg; break;
+        case 2: merge = true; break;
+        default: usage(argv[0]); return opt == 'h' ? 0 : 2;
+        }
+    }
+
+    if (collect) {
+        if (optind >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        return run_collect(collect, argc - optind, argv + optind);
+    }
+    if (merge) {
+        if (optind >= argc) {
+            usage(argv[0]);
+            return 2;
+        }
+        return run_merge(argc - optind, argv + optind);
+    }
+    if (argc - optind != 2 || threshold < 0 || (confidence != 95 && confidence != 99)) {
+        usage(argv[0]);
+        return 2;
+    }
+    return run_compare(argv[optind], argv[optind + 1], threshold / 100.0, confidence, verbose);
+}
@@ -0,0 +1,195 @@
+#!/bin/bash
+
+# PodCache performance regression gate
+# Esegue i microbenchmark e un load test (seed fissi, più ripetizioni) e confronta i risultati
+# con le baseline in bench/baselines tramite podcache_perfcmp (t-test di Welch + soglia).
+# Esce con codice diverso da zero se almeno una metrica peggiora in modo significativo.
+#
+# Usage: bench/perf_gate.sh [--build DIR] [--runs N] [--threshold PCT] [--load-threshold PCT]
+#                           [--confidence 95|99] [--confirm N] [--baseline-dir DIR] [--out DIR]
+#                           [--no-micro] [--no-load] [--update]
+
+set -e
+
+SCRIPT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="$SCRIPT_DIR/../build"
+BASELINE_DIR="$SCRIPT_DIR/baselines"
+OUT_DIR=""
+RUNS=7
+MIN_RUNS=5 # con meno campioni il t-test scambia per regressione il rumore di una VM condivisa
+THRESHOLD=15
+LOAD_THRESHOLD=20
+CONFIRM=1 # ripetizioni di conferma per le metriche in regressione
+CONFIDENCE=95
+RUN_MICRO=1
+RUN_LOAD=1
+UPDATE=0
+SERVER_PORT=6392
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --build) BUILD_DIR="$2"; shift 2 ;;
+        --runs) RUNS="$2"; shift 2 ;;
+        --threshold) THRESHOLD="$2"; shift 2 ;;
+        --load-threshold) LOAD_THRESHOLD="$2"; shift 2 ;;
+        --confidence) CONFIDENCE="$2"; shift 2 ;;
+        --confirm) CONFIRM="$2"; shift 2 ;;
+        --baseline-dir) BASELINE_DIR="$2"; shift 2 ;;
+        --out) OUT_DIR="$2"; shift 2 ;;
+        --no-micro) RUN_MICRO=0; shift ;;
+        --no-load) RUN_LOAD=0; shift ;;
+        --update) UPDATE=1; shift ;;
+        *) echo "unknown option: $1"; exit 2 ;;
+    esac
+done
+
+if [ "$RUNS" -lt "$MIN_RUNS" ] && [ "$UPDATE" -eq 0 ]; then
+    echo "--runs $RUNS is too few samples for the t-test, using $MIN_RUNS"
+    RUNS=$MIN_RUNS
+fi
+
+MICROBENCH="$BUILD_DIR/bench/podcache_microbench"
+LOADGEN="$BUILD_DIR/bench/podcache_loadgen"
+PERFCMP="$BUILD_DIR/bench/podcache_perfcmp"
+SERVER="$BUILD_DIR/podcache"
+
+for tool in "$MICROBENCH" "$LOADGEN" "$PERFCMP" "$SERVER"; do
+    if [ ! -x "$tool" ]; then
+        echo "$tool not found, build the project first"
+        exit 2
+    fi
+done
+
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-perfgate-XXXXXX")"
+[ -z "$OUT_DIR" ] && OUT_DIR="$WORK_DIR/results"
+mkdir -p "$OUT_DIR" "$WORK_DIR/fsroot"
+SERVER_PID=""
+
+cleanup() {
+    if [ -n "$SERVER_PID" ]; then
+        kill "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+    fi
+    rm -rf "$WORK_DIR/fsroot" "$WORK_DIR/loadgen" "$WORK_DIR/microbench"
+    [ "$OUT_DIR" = "$WORK_DIR/results" ] && rm -rf "$WORK_DIR"
+    return 0
+}
+trap cleanup EXIT
+
+# solo le primitive in memoria: i benchmark su disco misurano soprattutto il filesystem.
+# Un processo per ripetizione: le ripetizioni nello stesso processo si somigliano più di due
+# esecuzioni diverse e il t-test scambierebbe per regressione la differenza tra due processi
+run_micro() {
+    echo "=== microbenchmarks ($RUNS runs) ==="
+    mkdir -p "$WORK_DIR/microbench"
+    local files=()
+    for i in $(seq 1 "$RUNS"); do
+        local file="$WORK_DIR/microbench/run-$i.json"
+        PODCACHE_FSROOT="$WORK_DIR/fsroot/" "$MICROBENCH" -t 1,4 -s 0.2 --seed 1 \
+            -x cas_,spill,disk --json "$file" > /dev/null 2>&1
+        files+=("$file")
+    done
+    "$PERFCMP" --merge "${files[@]}" > "$OUT_DIR/microbench.json"
+    grep -c '"name"' "$OUT_DIR/microbench.json" | sed 's/$/ metrics/'
+}
+
+# anche qui un server nuovo per ripetizione, per la stessa ragione dei microbenchmark
+run_load() {
+    echo
+    echo "=== load test ($RUNS runs) ==="
+    mkdir -p "$WORK_DIR/loadgen"
+    local files=()
+    for i in $(seq 1 "$RUNS"); do
+        rm -rf "$WORK_DIR/fsroot" && mkdir -p "$WORK_DIR/fsroot"
+        env PODCACHE_SIZE=64 PODCACHE_SERVER_PORT=$SERVER_PORT \
+            PODCACHE_FSROOT="$WORK_DIR/fsroot/" "$SERVER" > /dev/null 2>&1 &
+        SERVER_PID=$!
+        sleep 1
+        local file="$WORK_DIR/loadgen/run-$i.json"
+        "$LOADGEN" -p $SERVER_PORT -t 2 -c 4 -k 20000 -d fixed:100 -r 0.9 -z zipf:0.99 \
+            -n 100000 -s 1 --json "$file" > /dev/null || true
+        files+=("$file")
+        kill -INT "$SERVER_PID" 2>/dev/null || true
+        wait "$SERVER_PID" 2>/dev/null || true
+        SERVER_PID=""
+    done
+    "$PERFCMP" --collect loadgen/zipf-90-10 "${files[@]}" > "$OUT_DIR/loadgen.json"
+    grep '"name"' "$OUT_DIR/loadgen.json"
+}
+
+[ "$RUN_MICRO" -eq 1 ] && run_micro
+[ "$RUN_LOAD" -eq 1 ] && run_load
+
+if [ "$UPDATE" -eq 1 ]; then
+    mkdir -p "$BASELINE_DIR"
+    for name in microbench loadgen; do
+        [ -f "$OUT_DIR/$name.json" ] && cp "$OUT_DIR/$name.json" "$BASELINE_DIR/$name.json"
+    done
+    echo
+    echo "baselines updated in $BASELINE_DIR"
+    exit 0
+fi
+
+status=0
+# metriche peggiorate in modo significativo nel confronto appena fatto, una per riga
+regressed() {
+    grep "REGRESSION$" "$1" | awk '{ print $1 }' | sort
+}
+
+# una metrica fallisce solo se peggiora anche nelle ripetizioni di conferma: su una macchina
+# condivisa un vicino rumoroso rallenta tutta una sessione e il t-test non lo distingue
+compare() {
+    local name="$1" threshold="$2" rerun="$3"
+    echo
+    if [ ! -f "$BASELINE_DIR/$name.json" ]; then
+        echo "no baseline for $name in $BASELINE_DIR (run with --update)"
+        return
+    fi
+    local failing="" attempt
+    for attempt in $(seq 0 "$CONFIRM"); do
+        if [ "$attempt" -gt 0 ]; then
+            echo
+            echo "$(echo "$failing" | wc -l) $name regressions, confirming ($attempt/$CONFIRM)"
+            $rerun
+            echo
+        fi
+        # lo stato della pipeline è quello di tee: il risultato del confronto è in PIPESTATUS
+        "$PERFCMP" -t "$threshold" -c "$CONFIDENCE" "$BASELINE_DIR/$name.json" \
+            "$OUT_DIR/$name.json" | tee "$WORK_DIR/$name.cmp"
+        local rc=${PIPESTATUS[0]}
+        if [ "$rc" -gt 1 ]; then
+            status=$rc
+            return 0
+        fi
+        if [ "$attempt" -eq 0 ]; then
+            failing=$(regressed "$WORK_DIR/$name.cmp")
+        else
+            failing=$(comm -12 <(echo "$failing") <(regressed "$WORK_DIR/$name.cmp"))
+        fi
+        if [ -z "$failing" ]; then break; fi
+    done
+    if [ -n "$failing" ]; then
+        if [ "$attempt" -gt 0 ]; then
+            echo "confirmed regressions:"
+            echo "$failing"
+        fi
+        status=1
+    fi
+    # una metrica nuova non viene controllata finché la baseline non la contiene
+    local missing
+    missing=$(grep -c "new (no baseline)" "$WORK_DIR/$name.cmp" || true)
+    [ "$missing" -gt 0 ] && \
+        echo "$missing metrics not gated: refresh $BASELINE_DIR/$name.json with --update"
+    return 0
+}
+
+[ "$RUN_MICRO" -eq 1 ] && compare microbench "$THRESHOLD" run_micro
+[ "$RUN_LOAD" -eq 1 ] && compare loadgen "$LOAD_THRESHOLD" run_load
+
+echo
+if [ "$status" -eq 0 ]; then
+    echo "perf gate: PASS"
+else
+    echo "perf gate: FAIL"
+fi
+exit $status
@@ -0,0 +1,414 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ *
+ * Replay di una trace catturata dal server (PODCACHE_TRACE_FILE), in-process contro una
+ * pod_cache con la configurazione indicata oppure contro un server in esecuzione.
+ * Le chiavi sono ricostruite dal loro hash, i valori sono riempiti con byte fissi della
+ * dimensione registrata.
+ */
+
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "clogger.h"
+#include "pod_cache.h"
+#include "trace.h"
+
+#define REPLAY_REPLY_TIMEOUT_MS 5000
+#define REPLAY_SPIN_NS 50000 // sotto questa attesa si fa spin invece di dormire
+
+typedef enum { TARGET_INPROC, TARGET_SERVER } replay_target_e;
+
+typedef struct {
+    const char *trace_path;
+    replay_target_e target;
+    size_t size_mb;
+    unsigned partitions;
+    const char *host;
+    const char *port;
+    double speed;
+    uint64_t limit;
+} replay_config_t;
+
+typedef struct {
+    uint64_t gets;
+    uint64_t get_hits;
+    uint64_t sets;
+    uint64_t dels;
+    uint64_t incrs;
+    uint64_t skipped;
+    uint64_t errors;
+    latency_hist_t get_latency;
+    latency_hist_t set_latency;
+    latency_hist_t other_latency;
+} replay_stats_t;
+
+typedef struct {
+    pod_cache_t *cache;
+    int fd;
+    out_buffer_t out;
+    out_buffer_t in;
+    char *value;
+    size_t value_cap;
+} replay_ctx_t;
+
+static void usage(const char *prog) {
+    fprintf(stderr,
+            "Usage: %s [options] TRACE\n"
+            "  --target inproc|server  replay in-process or against a server (default inproc)\n"
+            "  --size MB               in-process cache capacity (default 64)\n"
+            "  --partitions N          in-process partitions (default 8)\n"
+            "  -H, --host HOST         server host or unix socket path (default 127.0.0.1)\n"
+            "  -p, --port PORT         server port (default 6379)\n"
+            "  --speed X               0 = as fast as possible (default), 1 = original timing,\n"
+            "                          X = X times faster than captured\n"
+            "  -n, --limit N           replay only the first N records\n",
+            prog);
+}
+
+static int parse_args(int argc, char **argv, replay_config_t *config) {
+    static const struct option long_options[] = {
+        {"target", required_argument, NULL, 'x'},
+        {"size", required_argument, NULL, 'S'},
+        {"partitions", required_argument, NULL, 'P'},
+        {"host", required_argument, NULL, 'H'},
+        {"port", required_argument, NULL, 'p'},
+        {"speed", required_argument, NULL, 'v'},
+        {"limit", required_argument, NULL, 'n'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "H:p:n:h", long_options, NULL)) != -1) {
+        switch (opt) {
+        case 'x':
+            if (strcmp(optarg, "inproc") == 0) {
+                config->target = TARGET_INPROC;
+            } else if (strcmp(optarg, "server") == 0) {
+                config->target = TARGET_SERVER;
+            } else {
+                fprintf(stderr, "invalid target: %s\n", optarg);
+                return -1;
+            }
+            break;
+        case 'S':
+            config->size_mb = strtoul(optarg, NULL, 10);
+            break;
+        case 'P':
+            config->partitions = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'H':
+            config->host = optarg;
+            break;
+        case 'p':
+            config->port = optarg;
+            break;
+        case 'v':
+            config->speed = strtod(optarg, NULL);
+            break;
+        case 'n':
+            config->limit = strtoull(optarg, NULL, 10);
+            break;
+        default:
+            return -1;
+        }
+    }
+
+    if (optind != argc - 1) return -1;
+    config->trace_path = argv[optind];
+
+    if (config->size_mb == 0 || config->partitions == 0 || config->partitions > 65535 ||
+        config->speed < 0) {
+        fprintf(stderr, "invalid size, partitions or speed\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* =============================================
+ * pacing
+ * ============================================= */
+
+static void wait_until(uint64_t target_ns) {
+    for (;;) {
+        uint64_t now = bench_now_ns();
+        if (now >= target_ns) return;
+        uint64_t delta = target_ns - now;
+        if (delta < REPLAY_SPIN_NS) continue;
+        struct timespec ts = {.tv_sec = 0, .tv_nsec = (long)(delta - REPLAY_SPIN_NS / 2)};
+        if (delta >= 1000000000ULL) {
+            ts.tv_sec = 1;
+            ts.tv_nsec = 0;
+        }
+        nanosleep(&ts, NULL);
+    }
+}
+
+/* =============================================
+ * execution
+ * ============================================= */
+
+static const char *value_of_size(replay_ctx_t *ctx, size_t size) {
+    if (size > ctx->value_cap) {
+        free(ctx->value);
+        ctx->value = malloc(size);
+        if (!ctx->value) {
+            perror("malloc");
+            exit(EXIT_FAILURE);
+        }
+        memset(ctx->value, 'x', size);
+        ctx->value_cap = size;
+    }
+    return ctx->value ? ctx->value : "";
+}
+
+static int run_inproc(replay_ctx_t *ctx, const trace_record_t *record, const char *key,
+                      replay_stats_t *stats) {
+    void *value = NULL;
+    size_t value_size = 0;
+
+    switch (record->command) {
+    case RESP_GET:
+        if (pod_cache_get(ctx->cache, key, &value, &value_size) >= 0) {
+            stats->get_hits++;
+            free(value);
+        }
+        return 0;
+    case RESP_SET:
+        return pod_cache_put(ctx->cache, key, (void *)value_of_size(ctx, record->value_size),
+                             record->value_size) < 0
+                   ? -1
+                   : 0;
+    case RESP_DEL:
+    case RESP_UNLINK:
+        pod_cache_evict(ctx->cache, key);
+        return 0;
+    case RESP_INCR: {
+        // come il server: lettura, incremento e riscrittura
+        long long number = 0;
+        if (pod_cache_get(ctx->cache, key, &value, &value_size) >= 0) {
+            char buffer[24] = {0};
+            memcpy(buffer, value, value_size < sizeof(buffer) - 1 ? value_size : sizeof(buffer) - 1);
+            number = strtoll(buffer, NULL, 10);
+            free(value);
+        }
+        char result[24];
+        int len = snprintf(result, sizeof(result), "%lld", number + 1);
+        return pod_cache_put(ctx->cache, key, result, (size_t)len) < 0 ? -1 : 0;
+    }
+    default:
+        return 0;
+    }
+}
+
+static int run_server(replay_ctx_t *ctx, const trace_record_t *record, const char *key,
+                      replay_stats_t *stats) {
+    const char *argv[3];
+    size_t lens[3];
+    int argc = 2;
+
+    argv[1] = key;
+    lens[1] = strlen(key);
+
+    switch (record->command) {
+    case RESP_GET:
+        argv[0] = "GET";
+        break;
+    case RESP_SET:
+        argv[0] = "SET";
+        argv[2] = value_of_size(ctx, record->value_size);
+        lens[2] = record->value_size;
+        argc = 3;
+        break;
+    case RESP_DEL:
+        argv[0] = "DEL";
+        break;
+    case RESP_UNLINK:
+        argv[0] = "UNLINK";
+        break;
+    case RESP_INCR:
+        argv[0] = "INCR";
+        break;
+    default:
+        return 0;
+    }
+    lens[0] = strlen(argv[0]);
+
+    ctx->out.len = 0;
+    encode_command(&ctx->out, argc, argv, lens);
+    if (bench_send_all(ctx->fd, ctx->out.data, ctx->out.len) != 0) return -2;
+
+    reply_kind_e kind;
+    if (read_reply(ctx->fd, &ctx->in, &kind) != 0) return -2;
+    if (kind == REPLY_ERROR) return -1;
+    if (record->command == RESP_GET && kind == REPLY_VALUE) stats->get_hits++;
+    return 0;
+}
+
+static int replay(const replay_config_t *config, const trace_file_t *trace, replay_ctx_t *ctx,
+                  replay_stats_t *stats, uint64_t *elapsed_ns) {
+    size_t count = trace->count;
+    if (config->limit && config->limit < count) count = (size_t)config->limit;
+
+    uint64_t first_ts = count ? trace->records[0].timestamp_ns : 0;
+    uint64_t start = bench_now_ns();
+    char key[32];
+
+    for (size_t i = 0; i < count; i++) {
+        const trace_record_t *record = &trace->records[i];
+
+        if (record->command != RESP_GET && record->command != RESP_SET &&
+            record->command != RESP_DEL && record->command != RESP_UNLINK &&
+            record->command != RESP_INCR) {
+            stats->skipped++;
+            continue;
+        }
+
+        if (config->speed > 0 && record->timestamp_ns > first_ts) {
+            wait_until(start + (uint64_t)((double)(record->timestamp_ns - first_ts) / config->speed));
+        }
+
+        snprintf(key, sizeof(key), "trace:%016llx", (unsigned long long)record->key_hash);
+
+        uint64_t t0 = bench_now_ns();
+        int rc = config->target == TARGET_INPROC ? run_inproc(ctx, record, key, stats)
+                                                 : run_server(ctx, record, key, stats);
+        uint64_t latency = bench_now_ns() - t0;
+
+        if (rc == -2) {
+            fprintf(stderr, "connection lost after %zu records\n", i);
+            *elapsed_ns = bench_now_ns() - start;
+            return -1;
+        }
+        if (rc != 0) stats->errors++;
+
+        switch (record->command) {
+        case RESP_GET:
+            stats->gets++;
+            hist_record(&stats->get_latency, latency);
+            break;
+        case RESP_SET:
+            stats->sets++;
+            hist_record(&stats->set_latency, latency);
+            break;
+        case RESP_INCR:
+            stats->incrs++;
+            hist_record(&stats->other_latency, latency);
+            break;
+        default:
+            stats->dels++;
+            hist_record(&stats->other_latency, latency);
+        }
+    }
+
+    *elapsed_ns = bench_now_ns() - start;
+    return 0;
+}
+
+static void print_report(const replay_config_t *config, const trace_file_t *trace,
+                         replay_ctx_t *ctx, const replay_stats_t *stats, uint64_t elapsed_ns) {
+    uint64_t ops = stats->gets + stats->sets + stats->dels + stats->incrs;
+    double seconds = (double)elapsed_ns / 1e9;
+    uint64_t captured_ns = trace->count ? trace->records[trace->count - 1].timestamp_ns : 0;
+
+    printf("\nReplayed %llu ops in %.2fs (%.0f ops/s), trace span %.2fs\n", (unsigned long long)ops,
+           seconds, seconds > 0 ? (double)ops / seconds : 0.0, (double)captured_ns / 1e9);
+    printf("  GET %llu, SET %llu, DEL/UNLINK %llu, INCR %llu, skipped %llu, errors %llu\n",
+           (unsigned long long)stats->gets, (unsigned long long)stats->sets,
+           (unsigned long long)stats->dels, (unsigned long long)stats->incrs,
+           (unsigned long long)stats->skipped, (unsigned long long)stats->errors);
+    printf("  GET hit ratio: %.2f%%\n",
+           stats->gets ? 100.0 * (double)stats->get_hits / (double)stats->gets : 0.0);
+
+    if (config->target == TARGET_INPROC) {
+        // include anche le letture fatte da INCR
+        pod_cache_stats_t cs;
+        pod_cache_get_stats(ctx->cache, &cs);
+        uint64_t lookups = cs.memory_hits + cs.disk_hits + cs.misses;
+        double denom = lookups ? (double)lookups : 1.0;
+        printf("  Lookups %llu: memory %.2f%%, disk %.2f%%, miss %.2f%%; demotions %llu, "
+               "promotions %llu\n",
+               (unsigned long long)lookups, 100.0 * (double)cs.memory_hits / denom,
+               100.0 * (double)cs.disk_hits / denom, 100.0 * (double)cs.misses / denom,
+               (unsigned long long)cs.demotions, (unsigned long long)cs.promotions);
+    }
+
+    printf("\nLatency (us):\n");
+    hist_print_us(stdout, "GET", &stats->get_latency);
+    hist_print_us(stdout, "SET", &stats->set_latency);
+    hist_print_us(stdout, "DEL/INCR", &stats->other_latency);
+}
+
+int main(int argc, char **argv) {
+    replay_config_t config = {
+        .target = TARGET_INPROC,
+        .size_mb = 64,
+        .partitions = 8,
+        .host = "127.0.0.1",
+        .port = "6379",
+        .speed = 0,
+    };
+    if (parse_args(argc, argv, &config) != 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    clog_init(LOG_LEVEL_ERROR, NULL);
+
+    trace_file_t trace;
+    if (trace_file_open(&trace, config.trace_path) != 0) {
+        fprintf(stderr, "cannot read trace %s\n", config.trace_path);
+        return EXIT_FAILURE;
+    }
+
+    replay_ctx_t ctx = {.fd = -1};
+    if (config.target == TARGET_INPROC) {
+        ctx.cache = pod_cache_create(MB_TO_BYTES(config.size_mb), (u_short)config.partitions);
+        if (!ctx.cache) {
+            trace_file_close(&trace);
+            return EXIT_FAILURE;
+        }
+        printf("Replaying %zu records in-process: %zu MB, %u partitions, speed %.2f\n",
+               trace.count, config.size_mb, config.partitions, config.speed);
+    } else {
+        ctx.fd = bench_connect(config.host, config.port, REPLAY_REPLY_TIMEOUT_MS);
+        if (ctx.fd < 0) {
+            trace_file_close(&trace);
+            return EXIT_FAILURE;
+        }
+        printf("Replaying %zu records against %s:%s, speed %.2f\n", trace.count, config.host,
+               config.port, config.speed);
+    }
+
+    replay_stats_t *stats = calloc(1, sizeof(*stats));
+    if (!stats) {
+        perror("calloc");
+        return EXIT_FAILURE;
+    }
+    hist_init(&stats->get_latency);
+    hist_init(&stats->set_latency);
+    hist_init(&stats->other_latency);
+
+    uint64_t elapsed_ns = 0;
+    int rc = replay(&config, &trace, &ctx, stats, &elapsed_ns);
+    print_report(&config, &trace, &ctx, stats, elapsed_ns);
+
+    if (ctx.cache) pod_cache_destroy(ctx.cache);
+    if (ctx.fd >= 0) close(ctx.fd);
+    free(ctx.out.data);
+    free(ctx.in.data);
+    free(ctx.value);
+    free(stats);
+    trace_file_close(&trace);
+    return rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,41 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+#include <stddef.h>
+
+/*
+ * Allocatore a bump per le allocazioni che vivono quanto una richiesta: ogni connessione ha la
+ * sua arena, usata dal parser e dagli handler, e la azzera dopo ogni batch di comandi. Nessun
+ * free per singolo oggetto; i blocchi restano all'arena e vengono riusati, quindi a regime non
+ * ci sono chiamate a malloc. I blocchi oltre ARENA_RETAIN_BLOCKS (o più grandi del normale,
+ * allocati per un singolo comando enorme) vengono liberati al reset.
+ */
+
+#define ARENA_BLOCK_SIZE (16 * 1024)
+#define ARENA_RETAIN_BLOCKS 4
+#define ARENA_ALIGN 16
+
+typedef struct arena_block arena_block_t;
+
+typedef struct arena {
+    arena_block_t *first;   // blocchi in uso e liberi, nell'ordine di allocazione
+    arena_block_t *current; // blocco da cui si alloca
+    size_t used;            // byte usati nel blocco corrente
+} arena_t;
+
+void arena_init(arena_t *arena);
+void arena_destroy(arena_t *arena);
+// NULL se la memoria è esaurita; allineato ad ARENA_ALIGN
+void *arena_alloc(arena_t *arena, size_t size);
+// copia terminata da '\0'
+char *arena_strndup(arena_t *arena, const char *src, size_t len);
+// libera tutte le allocazioni, tenendo i blocchi per il prossimo batch
+void arena_reset(arena_t *arena);
+
+#endif //ARENA_H
@@ -7,26 +7,123 @@
  
 #ifndef CAS_H
 #define CAS_H
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
 
+#include "disk_io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// stima dell'ingombro su disco: i file di una entry occupano blocchi interi
+#define CAS_BLOCK_SIZE 4096
+#define CAS_INDEX_INITIAL_BUCKETS 1024
+// motore di I/O: richieste in volo (io_uring) e thread del pool di riserva
+#define CAS_IO_QUEUE_DEPTH 64
+#define CAS_IO_THREADS 4
+
+typedef struct cas_entry cas_entry_t;
+
+// durabilità delle scritture del tier su disco
+typedef enum {
+    CAS_SYNC_NONE,  // nessuna sync: i dati arrivano al disco con il writeback del kernel
+    CAS_SYNC_BATCH, // una syncfs per chiamata a cas_put/cas_put_batch (group commit)
+} cas_sync_e;
+
+// entry da scrivere con cas_put_batch
+typedef struct cas_record {
+    const char *key;
+    const void *value;
+    size_t size;
+} cas_record_t;
+
+/* chiamata per ogni entry rimossa per rispettare il budget, con il mutex del registry
+ * bloccato: deve essere breve e non può usare il registry */
+typedef void (*cas_drop_fn)(const char *key, void *ctx);
+
+/* Il registry è l'indice del tier su disco: ogni entry (per hash della chiave) sta in una
+ * tabella hash e in una lista per recenza, con l'ingombro stimato dei suoi file. Con un
+ * budget (cas_set_limit) le entry meno recenti vengono rimosse prima di scriverne una nuova,
+ * senza visitare il filesystem */
 typedef struct cas_registry {
-    char **entries;
+    cas_entry_t **buckets;
+    size_t bucket_count;
+    cas_entry_t *head;     // usata più di recente
+    cas_entry_t *tail;     // prima candidata alla rimozione
     char base_path[512];
     size_t entries_count;
-    size_t capacity;
+    size_t bytes;          // ingombro stimato delle entry
+    size_t pending_bytes;  // ingombro delle entry in scrittura, non ancora registrate
+    size_t max_bytes;      // budget, 0 nessun limite
+    uint64_t drops;        // entry rimosse per il budget
+    cas_drop_fn on_drop;
+    void *drop_ctx;
+    cas_sync_e sync;
+    uint64_t syncs;        // syncfs eseguite
+    disk_io_t *io;         // letture e scritture dei file delle entry
+    /* condiviso da tutte le partizioni, protegge indice e lista: le letture e le scritture
+     * dei file avvengono senza, su file aperti con il mutex */
+    pthread_mutex_t mutex;
 } cas_registry_t;
 
+typedef struct cas_stats {
+    size_t entries;
+    size_t bytes;
+    size_t max_bytes;
+    uint64_t drops;
+    uint64_t syncs;
+} cas_stats_t;
+
 typedef struct fs_path {
     char *p[4];
 } fs_path_t;
 
 
+// callback di cas_foreach/cas_clear: un valore diverso da 0 interrompe la visita
+typedef int (*cas_visit_fn)(const char *key, const void *value, size_t size, void *ctx);
+
 cas_registry_t *cas_create_registry();
-int cas_put(const cas_registry_t *registry, const char *key, void *value, size_t value_size, char *output_path);
-int cas_get(const cas_registry_t *registry, const char *key, void **buffer, size_t *actual_size);
+/* scrive la entry e la registra (sostituendo quella della stessa chiave): 0, -1 su errore o se
+ * la entry da sola supera il budget, -9 se il volume è pieno */
+int cas_put(cas_registry_t *registry, const char *key, void *value, size_t value_size, char *output_path);
+/* scrive più entry con una sola sottomissione al motore di I/O e, con CAS_SYNC_BATCH, una
+ * sola sync alla fine. results (opzionale) riceve il codice di cas_put di ogni entry; restituisce le entry
+ * scritte */
+int cas_put_batch(cas_registry_t *registry, size_t count, const cas_record_t *records,
+                  int *results);
+/* cas_put e cas_put_batch scrivono i file senza il mutex del registry: le scritture concorrenti
+ * della stessa chiave vanno serializzate dal chiamante (pod_cache lo fa con il mutex della
+ * partizione), quelle di chiavi diverse procedono in parallelo */
+int cas_get(cas_registry_t *registry, const char *key, void **buffer, size_t *actual_size);
+// 0 se rimossa, -1 se assente o in caso di errore
 int cas_evict(const char *key, cas_registry_t *registry);
-int cas_add_to_registry(cas_registry_t *registry, char *path);
+bool cas_contains(cas_registry_t *registry, const char *key);
+// come cas_contains, e se presente la entry diventa la più recente (nessuna syscall)
+bool cas_touch(cas_registry_t *registry, const char *key);
 void cas_registry_destroy(cas_registry_t *registry);
+/* budget in byte del tier (0: nessun limite); se già superato le entry meno recenti vengono
+ * rimosse subito. on_drop (opzionale) riceve la chiave di ogni entry rimossa */
+void cas_set_limit(cas_registry_t *registry, size_t max_bytes, cas_drop_fn on_drop, void *ctx);
+void cas_get_stats(cas_registry_t *registry, cas_stats_t *out);
+void cas_set_sync(cas_registry_t *registry, cas_sync_e sync);
+/* sostituisce il motore di I/O (default DISK_IO_AUTO: io_uring se il kernel lo supporta,
+ * altrimenti il pool di thread). 0, -1 se il backend richiesto non è disponibile: resta
+ * quello attuale */
+int cas_set_io(cas_registry_t *registry, disk_io_backend_e backend);
+// "io_uring" o "threads"
+const char *cas_io_backend(cas_registry_t *registry);
+/* visita le entry del registry (chiave letta da key.dat): i file di ogni entry sono aperti con
+ * il mutex bloccato, letti e passati alla callback senza. Restituisce le entry visitate, -1 su
+ * errore */
+int cas_foreach(cas_registry_t *registry, cas_visit_fn visit, void *ctx);
+// rimuove tutte le entry; visit (opzionale) riceve la chiave di ognuna, con value NULL
+int cas_clear(cas_registry_t *registry, cas_visit_fn visit, void *ctx);
 
+#ifdef __cplusplus
+}
+#endif
 
 #endif //CAS_H
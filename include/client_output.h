@@ -0,0 +1,78 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef CLIENT_OUTPUT_H
+#define CLIENT_OUTPUT_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/uio.h>
+#include <time.h>
+
+#include "pod_cache.h"
+
+/*
+ * Coda di uscita di una connessione: le risposte vengono accodate e inviate con writev su un
+ * socket non bloccante, tenendo conto degli invii parziali. Il thread del client non resta
+ * bloccato su un lettore lento: quando il socket è pieno aspetta con poll che torni
+ * scrivibile, continuando a leggere i comandi.
+ *
+ * Le risposte piccole vengono copiate in blocchi contigui; i valori grandi restano in cache
+ * (pod_cache_handle_t) fino a quando sono stati inviati, senza copia.
+ *
+ * Limiti, come client-output-buffer-limit di Redis: oltre hard_limit byte in coda la
+ * connessione viene chiusa subito, oltre soft_limit viene chiusa se ci resta per
+ * soft_seconds secondi. 0 disabilita il limite.
+ */
+
+#define CLIENT_OUTPUT_CHUNK_SIZE (16 * 1024) // blocco minimo per le risposte copiate
+#define CLIENT_OUTPUT_COPY_MAX 4096          // valori fino a questa dimensione vengono copiati
+#define CLIENT_OUTPUT_DEFAULT_HARD_MB 256
+#define CLIENT_OUTPUT_DEFAULT_SOFT_MB 64
+#define CLIENT_OUTPUT_DEFAULT_SOFT_SECONDS 60
+
+typedef struct client_output_limits {
+    size_t hard_limit;
+    size_t soft_limit;
+    int soft_seconds;
+} client_output_limits_t;
+
+typedef struct output_chunk output_chunk_t;
+
+typedef struct client_output {
+    int socket_fd;
+    output_chunk_t *head;
+    output_chunk_t *tail;
+    output_chunk_t *spare;      // blocco dati libero, riusato senza malloc
+    output_chunk_t *free_refs;  // descrittori liberi per i valori in prestito
+    int free_ref_count;
+    size_t pending;     // byte accodati e non ancora inviati
+    time_t soft_since;  // da quando la coda supera soft_limit, 0 se sotto
+    bool overflow;      // limite superato: la connessione va chiusa
+    client_output_limits_t limits;
+} client_output_t;
+
+void client_output_init(client_output_t *out, int socket_fd, const client_output_limits_t *limits);
+// libera i blocchi e rilascia i valori ancora in coda
+void client_output_free(client_output_t *out);
+
+// accoda una copia dei dati: 0, -1 se la memoria è esaurita o la coda supera il limite hard
+int client_output_write(client_output_t *out, const void *data, size_t len);
+// accoda una copia delle parti, contigue (una risposta composta da prefisso, testo e \r\n)
+int client_output_writev(client_output_t *out, const struct iovec *parts, int count);
+/* accoda un valore letto con pod_cache_borrow, di cui prende il possesso (rilasciato dopo
+ * l'invio, o subito se piccolo e quindi copiato). Come client_output_write */
+int client_output_write_value(client_output_t *out, pod_cache_handle_t *handle);
+
+/* invia quanto il socket accetta senza bloccare: 0 (la coda può restare non vuota), -1 se la
+ * connessione è chiusa o un limite è stato superato */
+int client_output_flush(client_output_t *out);
+/* invia tutta la coda aspettando al più timeout_ms: 0 se vuota, -1 su errore o timeout. Per
+ * chi deve scrivere direttamente sul socket dopo le risposte accodate */
+int client_output_drain(client_output_t *out, int timeout_ms);
+size_t client_output_pending(const client_output_t *out);
+
+#endif //CLIENT_OUTPUT_H
@@ -0,0 +1,88 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef CLUSTER_H
+#define CLUSTER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pod_cache.h"
+
+/*
+ * Modalità cluster compatibile con Redis Cluster: lo spazio delle chiavi è diviso in 16384
+ * slot (CRC16 della chiave, o della parte tra {} se presente) assegnati ai nodi. Un comando
+ * su una chiave di un altro nodo riceve -MOVED slot host:port e il client aggiorna la sua
+ * mappa degli slot.
+ *
+ * Niente gossip: la topologia iniziale arriva dalla configurazione (stessa lista di nodi su
+ * tutte le istanze, slot divisi in parti uguali nell'ordine della lista) e le modifiche
+ * (CLUSTER MEET, CLUSTER SETSLOT) vanno inviate a ogni nodo, come fa redis-cli --cluster.
+ * L'id di un nodo è derivato da host:port, quindi tutti i nodi lo calcolano uguale.
+ *
+ * Migrazione online di uno slot da A a B:
+ *   B: CLUSTER SETSLOT s IMPORTING <id A>   A: CLUSTER SETSLOT s MIGRATING <id B>
+ *   A: CLUSTER GETKEYSINSLOT s n + MIGRATE host_B port_B "" 0 timeout KEYS ... (ripetuti)
+ *   tutti i nodi: CLUSTER SETSLOT s NODE <id B>
+ * Durante la migrazione A risponde -ASK per le chiavi che non ha più e B le serve solo ai
+ * client che inviano ASKING prima del comando.
+ */
+
+#define CLUSTER_SLOTS 16384
+#define CLUSTER_MAX_NODES 64
+#define CLUSTER_ID_SIZE 40
+
+typedef enum {
+    CLUSTER_ROUTE_LOCAL, // il comando va eseguito qui
+    CLUSTER_ROUTE_MOVED, // lo slot è di un altro nodo
+    CLUSTER_ROUTE_ASK,   // slot in migrazione e chiave già spostata: riprovare sul nodo indicato
+    CLUSTER_ROUTE_DOWN,  // slot non assegnato
+} cluster_route_e;
+
+/* nodes: "host:port,host:port,..." (la configurazione salvata in config_path, se esiste, ha la
+ * precedenza); myself: host:port di questa istanza, NULL per cercarla per porta nella lista */
+int cluster_init(const char *nodes, const char *myself, int port, const char *config_path);
+bool cluster_enabled(void);
+void cluster_shutdown(void);
+
+uint16_t cluster_keyslot(const char *key, size_t len);
+/* dove eseguire un comando sulla chiave; asking: il client ha inviato ASKING. Per MOVED/ASK
+ * target riceve "host:port" */
+cluster_route_e cluster_route(const char *key, bool asking, int *slot, char *target,
+                              size_t target_size);
+
+// indice chiavi per slot, tenuto aggiornato dal listener della cache
+void cluster_key_listener(pod_cache_event_e event, const char *key, const void *value,
+                          size_t size, void *ctx);
+size_t cluster_count_keys_in_slot(int slot);
+/* fino a max chiavi dello slot (da liberare con free, come l'array); restituisce il numero
+ * di chiavi, -1 in caso di errore */
+int cluster_get_keys_in_slot(int slot, size_t max, char ***keys);
+
+// CLUSTER MEET host port: 0, -1 se la tabella dei nodi è piena
+int cluster_meet(const char *host, int port);
+/* CLUSTER SETSLOT slot IMPORTING|MIGRATING|NODE <id> | STABLE: 0, -1 (*error descrive il
+ * motivo) */
+int cluster_setslot(int slot, const char *action, const char *node_id, const char **error);
+const char *cluster_myid(void);
+
+// risposte ai sottocomandi di CLUSTER, allocate con malloc (*len: lunghezza); NULL su errore
+char *cluster_format_slots(size_t *len);
+char *cluster_format_shards(bool resp3, size_t *len);
+char *cluster_format_nodes(size_t *len);
+char *cluster_format_info(size_t *len);
+
+#define CLUSTER_MIGRATE_IOERR -1   // nodo di destinazione irraggiungibile o timeout
+#define CLUSTER_MIGRATE_REFUSED -2 // il nodo di destinazione ha risposto con un errore
+
+/* MIGRATE: copia le chiavi sul nodo host:port (SET preceduti da ASKING, in un solo invio) e,
+ * senza copy, le rimuove localmente. Restituisce il numero di chiavi spostate (0: nessuna
+ * chiave presente) o uno dei codici CLUSTER_MIGRATE_* */
+int cluster_migrate(pod_cache_t *cache, const char *host, int port, char **keys, int count,
+                    bool copy, int timeout_ms);
+
+#endif //CLUSTER_H
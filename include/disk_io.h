@@ -0,0 +1,65 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef DISK_IO_H
+#define DISK_IO_H
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+/*
+ * Motore di I/O del tier su disco: le letture e le scritture di un gruppo (i file di una
+ * entry, le entry di una demotion a gruppi) vengono sottomesse insieme e completate in
+ * parallelo, così il dispositivo vede più richieste in coda invece di una alla volta.
+ *
+ * Due backend:
+ * - io_uring (system call dirette, senza liburing): una io_uring_enter sottomette l'intero
+ *   gruppo e aspetta i completamenti;
+ * - pool di thread con pread/pwrite, per i kernel senza io_uring (o dove è disabilitato) e
+ *   sotto faultfs, che intercetta solo le system call classiche. Il thread che sottomette
+ *   lavora insieme al pool.
+ *
+ * Il thread che sottomette resta in attesa fino al completamento dell'ultima richiesta del
+ * gruppo; una richiesta singola non ha nulla da sovrapporre e viene eseguita direttamente da
+ * lui con pread/pwrite. Le sottomissioni concorrenti non si aspettano a vicenda: con io_uring
+ * vanno su anelli diversi (finché ce ne sono di liberi), col pool chi lo trova occupato esegue
+ * il proprio gruppo da sé.
+ */
+
+typedef enum {
+    DISK_IO_AUTO,    // io_uring se disponibile, altrimenti il pool di thread
+    DISK_IO_URING,
+    DISK_IO_THREADS,
+} disk_io_backend_e;
+
+typedef enum {
+    DISK_IO_READ,
+    DISK_IO_WRITE,
+} disk_io_op_e;
+
+typedef struct disk_io_request {
+    disk_io_op_e op;
+    int fd;
+    void *buffer;
+    size_t len;
+    off_t offset;
+    ssize_t result; // dopo disk_io_submit: byte trasferiti (len se completa) o -errno
+    struct iovec iov; // uso interno
+} disk_io_request_t;
+
+typedef struct disk_io disk_io_t;
+
+/* queue_depth: richieste in volo al massimo (io_uring), threads: thread del pool di riserva.
+ * NULL se nessun backend è utilizzabile */
+disk_io_t *disk_io_create(disk_io_backend_e backend, unsigned queue_depth, int threads);
+void disk_io_destroy(disk_io_t *io);
+// esegue tutte le richieste e ritorna al completamento: 0 se tutte complete, -1 altrimenti
+int disk_io_submit(disk_io_t *io, disk_io_request_t *requests, size_t count);
+// "io_uring" o "threads"
+const char *disk_io_backend_name(const disk_io_t *io);
+
+#endif //DISK_IO_H
@@ -0,0 +1,41 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef FREQ_SKETCH_H
+#define FREQ_SKETCH_H
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Stima della frequenza di accesso delle chiavi (count-min sketch alla TinyLFU): FREQ_SKETCH_DEPTH
+ * righe di contatori saturi a FREQ_SKETCH_MAX, indicizzate da hash diversi della stessa chiave.
+ * La stima è il minimo dei contatori della chiave: può solo sovrastimare, per i conflitti.
+ * Dopo 10 aggiunte per contatore di riga tutti i contatori vengono dimezzati, così la stima
+ * segue gli accessi recenti e le chiavi non più usate perdono peso.
+ *
+ * Non è thread-safe: pod_cache ne tiene uno per partizione, protetto dal suo mutex.
+ */
+
+#define FREQ_SKETCH_DEPTH 4
+#define FREQ_SKETCH_MAX 15
+
+typedef struct freq_sketch {
+    uint8_t *table;       // FREQ_SKETCH_DEPTH righe consecutive di mask + 1 contatori
+    size_t mask;          // larghezza della riga - 1 (potenza di due)
+    uint64_t additions;   // aggiunte dall'ultimo dimezzamento
+    uint64_t sample_size; // aggiunte che fanno scattare il dimezzamento
+} freq_sketch_t;
+
+// larghezza delle righe: potenza di due >= expected_keys. 0 se creato, -1 senza memoria
+int freq_sketch_init(freq_sketch_t *sketch, size_t expected_keys);
+void freq_sketch_destroy(freq_sketch_t *sketch);
+// registra un accesso alla chiave con hash key_hash (hash64)
+void freq_sketch_add(freq_sketch_t *sketch, uint64_t key_hash);
+// accessi stimati alla chiave, al massimo FREQ_SKETCH_MAX
+unsigned freq_sketch_estimate(const freq_sketch_t *sketch, uint64_t key_hash);
+
+#endif //FREQ_SKETCH_H
@@ -14,6 +14,7 @@
 
 uint32_t hash_key(const char* key, size_t hash_table_capacity);
 uint32_t hash(const char* key);
+uint64_t hash64(const char *key);
 void sha256_string(const char *str, char *output);
 
 #endif //HASH_FUNC_H
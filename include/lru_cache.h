@@ -7,8 +7,14 @@
  
 #ifndef LRU_CACHE_H
 #define LRU_CACHE_H
+#include <stdbool.h>
 #include <stddef.h>
 #include <pthread.h>
+#include <time.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
 
 typedef struct lru_node {
     char *key;
@@ -34,14 +40,31 @@ typedef struct lru_cache {
     size_t max_bytes_capacity;
     size_t current_bytes_size;
     size_t hash_table_size;
+    bool accounting_only; // solo chiavi e dimensioni, i valori non vengono memorizzati
     pthread_mutex_t mutex;
 } lru_cache_t;
 
 lru_cache_t *lru_cache_create(size_t max_bytes_capacity);
+// come lru_cache_create ma senza copie dei valori: get restituisce value NULL e la dimensione
+lru_cache_t *lru_cache_create_accounting(size_t max_bytes_capacity);
 int lru_cache_put(lru_cache_t *cache, const char *key, void *value, size_t value_size);
 int lru_cache_get(lru_cache_t *cache, const char *key, void **value, size_t *value_size);
+/* lettura senza copia: *value resta valido (e immutabile) fino a lru_value_unref, anche se
+ * nel frattempo la chiave viene sovrascritta o rimossa */
+int lru_cache_borrow(lru_cache_t *cache, const char *key, const void **value, size_t *value_size);
 int lru_cache_evict(lru_cache_t *cache, const char *key);
+// presenza della chiave, senza toccarne la recenza
+bool lru_cache_contains(lru_cache_t *cache, const char *key);
 void lru_cache_destroy(lru_cache_t *cache);
+// il nodo restituito resta valido solo finché il chiamante tiene cache->mutex
 lru_node_t *lru_cache_get_tail_node(lru_cache_t *cache);
 int lru_cache_remove_tail(lru_cache_t *cache);
+
+// valori con contatore di riferimenti, come quelli memorizzati nei nodi
+void *lru_value_alloc(size_t size);
+void lru_value_ref(void *value);
+void lru_value_unref(void *value);
+#ifdef __cplusplus
+}
+#endif
 #endif //LRU_CACHE_H
@@ -0,0 +1,50 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef PEER_H
+#define PEER_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Peer fill: un miss locale (memoria e disco) viene chiesto ai pod vicini prima di rispondere
+ * nil, così un pod appena avviato si scalda dalle copie che gli altri hanno già.
+ *
+ * Tutti i pod usano la stessa lista di peer: un anello di hashing consistente (più punti per
+ * peer) sceglie il proprietario di ogni chiave, che riceve la richiesta (PEERGET, servita solo
+ * dai tier locali del peer). Se il proprietario è questo pod si passa al successivo
+ * sull'anello; si interrogano al massimo probes peer. Ogni richiesta ha un timeout breve e un
+ * peer che fallisce viene saltato per PEER_RETRY_MS. Le richieste concorrenti sulla stessa
+ * chiave sono unite dalla cache (single-flight, vedi pod_cache_set_loader).
+ */
+
+#define PEER_DEFAULT_TIMEOUT_MS 50
+#define PEER_DEFAULT_PROBES 1
+#define PEER_MAX_PEERS 64
+#define PEER_RETRY_MS 1000
+
+typedef struct peer_stats {
+    uint64_t requests; // PEERGET inviate
+    uint64_t hits;
+    uint64_t errors;   // timeout, connessioni fallite, risposte non valide
+    uint64_t skipped;  // peer saltati perché falliti da poco
+} peer_stats_t;
+
+/* peers: "host:port,host:port,..."; self: host:port di questo pod, NULL per cercarlo per
+ * porta nella lista (se non c'è, tutti i peer sono remoti) */
+int peer_init(const char *peers, const char *self, int port, int timeout_ms, int probes);
+void peer_shutdown(void);
+
+// pod_cache_loader_fn: cerca la chiave sui peer
+int peer_loader(const char *key, void **value, size_t *size, void *ctx);
+/* la richiesta servita dal thread corrente arriva da un altro pod: il loader non interroga
+ * i peer, così una richiesta non rimbalza tra pod con liste diverse */
+void peer_set_local_only(bool local_only);
+void peer_get_stats(peer_stats_t *out);
+
+#endif //PEER_H
@@ -9,28 +9,191 @@
 #define CACHE_H
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 #include "lru_cache.h"
 #include <pthread.h>
 #include "cas.h"
+#include "freq_sketch.h"
 
-#define MB_TO_BYTES(mb) ((mb) * 1024 * 1024)
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// incrementata a ogni modifica incompatibile dell'API pubblica (anche per l'uso in-process)
+#define POD_CACHE_API_VERSION 1
+
+#define MB_TO_BYTES(mb) ((size_t)(mb) * 1024 * 1024)
 #define BYTES_TO_MB(bytes) ((double)(bytes) / (1024.0 * 1024.0))
 
+// demotion a gruppi: chiavi e byte liberati al massimo oltre lo spazio necessario
+#define POD_CACHE_DEMOTE_BATCH_KEYS 16
+#define POD_CACHE_DEMOTE_BATCH_BYTES MB_TO_BYTES(1)
+
 typedef unsigned short u_short;
 
+// contatori cumulativi, aggiornati in modo atomico
+typedef struct pod_cache_stats {
+    uint64_t memory_hits;
+    uint64_t disk_hits;
+    uint64_t misses;
+    uint64_t demotions;
+    uint64_t clean_demotions; // demotion senza scrittura: la copia su disco era ancora valida
+    uint64_t demote_batches;  // scritture su disco a gruppi (una per demotion a gruppi)
+    uint64_t promotions;
+    uint64_t loader_hits; // miss locali risolti dal loader (già contati in misses)
+    uint64_t disk_drops;  // chiavi rimosse dal disco per rispettarne il budget
+    uint64_t disk_rejections; // chiavi uscite dalla memoria e scartate dal filtro di ammissione
+    size_t disk_bytes;    // ingombro stimato del tier su disco (valore corrente)
+    size_t disk_capacity; // budget del tier su disco, 0 nessun limite
+    uint64_t disk_syncs;  // sync del tier su disco (con CAS_SYNC_BATCH)
+} pod_cache_stats_t;
+
+/* eventi sulle chiavi notificati ai listener registrati con pod_cache_add_listener */
+typedef enum {
+    POD_CACHE_EVENT_PUT,     // nuovo valore in memoria (SET, INCR, mput)
+    POD_CACHE_EVENT_DELETE,  // chiave rimossa
+    POD_CACHE_EVENT_DEMOTE,  // chiave spostata dalla memoria al disco
+    POD_CACHE_EVENT_PROMOTE, // chiave riportata in memoria dal disco, valore invariato (la copia
+                             // su disco resta finché la chiave non viene modificata)
+} pod_cache_event_e;
+
+#define POD_CACHE_MAX_LISTENERS 4
+
+/* chiamata con il mutex della partizione bloccato, quindi nello stesso ordine delle modifiche
+ * alla chiave: deve essere breve e non può usare la cache. value è NULL per DELETE e DEMOTE
+ * (e in modalità accounting) e resta valido solo durante la chiamata. */
+typedef void (*pod_cache_listener_fn)(pod_cache_event_e event, const char *key,
+                                      const void *value, size_t size, void *ctx);
+
+typedef struct pod_cache_listener {
+    pod_cache_listener_fn fn;
+    void *ctx;
+} pod_cache_listener_t;
+
+/* tier opzionale dopo il disco (ad esempio i pod vicini): chiamato senza lock quando get o
+ * borrow non trovano la chiave. 0 con *value allocato con malloc se trovata, un valore
+ * diverso da 0 altrimenti; la cache inserisce il valore in memoria e libera *value */
+typedef int (*pod_cache_loader_fn)(const char *key, void **value, size_t *size, void *ctx);
+
+// chiave rimossa dal disco per il budget, in attesa dell'evento DELETE
+typedef struct pod_cache_dropped {
+    struct pod_cache_dropped *next;
+    char key[];
+} pod_cache_dropped_t;
+
+// caricamento in corso per una chiave: le richieste concorrenti aspettano il primo
+typedef struct pod_cache_flight {
+    struct pod_cache_flight *next;
+    int waiters;
+    int result;
+    bool done;
+    bool stale; // chiave cancellata durante il caricamento: il valore del loader va scartato
+    char key[];
+} pod_cache_flight_t;
+
 typedef struct pod_cache {
     size_t total_capacity;
     size_t partition_capacity;
     u_short partition_count;
     lru_cache_t **partitions;
     cas_registry_t *cas_registry;
+    lru_cache_t *disk_index; // solo in modalità accounting: simula il tier su disco
+    bool accounting_only;
+    pod_cache_stats_t stats;
+    pod_cache_listener_t listeners[POD_CACHE_MAX_LISTENERS];
+    int listener_count;
+    pod_cache_loader_fn loader;
+    void *loader_ctx;
+    pthread_mutex_t flight_mutex;
+    pthread_cond_t flight_cond;
+    pod_cache_flight_t *flights;
+    pthread_mutex_t drop_mutex;
+    pod_cache_dropped_t *dropped;
+    unsigned disk_admission;   // letture stimate per entrare nel tier su disco, 0 ammette tutto
+    freq_sketch_t *sketches;   // letture recenti, uno per partizione (solo con disk_admission)
+    size_t demote_batch_keys;  // limiti di una demotion a gruppi (pod_cache_set_demote_batch)
+    size_t demote_batch_bytes;
 } pod_cache_t;
 
+/* valore letto in place con pod_cache_borrow: resta valido e immutabile fino a
+ * pod_cache_release, anche se nel frattempo la chiave viene sovrascritta, rimossa o spostata
+ * su disco. Non va modificato né liberato con free. */
+typedef struct pod_cache_handle {
+    const void *value; // NULL in modalità accounting
+    size_t size;
+} pod_cache_handle_t;
+
+// callback di pod_cache_foreach: un valore diverso da 0 interrompe l'iterazione
+typedef int (*pod_cache_visit_fn)(const char *key, const void *value, size_t size, void *ctx);
+
 pod_cache_t *pod_cache_create(size_t capacity, u_short partitions);
+/* cache per la simulazione: stesse politiche di pod_cache_create ma senza copie dei valori
+ * e senza scritture su disco. put accetta value NULL, get restituisce value NULL. */
+pod_cache_t *pod_cache_create_accounting(size_t capacity, u_short partitions);
 void pod_cache_destroy(pod_cache_t *pod_cache);
 int pod_cache_put(pod_cache_t *cache, const char *key, void *value, size_t value_size);
 int pod_cache_get(pod_cache_t *cache, const char *key, void **out_value, size_t *out_value_size);
 int pod_cache_evict(pod_cache_t *cache, const char *key);
+void pod_cache_get_stats(pod_cache_t *cache, pod_cache_stats_t *out);
+/* budget in byte del tier su disco (0: nessun limite, il default). Oltre il budget le chiavi
+ * lette meno di recente vengono rimosse dal disco e notificate con DELETE. Ignorato in
+ * modalità accounting */
+void pod_cache_set_disk_capacity(pod_cache_t *cache, size_t bytes);
+/* filtro di ammissione del tier su disco: una chiave uscita dalla memoria viene scritta su
+ * disco solo se è stata letta (GET/borrow, anche senza successo) almeno min_reads volte di
+ * recente, altrimenti viene scartata e notificata con DELETE. Le letture sono stimate per
+ * partizione con un count-min sketch che invecchia; min_reads è limitato a FREQ_SKETCH_MAX,
+ * 0 disattiva il filtro (il default). Va chiamata prima di usare la cache da più thread.
+ * 0 se impostato, -1 senza memoria per lo sketch */
+int pod_cache_set_disk_admission(pod_cache_t *cache, unsigned min_reads);
+/* demotion a gruppi: quando una partizione è piena, oltre allo spazio per il nuovo valore
+ * escono dalla coda fino a keys chiavi (al massimo 64) o bytes byte (al massimo 1/16 della
+ * partizione), il primo limite raggiunto, scritte su disco insieme. keys 1 (o bytes 0): una
+ * chiave alla volta. Default POD_CACHE_DEMOTE_BATCH_KEYS e POD_CACHE_DEMOTE_BATCH_BYTES */
+void pod_cache_set_demote_batch(pod_cache_t *cache, size_t keys, size_t bytes);
+/* durabilità del tier su disco: con CAS_SYNC_BATCH ogni demotion a gruppi si chiude con una
+ * sola sync del filesystem. Default CAS_SYNC_NONE; ignorata in modalità accounting */
+void pod_cache_set_disk_sync(pod_cache_t *cache, cas_sync_e sync);
+/* backend di I/O del tier su disco (vedi disk_io.h), default DISK_IO_AUTO. Va chiamata prima
+ * di usare la cache da più thread. 0, -1 se il backend non è disponibile (resta il precedente)
+ * o in modalità accounting */
+int pod_cache_set_disk_io(pod_cache_t *cache, disk_io_backend_e backend);
+/* registra un listener degli eventi sulle chiavi; va chiamata prima di usare la cache da più
+ * thread. 0 se registrato, -1 se i posti sono esauriti */
+int pod_cache_add_listener(pod_cache_t *cache, pod_cache_listener_fn fn, void *ctx);
+/* installa il loader (NULL per rimuoverlo), da chiamare prima di usare la cache da più
+ * thread. Una sola chiamata al loader in volo per chiave; mget non lo usa */
+void pod_cache_set_loader(pod_cache_t *cache, pod_cache_loader_fn fn, void *ctx);
+
+/* lettura senza copia: 0 se trovata (memoria o disco, una chiave su disco viene promossa),
+ * -100 se assente, -1 in caso di errore. Ogni borrow riuscito va chiuso con pod_cache_release */
+int pod_cache_borrow(pod_cache_t *cache, const char *key, pod_cache_handle_t *handle);
+void pod_cache_release(pod_cache_handle_t *handle);
+
+/* batch: ogni partizione coinvolta viene bloccata una volta sola. results (opzionale) riceve
+ * per ogni chiave il codice della singola operazione (borrow: 0/-100/-1, put: come
+ * pod_cache_put). Restituiscono il numero di chiavi trovate/memorizzate, -1 su errore. */
+int pod_cache_mget(pod_cache_t *cache, size_t count, const char *const *keys,
+                   pod_cache_handle_t *handles, int *results);
+void pod_cache_release_all(pod_cache_handle_t *handles, size_t count);
+int pod_cache_mput(pod_cache_t *cache, size_t count, const char *const *keys,
+                   const void *const *values, const size_t *value_sizes, int *results);
+
+/* visita le chiavi in memoria, partizione per partizione, dalla più recente; la partizione
+ * visitata resta bloccata durante la callback, che non deve modificare la cache. Le chiavi
+ * sul disco si visitano con pod_cache_foreach_disk. */
+int pod_cache_foreach(pod_cache_t *cache, pod_cache_visit_fn visit, void *ctx);
+/* visita le chiavi che sono solo sul disco (una lettura per chiave, callback senza lock): le
+ * copie su disco delle chiavi promosse e ancora in memoria vengono saltate. Una chiave spostata
+ * tra i tier durante la visita può essere vista due volte o non essere vista. In modalità
+ * accounting non visita nulla */
+int pod_cache_foreach_disk(pod_cache_t *cache, pod_cache_visit_fn visit, void *ctx);
+// svuota entrambi i tier, con un evento DELETE per ogni chiave
+void pod_cache_clear(pod_cache_t *cache);
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif //CACHE_H
@@ -0,0 +1,46 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef REPLICATION_H
+#define REPLICATION_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pod_cache.h"
+
+/*
+ * Replica asincrona primary -> replica, sullo stesso protocollo RESP dei client.
+ *
+ * Il primary serializza ogni modifica (SET chiave valore, DEL chiave) in un backlog circolare
+ * con un offset monotono. La replica si collega e invia PSYNC <replid> <offset>:
+ *  - +CONTINUE <replid>: l'offset è ancora nel backlog, lo stream riprende da lì;
+ *  - +FULLRESYNC <replid> <offset>: la replica svuota la cache, riceve uno snapshot dei due
+ *    tier come comandi SET, chiuso da +SNAPSHOT-END, e poi lo stream dall'offset indicato.
+ * La replica conferma ogni secondo l'offset applicato con REPLCONF ACK <offset>.
+ */
+
+#define REPL_ID_SIZE 40
+#define REPL_DEFAULT_BACKLOG_MB 4
+#define REPL_MAX_REPLICAS 16
+
+// primary: registra il listener, il backlog viene allocato alla prima PSYNC
+int repl_init(pod_cache_t *cache, size_t backlog_size);
+/* serve una replica sulla connessione che ha inviato PSYNC: ritorna solo quando la replica si
+ * disconnette (o il server si ferma), con -1 per chiudere la connessione */
+int repl_serve_replica(pod_cache_t *cache, int socket_fd, const char *peer, const char *replid,
+                       const char *offset);
+
+// replica: avvia il thread che si collega al primary e applica lo stream
+int repl_start_replica(pod_cache_t *cache, const char *host, int port);
+bool repl_is_replica(void);
+
+// risposta RESP al comando ROLE; -1 se non entra nel buffer
+int repl_format_role(char *buffer, size_t size);
+void repl_shutdown(void);
+
+#endif //REPLICATION_H
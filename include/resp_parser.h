@@ -9,6 +9,8 @@
 #define RESP_PARSER_H
 #include <stddef.h>
 
+#include "arena.h"
+
 #define MAX_ARGS 100
 #define MAX_STR_LEN (1024 * 1024)
 #define MIN_BUFFER_SIZE 4
@@ -36,18 +38,57 @@ typedef enum {
     RESP_CLIENT,
     RESP_UNKNOW,
     RESP_INCR,
-    RESP_UNLINK
+    RESP_UNLINK,
+    RESP_HELLO,
+    RESP_PSYNC,
+    RESP_REPLCONF,
+    RESP_ROLE,
+    RESP_CLUSTER,
+    RESP_ASKING,
+    RESP_MIGRATE,
+    RESP_PEERGET,
+    RESP_COMMAND_COUNT // numero di valori, per le tabelle indicizzate per comando
 } resp_command_e;
 
+#define RESP_CMD_WRITE 0x1 // modifica il dataset: rifiutato da una replica
+
+// metadati di un comando, come nella command table di Redis
+typedef struct {
+    const char *name;
+    int arity;       // argomenti compreso il nome; negativo: almeno -arity
+    unsigned flags;  // RESP_CMD_*
+    int first_key;   // argomento con la chiave (1 = primo), 0 se non va instradato per chiave
+} resp_command_info_t;
+
 typedef struct {
     char *command; // resp command
     char **args;   // argument list
     int arg_count; // number of arguments
 } resp_command_t;
 
-resp_command_e decode_command(char *command);
+/* codifica delle risposte senza vsnprintf. Le risposte fisse sono letterali condivisi, da
+ * passare con RESP_LITERAL: send(fd, RESP_LITERAL(RESP_OK), 0) */
+#define RESP_OK "+OK\r\n"
+#define RESP_PONG "+PONG\r\n"
+#define RESP_NIL "$-1\r\n"
+#define RESP3_NULL "_\r\n"
+#define RESP_CRLF "\r\n"
+#define RESP_LITERAL(reply) (reply), (sizeof(reply) - 1)
+#define RESP_INTEGER_MAX_LEN 24 // prefisso, segno, 20 cifre, \r\n
+
+/* <prefix><value>\r\n in out (":42\r\n", header "$5\r\n" di una bulk string, "*3\r\n"),
+ * che deve avere almeno RESP_INTEGER_MAX_LEN byte. Restituisce la lunghezza */
+size_t resp_encode_integer(char *out, char prefix, long long value);
+
 int resp_parse(const char *buf, size_t buf_len, resp_command_t *out);
+/* come resp_parse, ma comando e argomenti sono allocati nell'arena: restano validi fino a
+ * arena_reset e non vanno liberati con resp_command_free */
+int resp_parse_arena(const char *buf, size_t buf_len, resp_command_t *out, arena_t *arena);
 void resp_command_free(resp_command_t *cmd);
+/* nome del comando (maiuscole o minuscole) -> tipo, senza copie: switch su lunghezza e
+ * prima lettera, poi un solo confronto. RESP_UNKNOW se non riconosciuto */
 resp_command_e resp_decode_command(const char *command);
+// NULL per RESP_UNKNOW
+const resp_command_info_t *resp_command_info(resp_command_e command);
 
 #endif //RESP_PARSER_H
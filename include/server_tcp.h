@@ -14,15 +14,26 @@
 #define MAX_ERROR_MSG 256
 
 #include <signal.h>
+#include <stdbool.h>
 #include <netinet/in.h>
 
+#include "arena.h"
+#include "client_output.h"
 #include "pod_cache.h"
 #include "resp_parser.h"
+#include "shm_index.h"
+#include "timer_wheel.h"
+#include "tracking.h"
 
 #define BUFFER_SIZE         4096
-#define MAX_PENDING_CONNS   128
+#define DEFAULT_TCP_BACKLOG 511  // come tcp-backlog di Redis, il kernel lo limita a somaxconn
+#define DEFAULT_MAX_CONNECTIONS 1000
+#define ACCEPT_BATCH        64   // connessioni accettate per ogni risveglio del listener
 #define DEFAULT_PORT        6379
 #define MAX_LINE_LENGTH     1024
+#define DEFAULT_UNIX_PERM   0660
+#define DEFAULT_SHM_SIZE_MB 64
+#define CLOSE_DRAIN_MS      1000 // attesa massima per le ultime risposte alla chiusura
 
 /* Client connection context */
 typedef struct {
@@ -30,6 +41,15 @@ typedef struct {
     struct sockaddr_in addr;
     pthread_t thread_id;
     char client_id[64];
+    uint64_t id;                 // progressivo restituito da CLIENT ID e HELLO
+    int resp_version;            // 2, oppure 3 dopo HELLO 3
+    tracking_client_t *tracking; // CLIENT TRACKING attivo, NULL altrimenti
+    bool asking;                 // ASKING ricevuto: vale solo per il comando successivo
+    client_output_t output;      // risposte in attesa di essere inviate
+    arena_t arena;               // allocazioni del batch di comandi in corso (parser, handler)
+    timer_entry_t idle_timer;    // nella ruota dei timeout di inattività
+    uint64_t last_active;        // secondo dell'ultimo comando ricevuto (g_server.clock)
+    bool no_timeout;             // mai chiusa per inattività (connessione di replica)
 } client_ctx_t;
 
 typedef struct {
@@ -41,14 +61,23 @@ typedef struct {
 typedef struct {
     volatile sig_atomic_t running;
     int socket_fd;
+    int unix_fd;             // listener AF_UNIX opzionale (PODCACHE_UNIX_SOCKET), -1 se assente
+    char unix_path[108];     // sizeof(sun_path)
     pod_cache_t *cache;
+    shm_index_t *shm;        // indice in memoria condivisa (PODCACHE_SHM_NAME), NULL se assente
+    client_output_limits_t output_limits; // limiti della coda di uscita di ogni client
+    int tcp_backlog;
+    int max_connections;     // 0: nessun limite
+    int connections;         // connessioni aperte, aggiornato con operazioni atomiche
+    uint64_t rejected;       // connessioni rifiutate perché oltre max_connections
+    int idle_timeout;        // secondi di inattività prima della chiusura, 0 disabilitato
+    uint64_t idle_closed;
+    uint64_t clock;          // secondi monotoni, aggiornati dal thread dei timeout
+    pthread_mutex_t idle_mutex;
+    timer_wheel_t idle_wheel; // un timer per client, rinviato in modo pigro
 } server_state_t;
 
-typedef struct {
-    resp_command_e type;
-    const char *name;
-    int (*handler)(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
-} command_handler_t;
+typedef int (*command_handler_fn)(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
 
 typedef struct {
     char buffer[MAX_COMMAND_SIZE];
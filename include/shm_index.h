@@ -0,0 +1,70 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef SHM_INDEX_H
+#define SHM_INDEX_H
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Indice in memoria condivisa del tier in memoria: il server (unico writer) pubblica ogni
+ * valore scritto in un'arena circolare e lo indicizza in una hash table a indirizzamento
+ * aperto; ogni slot è protetto da un seqlock. I processi nello stesso pod leggono senza
+ * syscall né lock: copiano il valore e verificano che slot e arena non siano cambiati nel
+ * frattempo. L'indice è una cache: una chiave assente va sempre chiesta al server. */
+
+#define SHM_INDEX_MAGIC "PCSHM001"
+#define SHM_INDEX_VERSION 1
+
+typedef struct shm_index_header shm_index_header_t;
+typedef struct shm_index_slot shm_index_slot_t;
+
+typedef struct shm_index {
+    shm_index_header_t *header;
+    shm_index_slot_t *slots;
+    unsigned char *arena;
+    size_t map_size;
+    int owner;                   // 1 nel server che ha creato il segmento
+    pthread_mutex_t write_mutex; // solo owner: serializza i writer delle varie partizioni
+    char name[64];
+} shm_index_t;
+
+typedef struct shm_index_stats {
+    uint64_t published;
+    uint64_t removed;
+    uint64_t too_large; // valori non pubblicati perché troppo grandi per l'arena
+    uint64_t arena_bytes;
+    uint32_t slots;
+} shm_index_stats_t;
+
+/* lato server */
+shm_index_t *shm_index_create(const char *name, size_t size, mode_t perm);
+int shm_index_publish(shm_index_t *index, const char *key, size_t key_len, const void *value,
+                      size_t value_len);
+void shm_index_remove(shm_index_t *index, const char *key, size_t key_len);
+void shm_index_destroy(shm_index_t *index);
+void shm_index_get_stats(shm_index_t *index, shm_index_stats_t *out);
+
+/* lato client (libreria podcache_shm) */
+shm_index_t *shm_index_open(const char *name);
+/* 0 trovata (valore copiato in buf), -100 non pubblicata (chiedere al server), -2 buf troppo
+ * piccolo (*value_len contiene la dimensione necessaria), -1 segmento non più valido (server
+ * fermato: riaprire) */
+int shm_index_get(shm_index_t *index, const char *key, size_t key_len, void *buf,
+                  size_t buf_size, size_t *value_len);
+void shm_index_close(shm_index_t *index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif //SHM_INDEX_H
@@ -0,0 +1,47 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+#include <stdint.h>
+
+/*
+ * Timer wheel a un livello (hashed wheel di Varghese e Lauck): un timer con scadenza t sta
+ * nello slot t % TIMER_WHEEL_SLOTS, inserimento e rimozione sono O(1) e ogni tick visita un
+ * solo slot. Le scadenze oltre un giro restano nello slot e vengono saltate finché non
+ * maturano. I tick sono in unità scelte dal chiamante (il server usa i secondi).
+ *
+ * I timer sono intrusivi (timer_entry_t dentro l'oggetto da controllare) e la ruota non è
+ * thread-safe: chi la condivide tra thread la protegge con un mutex.
+ */
+
+#define TIMER_WHEEL_SLOTS 256
+
+typedef struct timer_entry {
+    struct timer_entry *prev;
+    struct timer_entry *next;
+    uint64_t expires;
+} timer_entry_t;
+
+/* chiamata per ogni timer scaduto, già rimosso dalla ruota: può reinserirlo con
+ * timer_wheel_add (rinvio pigro, senza toccare la ruota a ogni attività) */
+typedef void (*timer_expired_fn)(timer_entry_t *entry, void *ctx);
+
+typedef struct timer_wheel {
+    timer_entry_t slots[TIMER_WHEEL_SLOTS]; // teste delle liste circolari
+    uint64_t now;                           // ultimo tick elaborato
+} timer_wheel_t;
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now);
+// inserisce un timer non attivo; una scadenza passata scade al prossimo timer_wheel_advance
+void timer_wheel_add(timer_wheel_t *wheel, timer_entry_t *entry, uint64_t expires);
+// rimuove il timer se è attivo, altrimenti non fa nulla
+void timer_wheel_remove(timer_entry_t *entry);
+// porta la ruota al tick now, chiamando expired per i timer con scadenza <= now
+void timer_wheel_advance(timer_wheel_t *wheel, uint64_t now, timer_expired_fn expired, void *ctx);
+
+#endif //TIMER_WHEEL_H
@@ -0,0 +1,58 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resp_parser.h"
+
+/*
+ * Trace binaria del workload: un header seguito da record a dimensione fissa, nell'ordine
+ * in cui i comandi sono stati eseguiti. I campi sono scritti nell'endianness della macchina.
+ * Le chiavi non vengono salvate, solo il loro hash64().
+ */
+#define TRACE_MAGIC "PCTRACE1"
+#define TRACE_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t start_unix_ns; // istante di apertura della trace (wall clock)
+} trace_header_t;
+
+typedef struct {
+    uint64_t timestamp_ns; // dall'apertura della trace (clock monotono)
+    uint64_t key_hash;     // hash64() della chiave, 0 per i comandi senza chiave
+    uint32_t value_size;   // dimensione del valore per SET, 0 altrimenti
+    uint8_t command;       // resp_command_e
+    uint8_t reserved[3];
+} trace_record_t;
+
+/* cattura (server): i record sono accumulati per thread e scritti a blocchi */
+int trace_open(const char *path);
+bool trace_enabled(void);
+void trace_record(resp_command_e command, const char *key, size_t value_size);
+void trace_flush_thread(void);
+void trace_close(void);
+
+/* lettura: la trace viene mappata in memoria */
+typedef struct {
+    void *base;
+    size_t map_size;
+    const trace_header_t *header;
+    const trace_record_t *records;
+    size_t count;
+} trace_file_t;
+
+int trace_file_open(trace_file_t *trace, const char *path);
+void trace_file_close(trace_file_t *trace);
+
+#endif //TRACE_H
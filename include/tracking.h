@@ -0,0 +1,70 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#ifndef TRACKING_H
+#define TRACKING_H
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Client-side caching (CLIENT TRACKING): il server ricorda quali chiavi ha letto ogni client e,
+ * quando una chiave cambia, accoda un'invalidazione al client. Le invalidazioni vengono
+ * accodate dal thread che modifica la cache (senza I/O) e inviate dal thread del client
+ * destinatario, svegliato tramite una pipe: ogni socket resta scritto da un solo thread.
+ *
+ * Modalità default: la tabella delle chiavi tracciate è limitata a max_keys; oltre il limite
+ * la chiave più vecchia viene invalidata e dimenticata. Modalità broadcast (BCAST): nessuna
+ * tabella, il client riceve le invalidazioni di tutte le chiavi con uno dei prefissi richiesti.
+ */
+
+#define TRACKING_MAX_PREFIXES 16
+#define TRACKING_MAX_PENDING 4096 // oltre, le invalidazioni accodate diventano un flush totale
+#define TRACKING_DEFAULT_MAX_KEYS 1000000
+
+typedef struct tracking_client tracking_client_t;
+
+typedef struct tracking_options {
+    bool bcast;
+    bool noloop; // niente invalidazioni per le modifiche fatte dallo stesso client
+    int prefix_count;
+    const char *prefixes[TRACKING_MAX_PREFIXES];
+} tracking_options_t;
+
+typedef struct tracking_stats {
+    uint64_t tracked_keys;
+    uint64_t tracking_clients;
+    uint64_t invalidations;    // chiavi accodate ai client
+    uint64_t evicted_keys;     // chiavi dimenticate per il limite della tabella
+} tracking_stats_t;
+
+int tracking_init(size_t max_keys);
+void tracking_shutdown(void);
+
+/* abilita (o riconfigura) il tracking per il client: restituisce il record del client,
+ * NULL in caso di errore */
+tracking_client_t *tracking_enable(uint64_t client_id, const tracking_options_t *options);
+// disabilita e libera il record: va chiamata dal thread del client
+void tracking_disable(tracking_client_t *client);
+bool tracking_is_bcast(const tracking_client_t *client);
+// fd da aspettare con poll: diventa leggibile quando ci sono invalidazioni da inviare
+int tracking_wake_fd(const tracking_client_t *client);
+
+// modalità default: il client ha letto la chiave (da chiamare prima di leggere il valore)
+void tracking_remember(tracking_client_t *client, const char *key);
+// una chiave è cambiata: chiamata dal listener della cache, con la partizione bloccata
+void tracking_invalidate(const char *key);
+// id del client che sta eseguendo il comando sul thread corrente (per NOLOOP), 0 = nessuno
+void tracking_set_current_client(uint64_t client_id);
+
+/* preleva le invalidazioni accodate: *keys (da liberare con tracking_free_keys) e count.
+ * flush_all indica che la coda è traboccata e il client deve svuotare tutta la sua cache */
+void tracking_drain(tracking_client_t *client, char ***keys, size_t *count, bool *flush_all);
+void tracking_free_keys(char **keys, size_t count);
+void tracking_get_stats(tracking_stats_t *out);
+
+#endif //TRACKING_H
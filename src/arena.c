@@ -0,0 +1,99 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/arena.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_block {
+    arena_block_t *next;
+    size_t capacity;
+};
+
+// i dati seguono l'header, allineati (malloc restituisce memoria allineata almeno a 16)
+#define BLOCK_HEADER ((sizeof(arena_block_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define BLOCK_DATA(block) ((char *)(block) + BLOCK_HEADER)
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static arena_block_t *next_block(arena_t *arena, size_t size);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+void arena_init(arena_t *arena) { *arena = (arena_t){0}; }
+
+void arena_destroy(arena_t *arena) {
+    arena_block_t *block = arena->first;
+    while (block) {
+        arena_block_t *next = block->next;
+        free(block);
+        block = next;
+    }
+    *arena = (arena_t){0};
+}
+
+void *arena_alloc(arena_t *arena, size_t size) {
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (!arena->current || arena->current->capacity - arena->used < size) {
+        arena_block_t *block = next_block(arena, size);
+        if (!block) return NULL;
+        arena->current = block;
+        arena->used = 0;
+    }
+    void *ptr = BLOCK_DATA(arena->current) + arena->used;
+    arena->used += size;
+    return ptr;
+}
+
+char *arena_strndup(arena_t *arena, const char *src, size_t len) {
+    char *dest = arena_alloc(arena, len + 1);
+    if (!dest) return NULL;
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+    return dest;
+}
+
+void arena_reset(arena_t *arena) {
+    // si tengono i primi blocchi di dimensione normale, il resto torna a malloc
+    arena_block_t **link = &arena->first;
+    int kept = 0;
+    while (*link) {
+        arena_block_t *block = *link;
+        if (kept < ARENA_RETAIN_BLOCKS && block->capacity == ARENA_BLOCK_SIZE) {
+            kept++;
+            link = &block->next;
+        } else {
+            *link = block->next;
+            free(block);
+        }
+    }
+    arena->current = arena->first;
+    arena->used = 0;
+}
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+// blocco successivo a quello corrente con almeno size byte: riusato se c'è, altrimenti nuovo
+static arena_block_t *next_block(arena_t *arena, size_t size) {
+    arena_block_t **link = arena->current ? &arena->current->next : &arena->first;
+    while (*link && (*link)->capacity < size) link = &(*link)->next;
+    if (*link) return *link;
+
+    size_t capacity = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    arena_block_t *block = malloc(BLOCK_HEADER + capacity);
+    if (!block) return NULL;
+    block->next = NULL;
+    block->capacity = capacity;
+    *link = block;
+    return block;
+}
@@ -5,11 +5,14 @@
  * License: AGPL 3
  */
 
+#define _GNU_SOURCE // syncfs
 #define CHUNK_PATH 16
 
 #include "../include/cas.h"
 
 #include <dirent.h>
+#include <fcntl.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -21,17 +24,67 @@
 #include "../include/clogger.h"
 #include "../include/hash_func.h"
 
-#define CAS_REGISTRY_INITIAL_CAPACITY 100
+#define BLOCKS(bytes) (((bytes) + CAS_BLOCK_SIZE - 1) / CAS_BLOCK_SIZE * CAS_BLOCK_SIZE)
+
+// entry del tier su disco: la directory si ricava dall'hash (vedi entry_path)
+struct cas_entry {
+    cas_entry_t *prev; // lista per recenza, head = più recente
+    cas_entry_t *next;
+    cas_entry_t *hash_next;
+    size_t footprint;
+    char hash[65];
+    char key[];
+};
+
+// file di una entry, nell'ordine delle richieste di scrittura
+static const char *entry_files[] = {"value.dat", "time.dat", "key.dat"};
+#define ENTRY_FILES 3
+
+/* entry in scrittura: preparata (directory e file aperti) con il mutex, i suoi file vengono
+ * scritti senza, insieme a quelli delle altre entry del gruppo con una sola sottomissione */
+typedef struct put_slot {
+    char hash[65];
+    size_t footprint;
+    char path[PATH_MAX];
+    int fds[ENTRY_FILES];
+    char timestamp[32];
+    int result;
+} put_slot_t;
 
 /* ========================================================
  * forward static declaration
  * ======================================================== */
+static int put_entries(cas_registry_t *registry, size_t count, const cas_record_t *records,
+                       int *results, char *output_path);
+static int prepare_put(cas_registry_t *registry, const cas_record_t *record, put_slot_t *slot,
+                       disk_io_request_t *requests);
+static int close_put(put_slot_t *slot, const disk_io_request_t *requests);
+static int finish_put(cas_registry_t *registry, const cas_record_t *record, put_slot_t *slot);
+static void close_slot(put_slot_t *slot);
+static void sync_entries(cas_registry_t *registry, cas_sync_e sync);
+static int cas_evict_locked(const char *key, cas_registry_t *registry);
+static cas_entry_t *index_find(const cas_registry_t *registry, const char hash[65]);
+static int index_add(cas_registry_t *registry, const char hash[65], const char *key,
+                     size_t footprint);
+static void index_unlink(cas_registry_t *registry, cas_entry_t *entry);
+static void index_grow(cas_registry_t *registry);
+static void list_unlink(cas_registry_t *registry, cas_entry_t *entry);
+static void list_push_head(cas_registry_t *registry, cas_entry_t *entry);
+static size_t bucket_of(const char hash[65], size_t bucket_count);
+static size_t entry_footprint(size_t value_size, size_t key_len);
+static void drop_until(cas_registry_t *registry, size_t incoming);
+static void entry_path(const cas_registry_t *registry, const char hash[65], char *path,
+                       size_t path_size);
 static int cas_remove(const cas_registry_t *registry, fs_path_t *fs_path);
-static int cas_create_directory(const cas_registry_t *registry, const char *key, char *output_path);
+static void discard_entry(const char *entry_path);
+static int open_files(const char *entry_path, const char **names, size_t count, int *fds);
+static int read_files(cas_registry_t *registry, const int *fds, size_t count, void **buffers,
+                      size_t *sizes);
+static int cas_create_directory(const cas_registry_t *registry, const char hash[65],
+                                char *output_path);
 static fs_path_t *create_fs_path(const char hash[65]);
 static void substring(const char *str, int portion, char *output);
 static int return_and_free(int result, fs_path_t *path);
-static char *get_path(const cas_registry_t *registry, const fs_path_t *path);
 static void free_path(fs_path_t *path);
 static void generate_base_path(char *buffer);
 int cleanup(const char *path);
@@ -52,75 +105,239 @@ cas_registry_t *cas_create_registry() {
     generate_base_path(registry->base_path);
     log_debug("CAS base path set to: %s", registry->base_path);
 
-    registry->entries = malloc(CAS_REGISTRY_INITIAL_CAPACITY * sizeof(char *));
-    if (!registry->entries) {
-        log_error("Failed to allocate memory for CAS registry entries");
+    registry->buckets = calloc(CAS_INDEX_INITIAL_BUCKETS, sizeof(cas_entry_t *));
+    if (!registry->buckets) {
+        log_error("Failed to allocate memory for CAS registry index");
         free(registry);
         return NULL;
     }
 
-    registry->capacity = CAS_REGISTRY_INITIAL_CAPACITY;
+    registry->bucket_count = CAS_INDEX_INITIAL_BUCKETS;
+    registry->head = registry->tail = NULL;
     registry->entries_count = 0;
+    registry->bytes = 0;
+    registry->pending_bytes = 0;
+    registry->max_bytes = 0;
+    registry->drops = 0;
+    registry->on_drop = NULL;
+    registry->drop_ctx = NULL;
+    registry->sync = CAS_SYNC_NONE;
+    registry->syncs = 0;
+
+    registry->io = disk_io_create(DISK_IO_AUTO, CAS_IO_QUEUE_DEPTH, CAS_IO_THREADS);
+    if (!registry->io) {
+        log_error("Failed to create disk I/O engine for CAS registry");
+        free(registry->buckets);
+        free(registry);
+        return NULL;
+    }
+    log_debug("CAS disk I/O backend: %s", disk_io_backend_name(registry->io));
+
+    if (pthread_mutex_init(&registry->mutex, NULL) != 0) {
+        log_error("Failed to initialize mutex for CAS registry");
+        disk_io_destroy(registry->io);
+        free(registry->buckets);
+        free(registry);
+        return NULL;
+    }
 
     log_info("CAS registry created successfully with initial capacity: %d",
-             CAS_REGISTRY_INITIAL_CAPACITY);
+             CAS_INDEX_INITIAL_BUCKETS);
     return registry;
 }
 
-int cas_put(const cas_registry_t *registry, const char *key, void *value, size_t value_size,
+int cas_put(cas_registry_t *registry, const char *key, void *value, size_t value_size,
             char *output_path) {
     if (!registry || !key || !value || !output_path) {
         log_error("Invalid parameters in cas_put");
         return -1;
     }
 
-    log_debug("CAS PUT: storing key '%s', size: %zu bytes", key, value_size);
+    cas_record_t record = {.key = key, .value = value, .size = value_size};
+    int result = -1;
+    put_entries(registry, 1, &record, &result, output_path);
+    return result;
+}
 
-    if (cas_create_directory(registry, key, output_path) != 0) {
-        log_error("Failed to create directory structure for key '%s'", key);
+int cas_put_batch(cas_registry_t *registry, size_t count, const cas_record_t *records,
+                  int *results) {
+    if (!registry || !records) {
+        log_error("Invalid parameters in cas_put_batch");
         return -1;
     }
 
-    log_debug("CAS PUT: created directory structure at: %s", output_path);
+    return put_entries(registry, count, records, results, NULL);
+}
 
-    // ho il path, ci devo scrivere dentro il contenuto di value
-    char complete_path[PATH_MAX];
-    sprintf(complete_path, "%s/%s", output_path, "value.dat");
-    FILE *fp = fopen(complete_path, "wb");
-    if (!fp) {
-        log_error("Failed to open file for writing: %s", complete_path);
+/* scrive le entry in tre passi: prepara ognuna (budget, directory, file aperti) con il mutex,
+ * sottomette tutte le scritture al motore di I/O in una volta senza, poi registra con il mutex
+ * le entry scritte per intero. Le entry in volo non sono nell'indice: una lettura concorrente
+ * della stessa chiave non le trova, una visita non le apre. results (opzionale) riceve il
+ * codice di ogni entry, output_path (opzionale) la directory dell'ultima scritta; restituisce
+ * le entry scritte */
+static int put_entries(cas_registry_t *registry, size_t count, const cas_record_t *records,
+                       int *results, char *output_path) {
+    put_slot_t *slots = calloc(count ? count : 1, sizeof(put_slot_t));
+    disk_io_request_t *requests =
+        calloc((count ? count : 1) * ENTRY_FILES, sizeof(disk_io_request_t));
+    if (!slots || !requests) {
+        log_error("Failed to allocate %zu CAS writes", count);
+        for (size_t i = 0; results && i < count; i++) results[i] = -1;
+        free(slots);
+        free(requests);
+        return 0;
+    }
+
+    pthread_mutex_lock(&registry->mutex);
+    cas_sync_e sync = registry->sync;
+    size_t submitted = 0;
+    for (size_t i = 0; i < count; i++) {
+        slots[i].result = prepare_put(registry, &records[i], &slots[i], &requests[submitted]);
+        if (slots[i].result == 0) submitted += ENTRY_FILES;
+    }
+    pthread_mutex_unlock(&registry->mutex);
+
+    // l'esito di ogni scrittura è nella sua richiesta
+    if (submitted > 0) disk_io_submit(registry->io, requests, submitted);
+    size_t next = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (slots[i].result != 0) continue;
+        slots[i].result = close_put(&slots[i], &requests[next]);
+        next += ENTRY_FILES;
+    }
+
+    int written = 0;
+    pthread_mutex_lock(&registry->mutex);
+    for (size_t i = 0; i < count; i++) {
+        if (slots[i].footprint > 0) {
+            slots[i].result = finish_put(registry, &records[i], &slots[i]);
+        }
+        if (results) results[i] = slots[i].result;
+        if (slots[i].result != 0) continue;
+        written++;
+        if (output_path) strcpy(output_path, slots[i].path);
+    }
+    pthread_mutex_unlock(&registry->mutex);
+
+    // group commit: una sola sync rende durevoli tutte le entry del gruppo
+    if (written > 0) sync_entries(registry, sync);
+    free(requests);
+    free(slots);
+    return written;
+}
+
+/* con il mutex: l'ingombro della entry resta in pending_bytes finché finish_put non la
+ * registra, così le scritture in volo di più thread non sforano il budget */
+static int prepare_put(cas_registry_t *registry, const cas_record_t *record, put_slot_t *slot,
+                       disk_io_request_t *requests) {
+    for (int f = 0; f < ENTRY_FILES; f++) slot->fds[f] = -1;
+    if (!record->key || !record->value) return -1;
+
+    const char *key = record->key;
+    log_debug("CAS PUT: storing key '%s', size: %zu bytes", key, record->size);
+
+    size_t key_len = strlen(key);
+    size_t footprint = entry_footprint(record->size, key_len);
+    if (registry->max_bytes && footprint > registry->max_bytes) {
+        log_warn("CAS PUT: key '%s' (%zu bytes) does not fit the disk budget of %zu bytes", key,
+                 record->size, registry->max_bytes);
         return -1;
     }
-    if (fwrite(value, 1, value_size, fp) != value_size) {
-        log_error("Failed to write complete data to file: %s", complete_path);
-        fclose(fp);
-        return -9;
+
+    sha256_string(key, slot->hash);
+    // la entry precedente della chiave viene sostituita (cas_create_directory ne rimuove i file)
+    cas_entry_t *previous = index_find(registry, slot->hash);
+    if (previous) {
+        index_unlink(registry, previous);
+        free(previous);
     }
-    fclose(fp);
-    log_debug("CAS PUT: successfully wrote value data to: %s", complete_path);
+    drop_until(registry, footprint);
 
-    sprintf(complete_path, "%s/%s", output_path, "time.dat");
-    fp = fopen(complete_path, "wb");
-    if (!fp) {
-        log_error("Failed to open timestamp file for writing: %s", complete_path);
+    if (cas_create_directory(registry, slot->hash, slot->path) != 0) {
+        log_error("Failed to create directory structure for key '%s'", key);
         return -1;
     }
-    time_t now = time(NULL);
-    fprintf(fp, "%ld", (long)now);
-    fclose(fp);
-    log_debug("CAS PUT: successfully wrote timestamp to: %s", complete_path);
 
-    log_info("CAS PUT: successfully stored key '%s' at: %s", key, output_path);
+    log_debug("CAS PUT: created directory structure at: %s", slot->path);
+
+    for (int f = 0; f < ENTRY_FILES; f++) {
+        char complete_path[sizeof(slot->path) + 16];
+        snprintf(complete_path, sizeof(complete_path), "%s/%s", slot->path, entry_files[f]);
+        slot->fds[f] = open(complete_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (slot->fds[f] < 0) {
+            log_error("Failed to open file for writing: %s", complete_path);
+            close_slot(slot);
+            discard_entry(slot->path);
+            return -1;
+        }
+    }
+
+    int timestamp_len = snprintf(slot->timestamp, sizeof(slot->timestamp), "%ld",
+                                 (long)time(NULL));
+    // il nome della chiave serve a chi visita il tier su disco (snapshot di replica)
+    const void *buffers[ENTRY_FILES] = {record->value, slot->timestamp, key};
+    size_t lengths[ENTRY_FILES] = {record->size, (size_t)timestamp_len, key_len};
+    for (int f = 0; f < ENTRY_FILES; f++) {
+        requests[f] = (disk_io_request_t){.op = DISK_IO_WRITE,
+                                          .fd = slot->fds[f],
+                                          .buffer = (void *)buffers[f],
+                                          .len = lengths[f],
+                                          .offset = 0};
+    }
+    slot->footprint = footprint;
+    registry->pending_bytes += footprint;
     return 0;
 }
 
-static int remove_dir(char *dir) {
-    struct stat st;
-    if (stat(dir, &st) == 0) {
-        int remove_result = remove(dir);
-        return remove_result;
+// con il volume pieno l'errore arriva dalla scrittura o, su alcuni filesystem, dalla close
+static int close_put(put_slot_t *slot, const disk_io_request_t *requests) {
+    int result = 0;
+    for (int f = 0; f < ENTRY_FILES; f++) {
+        if (requests[f].result == (ssize_t)requests[f].len) continue;
+        log_error("Failed to write %s/%s: %s", slot->path, entry_files[f],
+                  requests[f].result < 0 ? strerror((int)-requests[f].result) : "short write");
+        result = -9;
+    }
+    for (int f = 0; f < ENTRY_FILES; f++) {
+        if (close(slot->fds[f]) != 0 && result == 0) {
+            log_error("Failed to flush %s/%s: %s", slot->path, entry_files[f], strerror(errno));
+            result = -9;
+        }
+        slot->fds[f] = -1;
+    }
+    return result;
+}
+
+// con il mutex: registra la entry scritta per intero, rimuove i file di quella fallita
+static int finish_put(cas_registry_t *registry, const cas_record_t *record, put_slot_t *slot) {
+    registry->pending_bytes -= slot->footprint;
+    int result = slot->result;
+    if (result == 0) {
+        // la stessa chiave scritta due volte nel gruppo: resta l'ultima
+        cas_entry_t *previous = index_find(registry, slot->hash);
+        if (previous) {
+            index_unlink(registry, previous);
+            free(previous);
+        }
+        if (index_add(registry, slot->hash, record->key, slot->footprint) != 0) {
+            log_error("Failed to register key '%s'", record->key);
+            result = -1;
+        }
+    }
+    if (result != 0) {
+        discard_entry(slot->path);
+        return result;
+    }
+
+    log_debug("CAS PUT: successfully stored key '%s' at: %s", record->key, slot->path);
+    return 0;
+}
+
+static void close_slot(put_slot_t *slot) {
+    for (int f = 0; f < ENTRY_FILES; f++) {
+        if (slot->fds[f] >= 0) close(slot->fds[f]);
+        slot->fds[f] = -1;
     }
-    return -1;
 }
 
 int cas_evict(const char *key, cas_registry_t *registry) {
@@ -129,92 +346,117 @@ int cas_evict(const char *key, cas_registry_t *registry) {
         return -1;
     }
 
+    pthread_mutex_lock(&registry->mutex);
+    int result = cas_evict_locked(key, registry);
+    pthread_mutex_unlock(&registry->mutex);
+    return result;
+}
+
+static int cas_evict_locked(const char *key, cas_registry_t *registry) {
+
     log_debug("CAS EVICT: attempting to remove key '%s'", key);
 
     char hash[65] = {'\0'};
-    char path[PATH_MAX] = {'\0'};
-
     sha256_string(key, hash);
-    fs_path_t *fs_path = create_fs_path(hash);
-
-    // Array dei path da rimuovere (dal più profondo al più superficiale)
-    const char *patterns[] = {"%s/%s/%s/%s/%s/value.dat", "%s/%s/%s/%s/%s", "%s/%s/%s/%s",
-                              "%s/%s/%s", "%s/%s"};
-
-    int founded = 1;
-    for (int i = 0; i < 5; i++) {
-        snprintf(path, sizeof(path), patterns[i], registry->base_path, fs_path->p[0], fs_path->p[1],
-                 fs_path->p[2], fs_path->p[3]);
-        log_debug("CAS EVICT: removing path: %s", path);
-        if (remove_dir(path) == -1) {
-            log_debug("CAS EVICT: failed to remove path: %s", path);
-            founded = 0;
-        }
-    }
-    if (founded == 0) {
-        log_warn("CAS EVICT: failed to remove some paths for key '%s'", key);
-        free(fs_path);
+    // il registry è completo: una chiave assente non costa accessi al filesystem
+    cas_entry_t *entry = index_find(registry, hash);
+    if (!entry) {
+        log_debug("CAS EVICT: key '%s' not in registry", key);
         return -1;
     }
 
-    char p[512] = {'\0'};
-    sprintf(p, "%s/%s/%s/%s/%s", registry->base_path, fs_path->p[0], fs_path->p[1], fs_path->p[2],
-            fs_path->p[3]);
-    log_debug("CAS EVICT: removing entry from registry: %s", p);
-
-    for (int i = 0; i < registry->entries_count; i++) {
-        if (strcmp(registry->entries[i], p) == 0) {
-            log_debug("CAS EVICT: found registry entry at index %d", i);
-            for (int j = i; j < registry->entries_count - 1; j++) {
-                registry->entries[j] = registry->entries[j + 1];
-            }
-            free(registry->entries[registry->entries_count - 1]);
-            registry->entries_count--;
-            log_debug("CAS EVICT: removed entry from registry, new count: %zu",
-                      registry->entries_count);
-            break;
-        }
+    fs_path_t *fs_path = create_fs_path(hash);
+    int removed = fs_path ? cas_remove(registry, fs_path) : -1;
+    free_path(fs_path);
+    index_unlink(registry, entry);
+    free(entry);
+    if (removed != 0) {
+        log_warn("CAS EVICT: failed to remove some paths for key '%s'", key);
+        return -1;
     }
 
-    free(fs_path);
     log_info("CAS EVICT: successfully removed key '%s'", key);
     return 0;
 }
 
-int cas_add_to_registry(cas_registry_t *registry, char *path) {
-    if (!registry || !path) {
-        log_error("Invalid parameters in cas_add_to_registry");
-        return -1;
-    }
+bool cas_contains(cas_registry_t *registry, const char *key) {
+    if (!registry || !key) return false;
 
-    log_debug("CAS REGISTRY: adding path to registry: %s", path);
+    char hash[65] = {'\0'};
+    sha256_string(key, hash);
+    pthread_mutex_lock(&registry->mutex);
+    bool found = index_find(registry, hash) != NULL;
+    pthread_mutex_unlock(&registry->mutex);
+    return found;
+}
 
-    if (registry->entries_count + 1 >= registry->capacity) {
-        size_t old_capacity = registry->capacity;
-        registry->capacity *= 2;
-        log_debug("CAS REGISTRY: expanding capacity from %zu to %zu", old_capacity,
-                  registry->capacity);
+bool cas_touch(cas_registry_t *registry, const char *key) {
+    if (!registry || !key) return false;
 
-        char **new_entries = realloc(registry->entries, registry->capacity * sizeof(char *));
-        if (!new_entries) {
-            log_error("Failed to reallocate registry entries");
-            return -1; // Errore di allocazione
-        }
-        registry->entries = new_entries;
+    char hash[65] = {'\0'};
+    sha256_string(key, hash);
+    pthread_mutex_lock(&registry->mutex);
+    cas_entry_t *entry = index_find(registry, hash);
+    if (entry) {
+        list_unlink(registry, entry);
+        list_push_head(registry, entry);
     }
+    pthread_mutex_unlock(&registry->mutex);
+    return entry != NULL;
+}
 
-    registry->entries[registry->entries_count] = malloc(strlen(path) + 1); // +1 per '\0'
-    if (!registry->entries[registry->entries_count]) {
-        log_error("Failed to allocate memory for registry entry");
-        return -1; // Errore di allocazione
-    }
-    strcpy(registry->entries[registry->entries_count], path);
-    registry->entries_count++;
+void cas_set_limit(cas_registry_t *registry, size_t max_bytes, cas_drop_fn on_drop, void *ctx) {
+    if (!registry) return;
+
+    pthread_mutex_lock(&registry->mutex);
+    registry->max_bytes = max_bytes;
+    registry->on_drop = on_drop;
+    registry->drop_ctx = ctx;
+    drop_until(registry, 0);
+    pthread_mutex_unlock(&registry->mutex);
+}
+
+void cas_get_stats(cas_registry_t *registry, cas_stats_t *out) {
+    if (!registry || !out) return;
 
-    log_debug("CAS REGISTRY: successfully added entry, total count: %zu", registry->entries_count);
+    pthread_mutex_lock(&registry->mutex);
+    out->entries = registry->entries_count;
+    out->bytes = registry->bytes;
+    out->max_bytes = registry->max_bytes;
+    out->drops = registry->drops;
+    out->syncs = registry->syncs;
+    pthread_mutex_unlock(&registry->mutex);
+}
+
+void cas_set_sync(cas_registry_t *registry, cas_sync_e sync) {
+    if (!registry) return;
+    pthread_mutex_lock(&registry->mutex);
+    registry->sync = sync;
+    pthread_mutex_unlock(&registry->mutex);
+}
+
+int cas_set_io(cas_registry_t *registry, disk_io_backend_e backend) {
+    if (!registry) return -1;
+    disk_io_t *io = disk_io_create(backend, CAS_IO_QUEUE_DEPTH, CAS_IO_THREADS);
+    if (!io) return -1;
+
+    pthread_mutex_lock(&registry->mutex);
+    disk_io_t *previous = registry->io;
+    registry->io = io;
+    pthread_mutex_unlock(&registry->mutex);
+    disk_io_destroy(previous);
+    log_debug("CAS disk I/O backend: %s", disk_io_backend_name(io));
     return 0;
 }
 
+const char *cas_io_backend(cas_registry_t *registry) {
+    if (!registry) return NULL;
+    pthread_mutex_lock(&registry->mutex);
+    const char *name = disk_io_backend_name(registry->io);
+    pthread_mutex_unlock(&registry->mutex);
+    return name;
+}
+
 void cas_registry_destroy(cas_registry_t *registry) {
     if (!registry) {
         log_warn("Attempted to destroy NULL CAS registry");
@@ -223,33 +465,98 @@ void cas_registry_destroy(cas_registry_t *registry) {
 
     log_info("Destroying CAS registry with %zu entries", registry->entries_count);
 
-    if (registry->entries != NULL) {
-        // Prima libera ogni singola stringa
-        log_debug("CAS REGISTRY: cleaning up %zu entries", registry->entries_count);
-        for (size_t i = 0; i < registry->entries_count; i++) {
-            if (registry->entries[i] != NULL) {
-                // TODO: rimuovi il file se esistente
-                log_debug("CAS REGISTRY: freeing entry %zu: %s", i, registry->entries[i]);
-                free(registry->entries[i]); // libera la stringa
-            }
-        }
-        log_debug("CAS REGISTRY: cleaning up base path: %s", registry->base_path);
-        cleanup(registry->base_path);
-        // Poi libera l'array di puntatori
-        free(registry->entries);
+    // Prima libera le entry, i file vengono rimossi insieme alla directory base
+    log_debug("CAS REGISTRY: cleaning up %zu entries", registry->entries_count);
+    cas_entry_t *entry = registry->head;
+    while (entry) {
+        cas_entry_t *next = entry->next;
+        free(entry);
+        entry = next;
     }
+    log_debug("CAS REGISTRY: cleaning up base path: %s", registry->base_path);
+    cleanup(registry->base_path);
+    free(registry->buckets);
+    disk_io_destroy(registry->io);
 
     // Infine libera la struct
+    pthread_mutex_destroy(&registry->mutex);
     free(registry);
     log_info("CAS registry destroyed successfully");
 }
 
+int cas_foreach(cas_registry_t *registry, cas_visit_fn visit, void *ctx) {
+    if (!registry || !visit) return -1;
+
+    // elenco copiato: le entry aggiunte o rimosse durante la visita non spostano l'indice
+    pthread_mutex_lock(&registry->mutex);
+    size_t count = registry->entries_count;
+    char (*hashes)[65] = malloc((count ? count : 1) * sizeof(*hashes));
+    if (!hashes) {
+        pthread_mutex_unlock(&registry->mutex);
+        return -1;
+    }
+    size_t listed = 0;
+    for (cas_entry_t *entry = registry->head; entry && listed < count; entry = entry->next) {
+        memcpy(hashes[listed++], entry->hash, 65);
+    }
+    pthread_mutex_unlock(&registry->mutex);
+
+    int visited = 0;
+    for (size_t i = 0; i < listed; i++) {
+        /* i file si aprono con il mutex solo se la entry è ancora registrata (scritta per
+         * intero), poi si leggono senza: una riscrittura successiva crea file nuovi */
+        const char *names[] = {"key.dat", "value.dat"};
+        int fds[2];
+        char path[PATH_MAX];
+        pthread_mutex_lock(&registry->mutex);
+        int rc = -1;
+        if (index_find(registry, hashes[i])) {
+            entry_path(registry, hashes[i], path, sizeof(path));
+            rc = open_files(path, names, 2, fds);
+        }
+        pthread_mutex_unlock(&registry->mutex);
+        void *buffers[2];
+        size_t sizes[2];
+        if (rc != 0 || read_files(registry, fds, 2, buffers, sizes) != 0) {
+            continue; // rimossa nel frattempo
+        }
+
+        visited++;
+        int stop = visit(buffers[0], buffers[1], sizes[1], ctx);
+        free(buffers[0]);
+        free(buffers[1]);
+        if (stop != 0) break;
+    }
+    free(hashes);
+    return visited;
+}
+
+int cas_clear(cas_registry_t *registry, cas_visit_fn visit, void *ctx) {
+    if (!registry) return -1;
+
+    pthread_mutex_lock(&registry->mutex);
+    int removed = 0;
+    while (registry->head) {
+        cas_entry_t *entry = registry->head;
+        if (visit) visit(entry->key, NULL, 0, ctx);
+        char path[PATH_MAX];
+        entry_path(registry, entry->hash, path, sizeof(path));
+        discard_entry(path);
+        index_unlink(registry, entry);
+        free(entry);
+        removed++;
+    }
+    pthread_mutex_unlock(&registry->mutex);
+    log_info("CAS CLEAR: removed %d entries", removed);
+    return removed;
+}
+
 /* si usa con :
     void *data = NULL;           // Inizializza a NULL
     size_t size;
     int result = cas_get("my_key", &data, &size);
 */
-int cas_get(const cas_registry_t *registry, const char *key, void **buffer, size_t *actual_size) {
+int cas_get(cas_registry_t *registry, const char *key, void **buffer, size_t *actual_size) {
     if (!registry || !key || !buffer || !actual_size) {
         log_error("Invalid parameters in cas_get");
         return -1;
@@ -259,72 +566,167 @@ int cas_get(const cas_registry_t *registry, const char *key, void **buffer, size
 
     char hash[65] = {'\0'};
     sha256_string(key, hash);
-    fs_path_t *fs_path = create_fs_path(hash);
-    char *path = get_path(registry, fs_path);
-    char complete_path[PATH_MAX];
-    sprintf(complete_path, "%s/%s", path, "value.dat");
-
-    log_debug("CAS GET: looking for file at: %s", complete_path);
-
-    struct stat st;
-    if (stat(complete_path, &st) != 0) {
-        log_debug("CAS GET: file not found for key '%s' at path: %s", key, complete_path);
-        free_path(fs_path);
-        free(path);
+    char path[PATH_MAX];
+    const char *names[] = {"value.dat"};
+    int fd = -1;
+
+    /* con il mutex si trova la entry e se ne apre il file, la lettura avviene senza: se nel
+     * frattempo la entry viene rimossa o riscritta, il file aperto resta quello completo */
+    pthread_mutex_lock(&registry->mutex);
+    cas_entry_t *entry = index_find(registry, hash);
+    if (!entry) {
+        pthread_mutex_unlock(&registry->mutex);
+        log_debug("CAS GET: key '%s' not in registry", key);
+        return -1;
+    }
+    // letta: diventa la più recente, l'ultima a essere rimossa per il budget
+    list_unlink(registry, entry);
+    list_push_head(registry, entry);
+    entry_path(registry, hash, path, sizeof(path));
+    int rc = open_files(path, names, 1, &fd);
+    pthread_mutex_unlock(&registry->mutex);
+
+    if (rc != 0 || read_files(registry, &fd, 1, buffer, actual_size) != 0) {
+        log_error("Failed to read value of key '%s' from: %s", key, path);
         return -1;
     }
 
-    size_t file_size = st.st_size;
-    log_debug("CAS GET: found file for key '%s', size: %zu bytes", key, file_size);
+    log_info("CAS GET: successfully retrieved key '%s', size: %zu bytes", key, *actual_size);
+    return 0;
+}
 
-    *buffer = malloc(file_size);
-    if (!*buffer) {
-        log_error("Memory allocation failed for key '%s' (size: %zu)", key, file_size);
-        free_path(fs_path);
-        free(path);
-        return -1; // Errore di allocazione
+/* ========================================
+ * static functions
+ * ======================================== */
+
+static cas_entry_t *index_find(const cas_registry_t *registry, const char hash[65]) {
+    cas_entry_t *entry = registry->buckets[bucket_of(hash, registry->bucket_count)];
+    while (entry && memcmp(entry->hash, hash, 64) != 0) entry = entry->hash_next;
+    return entry;
+}
+
+static int index_add(cas_registry_t *registry, const char hash[65], const char *key,
+                     size_t footprint) {
+    size_t key_len = strlen(key);
+    cas_entry_t *entry = malloc(sizeof(cas_entry_t) + key_len + 1);
+    if (!entry) return -1;
+    memcpy(entry->hash, hash, 65);
+    memcpy(entry->key, key, key_len + 1);
+    entry->footprint = footprint;
+
+    if (registry->entries_count >= registry->bucket_count) index_grow(registry);
+    size_t bucket = bucket_of(hash, registry->bucket_count);
+    entry->hash_next = registry->buckets[bucket];
+    registry->buckets[bucket] = entry;
+    list_push_head(registry, entry);
+    registry->entries_count++;
+    registry->bytes += footprint;
+    return 0;
+}
+
+// toglie la entry da indice e lista, senza liberarla
+static void index_unlink(cas_registry_t *registry, cas_entry_t *entry) {
+    cas_entry_t **link = &registry->buckets[bucket_of(entry->hash, registry->bucket_count)];
+    while (*link && *link != entry) link = &(*link)->hash_next;
+    if (*link) *link = entry->hash_next;
+    list_unlink(registry, entry);
+    registry->entries_count--;
+    registry->bytes -= entry->footprint;
+}
+
+// raddoppia i bucket; se la memoria manca l'indice resta valido, solo con catene più lunghe
+static void index_grow(cas_registry_t *registry) {
+    size_t bucket_count = registry->bucket_count * 2;
+    cas_entry_t **buckets = calloc(bucket_count, sizeof(cas_entry_t *));
+    if (!buckets) return;
+    for (cas_entry_t *entry = registry->head; entry; entry = entry->next) {
+        size_t bucket = bucket_of(entry->hash, bucket_count);
+        entry->hash_next = buckets[bucket];
+        buckets[bucket] = entry;
     }
+    free(registry->buckets);
+    registry->buckets = buckets;
+    registry->bucket_count = bucket_count;
+}
 
-    FILE *fp = fopen(complete_path, "rb");
-    if (!fp) {
-        log_error("Failed to open file for reading: %s", complete_path);
-        free(*buffer);
-        free_path(fs_path);
-        free(path);
-        return -1;
+/* syncfs sul filesystem del registry: dati e metadati (directory, file) di tutte le entry
+ * scritte finora arrivano sul disco con un solo flush */
+static void sync_entries(cas_registry_t *registry, cas_sync_e sync) {
+    if (sync == CAS_SYNC_NONE) return;
+    int fd = open(registry->base_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0 || syncfs(fd) != 0) {
+        log_error("CAS SYNC: failed to sync %s: %s", registry->base_path, strerror(errno));
+    } else {
+        pthread_mutex_lock(&registry->mutex);
+        registry->syncs++;
+        pthread_mutex_unlock(&registry->mutex);
     }
+    if (fd >= 0) close(fd);
+}
 
-    size_t read_size = fread(*buffer, 1, file_size, fp);
-    if (read_size < file_size) {
-        log_error("Failed to read complete file for key '%s' (read: %zu, expected: %zu)", key,
-                  read_size, file_size);
-        free(*buffer);
-        free_path(fs_path);
-        free(path);
-        fclose(fp);
-        return -1;
+static void list_unlink(cas_registry_t *registry, cas_entry_t *entry) {
+    if (entry->prev) entry->prev->next = entry->next;
+    else registry->head = entry->next;
+    if (entry->next) entry->next->prev = entry->prev;
+    else registry->tail = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+static void list_push_head(cas_registry_t *registry, cas_entry_t *entry) {
+    entry->prev = NULL;
+    entry->next = registry->head;
+    if (registry->head) registry->head->prev = entry;
+    registry->head = entry;
+    if (!registry->tail) registry->tail = entry;
+}
+
+// l'hash è uno SHA-256 esadecimale: le prime cifre sono già distribuite uniformemente
+static size_t bucket_of(const char hash[65], size_t bucket_count) {
+    uint64_t value = 0;
+    for (int i = 0; i < 16; i++) {
+        char c = hash[i];
+        value = (value << 4) | (uint64_t)(c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
     }
+    return (size_t)(value % bucket_count);
+}
 
-    *actual_size = read_size;
-    fclose(fp);
-    free_path(fs_path);
-    free(path);
+/* ingombro stimato: value.dat, key.dat e time.dat arrotondati al blocco, più le quattro
+ * directory del percorso (16 cifre dell'hash per livello: quasi mai condivise) */
+static size_t entry_footprint(size_t value_size, size_t key_len) {
+    return BLOCKS(value_size) + BLOCKS(key_len) + CAS_BLOCK_SIZE + 4 * CAS_BLOCK_SIZE;
+}
 
-    log_info("CAS GET: successfully retrieved key '%s', size: %zu bytes", key, read_size);
-    return 0;
+/* rimuove le entry meno recenti finché altri incoming byte stanno nel budget, contando anche
+ * le scritture ancora in volo */
+static void drop_until(cas_registry_t *registry, size_t incoming) {
+    if (!registry->max_bytes) return;
+    while (registry->tail &&
+           registry->bytes + registry->pending_bytes + incoming > registry->max_bytes) {
+        cas_entry_t *entry = registry->tail;
+        fs_path_t *fs_path = create_fs_path(entry->hash);
+        if (!fs_path || cas_remove(registry, fs_path) != 0) {
+            log_warn("CAS DROP: failed to remove some paths for key '%s'", entry->key);
+        }
+        free_path(fs_path);
+        index_unlink(registry, entry);
+        registry->drops++;
+        log_debug("CAS DROP: removed key '%s' to stay within %zu bytes", entry->key,
+                  registry->max_bytes);
+        if (registry->on_drop) registry->on_drop(entry->key, registry->drop_ctx);
+        free(entry);
+    }
 }
 
-/* ========================================
- * static functions
- * ======================================== */
+static void entry_path(const cas_registry_t *registry, const char hash[65], char *path,
+                       size_t path_size) {
+    snprintf(path, path_size, "%s/%.16s/%.16s/%.16s/%.16s", registry->base_path, hash,
+             hash + 16, hash + 32, hash + 48);
+}
 
-static int cas_create_directory(const cas_registry_t *registry, const char *key,
+static int cas_create_directory(const cas_registry_t *registry, const char hash[65],
                                 char *output_path) {
-    if (!key) return -1;
-
-    char hash[65] = {'\0'};
-    sha256_string(key, hash);
     fs_path_t *fs_path = create_fs_path(hash);
+    if (!fs_path) return -1;
 
     char path[PATH_MAX] = {'\0'};
     sprintf(path, "%s/%s/%s/%s/%s", registry->base_path, fs_path->p[0], fs_path->p[1],
@@ -362,22 +764,93 @@ static int cas_remove(const cas_registry_t *registry, fs_path_t *fs_path) {
             fs_path->p[2], fs_path->p[3]);
     remove(path);
 
+    sprintf(path, "%s/%s/%s/%s/%s/time.dat", registry->base_path, fs_path->p[0], fs_path->p[1],
+            fs_path->p[2], fs_path->p[3]);
+    remove(path);
+
+    sprintf(path, "%s/%s/%s/%s/%s/key.dat", registry->base_path, fs_path->p[0], fs_path->p[1],
+            fs_path->p[2], fs_path->p[3]);
+    remove(path);
+
     sprintf(path, "%s/%s/%s/%s/%s", registry->base_path, fs_path->p[0], fs_path->p[1],
             fs_path->p[2], fs_path->p[3]);
     if (remove(path) != 0) return -1;
 
-    sprintf(path, "%s/%s/%s/%s", registry->base_path, fs_path->p[0], fs_path->p[1], fs_path->p[2]);
-    if (remove(path) != 0) return -1;
+    // le directory intermedie possono essere condivise con altre chiavi: ci si ferma alla
+    // prima non vuota
+    const char *patterns[] = {"%s/%s/%s/%s", "%s/%s/%s", "%s/%s"};
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), patterns[i], registry->base_path, fs_path->p[0],
+                 fs_path->p[1], fs_path->p[2]);
+        if (remove(path) != 0) break;
+    }
 
-    sprintf(path, "%s/%s/%s", registry->base_path, fs_path->p[0], fs_path->p[1]);
-    if (remove(path) != 0) return -1;
+    return 0;
+}
 
-    sprintf(path, "%s/%s", registry->base_path, fs_path->p[0]);
-    if (remove(path) != 0) return -1;
+// rimuove una entry scritta a metà, così un volume pieno non lascia directory orfane
+static void discard_entry(const char *entry_path) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/value.dat", entry_path);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/time.dat", entry_path);
+    remove(path);
+    snprintf(path, sizeof(path), "%s/key.dat", entry_path);
+    remove(path);
+    remove(entry_path);
+}
 
+// apre in lettura i file di una entry: 0, -1 se uno manca (nessun file resta aperto)
+static int open_files(const char *entry_path, const char **names, size_t count, int *fds) {
+    for (size_t i = 0; i < count; i++) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", entry_path, names[i]);
+        fds[i] = open(path, O_RDONLY | O_CLOEXEC);
+        if (fds[i] >= 0) continue;
+        while (i > 0) close(fds[--i]);
+        return -1;
+    }
     return 0;
 }
 
+/* legge per intero i file aperti con open_files con una sola sottomissione al motore di I/O e
+ * li chiude; ogni buffer ha un byte in più per terminare la chiave. 0, -1 se un file non è
+ * leggibile */
+static int read_files(cas_registry_t *registry, const int *fds, size_t count, void **buffers,
+                      size_t *sizes) {
+    disk_io_request_t requests[ENTRY_FILES];
+    if (count > ENTRY_FILES) return -1;
+
+    int result = 0;
+    for (size_t i = 0; i < count; i++) {
+        buffers[i] = NULL;
+        struct stat st;
+        if (result == 0 && fstat(fds[i], &st) == 0) buffers[i] = malloc((size_t)st.st_size + 1);
+        if (!buffers[i]) {
+            result = -1;
+            continue;
+        }
+        sizes[i] = (size_t)st.st_size;
+        requests[i] = (disk_io_request_t){.op = DISK_IO_READ,
+                                          .fd = fds[i],
+                                          .buffer = buffers[i],
+                                          .len = (size_t)st.st_size,
+                                          .offset = 0};
+    }
+
+    if (result == 0 && disk_io_submit(registry->io, requests, count) != 0) result = -1;
+    for (size_t i = 0; i < count; i++) {
+        close(fds[i]);
+        if (result == 0) {
+            ((char *)buffers[i])[sizes[i]] = '\0';
+        } else {
+            free(buffers[i]);
+            buffers[i] = NULL;
+        }
+    }
+    return result;
+}
+
 static int return_and_free(int result, fs_path_t *path) {
     free_path(path);
     return result;
@@ -407,15 +880,6 @@ static fs_path_t *create_fs_path(const char hash[65]) {
     return r;
 }
 
-static char *get_path(const cas_registry_t *registry, const fs_path_t *path) {
-    char *r = calloc(1, 512);
-    if (!r) return NULL;
-
-    sprintf(r, "%s/%s/%s/%s/%s", registry->base_path, path->p[0], path->p[1], path->p[2],
-            path->p[3]);
-    return r;
-}
-
 static void free_path(fs_path_t *path) {
     if (!path) return;
 
@@ -452,6 +916,8 @@ int cleanup(const char *path) {
 
     dir = opendir(path);
     if (dir == NULL) {
+        // nessuna demotion: la directory del registry non è mai stata creata
+        if (errno == ENOENT) return 0;
         perror("opendir");
         return -1;
     }
@@ -0,0 +1,253 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/client_output.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include "../include/clogger.h"
+
+#define OUTPUT_MAX_IOV 64 // blocchi inviati con una sola sendmsg
+
+struct output_chunk {
+    output_chunk_t *next;
+    pod_cache_handle_t handle; // valore in prestito; value NULL per i blocchi con dati propri
+    const char *data;          // handle.value oppure buffer
+    size_t len;
+    size_t sent;
+    size_t capacity;           // solo per i blocchi con dati propri
+    char buffer[];
+};
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static output_chunk_t *append_chunk(client_output_t *out, size_t capacity);
+static void release_chunk(client_output_t *out, output_chunk_t *chunk);
+static int account(client_output_t *out, size_t len);
+static int check_soft_limit(client_output_t *out);
+static time_t monotonic_seconds(void);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+void client_output_init(client_output_t *out, int socket_fd, const client_output_limits_t *limits) {
+    memset(out, 0, sizeof(*out));
+    out->socket_fd = socket_fd;
+    if (limits) out->limits = *limits;
+}
+
+void client_output_free(client_output_t *out) {
+    output_chunk_t *chunk = out->head;
+    while (chunk) {
+        output_chunk_t *next = chunk->next;
+        if (chunk->handle.value) pod_cache_release(&chunk->handle);
+        free(chunk);
+        chunk = next;
+    }
+    for (chunk = out->free_refs; chunk;) {
+        output_chunk_t *next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    free(out->spare);
+    out->head = out->tail = out->spare = out->free_refs = NULL;
+    out->free_ref_count = 0;
+    out->pending = 0;
+}
+
+int client_output_write(client_output_t *out, const void *data, size_t len) {
+    struct iovec part = {.iov_base = (void *)data, .iov_len = len};
+    return client_output_writev(out, &part, 1);
+}
+
+int client_output_writev(client_output_t *out, const struct iovec *parts, int count) {
+    size_t len = 0;
+    for (int i = 0; i < count; i++) len += parts[i].iov_len;
+    if (len == 0) return 0;
+    if (account(out, len) != 0) return -1;
+
+    // le risposte piccole vengono unite nell'ultimo blocco, se ha ancora spazio
+    output_chunk_t *tail = out->tail;
+    if (!tail || tail->handle.value || tail->capacity - tail->len < len) {
+        tail = append_chunk(out, len > CLIENT_OUTPUT_CHUNK_SIZE ? len : CLIENT_OUTPUT_CHUNK_SIZE);
+        if (!tail) return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        memcpy(tail->buffer + tail->len, parts[i].iov_base, parts[i].iov_len);
+        tail->len += parts[i].iov_len;
+    }
+    return 0;
+}
+
+int client_output_write_value(client_output_t *out, pod_cache_handle_t *handle) {
+    if (handle->size <= CLIENT_OUTPUT_COPY_MAX) {
+        int result = client_output_write(out, handle->value, handle->size);
+        pod_cache_release(handle);
+        return result;
+    }
+    if (account(out, handle->size) != 0) {
+        pod_cache_release(handle);
+        return -1;
+    }
+    output_chunk_t *chunk = append_chunk(out, 0);
+    if (!chunk) {
+        pod_cache_release(handle);
+        return -1;
+    }
+    chunk->handle = *handle;
+    chunk->data = handle->value;
+    chunk->len = handle->size;
+    handle->value = NULL;
+    handle->size = 0;
+    return 0;
+}
+
+int client_output_flush(client_output_t *out) {
+    if (out->overflow) return -1;
+
+    while (out->head) {
+        struct iovec iov[OUTPUT_MAX_IOV];
+        int count = 0;
+        for (output_chunk_t *chunk = out->head; chunk && count < OUTPUT_MAX_IOV;
+             chunk = chunk->next) {
+            iov[count].iov_base = (void *)(chunk->data + chunk->sent);
+            iov[count].iov_len = chunk->len - chunk->sent;
+            count++;
+        }
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = (size_t)count};
+        ssize_t n = sendmsg(out->socket_fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+
+        // invio parziale: i blocchi completati vengono liberati, l'ultimo riprende da sent
+        out->pending -= (size_t)n;
+        while (n > 0) {
+            output_chunk_t *chunk = out->head;
+            size_t left = chunk->len - chunk->sent;
+            if ((size_t)n < left) {
+                chunk->sent += (size_t)n;
+                break;
+            }
+            n -= (ssize_t)left;
+            out->head = chunk->next;
+            if (!out->head) out->tail = NULL;
+            release_chunk(out, chunk);
+        }
+    }
+    return check_soft_limit(out);
+}
+
+int client_output_drain(client_output_t *out, int timeout_ms) {
+    time_t deadline = monotonic_seconds() + (timeout_ms + 999) / 1000;
+    while (out->head) {
+        if (client_output_flush(out) != 0) return -1;
+        if (!out->head) break;
+        if (monotonic_seconds() > deadline) return -1;
+        struct pollfd pfd = {.fd = out->socket_fd, .events = POLLOUT};
+        if (poll(&pfd, 1, timeout_ms) < 0 && errno != EINTR) return -1;
+    }
+    return 0;
+}
+
+size_t client_output_pending(const client_output_t *out) { return out->pending; }
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+// a regime i blocchi vengono dai liberi: nessuna malloc per risposta
+static output_chunk_t *append_chunk(client_output_t *out, size_t capacity) {
+    output_chunk_t *chunk = NULL;
+    if (capacity == 0 && out->free_refs) {
+        chunk = out->free_refs;
+        out->free_refs = chunk->next;
+        out->free_ref_count--;
+    } else if (capacity > 0 && capacity <= CLIENT_OUTPUT_CHUNK_SIZE && out->spare) {
+        chunk = out->spare;
+        out->spare = NULL;
+        capacity = CLIENT_OUTPUT_CHUNK_SIZE;
+    } else {
+        chunk = malloc(sizeof(output_chunk_t) + capacity);
+    }
+    if (!chunk) {
+        log_error("Out of memory for client output");
+        out->overflow = true;
+        return NULL;
+    }
+    chunk->next = NULL;
+    chunk->handle = (pod_cache_handle_t){0};
+    chunk->data = chunk->buffer;
+    chunk->len = 0;
+    chunk->sent = 0;
+    chunk->capacity = capacity;
+    if (out->tail) out->tail->next = chunk;
+    else out->head = chunk;
+    out->tail = chunk;
+    return chunk;
+}
+
+// blocco inviato: tenuto tra i liberi se c'è posto, altrimenti liberato
+static void release_chunk(client_output_t *out, output_chunk_t *chunk) {
+    if (chunk->handle.value) {
+        pod_cache_release(&chunk->handle);
+        if (out->free_ref_count < OUTPUT_MAX_IOV) {
+            chunk->next = out->free_refs;
+            out->free_refs = chunk;
+            out->free_ref_count++;
+            return;
+        }
+    } else if (chunk->capacity == CLIENT_OUTPUT_CHUNK_SIZE && !out->spare) {
+        out->spare = chunk;
+        return;
+    }
+    free(chunk);
+}
+
+// conta i byte in coda e applica il limite hard
+static int account(client_output_t *out, size_t len) {
+    if (out->overflow) return -1;
+    if (out->limits.hard_limit && out->pending + len > out->limits.hard_limit) {
+        log_warn("Client output of %zu bytes over the hard limit (%zu): closing connection",
+                 out->pending + len, out->limits.hard_limit);
+        out->overflow = true;
+        return -1;
+    }
+    out->pending += len;
+    return 0;
+}
+
+static int check_soft_limit(client_output_t *out) {
+    if (!out->limits.soft_limit || out->pending <= out->limits.soft_limit) {
+        out->soft_since = 0;
+        return 0;
+    }
+    time_t now = monotonic_seconds();
+    if (out->soft_since == 0) {
+        out->soft_since = now;
+    } else if (now - out->soft_since >= out->limits.soft_seconds) {
+        log_warn("Client output over the soft limit (%zu bytes) for %d seconds: closing "
+                 "connection", out->limits.soft_limit, out->limits.soft_seconds);
+        out->overflow = true;
+        return -1;
+    }
+    return 0;
+}
+
+static time_t monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1; // mai 0: soft_since == 0 vuol dire sotto il limite
+}
@@ -0,0 +1,868 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/cluster.h"
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+#include "../include/hash_func.h"
+
+#define CLUSTER_INITIAL_BUCKETS 1024
+#define CLUSTER_HOST_SIZE 256
+
+typedef struct {
+    char id[CLUSTER_ID_SIZE + 1];
+    char host[CLUSTER_HOST_SIZE];
+    int port;
+} cluster_node_t;
+
+// chiave presente in cache: catena del bucket più lista doppia dello slot
+typedef struct slot_key {
+    struct slot_key *next;
+    struct slot_key *slot_prev;
+    struct slot_key *slot_next;
+    uint32_t hash;
+    uint16_t slot;
+    char key[];
+} slot_key_t;
+
+// risposta RESP costruita incrementalmente
+typedef struct {
+    char *data;
+    size_t len;
+    size_t capacity;
+    bool failed;
+} reply_t;
+
+/* topologia: letta da ogni comando su una chiave, modificata solo da MEET/SETSLOT.
+ * Ordine dei lock: topology_lock prima di index_mutex */
+static pthread_rwlock_t topology_lock = PTHREAD_RWLOCK_INITIALIZER;
+static cluster_node_t nodes[CLUSTER_MAX_NODES];
+static int node_count = 0;
+static int myself = -1;
+static int16_t slot_owner[CLUSTER_SLOTS];
+static int16_t migrating_to[CLUSTER_SLOTS];
+static int16_t importing_from[CLUSTER_SLOTS];
+static char config_file[512];
+static bool enabled = false;
+
+// indice chiavi -> slot, aggiornato dal listener con la partizione della cache bloccata
+static pthread_mutex_t index_mutex = PTHREAD_MUTEX_INITIALIZER;
+static slot_key_t **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t key_count = 0;
+static slot_key_t *slot_keys[CLUSTER_SLOTS];
+static uint32_t slot_key_count[CLUSTER_SLOTS];
+
+static uint16_t crc16_table[256];
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static void init_crc16_table(void);
+static uint16_t crc16(const char *buf, size_t len);
+static int parse_host_port(const char *value, char *host, size_t host_size, int *port);
+static int add_node(const char *host, int port);
+static int find_node(const char *id);
+static void node_id(const char *host, int port, char *out);
+static int load_config(const char *path);
+static int save_config(void);
+static slot_key_t *find_key(const char *key, uint32_t key_hash);
+static void index_add(const char *key);
+static void index_remove(const char *key);
+static int grow_buckets(void);
+static void reply_append(reply_t *reply, const char *format, ...);
+static void reply_write(reply_t *reply, const void *data, size_t len);
+static char *reply_finish(reply_t *reply, size_t *len);
+static int connect_node(const char *host, int port, int timeout_ms);
+static int send_all(int socket_fd, const void *data, size_t len);
+static int read_replies(int socket_fd, int count);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+int cluster_init(const char *node_list, const char *announce, int port, const char *config_path) {
+    init_crc16_table();
+    for (int s = 0; s < CLUSTER_SLOTS; s++) {
+        slot_owner[s] = -1;
+        migrating_to[s] = -1;
+        importing_from[s] = -1;
+    }
+    snprintf(config_file, sizeof(config_file), "%s", config_path ? config_path : "");
+
+    // la configurazione salvata conserva MEET e migrazioni fatte prima di un riavvio
+    int loaded = config_file[0] ? load_config(config_file) : 0;
+    if (loaded < 0) return -1;
+    if (loaded == 0) {
+        char *list = strdup(node_list ? node_list : "");
+        if (!list) return -1;
+        char *save = NULL;
+        for (char *item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+            char host[CLUSTER_HOST_SIZE];
+            int node_port;
+            if (parse_host_port(item, host, sizeof(host), &node_port) != 0 ||
+                add_node(host, node_port) < 0) {
+                log_error("Cluster: invalid node '%s'", item);
+                free(list);
+                return -1;
+            }
+        }
+        free(list);
+        if (node_count == 0) {
+            log_error("Cluster: empty node list");
+            return -1;
+        }
+        // slot divisi in parti uguali nell'ordine della lista: uguale su tutti i nodi
+        for (int s = 0; s < CLUSTER_SLOTS; s++) {
+            slot_owner[s] = (int16_t)((long)s * node_count / CLUSTER_SLOTS);
+        }
+    }
+
+    if (announce && *announce) {
+        char host[CLUSTER_HOST_SIZE];
+        int announce_port;
+        char id[CLUSTER_ID_SIZE + 1];
+        if (parse_host_port(announce, host, sizeof(host), &announce_port) != 0) {
+            log_error("Cluster: invalid announce address '%s'", announce);
+            return -1;
+        }
+        node_id(host, announce_port, id);
+        myself = find_node(id);
+    } else {
+        for (int i = 0; i < node_count && myself < 0; i++) {
+            if (nodes[i].port == port) myself = i;
+        }
+    }
+    if (myself < 0) {
+        log_error("Cluster: this instance is not in the node list");
+        return -1;
+    }
+
+    buckets = calloc(CLUSTER_INITIAL_BUCKETS, sizeof(slot_key_t *));
+    if (!buckets) return -1;
+    bucket_count = CLUSTER_INITIAL_BUCKETS;
+    enabled = true;
+    if (config_file[0]) save_config();
+
+    log_info("Cluster mode: node %s (%s:%d), %d known nodes", nodes[myself].id,
+             nodes[myself].host, nodes[myself].port, node_count);
+    return 0;
+}
+
+bool cluster_enabled(void) { return enabled; }
+
+void cluster_shutdown(void) {
+    pthread_mutex_lock(&index_mutex);
+    for (size_t i = 0; i < bucket_count; i++) {
+        slot_key_t *entry = buckets[i];
+        while (entry) {
+            slot_key_t *next = entry->next;
+            free(entry);
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    key_count = 0;
+    memset(slot_keys, 0, sizeof(slot_keys));
+    memset(slot_key_count, 0, sizeof(slot_key_count));
+    pthread_mutex_unlock(&index_mutex);
+}
+
+uint16_t cluster_keyslot(const char *key, size_t len) {
+    // hash tag: se la chiave contiene {...} non vuoto conta solo quella parte
+    const char *open = memchr(key, '{', len);
+    if (open) {
+        size_t rest = len - (size_t)(open - key) - 1;
+        const char *close = memchr(open + 1, '}', rest);
+        if (close && close > open + 1) {
+            return crc16(open + 1, (size_t)(close - open - 1)) & (CLUSTER_SLOTS - 1);
+        }
+    }
+    return crc16(key, len) & (CLUSTER_SLOTS - 1);
+}
+
+cluster_route_e cluster_route(const char *key, bool asking, int *slot, char *target,
+                              size_t target_size) {
+    int s = cluster_keyslot(key, strlen(key));
+    *slot = s;
+
+    pthread_rwlock_rdlock(&topology_lock);
+    int owner = slot_owner[s];
+    int redirect = -1;
+    cluster_route_e route = CLUSTER_ROUTE_LOCAL;
+    if (owner < 0) {
+        route = CLUSTER_ROUTE_DOWN;
+    } else if (owner == myself) {
+        // slot in uscita: le chiavi già spostate (o nuove) vanno chieste al nodo di destinazione
+        if (migrating_to[s] >= 0) {
+            pthread_mutex_lock(&index_mutex);
+            bool present = find_key(key, hash(key)) != NULL;
+            pthread_mutex_unlock(&index_mutex);
+            if (!present) {
+                route = CLUSTER_ROUTE_ASK;
+                redirect = migrating_to[s];
+            }
+        }
+    } else if (!(asking && importing_from[s] >= 0)) {
+        route = CLUSTER_ROUTE_MOVED;
+        redirect = owner;
+    }
+    if (redirect >= 0) {
+        snprintf(target, target_size, "%s:%d", nodes[redirect].host, nodes[redirect].port);
+    }
+    pthread_rwlock_unlock(&topology_lock);
+    return route;
+}
+
+void cluster_key_listener(pod_cache_event_e event, const char *key, const void *value,
+                          size_t size, void *ctx) {
+    (void)value;
+    (void)size;
+    (void)ctx;
+    // demotion e promozione non cambiano l'insieme delle chiavi del nodo
+    if (event == POD_CACHE_EVENT_PUT) {
+        index_add(key);
+    } else if (event == POD_CACHE_EVENT_DELETE) {
+        index_remove(key);
+    }
+}
+
+size_t cluster_count_keys_in_slot(int slot) {
+    pthread_mutex_lock(&index_mutex);
+    size_t count = slot_key_count[slot];
+    pthread_mutex_unlock(&index_mutex);
+    return count;
+}
+
+int cluster_get_keys_in_slot(int slot, size_t max, char ***keys) {
+    pthread_mutex_lock(&index_mutex);
+    size_t count = slot_key_count[slot] < max ? slot_key_count[slot] : max;
+    char **out = malloc((count ? count : 1) * sizeof(char *));
+    if (!out) {
+        pthread_mutex_unlock(&index_mutex);
+        return -1;
+    }
+    size_t n = 0;
+    for (slot_key_t *entry = slot_keys[slot]; entry && n < count; entry = entry->slot_next) {
+        out[n] = strdup(entry->key);
+        if (!out[n]) break;
+        n++;
+    }
+    pthread_mutex_unlock(&index_mutex);
+    *keys = out;
+    return (int)n;
+}
+
+int cluster_meet(const char *host, int port) {
+    pthread_rwlock_wrlock(&topology_lock);
+    int index = add_node(host, port);
+    if (index >= 0) save_config();
+    pthread_rwlock_unlock(&topology_lock);
+    if (index >= 0) log_info("Cluster: meet %s:%d (%s)", host, port, nodes[index].id);
+    return index >= 0 ? 0 : -1;
+}
+
+int cluster_setslot(int slot, const char *action, const char *node, const char **error) {
+    pthread_rwlock_wrlock(&topology_lock);
+    int target = node ? find_node(node) : -1;
+    int result = -1;
+
+    if (strcasecmp(action, "STABLE") == 0) {
+        migrating_to[slot] = -1;
+        importing_from[slot] = -1;
+        result = 0;
+    } else if (target < 0) {
+        *error = "ERR I don't know about node";
+    } else if (strcasecmp(action, "MIGRATING") == 0) {
+        if (slot_owner[slot] != myself) {
+            *error = "ERR I'm not the owner of hash slot";
+        } else if (target == myself) {
+            *error = "ERR I can't migrate to myself";
+        } else {
+            migrating_to[slot] = (int16_t)target;
+            result = 0;
+        }
+    } else if (strcasecmp(action, "IMPORTING") == 0) {
+        if (slot_owner[slot] == myself) {
+            *error = "ERR I'm already the owner of hash slot";
+        } else if (target == myself) {
+            *error = "ERR I can't import from myself";
+        } else {
+            importing_from[slot] = (int16_t)target;
+            result = 0;
+        }
+    } else if (strcasecmp(action, "NODE") == 0) {
+        if (slot_owner[slot] == myself && target != myself && cluster_count_keys_in_slot(slot)) {
+            *error = "ERR Can't assign hashslot to a different node while I still hold keys "
+                     "for this hash slot";
+        } else {
+            slot_owner[slot] = (int16_t)target;
+            // la migrazione termina quando lo slot cambia proprietario
+            if (target == myself) importing_from[slot] = -1;
+            if (target != myself) migrating_to[slot] = -1;
+            save_config();
+            result = 0;
+        }
+    } else {
+        *error = "ERR Invalid CLUSTER SETSLOT action or number of arguments";
+    }
+    pthread_rwlock_unlock(&topology_lock);
+
+    if (result == 0) log_info("Cluster: SETSLOT %d %s %s", slot, action, node ? node : "");
+    return result;
+}
+
+const char *cluster_myid(void) { return myself >= 0 ? nodes[myself].id : ""; }
+
+char *cluster_format_slots(size_t *len) {
+    reply_t body = {0};
+    int ranges = 0;
+
+    pthread_rwlock_rdlock(&topology_lock);
+    for (int start = 0; start < CLUSTER_SLOTS;) {
+        int owner = slot_owner[start];
+        int end = start;
+        while (end + 1 < CLUSTER_SLOTS && slot_owner[end + 1] == owner) end++;
+        if (owner >= 0) {
+            const cluster_node_t *n = &nodes[owner];
+            reply_append(&body, "*3\r\n:%d\r\n:%d\r\n*3\r\n$%zu\r\n%s\r\n:%d\r\n$%d\r\n%s\r\n",
+                         start, end, strlen(n->host), n->host, n->port, CLUSTER_ID_SIZE, n->id);
+            ranges++;
+        }
+        start = end + 1;
+    }
+    pthread_rwlock_unlock(&topology_lock);
+
+    reply_t reply = {0};
+    reply_append(&reply, "*%d\r\n%.*s", ranges, (int)body.len, body.data ? body.data : "");
+    free(body.data);
+    return reply_finish(&reply, len);
+}
+
+char *cluster_format_shards(bool resp3, size_t *len) {
+    reply_t reply = {0};
+
+    pthread_rwlock_rdlock(&topology_lock);
+    reply_append(&reply, "*%d\r\n", node_count);
+    for (int i = 0; i < node_count; i++) {
+        const cluster_node_t *n = &nodes[i];
+        reply_t ranges = {0};
+        int bounds = 0;
+        for (int start = 0; start < CLUSTER_SLOTS;) {
+            int end = start;
+            while (end + 1 < CLUSTER_SLOTS && slot_owner[end + 1] == slot_owner[start]) end++;
+            if (slot_owner[start] == i) {
+                reply_append(&ranges, ":%d\r\n:%d\r\n", start, end);
+                bounds += 2;
+            }
+            start = end + 1;
+        }
+
+        // RESP3 usa mappe, RESP2 array di coppie chiave/valore
+        reply_append(&reply, "%s\r\n$5\r\nslots\r\n*%d\r\n%.*s$5\r\nnodes\r\n*1\r\n",
+                     resp3 ? "%2" : "*4", bounds, (int)ranges.len, ranges.data ? ranges.data : "");
+        reply_append(&reply,
+                     "%s\r\n$2\r\nid\r\n$%d\r\n%s\r\n$4\r\nport\r\n:%d\r\n"
+                     "$2\r\nip\r\n$%zu\r\n%s\r\n$8\r\nendpoint\r\n$%zu\r\n%s\r\n"
+                     "$4\r\nrole\r\n$6\r\nmaster\r\n$18\r\nreplication-offset\r\n:0\r\n"
+                     "$6\r\nhealth\r\n$6\r\nonline\r\n",
+                     resp3 ? "%7" : "*14", CLUSTER_ID_SIZE, n->id, n->port, strlen(n->host),
+                     n->host, strlen(n->host), n->host);
+        free(ranges.data);
+    }
+    pthread_rwlock_unlock(&topology_lock);
+    return reply_finish(&reply, len);
+}
+
+char *cluster_format_nodes(size_t *len) {
+    reply_t body = {0};
+
+    pthread_rwlock_rdlock(&topology_lock);
+    for (int i = 0; i < node_count; i++) {
+        const cluster_node_t *n = &nodes[i];
+        reply_append(&body, "%s %s:%d@%d %smaster - 0 0 1 connected", n->id, n->host, n->port,
+                     n->port + 10000, i == myself ? "myself," : "");
+        for (int start = 0; start < CLUSTER_SLOTS;) {
+            int end = start;
+            while (end + 1 < CLUSTER_SLOTS && slot_owner[end + 1] == slot_owner[start]) end++;
+            if (slot_owner[start] == i) {
+                if (start == end) {
+                    reply_append(&body, " %d", start);
+                } else {
+                    reply_append(&body, " %d-%d", start, end);
+                }
+            }
+            start = end + 1;
+        }
+        // come Redis, le migrazioni in corso compaiono solo nella riga del nodo locale
+        if (i == myself) {
+            for (int s = 0; s < CLUSTER_SLOTS; s++) {
+                if (migrating_to[s] >= 0) {
+                    reply_append(&body, " [%d->-%s]", s, nodes[migrating_to[s]].id);
+                }
+                if (importing_from[s] >= 0) {
+                    reply_append(&body, " [%d-<-%s]", s, nodes[importing_from[s]].id);
+                }
+            }
+        }
+        reply_append(&body, "\n");
+    }
+    pthread_rwlock_unlock(&topology_lock);
+
+    reply_t reply = {0};
+    reply_append(&reply, "$%zu\r\n%.*s\r\n", body.len, (int)body.len, body.data ? body.data : "");
+    free(body.data);
+    return reply_finish(&reply, len);
+}
+
+char *cluster_format_info(size_t *len) {
+    int assigned = 0;
+    bool owners[CLUSTER_MAX_NODES] = {false};
+    int size = 0;
+
+    pthread_rwlock_rdlock(&topology_lock);
+    for (int s = 0; s < CLUSTER_SLOTS; s++) {
+        if (slot_owner[s] < 0) continue;
+        assigned++;
+        if (!owners[slot_owner[s]]) {
+            owners[slot_owner[s]] = true;
+            size++;
+        }
+    }
+    int known = node_count;
+    pthread_rwlock_unlock(&topology_lock);
+
+    char body[512];
+    int body_len = snprintf(body, sizeof(body),
+                            "cluster_enabled:1\r\ncluster_state:%s\r\n"
+                            "cluster_slots_assigned:%d\r\ncluster_slots_ok:%d\r\n"
+                            "cluster_slots_pfail:0\r\ncluster_slots_fail:0\r\n"
+                            "cluster_known_nodes:%d\r\ncluster_size:%d\r\n"
+                            "cluster_current_epoch:1\r\ncluster_my_epoch:1\r\n",
+                            assigned == CLUSTER_SLOTS ? "ok" : "fail", assigned, assigned, known,
+                            size);
+    reply_t reply = {0};
+    reply_append(&reply, "$%d\r\n%s\r\n", body_len, body);
+    return reply_finish(&reply, len);
+}
+
+int cluster_migrate(pod_cache_t *cache, const char *host, int port, char **keys, int count,
+                    bool copy, int timeout_ms) {
+    // i valori restano in place fino al confronto finale, senza copie
+    pod_cache_handle_t *handles =
+        calloc(count > 0 ? (size_t)count : 1, sizeof(pod_cache_handle_t));
+    reply_t request = {0};
+    int found = 0;
+    if (!handles) return -1;
+
+    // ASKING: il nodo di destinazione accetta la chiave anche se lo slot non è ancora suo
+    for (int i = 0; i < count; i++) {
+        if (pod_cache_borrow(cache, keys[i], &handles[i]) != 0) {
+            handles[i].value = NULL; // già rimossa
+            continue;
+        }
+        reply_append(&request, "*1\r\n$6\r\nASKING\r\n*3\r\n$3\r\nSET\r\n$%zu\r\n%s\r\n$%zu\r\n",
+                     strlen(keys[i]), keys[i], handles[i].size);
+        reply_write(&request, handles[i].value, handles[i].size);
+        reply_write(&request, "\r\n", 2);
+        found++;
+    }
+
+    // tutto il blocco in una scrittura, poi le risposte: un solo round trip per MIGRATE
+    int result = found;
+    if (found > 0) {
+        int socket_fd = request.failed ? -1 : connect_node(host, port, timeout_ms);
+        if (socket_fd < 0) {
+            result = CLUSTER_MIGRATE_IOERR;
+        } else {
+            if (send_all(socket_fd, request.data, request.len) != 0) {
+                result = CLUSTER_MIGRATE_IOERR;
+            } else {
+                result = read_replies(socket_fd, found * 2);
+                if (result == 0) result = found;
+            }
+            close(socket_fd);
+        }
+    }
+
+    /* la chiave resta anche se è stata modificata nel frattempo: lo slot non può cambiare
+     * proprietario finché il nodo ha chiavi, e la migrazione la ritenterà */
+    for (int i = 0; i < count; i++) {
+        if (!handles[i].value) continue;
+        if (result > 0 && !copy) {
+            pod_cache_handle_t current;
+            if (pod_cache_borrow(cache, keys[i], &current) == 0) {
+                bool unchanged = current.size == handles[i].size &&
+                                 memcmp(current.value, handles[i].value, current.size) == 0;
+                pod_cache_release(&current);
+                if (unchanged) pod_cache_evict(cache, keys[i]);
+            }
+        }
+        pod_cache_release(&handles[i]);
+    }
+    if (result < 0) log_warn("Cluster: MIGRATE of %d keys to %s:%d failed", found, host, port);
+    free(handles);
+    free(request.data);
+    return result;
+}
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+// CRC16-CCITT (XMODEM), lo stesso di Redis Cluster
+static void init_crc16_table(void) {
+    for (int i = 0; i < 256; i++) {
+        uint16_t crc = (uint16_t)(i << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+        crc16_table[i] = crc;
+    }
+}
+
+static uint16_t crc16(const char *buf, size_t len) {
+    uint16_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = (uint16_t)((crc << 8) ^ crc16_table[((crc >> 8) ^ (uint8_t)buf[i]) & 0xff]);
+    }
+    return crc;
+}
+
+static int parse_host_port(const char *value, char *host, size_t host_size, int *port) {
+    while (*value == ' ') value++;
+    const char *colon = strrchr(value, ':');
+    if (!colon || colon == value || (size_t)(colon - value) >= host_size) return -1;
+    char *endptr;
+    long parsed = strtol(colon + 1, &endptr, 10);
+    if (endptr == colon + 1 || (*endptr != '\0' && *endptr != ' ') || parsed < 1 ||
+        parsed > 65535) {
+        return -1;
+    }
+    memcpy(host, value, (size_t)(colon - value));
+    host[colon - value] = '\0';
+    *port = (int)parsed;
+    return 0;
+}
+
+// restituisce l'indice del nodo (anche se già presente), -1 se la tabella è piena
+static int add_node(const char *host, int port) {
+    char id[CLUSTER_ID_SIZE + 1];
+    node_id(host, port, id);
+    int existing = find_node(id);
+    if (existing >= 0) return existing;
+    if (node_count == CLUSTER_MAX_NODES || strlen(host) >= CLUSTER_HOST_SIZE) return -1;
+
+    cluster_node_t *n = &nodes[node_count];
+    memcpy(n->id, id, sizeof(n->id));
+    snprintf(n->host, sizeof(n->host), "%s", host);
+    n->port = port;
+    return node_count++;
+}
+
+static int find_node(const char *id) {
+    for (int i = 0; i < node_count; i++) {
+        if (strcasecmp(nodes[i].id, id) == 0) return i;
+    }
+    return -1;
+}
+
+// id stabile derivato dall'indirizzo: tutti i nodi lo calcolano senza scambiarselo
+static void node_id(const char *host, int port, char *out) {
+    char address[CLUSTER_HOST_SIZE + 8];
+    char digest[65];
+    snprintf(address, sizeof(address), "%s:%d", host, port);
+    sha256_string(address, digest);
+    memcpy(out, digest, CLUSTER_ID_SIZE);
+    out[CLUSTER_ID_SIZE] = '\0';
+}
+
+/* formato: "node <host> <port>" e "slots <inizio> <fine> <id>", una voce per riga.
+ * Restituisce 1 se caricata, 0 se il file non esiste, -1 se non è valido */
+static int load_config(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) return 0;
+
+    char line[512];
+    int result = 1;
+    while (fgets(line, sizeof(line), file)) {
+        char host[CLUSTER_HOST_SIZE];
+        char id[CLUSTER_ID_SIZE + 1];
+        int port, start, end;
+        if (line[0] == '#' || line[0] == '\n') continue;
+        if (sscanf(line, "node %255s %d", host, &port) == 2) {
+            if (add_node(host, port) < 0) result = -1;
+        } else if (sscanf(line, "slots %d %d %40s", &start, &end, id) == 3) {
+            int owner = find_node(id);
+            if (owner < 0 || start < 0 || end >= CLUSTER_SLOTS || start > end) {
+                result = -1;
+                continue;
+            }
+            for (int s = start; s <= end; s++) slot_owner[s] = (int16_t)owner;
+        } else {
+            result = -1;
+        }
+    }
+    fclose(file);
+    if (result < 0) log_error("Cluster: invalid configuration file %s", path);
+    else log_info("Cluster: configuration loaded from %s", path);
+    return result;
+}
+
+// riscrive la configurazione (file temporaneo + rename); chiamata con topology_lock in scrittura
+static int save_config(void) {
+    if (!config_file[0]) return 0;
+
+    char tmp_path[sizeof(config_file) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", config_file);
+    FILE *file = fopen(tmp_path, "w");
+    if (!file) {
+        log_warn("Cluster: cannot write %s: %s", tmp_path, strerror(errno));
+        return -1;
+    }
+    fprintf(file, "# podcache cluster configuration, rewritten on MEET and SETSLOT NODE\n");
+    for (int i = 0; i < node_count; i++) {
+        fprintf(file, "node %s %d\n", nodes[i].host, nodes[i].port);
+    }
+    for (int start = 0; start < CLUSTER_SLOTS;) {
+        int end = start;
+        while (end + 1 < CLUSTER_SLOTS && slot_owner[end + 1] == slot_owner[start]) end++;
+        if (slot_owner[start] >= 0) {
+            fprintf(file, "slots %d %d %s\n", start, end, nodes[slot_owner[start]].id);
+        }
+        start = end + 1;
+    }
+    if (fclose(file) != 0 || rename(tmp_path, config_file) != 0) {
+        log_warn("Cluster: cannot save %s: %s", config_file, strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+static slot_key_t *find_key(const char *key, uint32_t key_hash) {
+    for (slot_key_t *entry = buckets[key_hash & (bucket_count - 1)]; entry; entry = entry->next) {
+        if (entry->hash == key_hash && strcmp(entry->key, key) == 0) return entry;
+    }
+    return NULL;
+}
+
+static void index_add(const char *key) {
+    size_t len = strlen(key);
+    uint32_t key_hash = hash(key);
+    uint16_t slot = cluster_keyslot(key, len);
+
+    pthread_mutex_lock(&index_mutex);
+    if (!buckets || find_key(key, key_hash)) {
+        pthread_mutex_unlock(&index_mutex);
+        return;
+    }
+    if (key_count >= bucket_count && grow_buckets() != 0) {
+        log_warn("Cluster: failed to grow the key index");
+    }
+    slot_key_t *entry = malloc(sizeof(slot_key_t) + len + 1);
+    if (!entry) {
+        pthread_mutex_unlock(&index_mutex);
+        log_error("Cluster: failed to index key '%s'", key);
+        return;
+    }
+    memcpy(entry->key, key, len + 1);
+    entry->hash = key_hash;
+    entry->slot = slot;
+    size_t bucket = key_hash & (bucket_count - 1);
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    entry->slot_prev = NULL;
+    entry->slot_next = slot_keys[slot];
+    if (slot_keys[slot]) slot_keys[slot]->slot_prev = entry;
+    slot_keys[slot] = entry;
+    slot_key_count[slot]++;
+    key_count++;
+    pthread_mutex_unlock(&index_mutex);
+}
+
+static void index_remove(const char *key) {
+    uint32_t key_hash = hash(key);
+
+    pthread_mutex_lock(&index_mutex);
+    if (!buckets) {
+        pthread_mutex_unlock(&index_mutex);
+        return;
+    }
+    for (slot_key_t **it = &buckets[key_hash & (bucket_count - 1)]; *it; it = &(*it)->next) {
+        slot_key_t *entry = *it;
+        if (entry->hash != key_hash || strcmp(entry->key, key) != 0) continue;
+
+        *it = entry->next;
+        if (entry->slot_prev) entry->slot_prev->slot_next = entry->slot_next;
+        else slot_keys[entry->slot] = entry->slot_next;
+        if (entry->slot_next) entry->slot_next->slot_prev = entry->slot_prev;
+        slot_key_count[entry->slot]--;
+        key_count--;
+        free(entry);
+        break;
+    }
+    pthread_mutex_unlock(&index_mutex);
+}
+
+static int grow_buckets(void) {
+    size_t new_count = bucket_count * 2;
+    slot_key_t **grown = calloc(new_count, sizeof(slot_key_t *));
+    if (!grown) return -1;
+
+    for (size_t i = 0; i < bucket_count; i++) {
+        slot_key_t *entry = buckets[i];
+        while (entry) {
+            slot_key_t *next = entry->next;
+            size_t bucket = entry->hash & (new_count - 1);
+            entry->next = grown[bucket];
+            grown[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = grown;
+    bucket_count = new_count;
+    return 0;
+}
+
+static void reply_append(reply_t *reply, const char *format, ...) {
+    if (reply->failed) return;
+
+    va_list args;
+    va_start(args, format);
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(NULL, 0, format, copy);
+    va_end(copy);
+    if (needed < 0) {
+        reply->failed = true;
+        va_end(args);
+        return;
+    }
+    if (reply->len + (size_t)needed + 1 > reply->capacity) {
+        size_t capacity = reply->capacity ? reply->capacity : 256;
+        while (capacity < reply->len + (size_t)needed + 1) capacity *= 2;
+        char *grown = realloc(reply->data, capacity);
+        if (!grown) {
+            reply->failed = true;
+            va_end(args);
+            return;
+        }
+        reply->data = grown;
+        reply->capacity = capacity;
+    }
+    vsnprintf(reply->data + reply->len, reply->capacity - reply->len, format, args);
+    reply->len += (size_t)needed;
+    va_end(args);
+}
+
+static void reply_write(reply_t *reply, const void *data, size_t len) {
+    if (reply->failed) return;
+    if (reply->len + len + 1 > reply->capacity) {
+        size_t capacity = reply->capacity ? reply->capacity : 256;
+        while (capacity < reply->len + len + 1) capacity *= 2;
+        char *grown = realloc(reply->data, capacity);
+        if (!grown) {
+            reply->failed = true;
+            return;
+        }
+        reply->data = grown;
+        reply->capacity = capacity;
+    }
+    memcpy(reply->data + reply->len, data, len);
+    reply->len += len;
+}
+
+static char *reply_finish(reply_t *reply, size_t *len) {
+    if (reply->failed || !reply->data) {
+        free(reply->data);
+        return NULL;
+    }
+    *len = reply->len;
+    return reply->data;
+}
+
+static int connect_node(const char *host, int port, int timeout_ms) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", port);
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(host, service, &hints, &result) != 0) return -1;
+
+    // il timeout di MIGRATE vale per ogni singola operazione di I/O
+    struct timeval timeout = {.tv_sec = timeout_ms / 1000, .tv_usec = (timeout_ms % 1000) * 1000};
+    int socket_fd = -1;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+        socket_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (socket_fd < 0) continue;
+        setsockopt(socket_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(socket_fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(socket_fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    freeaddrinfo(result);
+    if (socket_fd >= 0) {
+        int one = 1;
+        setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return socket_fd;
+}
+
+static int send_all(int socket_fd, const void *data, size_t len) {
+    const char *bytes = data;
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(socket_fd, bytes + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+    return 0;
+}
+
+/* attende count risposte di stato (+OK): CLUSTER_MIGRATE_IOERR su errore o timeout,
+ * CLUSTER_MIGRATE_REFUSED se il nodo risponde con un errore */
+static int read_replies(int socket_fd, int count) {
+    char line[256];
+    size_t used = 0;
+    while (count > 0) {
+        ssize_t n = recv(socket_fd, line + used, sizeof(line) - used, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return CLUSTER_MIGRATE_IOERR;
+        used += (size_t)n;
+
+        char *end;
+        while (count > 0 && (end = memchr(line, '\n', used)) != NULL) {
+            if (line[0] != '+') return CLUSTER_MIGRATE_REFUSED;
+            size_t consumed = (size_t)(end - line) + 1;
+            memmove(line, line + consumed, used - consumed);
+            used -= consumed;
+            count--;
+        }
+        if (used == sizeof(line)) return CLUSTER_MIGRATE_IOERR;
+    }
+    return 0;
+}
@@ -0,0 +1,427 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/disk_io.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+
+#define DISK_IO_MAX_DEPTH 256
+
+#define DISK_IO_RINGS 4
+
+// un anello io_uring: code mappate dal kernel, usate da un solo thread alla volta
+typedef struct disk_ring {
+    pthread_mutex_t mutex;
+    int ring_fd;
+    unsigned entries;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_ring;
+    size_t sq_ring_size;
+    void *cq_ring; // coincide con sq_ring con IORING_FEAT_SINGLE_MMAP
+    size_t cq_ring_size;
+    size_t sqes_size;
+} disk_ring_t;
+
+struct disk_io {
+    disk_io_backend_e backend;
+
+    /* io_uring: più anelli indipendenti, così i gruppi sottomessi da thread diversi (partizioni
+     * diverse) restano in volo insieme invece di accodarsi uno dietro l'altro */
+    disk_ring_t rings[DISK_IO_RINGS];
+    int ring_count;
+    unsigned ring_next;
+
+    // pool di thread: un gruppo alla volta, consumato per indice
+    pthread_mutex_t submit_mutex; // occupato mentre il pool serve un gruppo
+    pthread_t *threads;
+    int thread_count;
+    pthread_mutex_t pool_mutex;
+    pthread_cond_t work_cond;
+    pthread_cond_t done_cond;
+    disk_io_request_t *batch;
+    size_t batch_count;
+    size_t batch_next;
+    size_t batch_pending;
+    bool stopping;
+};
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static int uring_setup(disk_ring_t *ring, unsigned queue_depth);
+static void uring_teardown(disk_ring_t *ring);
+static int uring_submit(disk_io_t *io, disk_io_request_t *requests, size_t count);
+static int ring_submit(disk_ring_t *ring, disk_io_request_t *requests, size_t count);
+static int pool_setup(disk_io_t *io, int threads);
+static void pool_teardown(disk_io_t *io);
+static int pool_submit(disk_io_t *io, disk_io_request_t *requests, size_t count);
+static void *pool_worker(void *arg);
+static bool pool_run_one(disk_io_t *io);
+static void transfer_sync(disk_io_request_t *request, size_t done);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+disk_io_t *disk_io_create(disk_io_backend_e backend, unsigned queue_depth, int threads) {
+    disk_io_t *io = calloc(1, sizeof(disk_io_t));
+    if (!io) return NULL;
+    pthread_mutex_init(&io->submit_mutex, NULL);
+
+    if (backend != DISK_IO_THREADS) {
+        // basta il primo anello: gli altri, se il kernel ne rifiuta qualcuno, sono un di più
+        while (io->ring_count < DISK_IO_RINGS &&
+               uring_setup(&io->rings[io->ring_count], queue_depth) == 0) {
+            io->ring_count++;
+        }
+        if (io->ring_count > 0) {
+            io->backend = DISK_IO_URING;
+            return io;
+        }
+        if (backend == DISK_IO_URING) {
+            log_error("io_uring not available: %s", strerror(errno));
+            pthread_mutex_destroy(&io->submit_mutex);
+            free(io);
+            return NULL;
+        }
+        log_info("io_uring not available (%s), disk I/O on a thread pool", strerror(errno));
+    }
+
+    if (pool_setup(io, threads) != 0) {
+        log_error("Failed to start the disk I/O thread pool");
+        pthread_mutex_destroy(&io->submit_mutex);
+        free(io);
+        return NULL;
+    }
+    io->backend = DISK_IO_THREADS;
+    return io;
+}
+
+void disk_io_destroy(disk_io_t *io) {
+    if (!io) return;
+    if (io->backend == DISK_IO_URING) {
+        for (int i = 0; i < io->ring_count; i++) uring_teardown(&io->rings[i]);
+    } else {
+        pool_teardown(io);
+    }
+    pthread_mutex_destroy(&io->submit_mutex);
+    free(io);
+}
+
+int disk_io_submit(disk_io_t *io, disk_io_request_t *requests, size_t count) {
+    if (!io || (!requests && count > 0)) return -1;
+    if (count == 0) return 0;
+
+    for (size_t i = 0; i < count; i++) requests[i].result = 0;
+    if (count == 1) {
+        // niente da sovrapporre: la richiesta singola la esegue chi aspetta, senza passaggi
+        transfer_sync(&requests[0], 0);
+        return requests[0].result == (ssize_t)requests[0].len ? 0 : -1;
+    }
+
+    int rc = io->backend == DISK_IO_URING ? uring_submit(io, requests, count)
+                                          : pool_submit(io, requests, count);
+    if (rc != 0) return -1;
+
+    for (size_t i = 0; i < count; i++) {
+        if (requests[i].result != (ssize_t)requests[i].len) return -1;
+    }
+    return 0;
+}
+
+const char *disk_io_backend_name(const disk_io_t *io) {
+    return io && io->backend == DISK_IO_URING ? "io_uring" : "threads";
+}
+
+/* =============================================
+ * io_uring
+ * ============================================= */
+
+static int uring_setup(disk_ring_t *ring, unsigned queue_depth) {
+    if (queue_depth == 0) queue_depth = 1;
+    if (queue_depth > DISK_IO_MAX_DEPTH) queue_depth = DISK_IO_MAX_DEPTH;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    int fd = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (fd < 0) return -1;
+    pthread_mutex_init(&ring->mutex, NULL);
+
+    ring->ring_fd = fd;
+    ring->entries = params.sq_entries;
+    ring->sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && ring->cq_ring_size > ring->sq_ring_size) {
+        ring->sq_ring_size = ring->cq_ring_size;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) goto fail;
+    if (single_mmap) {
+        ring->cq_ring = ring->sq_ring;
+    } else {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) goto fail;
+    }
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) goto fail;
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring->cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+    return 0;
+
+fail: {
+    int saved = errno;
+    uring_teardown(ring);
+    errno = saved;
+    return -1;
+}
+}
+
+static void uring_teardown(disk_ring_t *ring) {
+    if (ring->sqes && ring->sqes != MAP_FAILED) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ring && ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring && ring->sq_ring != MAP_FAILED) munmap(ring->sq_ring, ring->sq_ring_size);
+    if (ring->ring_fd >= 0) close(ring->ring_fd);
+    ring->sqes = NULL;
+    ring->sq_ring = ring->cq_ring = NULL;
+    ring->ring_fd = -1;
+    pthread_mutex_destroy(&ring->mutex);
+}
+
+/* il gruppo va sul primo anello libero; se sono tutti occupati aspetta il proprio turno su
+ * uno scelto a rotazione */
+static int uring_submit(disk_io_t *io, disk_io_request_t *requests, size_t count) {
+    disk_ring_t *ring = NULL;
+    for (int i = 0; i < io->ring_count && !ring; i++) {
+        if (pthread_mutex_trylock(&io->rings[i].mutex) == 0) ring = &io->rings[i];
+    }
+    if (!ring) {
+        unsigned next = __atomic_fetch_add(&io->ring_next, 1, __ATOMIC_RELAXED);
+        ring = &io->rings[next % (unsigned)io->ring_count];
+        pthread_mutex_lock(&ring->mutex);
+    }
+    int rc = ring_submit(ring, requests, count);
+    pthread_mutex_unlock(&ring->mutex);
+    return rc;
+}
+
+/* riempie la submission queue fino a entries richieste in volo e aspetta i completamenti;
+ * user_data è l'indice della richiesta. I trasferimenti parziali vengono completati alla fine
+ * con pread/pwrite */
+static int ring_submit(disk_ring_t *ring, disk_io_request_t *requests, size_t count) {
+    size_t next = 0, inflight = 0, completed = 0;
+    while (completed < count) {
+        unsigned tail = *ring->sq_tail;
+        while (next < count && inflight < ring->entries) {
+            disk_io_request_t *request = &requests[next];
+            request->iov.iov_base = request->buffer;
+            request->iov.iov_len = request->len;
+            unsigned index = tail & *ring->sq_mask;
+            struct io_uring_sqe *sqe = &ring->sqes[index];
+            memset(sqe, 0, sizeof(*sqe));
+            sqe->opcode = request->op == DISK_IO_READ ? IORING_OP_READV : IORING_OP_WRITEV;
+            sqe->fd = request->fd;
+            sqe->addr = (uint64_t)(uintptr_t)&request->iov;
+            sqe->len = 1;
+            sqe->off = (uint64_t)request->offset;
+            sqe->user_data = next;
+            ring->sq_array[index] = index;
+            tail++;
+            next++;
+            inflight++;
+        }
+        __atomic_store_n(ring->sq_tail, tail, __ATOMIC_RELEASE);
+
+        // le richieste non ancora prese dal kernel (anche dopo un EINTR) vengono risottomesse
+        unsigned to_submit = tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        int ret = (int)syscall(__NR_io_uring_enter, ring->ring_fd, to_submit, 1,
+                               IORING_ENTER_GETEVENTS, NULL, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            /* non si può tornare finché il kernel usa iovec e buffer delle richieste in volo, e
+             * le loro completion tardive finirebbero nel gruppo successivo. Le SQE non ancora
+             * prese vengono ritirate (senza SQPOLL il kernel legge la coda solo in
+             * io_uring_enter) e completate qui insieme alle altre mai sottomesse, poi si
+             * aspettano le completion di quelle già in volo */
+            log_error("io_uring_enter failed: %s, finishing the batch synchronously",
+                      strerror(errno));
+            unsigned sq_head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+            unsigned withdrawn = tail - sq_head;
+            __atomic_store_n(ring->sq_tail, sq_head, __ATOMIC_RELEASE);
+            inflight -= withdrawn;
+            for (size_t i = next - withdrawn; i < count; i++) transfer_sync(&requests[i], 0);
+            completed += count - (next - withdrawn);
+            next = count;
+        }
+
+        unsigned head = *ring->cq_head;
+        unsigned cq_tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+        while (head != cq_tail) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            requests[cqe->user_data].result = cqe->res;
+            head++;
+            inflight--;
+            completed++;
+        }
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ssize_t result = requests[i].result;
+        if (result > 0 && (size_t)result < requests[i].len) transfer_sync(&requests[i], result);
+    }
+    return 0;
+}
+
+/* =============================================
+ * thread pool
+ * ============================================= */
+
+static int pool_setup(disk_io_t *io, int threads) {
+    if (threads < 0) threads = 0;
+    pthread_mutex_init(&io->pool_mutex, NULL);
+    pthread_cond_init(&io->work_cond, NULL);
+    pthread_cond_init(&io->done_cond, NULL);
+    io->threads = threads > 0 ? calloc((size_t)threads, sizeof(pthread_t)) : NULL;
+    if (threads > 0 && !io->threads) {
+        pthread_cond_destroy(&io->done_cond);
+        pthread_cond_destroy(&io->work_cond);
+        pthread_mutex_destroy(&io->pool_mutex);
+        return -1;
+    }
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&io->threads[i], NULL, pool_worker, io) != 0) break;
+        io->thread_count++;
+    }
+    return 0;
+}
+
+static void pool_teardown(disk_io_t *io) {
+    pthread_mutex_lock(&io->pool_mutex);
+    io->stopping = true;
+    pthread_cond_broadcast(&io->work_cond);
+    pthread_mutex_unlock(&io->pool_mutex);
+    for (int i = 0; i < io->thread_count; i++) pthread_join(io->threads[i], NULL);
+    free(io->threads);
+    pthread_cond_destroy(&io->done_cond);
+    pthread_cond_destroy(&io->work_cond);
+    pthread_mutex_destroy(&io->pool_mutex);
+}
+
+/* il pool serve un gruppo alla volta: chi lo trova occupato esegue il proprio gruppo da sé
+ * invece di aspettare in coda, così un gruppo lungo non ferma gli altri */
+static int pool_submit(disk_io_t *io, disk_io_request_t *requests, size_t count) {
+    if (pthread_mutex_trylock(&io->submit_mutex) != 0) {
+        for (size_t i = 0; i < count; i++) transfer_sync(&requests[i], 0);
+        return 0;
+    }
+
+    pthread_mutex_lock(&io->pool_mutex);
+    io->batch = requests;
+    io->batch_count = count;
+    io->batch_next = 0;
+    io->batch_pending = count;
+    pthread_cond_broadcast(&io->work_cond);
+    pthread_mutex_unlock(&io->pool_mutex);
+
+    while (pool_run_one(io)) {
+    }
+
+    pthread_mutex_lock(&io->pool_mutex);
+    while (io->batch_pending > 0) pthread_cond_wait(&io->done_cond, &io->pool_mutex);
+    io->batch = NULL;
+    io->batch_count = 0;
+    pthread_mutex_unlock(&io->pool_mutex);
+    pthread_mutex_unlock(&io->submit_mutex);
+    return 0;
+}
+
+static void *pool_worker(void *arg) {
+    disk_io_t *io = arg;
+    for (;;) {
+        pthread_mutex_lock(&io->pool_mutex);
+        while (!io->stopping && io->batch_next >= io->batch_count) {
+            pthread_cond_wait(&io->work_cond, &io->pool_mutex);
+        }
+        bool stopping = io->stopping;
+        pthread_mutex_unlock(&io->pool_mutex);
+        if (stopping) return NULL;
+        pool_run_one(io);
+    }
+}
+
+// prende la prossima richiesta del gruppo e la esegue; false se non ce ne sono più
+static bool pool_run_one(disk_io_t *io) {
+    pthread_mutex_lock(&io->pool_mutex);
+    if (io->batch_next >= io->batch_count) {
+        pthread_mutex_unlock(&io->pool_mutex);
+        return false;
+    }
+    disk_io_request_t *request = &io->batch[io->batch_next++];
+    pthread_mutex_unlock(&io->pool_mutex);
+
+    transfer_sync(request, 0);
+
+    pthread_mutex_lock(&io->pool_mutex);
+    if (--io->batch_pending == 0) pthread_cond_signal(&io->done_cond);
+    pthread_mutex_unlock(&io->pool_mutex);
+    return true;
+}
+
+// completa la richiesta con pread/pwrite a partire da done byte già trasferiti
+static void transfer_sync(disk_io_request_t *request, size_t done) {
+    char *buffer = request->buffer;
+    while (done < request->len) {
+        ssize_t n = request->op == DISK_IO_READ
+                        ? pread(request->fd, buffer + done, request->len - done,
+                                request->offset + (off_t)done)
+                        : pwrite(request->fd, buffer + done, request->len - done,
+                                 request->offset + (off_t)done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            request->result = -errno;
+            return;
+        }
+        if (n == 0) break; // fine del file in lettura
+        done += (size_t)n;
+    }
+    request->result = (ssize_t)done;
+}
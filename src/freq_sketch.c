@@ -0,0 +1,84 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/freq_sketch.h"
+
+#include <stdlib.h>
+
+#define SKETCH_MIN_WIDTH 1024
+#define SKETCH_MAX_WIDTH (1u << 24)
+#define SKETCH_SAMPLE_FACTOR 10 // aggiunte per contatore di riga prima del dimezzamento
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static size_t counter_index(const freq_sketch_t *sketch, uint64_t key_hash, int row);
+static void halve(freq_sketch_t *sketch);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+int freq_sketch_init(freq_sketch_t *sketch, size_t expected_keys) {
+    size_t width = SKETCH_MIN_WIDTH;
+    while (width < expected_keys && width < SKETCH_MAX_WIDTH) width <<= 1;
+
+    sketch->table = calloc(FREQ_SKETCH_DEPTH, width);
+    if (!sketch->table) return -1;
+    sketch->mask = width - 1;
+    sketch->additions = 0;
+    sketch->sample_size = (uint64_t)width * SKETCH_SAMPLE_FACTOR;
+    return 0;
+}
+
+void freq_sketch_destroy(freq_sketch_t *sketch) {
+    free(sketch->table);
+    sketch->table = NULL;
+}
+
+void freq_sketch_add(freq_sketch_t *sketch, uint64_t key_hash) {
+    size_t index[FREQ_SKETCH_DEPTH];
+    unsigned min = FREQ_SKETCH_MAX;
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        index[row] = counter_index(sketch, key_hash, row);
+        if (sketch->table[index[row]] < min) min = sketch->table[index[row]];
+    }
+    if (min == FREQ_SKETCH_MAX) return;
+
+    // aggiornamento conservativo: crescono solo i contatori al minimo, gli altri hanno già
+    // contato anche gli accessi di chiavi in conflitto
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        if (sketch->table[index[row]] == min) sketch->table[index[row]]++;
+    }
+    if (++sketch->additions >= sketch->sample_size) halve(sketch);
+}
+
+unsigned freq_sketch_estimate(const freq_sketch_t *sketch, uint64_t key_hash) {
+    unsigned min = FREQ_SKETCH_MAX;
+    for (int row = 0; row < FREQ_SKETCH_DEPTH; row++) {
+        unsigned count = sketch->table[counter_index(sketch, key_hash, row)];
+        if (count < min) min = count;
+    }
+    return min;
+}
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+// doppio hashing (Kirsch-Mitzenmacher): h1 + row * h2, con h2 dispari
+static size_t counter_index(const freq_sketch_t *sketch, uint64_t key_hash, int row) {
+    uint32_t h1 = (uint32_t)key_hash;
+    uint32_t h2 = (uint32_t)(key_hash >> 32) | 1;
+    return (size_t)row * (sketch->mask + 1) + ((h1 + (uint32_t)row * h2) & sketch->mask);
+}
+
+static void halve(freq_sketch_t *sketch) {
+    size_t total = FREQ_SKETCH_DEPTH * (sketch->mask + 1);
+    for (size_t i = 0; i < total; i++) sketch->table[i] >>= 1;
+    sketch->additions /= 2;
+}
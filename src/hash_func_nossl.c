@@ -53,6 +53,16 @@ uint32_t hash_key(const char *key, size_t hash_table_capacity) {
 
 uint32_t hash(const char *key) { return hash_djb2(key); }
 
+// FNV-1a a 64 bit: usato dove servono pochi conflitti su milioni di chiavi (trace)
+uint64_t hash64(const char *key) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    while (*key) {
+        hash ^= (unsigned char)*key++;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
 void sha256_string(const char *str, char *output) {
     size_t len = strlen(str);
 
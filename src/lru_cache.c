@@ -15,14 +15,24 @@
 #include "../include/clogger.h"
 #include "../include/hash_func.h"
 
+/* ogni valore è preceduto da un contatore di riferimenti: il nodo ne tiene uno, ogni borrow
+ * un altro, così un valore sostituito o rimosso resta leggibile finché l'ultimo borrow non
+ * viene rilasciato. 16 byte per mantenere i dati allineati come un malloc. */
+typedef struct {
+    uint32_t refs;
+    uint32_t reserved[3];
+} lru_value_header_t;
+
 /* ======================================================
  * forward declaration static functions
  *  ====================================================== */
-static lru_node_t *create_node(const char *key, size_t value_size, void *value);
+static lru_node_t *create_node(const char *key, size_t value_size, void *value,
+                               bool accounting_only);
 static hash_node_t *create_hash_node(const char *key, lru_node_t *lru_node);
 static void add_to_head(lru_cache_t *cache, lru_node_t *lru_node);
 static void move_to_head(lru_cache_t *cache, lru_node_t *lru_node);
 static size_t calculate_hash_table_size(size_t max_bytes_capacity);
+static lru_value_header_t *value_header(void *value);
 
 /* =============================================
  * public functions implementation
@@ -36,12 +46,17 @@ lru_cache_t *lru_cache_create(size_t max_bytes_capacity) {
         return NULL;
     }
 
-    // create mutex for put
-    if (pthread_mutex_init(&cache->mutex, NULL) != 0) {
+    // mutex ricorsivo: pod_cache lo tiene durante la demotion e richiama put/remove_tail
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    if (pthread_mutex_init(&cache->mutex, &attr) != 0) {
         log_error("Failed to initialize mutex for LRU cache");
+        pthread_mutexattr_destroy(&attr);
         free(cache);
         return NULL;
     }
+    pthread_mutexattr_destroy(&attr);
     log_debug("Mutex initialized for LRU cache");
 
     size_t estimated_capacity = calculate_hash_table_size(max_bytes_capacity) + 1;
@@ -65,6 +80,12 @@ lru_cache_t *lru_cache_create(size_t max_bytes_capacity) {
     return cache;
 }
 
+lru_cache_t *lru_cache_create_accounting(size_t max_bytes_capacity) {
+    lru_cache_t *cache = lru_cache_create(max_bytes_capacity);
+    if (cache) cache->accounting_only = true;
+    return cache;
+}
+
 int lru_cache_get(lru_cache_t *cache, const char *key, void **value, size_t *value_size) {
     if (!cache || !key || !value || !value_size) {
         log_error("Invalid parameters in lru_cache_get");
@@ -73,15 +94,25 @@ int lru_cache_get(lru_cache_t *cache, const char *key, void **value, size_t *val
 
     log_debug("LRU GET: searching for key '%s'", key);
 
+    pthread_mutex_lock(&cache->mutex);
+
     uint32_t hash = hash_key(key, cache->hash_table_size);
     hash_node_t *current = cache->buckets[hash];
     while (current) {
         if (strcmp(current->key, key) == 0) {
             // item found, read value and move it to the head of linkedlist
+            if (cache->accounting_only) {
+                *value = NULL;
+                *value_size = current->node->size;
+                move_to_head(cache, current->node);
+                pthread_mutex_unlock(&cache->mutex);
+                return 0;
+            }
             *value = malloc(current->node->size);
             if (!*value) {
                 log_error("Memory allocation failed for key '%s' (size: %zu)", key,
                           current->node->size);
+                pthread_mutex_unlock(&cache->mutex);
                 return -1; // Errore di allocazione
             }
             *value_size = current->node->size;
@@ -90,15 +121,57 @@ int lru_cache_get(lru_cache_t *cache, const char *key, void **value, size_t *val
 
             move_to_head(cache, current->node);
             log_debug("LRU GET: moved key '%s' to head (most recently used)", key);
+            pthread_mutex_unlock(&cache->mutex);
             return 0;
         }
         current = current->next;
     }
+    pthread_mutex_unlock(&cache->mutex);
     // not found, returning -100
     log_debug("LRU GET: key '%s' not found", key);
     return -100;
 }
 
+int lru_cache_borrow(lru_cache_t *cache, const char *key, const void **value, size_t *value_size) {
+    if (!cache || !key || !value || !value_size) {
+        log_error("Invalid parameters in lru_cache_borrow");
+        return -1;
+    }
+
+    pthread_mutex_lock(&cache->mutex);
+
+    uint32_t hash = hash_key(key, cache->hash_table_size);
+    for (hash_node_t *current = cache->buckets[hash]; current; current = current->next) {
+        if (strcmp(current->key, key) == 0) {
+            // nessuna copia: il riferimento tiene in vita il valore anche dopo put/evict
+            lru_value_ref(current->node->value);
+            *value = current->node->value;
+            *value_size = current->node->size;
+            move_to_head(cache, current->node);
+            pthread_mutex_unlock(&cache->mutex);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return -100;
+}
+
+bool lru_cache_contains(lru_cache_t *cache, const char *key) {
+    if (!cache || !key) return false;
+
+    pthread_mutex_lock(&cache->mutex);
+    bool found = false;
+    uint32_t hash = hash_key(key, cache->hash_table_size);
+    for (hash_node_t *current = cache->buckets[hash]; current; current = current->next) {
+        if (strcmp(current->key, key) == 0) {
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&cache->mutex);
+    return found;
+}
+
 int lru_cache_evict(lru_cache_t *cache, const char *key) {
     if (!cache || !key) {
         log_error("Invalid parameters in lru_cache_evict");
@@ -107,6 +180,8 @@ int lru_cache_evict(lru_cache_t *cache, const char *key) {
 
     log_debug("LRU EVICT: attempting to remove key '%s'", key);
 
+    pthread_mutex_lock(&cache->mutex);
+
     uint32_t hash = hash_key(key, cache->hash_table_size);
     hash_node_t *current = cache->buckets[hash];
     hash_node_t *prev_hash = NULL;
@@ -157,8 +232,9 @@ int lru_cache_evict(lru_cache_t *cache, const char *key) {
             free(current->key);
             free(current);
             free(node_to_remove->key);
-            free(node_to_remove->value);
+            lru_value_unref(node_to_remove->value);
             free(node_to_remove);
+            pthread_mutex_unlock(&cache->mutex);
 
             log_info("LRU EVICT: successfully removed key '%s'", key);
             return 0;
@@ -166,6 +242,7 @@ int lru_cache_evict(lru_cache_t *cache, const char *key) {
         prev_hash = current;
         current = current->next;
     }
+    pthread_mutex_unlock(&cache->mutex);
 
     // elemento non trovato
     log_debug("LRU EVICT: key '%s' not found", key);
@@ -173,7 +250,7 @@ int lru_cache_evict(lru_cache_t *cache, const char *key) {
 }
 
 int lru_cache_put(lru_cache_t *cache, const char *key, void *value, size_t value_size) {
-    if (!cache || !key || !value) {
+    if (!cache || !key || (!value && !cache->accounting_only)) {
         log_error("Invalid parameters in lru_cache_put");
         return -1;
     }
@@ -198,17 +275,20 @@ int lru_cache_put(lru_cache_t *cache, const char *key, void *value, size_t value
         if (strcmp(current->key, key) == 0) {
             log_debug("LRU PUT: updating existing key '%s'", key);
 
-            free(current->node->value);
+            lru_value_unref(current->node->value);
+            current->node->value = NULL;
             size_t old_value_size = current->node->size;
 
-            current->node->value = malloc(value_size);
-            if (!current->node->value) {
-                log_error("Memory allocation failed for updating key '%s'", key);
-                pthread_mutex_unlock(&cache->mutex);
-                return -1; // Errore di allocazione
+            if (!cache->accounting_only) {
+                current->node->value = lru_value_alloc(value_size);
+                if (!current->node->value) {
+                    log_error("Memory allocation failed for updating key '%s'", key);
+                    pthread_mutex_unlock(&cache->mutex);
+                    return -1; // Errore di allocazione
+                }
+                memcpy(current->node->value, value, value_size);
             }
             current->node->size = value_size;
-            memcpy(current->node->value, value, value_size);
 
             size_t old_total_size = cache->current_bytes_size;
             cache->current_bytes_size += (current->node->size - old_value_size);
@@ -225,7 +305,7 @@ int lru_cache_put(lru_cache_t *cache, const char *key, void *value, size_t value
 
     log_debug("LRU PUT: inserting new key '%s'", key);
 
-    lru_node_t *new_lru_node = create_node(key, value_size, value);
+    lru_node_t *new_lru_node = create_node(key, value_size, value, cache->accounting_only);
     if (!new_lru_node) {
         log_error("Failed to create LRU node for key '%s'", key);
         pthread_mutex_unlock(&cache->mutex);
@@ -236,7 +316,7 @@ int lru_cache_put(lru_cache_t *cache, const char *key, void *value, size_t value
     if (!new_hash_node) {
         log_error("Failed to create hash node for key '%s'", key);
         free(new_lru_node->key);
-        free(new_lru_node->value);
+        lru_value_unref(new_lru_node->value);
         free(new_lru_node);
         pthread_mutex_unlock(&cache->mutex);
         return -1;
@@ -262,7 +342,7 @@ void lru_cache_destroy(lru_cache_t *cache) {
     while (current) {
         lru_node_t *next = current->next;
         free(current->key);
-        free(current->value);
+        lru_value_unref(current->value);
         free(current);
         current = next;
     }
@@ -286,11 +366,32 @@ void lru_cache_destroy(lru_cache_t *cache) {
     free(cache);
 }
 
+void *lru_value_alloc(size_t size) {
+    lru_value_header_t *header = malloc(sizeof(lru_value_header_t) + size);
+    if (!header) return NULL;
+    header->refs = 1;
+    return header + 1;
+}
+
+void lru_value_ref(void *value) {
+    if (!value) return;
+    __atomic_add_fetch(&value_header(value)->refs, 1, __ATOMIC_RELAXED);
+}
+
+void lru_value_unref(void *value) {
+    if (!value) return;
+    lru_value_header_t *header = value_header(value);
+    if (__atomic_sub_fetch(&header->refs, 1, __ATOMIC_ACQ_REL) == 0) free(header);
+}
+
 /* =============================================
  * static functions implementation
  * ============================================= */
 
-static lru_node_t *create_node(const char *key, size_t value_size, void *value) {
+static lru_value_header_t *value_header(void *value) { return (lru_value_header_t *)value - 1; }
+
+static lru_node_t *create_node(const char *key, size_t value_size, void *value,
+                               bool accounting_only) {
     lru_node_t *new_lru_node = calloc(1, sizeof(lru_node_t));
     if (!new_lru_node) return NULL;
 
@@ -300,15 +401,17 @@ static lru_node_t *create_node(const char *key, size_t value_size, void *value)
         return NULL;
     }
 
-    new_lru_node->value = malloc(value_size); // Rimosso +1 non necessario
-    if (!new_lru_node->value) {
-        free(new_lru_node->key);
-        free(new_lru_node);
-        return NULL;
-    }
+    if (!accounting_only) {
+        new_lru_node->value = lru_value_alloc(value_size);
+        if (!new_lru_node->value) {
+            free(new_lru_node->key);
+            free(new_lru_node);
+            return NULL;
+        }
 
-    memcpy(new_lru_node->value, value, value_size);
-    log_debug("PUT: storing '%.*s' (size: %zu)", (int)value_size, (char *)value, value_size);
+        memcpy(new_lru_node->value, value, value_size);
+        log_debug("PUT: storing '%.*s' (size: %zu)", (int)value_size, (char *)value, value_size);
+    }
     new_lru_node->size = value_size;
     new_lru_node->next = NULL;
     new_lru_node->creation_time = time(NULL);
@@ -354,7 +457,13 @@ lru_node_t *lru_cache_get_tail_node(lru_cache_t *cache) {
 }
 
 int lru_cache_remove_tail(lru_cache_t *cache) {
-    if (!cache || !cache->tail) return -1;
+    if (!cache) return -1;
+
+    pthread_mutex_lock(&cache->mutex);
+    if (!cache->tail) {
+        pthread_mutex_unlock(&cache->mutex);
+        return -1;
+    }
 
     lru_node_t *tail_node = cache->tail;
 
@@ -386,8 +495,9 @@ int lru_cache_remove_tail(lru_cache_t *cache) {
     }
     cache->current_bytes_size -= tail_node->size;
     free(tail_node->key);
-    free(tail_node->value);
+    lru_value_unref(tail_node->value);
     free(tail_node);
+    pthread_mutex_unlock(&cache->mutex);
     log_info("removed tail element from list");
     return 0;
 }
@@ -10,10 +10,11 @@ int main(void) {
     log_info("PodCache server starting up...");
 
     log_debug("Initializing TCP server");
-    tcp_server_start();
+    // un errore di avvio (porta o socket Unix occupati) deve arrivare a supervisord
+    int rc = tcp_server_start();
 
     log_info("PodCache server shutdown complete");
-    return 0;
+    return rc;
 }
 
 int test_cache_main(void) {
@@ -0,0 +1,381 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/peer.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+#include "../include/hash_func.h"
+#include "../include/resp_parser.h"
+
+#define PEER_RING_POINTS 64 // punti sull'anello per ogni peer
+#define PEER_POOL_SIZE 4    // connessioni inattive tenute aperte per peer
+#define PEER_HOST_SIZE 256
+
+typedef struct {
+    char host[PEER_HOST_SIZE];
+    int port;
+    pthread_mutex_t mutex; // protegge il pool e down_until
+    int idle[PEER_POOL_SIZE];
+    int idle_count;
+    uint64_t down_until; // ms monotoni: fino ad allora il peer viene saltato
+} peer_t;
+
+typedef struct {
+    uint64_t hash;
+    int peer;
+} ring_point_t;
+
+static peer_t peers[PEER_MAX_PEERS];
+static int peer_count = 0;
+static int self_index = -1;
+static ring_point_t *ring = NULL;
+static size_t ring_size = 0;
+static int request_timeout_ms = PEER_DEFAULT_TIMEOUT_MS;
+static int max_probes = PEER_DEFAULT_PROBES;
+static peer_stats_t stats;
+static __thread bool local_only = false;
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static int parse_host_port(const char *value, char *host, size_t host_size, int *port);
+static int compare_points(const void *a, const void *b);
+static int fetch(peer_t *peer, const char *key, void **value, size_t *size);
+static int request(int socket_fd, const char *key, void **value, size_t *size);
+static int take_connection(peer_t *peer, bool *pooled);
+static void return_connection(peer_t *peer, int socket_fd);
+static int connect_peer(const peer_t *peer);
+static int wait_fd(int socket_fd, short events, uint64_t deadline);
+static uint64_t now_ms(void);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+int peer_init(const char *peer_list, const char *self, int port, int timeout_ms, int probes) {
+    char *list = strdup(peer_list ? peer_list : "");
+    if (!list) return -1;
+    char *save = NULL;
+    for (char *item = strtok_r(list, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        if (peer_count == PEER_MAX_PEERS) {
+            log_error("Peer fill: more than %d peers", PEER_MAX_PEERS);
+            free(list);
+            return -1;
+        }
+        peer_t *peer = &peers[peer_count];
+        if (parse_host_port(item, peer->host, sizeof(peer->host), &peer->port) != 0) {
+            log_error("Peer fill: invalid peer '%s'", item);
+            free(list);
+            return -1;
+        }
+        pthread_mutex_init(&peer->mutex, NULL);
+        peer->idle_count = 0;
+        peer->down_until = 0;
+        peer_count++;
+    }
+    free(list);
+    if (peer_count == 0) return -1;
+
+    if (self && *self) {
+        char host[PEER_HOST_SIZE];
+        int self_port;
+        if (parse_host_port(self, host, sizeof(host), &self_port) != 0) {
+            log_error("Peer fill: invalid self address '%s'", self);
+            return -1;
+        }
+        for (int i = 0; i < peer_count && self_index < 0; i++) {
+            if (peers[i].port == self_port && strcmp(peers[i].host, host) == 0) self_index = i;
+        }
+    } else {
+        for (int i = 0; i < peer_count && self_index < 0; i++) {
+            if (peers[i].port == port) self_index = i;
+        }
+    }
+
+    // l'anello dipende solo dalla lista: tutti i pod scelgono lo stesso proprietario
+    ring_size = (size_t)peer_count * PEER_RING_POINTS;
+    ring = malloc(ring_size * sizeof(ring_point_t));
+    if (!ring) return -1;
+    for (int i = 0; i < peer_count; i++) {
+        for (int point = 0; point < PEER_RING_POINTS; point++) {
+            char label[PEER_HOST_SIZE + 32];
+            snprintf(label, sizeof(label), "%s:%d#%d", peers[i].host, peers[i].port, point);
+            ring[(size_t)i * PEER_RING_POINTS + point] = (ring_point_t){hash64(label), i};
+        }
+    }
+    qsort(ring, ring_size, sizeof(ring_point_t), compare_points);
+
+    request_timeout_ms = timeout_ms;
+    max_probes = probes < peer_count ? probes : peer_count;
+    log_info("Peer fill: %d peers (%s), timeout %d ms, %d probes per miss", peer_count,
+             self_index >= 0 ? "this pod included" : "this pod not listed", request_timeout_ms,
+             max_probes);
+    return 0;
+}
+
+void peer_shutdown(void) {
+    for (int i = 0; i < peer_count; i++) {
+        pthread_mutex_lock(&peers[i].mutex);
+        for (int c = 0; c < peers[i].idle_count; c++) close(peers[i].idle[c]);
+        peers[i].idle_count = 0;
+        pthread_mutex_unlock(&peers[i].mutex);
+    }
+    free(ring);
+    ring = NULL;
+    ring_size = 0;
+}
+
+int peer_loader(const char *key, void **value, size_t *size, void *ctx) {
+    (void)ctx;
+    if (local_only || ring_size == 0) return -100;
+
+    // primo punto dell'anello con hash >= hash della chiave (circolare)
+    uint64_t key_hash = hash64(key);
+    size_t low = 0, high = ring_size;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (ring[mid].hash < key_hash) low = mid + 1;
+        else high = mid;
+    }
+
+    bool asked[PEER_MAX_PEERS] = {false};
+    int probes = 0;
+    for (size_t step = 0; step < ring_size && probes < max_probes; step++) {
+        int index = ring[(low + step) % ring_size].peer;
+        if (index == self_index || asked[index]) continue;
+        asked[index] = true;
+        probes++;
+
+        peer_t *peer = &peers[index];
+        pthread_mutex_lock(&peer->mutex);
+        bool down = peer->down_until > now_ms();
+        pthread_mutex_unlock(&peer->mutex);
+        if (down) {
+            __atomic_add_fetch(&stats.skipped, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        if (fetch(peer, key, value, size) == 0) return 0;
+    }
+    return -100;
+}
+
+void peer_set_local_only(bool value) { local_only = value; }
+
+void peer_get_stats(peer_stats_t *out) {
+    if (!out) return;
+    out->requests = __atomic_load_n(&stats.requests, __ATOMIC_RELAXED);
+    out->hits = __atomic_load_n(&stats.hits, __ATOMIC_RELAXED);
+    out->errors = __atomic_load_n(&stats.errors, __ATOMIC_RELAXED);
+    out->skipped = __atomic_load_n(&stats.skipped, __ATOMIC_RELAXED);
+}
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+static int parse_host_port(const char *value, char *host, size_t host_size, int *port) {
+    while (*value == ' ') value++;
+    const char *colon = strrchr(value, ':');
+    if (!colon || colon == value || (size_t)(colon - value) >= host_size) return -1;
+    char *endptr;
+    long parsed = strtol(colon + 1, &endptr, 10);
+    if (endptr == colon + 1 || *endptr != '\0' || parsed < 1 || parsed > 65535) return -1;
+    memcpy(host, value, (size_t)(colon - value));
+    host[colon - value] = '\0';
+    *port = (int)parsed;
+    return 0;
+}
+
+static int compare_points(const void *a, const void *b) {
+    uint64_t ha = ((const ring_point_t *)a)->hash;
+    uint64_t hb = ((const ring_point_t *)b)->hash;
+    return ha < hb ? -1 : ha > hb;
+}
+
+// 0 se trovata, -100 se il peer non ce l'ha, -1 su errore (il peer viene saltato per un po')
+static int fetch(peer_t *peer, const char *key, void **value, size_t *size) {
+    __atomic_add_fetch(&stats.requests, 1, __ATOMIC_RELAXED);
+
+    // una connessione dal pool può essere stata chiusa dal peer: si riprova con una nuova
+    for (int attempt = 0; attempt < 2; attempt++) {
+        bool pooled = false;
+        int socket_fd = take_connection(peer, &pooled);
+        if (socket_fd < 0) break;
+
+        int result = request(socket_fd, key, value, size);
+        if (result != -1) {
+            return_connection(peer, socket_fd);
+            if (result == 0) __atomic_add_fetch(&stats.hits, 1, __ATOMIC_RELAXED);
+            return result;
+        }
+        close(socket_fd);
+        if (!pooled) break;
+    }
+
+    __atomic_add_fetch(&stats.errors, 1, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&peer->mutex);
+    peer->down_until = now_ms() + PEER_RETRY_MS;
+    pthread_mutex_unlock(&peer->mutex);
+    log_warn("Peer fill: %s:%d unavailable, skipped for %d ms", peer->host, peer->port,
+             PEER_RETRY_MS);
+    return -1;
+}
+
+// PEERGET sulla connessione, con il timeout della richiesta: 0, -100 (nil), -1 su errore
+static int request(int socket_fd, const char *key, void **value, size_t *size) {
+    uint64_t deadline = now_ms() + (uint64_t)request_timeout_ms;
+    size_t key_len = strlen(key);
+    char header[64];
+    int header_len =
+        snprintf(header, sizeof(header), "*2\r\n$7\r\nPEERGET\r\n$%zu\r\n", key_len);
+    const char *parts[3] = {header, key, "\r\n"};
+    size_t lengths[3] = {(size_t)header_len, key_len, 2};
+    for (int i = 0; i < 3; i++) {
+        size_t sent = 0;
+        while (sent < lengths[i]) {
+            if (wait_fd(socket_fd, POLLOUT, deadline) != 0) return -1;
+            ssize_t n = send(socket_fd, parts[i] + sent, lengths[i] - sent,
+                             MSG_NOSIGNAL | (i < 2 ? MSG_MORE : 0));
+            if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (n <= 0) return -1;
+            sent += (size_t)n;
+        }
+    }
+
+    // risposta: $-1\r\n oppure $<len>\r\n<valore>\r\n
+    char line[32];
+    size_t used = 0;
+    char *end = NULL;
+    while (!(end = memchr(line, '\n', used))) {
+        if (used == sizeof(line) || wait_fd(socket_fd, POLLIN, deadline) != 0) return -1;
+        ssize_t n = recv(socket_fd, line + used, sizeof(line) - used, 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) return -1;
+        used += (size_t)n;
+    }
+    if (line[0] != '$') return -1;
+    char *endptr;
+    long length = strtol(line + 1, &endptr, 10);
+    if (endptr == line + 1 || *endptr != '\r') return -1;
+    size_t header_size = (size_t)(end - line) + 1;
+    if (length < 0) return used == header_size ? -100 : -1;
+    if (length > MAX_STR_LEN) return -1;
+
+    size_t total = (size_t)length + 2;
+    char *buffer = malloc(total);
+    if (!buffer) return -1;
+    size_t have = used - header_size;
+    if (have > total) {
+        free(buffer);
+        return -1;
+    }
+    memcpy(buffer, line + header_size, have);
+    while (have < total) {
+        if (wait_fd(socket_fd, POLLIN, deadline) != 0) {
+            free(buffer);
+            return -1;
+        }
+        ssize_t n = recv(socket_fd, buffer + have, total - have, 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+        if (n <= 0) {
+            free(buffer);
+            return -1;
+        }
+        have += (size_t)n;
+    }
+    *value = buffer;
+    *size = (size_t)length;
+    return 0;
+}
+
+static int take_connection(peer_t *peer, bool *pooled) {
+    pthread_mutex_lock(&peer->mutex);
+    if (peer->idle_count > 0) {
+        int socket_fd = peer->idle[--peer->idle_count];
+        pthread_mutex_unlock(&peer->mutex);
+        *pooled = true;
+        return socket_fd;
+    }
+    pthread_mutex_unlock(&peer->mutex);
+    *pooled = false;
+    return connect_peer(peer);
+}
+
+static void return_connection(peer_t *peer, int socket_fd) {
+    pthread_mutex_lock(&peer->mutex);
+    if (peer->idle_count < PEER_POOL_SIZE) {
+        peer->idle[peer->idle_count++] = socket_fd;
+        socket_fd = -1;
+    }
+    pthread_mutex_unlock(&peer->mutex);
+    if (socket_fd >= 0) close(socket_fd);
+}
+
+// connect non bloccante: anche l'apertura della connessione rispetta il timeout
+static int connect_peer(const peer_t *peer) {
+    char service[16];
+    snprintf(service, sizeof(service), "%d", peer->port);
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(peer->host, service, &hints, &result) != 0) return -1;
+
+    uint64_t deadline = now_ms() + (uint64_t)request_timeout_ms;
+    int socket_fd = -1;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+        socket_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (socket_fd < 0) continue;
+        fcntl(socket_fd, F_SETFL, fcntl(socket_fd, F_GETFL) | O_NONBLOCK);
+        int rc = connect(socket_fd, ai->ai_addr, ai->ai_addrlen);
+        if (rc != 0 && errno == EINPROGRESS && wait_fd(socket_fd, POLLOUT, deadline) == 0) {
+            int error = 0;
+            socklen_t len = sizeof(error);
+            getsockopt(socket_fd, SOL_SOCKET, SO_ERROR, &error, &len);
+            rc = error == 0 ? 0 : -1;
+        }
+        if (rc == 0) break;
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    freeaddrinfo(result);
+    if (socket_fd >= 0) {
+        int one = 1;
+        setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return socket_fd;
+}
+
+static int wait_fd(int socket_fd, short events, uint64_t deadline) {
+    for (;;) {
+        uint64_t now = now_ms();
+        if (now >= deadline) return -1;
+        struct pollfd pfd = {.fd = socket_fd, .events = events};
+        int ready = poll(&pfd, 1, (int)(deadline - now));
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) return -1;
+        return (pfd.revents & (events | POLLHUP)) ? 0 : -1;
+    }
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
@@ -8,7 +8,9 @@
 #include "../include/pod_cache.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../include/cas.h"
 #include "../include/clogger.h"
@@ -16,10 +18,49 @@
 #include "../include/hash_func.h"
 
 #define MAX_PARTITIONS 20
-
+// dimensione media delle chiavi usata per dimensionare lo sketch delle letture
+#define ADMISSION_BYTES_PER_KEY 512
+// chiavi al massimo in una demotion a gruppi
+#define DEMOTE_BATCH_MAX 64
+// un batch non libera più di questa frazione della partizione oltre lo spazio necessario
+#define DEMOTE_BATCH_PARTITION_SHARE 16
+#define VICTIM_CLEAN -1
+#define VICTIM_REJECTED -2
+
+#define STAT_INC(cache, field) __atomic_fetch_add(&(cache)->stats.field, 1, __ATOMIC_RELAXED)
+
+static pod_cache_t *create_cache(size_t capacity, u_short partitions, bool accounting_only);
 static int get_partition(uint32_t hash, u_short partition_count);
+static int demote_batch(pod_cache_t *cache, int partition_index, size_t needed);
+static size_t room_needed(const lru_cache_t *partition, size_t value_size);
+static int promote_from_disk(pod_cache_t *cache, int partition_index, const char *key,
+                             void **out_value, size_t *out_value_size);
+static void notify(pod_cache_t *cache, pod_cache_event_e event, const char *key,
+                   const void *value, size_t size);
+static int put_locked(pod_cache_t *cache, int partition_index, const char *key, const void *value,
+                      size_t value_size);
+static int borrow_locked(pod_cache_t *cache, int partition_index, const char *key,
+                         pod_cache_handle_t *handle);
+static int load_missing(pod_cache_t *cache, const char *key);
+static int insert_loaded(pod_cache_t *cache, pod_cache_flight_t *flight, const void *value,
+                         size_t size);
+static void cancel_loads(pod_cache_t *cache, const char *key);
+static int evict_from_disk(pod_cache_t *cache, const char *key);
+static void disk_dropped(const char *key, void *ctx);
+static void notify_dropped(pod_cache_t *cache);
+static void record_read(pod_cache_t *cache, int partition_index, const char *key);
+static bool admit_to_disk(pod_cache_t *cache, int partition_index, const char *key);
+static bool disk_copy_valid(pod_cache_t *cache, const char *key);
 
 pod_cache_t *pod_cache_create(size_t capacity, u_short partitions) {
+    return create_cache(capacity, partitions, false);
+}
+
+pod_cache_t *pod_cache_create_accounting(size_t capacity, u_short partitions) {
+    return create_cache(capacity, partitions, true);
+}
+
+static pod_cache_t *create_cache(size_t capacity, u_short partitions, bool accounting_only) {
     log_debug("Creating pod cache with capacity %zu bytes, %d partitions", capacity, partitions);
 
     pod_cache_t *pod_cache = malloc(sizeof(pod_cache_t));
@@ -34,34 +75,56 @@ pod_cache_t *pod_cache_create(size_t capacity, u_short partitions) {
     pod_cache->partition_capacity = single_partition_capacity;
     pod_cache->partition_count = partitions;
     pod_cache->total_capacity = capacity;
-    pod_cache->cas_registry = cas_create_registry();
-
-    if (!pod_cache->cas_registry) {
-        log_error("Failed to create CAS registry");
-        free(pod_cache);
-        return NULL;
+    pod_cache->stats = (pod_cache_stats_t){0};
+    pod_cache->accounting_only = accounting_only;
+    pod_cache->cas_registry = NULL;
+    pod_cache->disk_index = NULL;
+    pod_cache->listener_count = 0;
+    pod_cache->loader = NULL;
+    pod_cache->loader_ctx = NULL;
+    pod_cache->flights = NULL;
+    pthread_mutex_init(&pod_cache->flight_mutex, NULL);
+    pthread_cond_init(&pod_cache->flight_cond, NULL);
+    pod_cache->dropped = NULL;
+    pthread_mutex_init(&pod_cache->drop_mutex, NULL);
+    pod_cache->disk_admission = 0;
+    pod_cache->sketches = NULL;
+    pod_cache->demote_batch_keys = POD_CACHE_DEMOTE_BATCH_KEYS;
+    pod_cache->demote_batch_bytes = POD_CACHE_DEMOTE_BATCH_BYTES;
+
+    if (accounting_only) {
+        // il disco non ha limiti di capacità: basta sapere quali chiavi ci sono
+        pod_cache->disk_index = lru_cache_create_accounting(SIZE_MAX);
+        if (!pod_cache->disk_index) {
+            log_error("Failed to create simulated disk index");
+            free(pod_cache);
+            return NULL;
+        }
+    } else {
+        pod_cache->cas_registry = cas_create_registry();
+        if (!pod_cache->cas_registry) {
+            log_error("Failed to create CAS registry");
+            free(pod_cache);
+            return NULL;
+        }
+        log_debug("CAS registry created successfully");
     }
-    log_debug("CAS registry created successfully");
 
-    pod_cache->partitions = malloc(partitions * sizeof(lru_cache_t *));
+    pod_cache->partitions = calloc(partitions, sizeof(lru_cache_t *));
     if (!pod_cache->partitions) {
         log_error("Failed to allocate memory for partitions array");
-        cas_registry_destroy(pod_cache->cas_registry);
-        free(pod_cache);
+        pod_cache_destroy(pod_cache);
         return NULL;
     }
 
     for (int i = 0; i < partitions; i++) {
-        pod_cache->partitions[i] = lru_cache_create(single_partition_capacity);
+        pod_cache->partitions[i] = accounting_only
+                                       ? lru_cache_create_accounting(single_partition_capacity)
+                                       : lru_cache_create(single_partition_capacity);
         if (!pod_cache->partitions[i]) {
             log_error("Failed to create partition %d", i);
-            // Cleanup already created partitions
-            for (int j = 0; j < i; j++) {
-                lru_cache_destroy(pod_cache->partitions[j]);
-            }
-            free(pod_cache->partitions);
-            cas_registry_destroy(pod_cache->cas_registry);
-            free(pod_cache);
+            // le partizioni non ancora create sono NULL, destroy le salta
+            pod_cache_destroy(pod_cache);
             return NULL;
         }
         log_debug("Created partition %d with capacity %zu bytes", i, single_partition_capacity);
@@ -73,7 +136,7 @@ pod_cache_t *pod_cache_create(size_t capacity, u_short partitions) {
 }
 
 int pod_cache_put(pod_cache_t *cache, const char *key, void *value, size_t value_size) {
-    if (!cache || !key || !value) {
+    if (!cache || !key || (!value && !cache->accounting_only)) {
         log_error("Invalid parameters in pod_cache_put: cache=%p, key=%p, value=%p", (void *)cache,
                   (void *)key, (void *)value);
         return -1;
@@ -85,55 +148,15 @@ int pod_cache_put(pod_cache_t *cache, const char *key, void *value, size_t value
     int partition_index = get_partition(hash(key), cache->partition_count);
     log_debug("Selected partition %d for key '%s'", partition_index, key);
 
-    int put_response = lru_cache_put(cache->partitions[partition_index], key, value, value_size);
-    switch (put_response) {
-    case -1:
-        log_error("Failed to put key '%s' in memory partition %d", key, partition_index);
-        return -1;
-    case -900:
-        log_info("Partition %d full, moving tail element to disk storage", partition_index);
-        // get pointer to tail element in partition
-        lru_node_t *tail = lru_cache_get_tail_node(cache->partitions[partition_index]);
-        if (!tail) {
-            log_error("No tail element found in partition %d", partition_index);
-            return -1;
-        }
-
-        log_debug("Moving key '%s' from memory to disk", tail->key);
+    lru_cache_t *partition = cache->partitions[partition_index];
 
-        // write it to disk cache
-        char output_path[512];
-        int cas_result =
-            cas_put(cache->cas_registry, tail->key, tail->value, tail->size, output_path);
-        if (cas_result != 0) {
-            log_error("Failed to write key '%s' to disk storage, error: %d", tail->key, cas_result);
-            return -1;
-        }
-
-        log_debug("Successfully wrote key '%s' to disk at path: %s", tail->key, output_path);
-
-        // TODO: inserire nel registry l'output generato, fare una routine perchè è un array
-        // dinamico, se non c'è spazio bisogna fare realloc
-        cas_add_to_registry(cache->cas_registry, output_path);
-
-        // remove from tail
-        lru_cache_remove_tail(cache->partitions[partition_index]);
-        log_debug("Removed tail element from memory partition %d", partition_index);
-
-        // Now retry the put operation
-        put_response = lru_cache_put(cache->partitions[partition_index], key, value, value_size);
-        if (put_response < 0) {
-            log_error("Failed to put key '%s' after freeing space in partition %d", key,
-                      partition_index);
-            return -1;
-        }
-        log_info("Successfully stored key '%s' in partition %d after disk eviction", key,
-                 partition_index);
-        return partition_index;
-    default:
-        log_debug("Successfully stored key '%s' in partition %d", key, partition_index);
-        return partition_index;
-    }
+    // la partizione resta bloccata finché il nuovo valore non è inserito, così la coda
+    // spostata su disco non può essere modificata da altri thread
+    pthread_mutex_lock(&partition->mutex);
+    int result = put_locked(cache, partition_index, key, value, value_size);
+    pthread_mutex_unlock(&partition->mutex);
+    notify_dropped(cache);
+    return result;
 }
 
 int pod_cache_get(pod_cache_t *cache, const char *key, void **out_value, size_t *out_value_size) {
@@ -149,46 +172,49 @@ int pod_cache_get(pod_cache_t *cache, const char *key, void **out_value, size_t
     int partition_index = get_partition(hash(key), cache->partition_count);
     log_debug("Searching in partition %d for key '%s'", partition_index, key);
 
-    int o_res = lru_cache_get(cache->partitions[partition_index], key, out_value, out_value_size);
+    lru_cache_t *partition = cache->partitions[partition_index];
 
-    switch (o_res) {
-    case -1:
-        log_error("Memory allocation error while getting key '%s' from partition %d", key,
-                  partition_index);
-        return -1;
-    case -100:
+    // la promozione da disco deve essere atomica rispetto a put/evict sulla stessa partizione
+    pthread_mutex_lock(&partition->mutex);
+    record_read(cache, partition_index, key);
+    int o_res = lru_cache_get(partition, key, out_value, out_value_size);
+    if (o_res == -100) {
         log_debug("Key '%s' not found in memory partition %d, searching in disk storage", key,
                   partition_index);
-        if (cas_get(cache->cas_registry, key, out_value, out_value_size) == 0) {
-            log_info("Key '%s' found in disk storage, promoting to memory", key);
-
-            // trovato su disco, sposto nella cache in-memory
-            int put_result =
-                lru_cache_put(cache->partitions[partition_index], key, *out_value, *out_value_size);
-            if (put_result < 0) {
-                log_warn(
-                    "Failed to promote key '%s' to memory partition %d, but returning disk value",
-                    key, partition_index);
-            } else {
-                log_debug("Successfully promoted key '%s' to memory partition %d", key,
-                          partition_index);
-            }
-
-            // rimuovo da disk cache
-            if (cas_evict(key, cache->cas_registry) == 0) {
-                log_debug("Successfully removed key '%s' from disk storage after promotion", key);
-            } else {
-                log_warn("Failed to remove key '%s' from disk storage after promotion", key);
+        o_res = promote_from_disk(cache, partition_index, key, out_value, out_value_size);
+        pthread_mutex_unlock(&partition->mutex);
+        notify_dropped(cache);
+        if (o_res != 0) {
+            STAT_INC(cache, misses);
+            log_debug("Key '%s' not found in disk storage", key);
+            /* il valore del loader viene inserito in memoria e riletto da lì (o dal disco, se
+             * una SET concorrente l'ha preceduto e la sua chiave è già stata spostata) */
+            if (cache->loader && load_missing(cache, key) == 0) {
+                pthread_mutex_lock(&partition->mutex);
+                o_res = lru_cache_get(partition, key, out_value, out_value_size);
+                if (o_res == -100) {
+                    o_res = promote_from_disk(cache, partition_index, key, out_value,
+                                              out_value_size);
+                }
+                pthread_mutex_unlock(&partition->mutex);
+                notify_dropped(cache);
+                if (o_res == 0) return 0;
             }
-
-            return 0;
+            return -1;
         }
-        log_debug("Key '%s' not found in disk storage", key);
+        STAT_INC(cache, disk_hits);
+        return 0;
+    }
+    pthread_mutex_unlock(&partition->mutex);
+
+    if (o_res == -1) {
+        log_error("Memory allocation error while getting key '%s' from partition %d", key,
+                  partition_index);
         return -1;
-    default:
-        log_debug("Key '%s' found in memory partition %d", key, partition_index);
     }
 
+    STAT_INC(cache, memory_hits);
+    log_debug("Key '%s' found in memory partition %d", key, partition_index);
     return partition_index;
 }
 
@@ -204,12 +230,21 @@ int pod_cache_evict(pod_cache_t *cache, const char *key) {
     int partition_index = get_partition(hash(key), cache->partition_count);
     log_debug("Evicting from partition %d for key '%s'", partition_index, key);
 
-    int memory_evict_result = lru_cache_evict(cache->partitions[partition_index], key);
+    lru_cache_t *partition = cache->partitions[partition_index];
+
+    pthread_mutex_lock(&partition->mutex);
+    cancel_loads(cache, key);
+    int memory_evict_result = lru_cache_evict(partition, key);
+    // anche con la chiave in memoria: una copia rimasta su disco tornerebbe alla prossima get
+    int cas_evict_result = evict_from_disk(cache, key);
+    if (memory_evict_result == 0 || cas_evict_result == 0) {
+        notify(cache, POD_CACHE_EVENT_DELETE, key, NULL, 0);
+    }
+    pthread_mutex_unlock(&partition->mutex);
+
     if (memory_evict_result == -100) {
         log_debug("Key '%s' not found in memory partition %d, attempting disk storage eviction",
                   key, partition_index);
-        // non trovata in memoria, provo a cancellarla da filesystem
-        int cas_evict_result = cas_evict(key, cache->cas_registry);
         if (cas_evict_result == 0) {
             log_info("Key '%s' successfully removed from disk storage", key);
             return 1;
@@ -228,6 +263,206 @@ int pod_cache_evict(pod_cache_t *cache, const char *key) {
     return 0;
 }
 
+int pod_cache_borrow(pod_cache_t *cache, const char *key, pod_cache_handle_t *handle) {
+    if (!cache || !key || !handle) {
+        log_error("Invalid parameters in pod_cache_borrow");
+        return -1;
+    }
+
+    int partition_index = get_partition(hash(key), cache->partition_count);
+    lru_cache_t *partition = cache->partitions[partition_index];
+
+    pthread_mutex_lock(&partition->mutex);
+    int result = borrow_locked(cache, partition_index, key, handle);
+    pthread_mutex_unlock(&partition->mutex);
+    notify_dropped(cache);
+
+    if (result == -100 && cache->loader && load_missing(cache, key) == 0) {
+        pthread_mutex_lock(&partition->mutex);
+        if (borrow_locked(cache, partition_index, key, handle) == 0) result = 0;
+        pthread_mutex_unlock(&partition->mutex);
+        notify_dropped(cache);
+    }
+    return result;
+}
+
+void pod_cache_release(pod_cache_handle_t *handle) {
+    if (!handle) return;
+    lru_value_unref((void *)handle->value);
+    handle->value = NULL;
+    handle->size = 0;
+}
+
+/* le chiavi vengono raggruppate per partizione: ogni partizione viene bloccata una sola volta
+ * per tutto il batch. Un'unica allocazione: partizione di ogni chiave e partizioni usate */
+static int *batch_partitions(pod_cache_t *cache, size_t count, const char *const *keys,
+                             bool **used_out) {
+    int *partition_of = malloc(count * sizeof(int) + cache->partition_count * sizeof(bool));
+    if (!partition_of) return NULL;
+    bool *used = (bool *)(partition_of + count);
+    memset(used, 0, cache->partition_count * sizeof(bool));
+    *used_out = used;
+    for (size_t i = 0; i < count; i++) {
+        if (!keys[i]) {
+            partition_of[i] = 0;
+            used[0] = true;
+            continue;
+        }
+        partition_of[i] = get_partition(hash(keys[i]), cache->partition_count);
+        used[partition_of[i]] = true;
+    }
+    return partition_of;
+}
+
+int pod_cache_mget(pod_cache_t *cache, size_t count, const char *const *keys,
+                   pod_cache_handle_t *handles, int *results) {
+    if (!cache || !keys || !handles) {
+        log_error("Invalid parameters in pod_cache_mget");
+        return -1;
+    }
+    if (count == 0) return 0;
+
+    bool *used;
+    int *partition_of = batch_partitions(cache, count, keys, &used);
+    if (!partition_of) return -1;
+
+    int found = 0;
+    for (int p = 0; p < cache->partition_count; p++) {
+        if (!used[p]) continue;
+        lru_cache_t *partition = cache->partitions[p];
+        pthread_mutex_lock(&partition->mutex);
+        for (size_t i = 0; i < count; i++) {
+            if (partition_of[i] != p) continue;
+            int rc = keys[i] ? borrow_locked(cache, p, keys[i], &handles[i]) : -1;
+            if (rc != 0) handles[i] = (pod_cache_handle_t){NULL, 0};
+            if (results) results[i] = rc;
+            if (rc == 0) found++;
+        }
+        pthread_mutex_unlock(&partition->mutex);
+    }
+    free(partition_of);
+    notify_dropped(cache);
+    return found;
+}
+
+void pod_cache_release_all(pod_cache_handle_t *handles, size_t count) {
+    if (!handles) return;
+    for (size_t i = 0; i < count; i++) pod_cache_release(&handles[i]);
+}
+
+int pod_cache_mput(pod_cache_t *cache, size_t count, const char *const *keys,
+                   const void *const *values, const size_t *value_sizes, int *results) {
+    if (!cache || !keys || !value_sizes || (!values && !cache->accounting_only)) {
+        log_error("Invalid parameters in pod_cache_mput");
+        return -1;
+    }
+    if (count == 0) return 0;
+
+    bool *used;
+    int *partition_of = batch_partitions(cache, count, keys, &used);
+    if (!partition_of) return -1;
+
+    int stored = 0;
+    for (int p = 0; p < cache->partition_count; p++) {
+        if (!used[p]) continue;
+        lru_cache_t *partition = cache->partitions[p];
+        pthread_mutex_lock(&partition->mutex);
+        for (size_t i = 0; i < count; i++) {
+            if (partition_of[i] != p) continue;
+            const void *value = values ? values[i] : NULL;
+            int rc = -1;
+            if (keys[i] && (value || cache->accounting_only)) {
+                rc = put_locked(cache, p, keys[i], value, value_sizes[i]);
+            }
+            if (results) results[i] = rc;
+            if (rc >= 0) stored++;
+        }
+        pthread_mutex_unlock(&partition->mutex);
+    }
+    free(partition_of);
+    notify_dropped(cache);
+    return stored;
+}
+
+int pod_cache_foreach(pod_cache_t *cache, pod_cache_visit_fn visit, void *ctx) {
+    if (!cache || !visit) return -1;
+
+    for (int p = 0; p < cache->partition_count; p++) {
+        lru_cache_t *partition = cache->partitions[p];
+        pthread_mutex_lock(&partition->mutex);
+        // dalla più recente alla meno recente; visit non deve modificare la cache
+        for (lru_node_t *node = partition->head; node; node = node->next) {
+            int rc = visit(node->key, node->value, node->size, ctx);
+            if (rc != 0) {
+                pthread_mutex_unlock(&partition->mutex);
+                return rc;
+            }
+        }
+        pthread_mutex_unlock(&partition->mutex);
+    }
+    return 0;
+}
+
+typedef struct {
+    pod_cache_t *cache;
+    pod_cache_visit_fn visit;
+    void *ctx;
+} disk_visit_t;
+
+// salta le chiavi ancora in memoria: pod_cache_foreach le visita con il valore corrente
+static int visit_disk_only(const char *key, const void *value, size_t size, void *ctx) {
+    disk_visit_t *disk_visit = ctx;
+    pod_cache_t *cache = disk_visit->cache;
+    lru_cache_t *partition = cache->partitions[get_partition(hash(key), cache->partition_count)];
+    pthread_mutex_lock(&partition->mutex);
+    bool in_memory = lru_cache_contains(partition, key);
+    pthread_mutex_unlock(&partition->mutex);
+    return in_memory ? 0 : disk_visit->visit(key, value, size, disk_visit->ctx);
+}
+
+int pod_cache_foreach_disk(pod_cache_t *cache, pod_cache_visit_fn visit, void *ctx) {
+    if (!cache || !visit) return -1;
+    if (cache->accounting_only) return 0;
+    disk_visit_t disk_visit = {.cache = cache, .visit = visit, .ctx = ctx};
+    return cas_foreach(cache->cas_registry, visit_disk_only, &disk_visit) < 0 ? -1 : 0;
+}
+
+static int notify_cleared(const char *key, const void *value, size_t size, void *ctx) {
+    (void)value;
+    (void)size;
+    notify(ctx, POD_CACHE_EVENT_DELETE, key, NULL, 0);
+    return 0;
+}
+
+void pod_cache_clear(pod_cache_t *cache) {
+    if (!cache) return;
+
+    cancel_loads(cache, NULL);
+    for (int p = 0; p < cache->partition_count; p++) {
+        lru_cache_t *partition = cache->partitions[p];
+        pthread_mutex_lock(&partition->mutex);
+        lru_node_t *tail;
+        while ((tail = lru_cache_get_tail_node(partition)) != NULL) {
+            // le chiavi con una copia su disco vengono notificate da cas_clear
+            if (cache->accounting_only || !cas_contains(cache->cas_registry, tail->key)) {
+                notify(cache, POD_CACHE_EVENT_DELETE, tail->key, NULL, 0);
+            }
+            lru_cache_remove_tail(partition);
+        }
+        pthread_mutex_unlock(&partition->mutex);
+    }
+
+    if (cache->accounting_only) {
+        lru_cache_t *disk = cache->disk_index;
+        while (lru_cache_get_tail_node(disk)) {
+            lru_cache_remove_tail(disk);
+        }
+    } else {
+        cas_clear(cache->cas_registry, notify_cleared, cache);
+    }
+    log_info("Pod cache cleared");
+}
+
 void pod_cache_destroy(pod_cache_t *pod_cache) {
     if (!pod_cache) {
         log_warn("Attempted to destroy NULL pod_cache");
@@ -240,6 +475,7 @@ void pod_cache_destroy(pod_cache_t *pod_cache) {
         log_debug("Destroying CAS registry");
         cas_registry_destroy(pod_cache->cas_registry);
     }
+    if (pod_cache->disk_index) lru_cache_destroy(pod_cache->disk_index);
 
     if (pod_cache->partitions) {
         log_debug("Destroying %d partitions", pod_cache->partition_count);
@@ -252,8 +488,501 @@ void pod_cache_destroy(pod_cache_t *pod_cache) {
         free(pod_cache->partitions); // Libera l'array delle partizioni
     }
 
+    if (pod_cache->sketches) {
+        for (int i = 0; i < pod_cache->partition_count; i++) {
+            freq_sketch_destroy(&pod_cache->sketches[i]);
+        }
+        free(pod_cache->sketches);
+    }
+
+    while (pod_cache->dropped) {
+        pod_cache_dropped_t *next = pod_cache->dropped->next;
+        free(pod_cache->dropped);
+        pod_cache->dropped = next;
+    }
+    pthread_mutex_destroy(&pod_cache->drop_mutex);
+    pthread_mutex_destroy(&pod_cache->flight_mutex);
+    pthread_cond_destroy(&pod_cache->flight_cond);
     free(pod_cache); // Libera la struttura principale alla fine
     log_info("Pod cache destroyed successfully");
 }
 
-static int get_partition(uint32_t hash, u_short partition_count) { return hash % partition_count; }
\ No newline at end of file
+void pod_cache_get_stats(pod_cache_t *cache, pod_cache_stats_t *out) {
+    if (!cache || !out) return;
+
+    out->memory_hits = __atomic_load_n(&cache->stats.memory_hits, __ATOMIC_RELAXED);
+    out->disk_hits = __atomic_load_n(&cache->stats.disk_hits, __ATOMIC_RELAXED);
+    out->misses = __atomic_load_n(&cache->stats.misses, __ATOMIC_RELAXED);
+    out->demotions = __atomic_load_n(&cache->stats.demotions, __ATOMIC_RELAXED);
+    out->clean_demotions = __atomic_load_n(&cache->stats.clean_demotions, __ATOMIC_RELAXED);
+    out->demote_batches = __atomic_load_n(&cache->stats.demote_batches, __ATOMIC_RELAXED);
+    out->promotions = __atomic_load_n(&cache->stats.promotions, __ATOMIC_RELAXED);
+    out->loader_hits = __atomic_load_n(&cache->stats.loader_hits, __ATOMIC_RELAXED);
+    out->disk_rejections = __atomic_load_n(&cache->stats.disk_rejections, __ATOMIC_RELAXED);
+    out->disk_drops = 0;
+    out->disk_syncs = 0;
+    out->disk_bytes = 0;
+    out->disk_capacity = 0;
+    if (cache->accounting_only) {
+        out->disk_bytes = cache->disk_index->current_bytes_size;
+    } else {
+        cas_stats_t disk;
+        cas_get_stats(cache->cas_registry, &disk);
+        out->disk_drops = disk.drops;
+        out->disk_bytes = disk.bytes;
+        out->disk_capacity = disk.max_bytes;
+        out->disk_syncs = disk.syncs;
+    }
+}
+
+void pod_cache_set_disk_capacity(pod_cache_t *cache, size_t bytes) {
+    if (!cache || cache->accounting_only) return;
+    cas_set_limit(cache->cas_registry, bytes, disk_dropped, cache);
+    notify_dropped(cache);
+}
+
+int pod_cache_set_disk_admission(pod_cache_t *cache, unsigned min_reads) {
+    if (!cache) return -1;
+    if (min_reads > FREQ_SKETCH_MAX) min_reads = FREQ_SKETCH_MAX;
+    if (min_reads > 0 && !cache->sketches) {
+        freq_sketch_t *sketches = calloc(cache->partition_count, sizeof(freq_sketch_t));
+        if (!sketches) return -1;
+        for (int i = 0; i < cache->partition_count; i++) {
+            if (freq_sketch_init(&sketches[i],
+                                 cache->partition_capacity / ADMISSION_BYTES_PER_KEY) != 0) {
+                log_error("Failed to allocate the disk admission sketch");
+                while (--i >= 0) freq_sketch_destroy(&sketches[i]);
+                free(sketches);
+                return -1;
+            }
+        }
+        cache->sketches = sketches;
+    }
+    cache->disk_admission = min_reads;
+    return 0;
+}
+
+void pod_cache_set_demote_batch(pod_cache_t *cache, size_t keys, size_t bytes) {
+    if (!cache) return;
+    if (keys < 1) keys = 1;
+    if (keys > DEMOTE_BATCH_MAX) keys = DEMOTE_BATCH_MAX;
+    cache->demote_batch_keys = keys;
+    cache->demote_batch_bytes = bytes;
+}
+
+void pod_cache_set_disk_sync(pod_cache_t *cache, cas_sync_e sync) {
+    if (!cache || cache->accounting_only) return;
+    cas_set_sync(cache->cas_registry, sync);
+}
+
+int pod_cache_set_disk_io(pod_cache_t *cache, disk_io_backend_e backend) {
+    if (!cache || cache->accounting_only) return -1;
+    return cas_set_io(cache->cas_registry, backend);
+}
+
+void pod_cache_set_loader(pod_cache_t *cache, pod_cache_loader_fn fn, void *ctx) {
+    if (!cache || cache->accounting_only) return;
+    cache->loader = fn;
+    cache->loader_ctx = ctx;
+}
+
+int pod_cache_add_listener(pod_cache_t *cache, pod_cache_listener_fn fn, void *ctx) {
+    if (!cache || !fn || cache->listener_count >= POD_CACHE_MAX_LISTENERS) return -1;
+    cache->listeners[cache->listener_count].fn = fn;
+    cache->listeners[cache->listener_count].ctx = ctx;
+    cache->listener_count++;
+    return 0;
+}
+
+static int get_partition(uint32_t hash, u_short partition_count) { return hash % partition_count; }
+
+static void notify(pod_cache_t *cache, pod_cache_event_e event, const char *key,
+                   const void *value, size_t size) {
+    for (int i = 0; i < cache->listener_count; i++) {
+        cache->listeners[i].fn(event, key, value, size, cache->listeners[i].ctx);
+    }
+}
+
+/* libera almeno needed byte dalla coda della partizione e, oltre, fino ai limiti del batch:
+ * le chiavi da scrivere vanno su disco con un solo cas_put_batch (un lock del registry e al più
+ * una sync). Restituisce 0 se almeno una chiave è uscita; il chiamante tiene il mutex della
+ * partizione */
+static int demote_batch(pod_cache_t *cache, int partition_index, size_t needed) {
+    lru_cache_t *partition = cache->partitions[partition_index];
+    lru_node_t *victims[DEMOTE_BATCH_MAX];
+    int record_of[DEMOTE_BATCH_MAX]; // indice in records, oppure VICTIM_CLEAN/VICTIM_REJECTED
+    cas_record_t records[DEMOTE_BATCH_MAX];
+    int results[DEMOTE_BATCH_MAX];
+    size_t batch_bytes = cache->demote_batch_bytes;
+    if (batch_bytes > partition->max_bytes_capacity / DEMOTE_BATCH_PARTITION_SHARE) {
+        batch_bytes = partition->max_bytes_capacity / DEMOTE_BATCH_PARTITION_SHARE;
+    }
+
+    // le vittime sono le ultime count chiavi della lista, dalla coda verso la testa
+    size_t count = 0, writes = 0, freed = 0;
+    for (lru_node_t *node = lru_cache_get_tail_node(partition); node && count < DEMOTE_BATCH_MAX;
+         node = node->prev) {
+        if (freed >= needed && (count >= cache->demote_batch_keys || freed >= batch_bytes)) break;
+        victims[count] = node;
+        if (disk_copy_valid(cache, node->key)) {
+            // promossa e mai modificata: il disco ha già il valore, basta liberare la memoria
+            record_of[count] = VICTIM_CLEAN;
+        } else if (!admit_to_disk(cache, partition_index, node->key)) {
+            // letta troppo poco per valere una scrittura su disco: esce dalla cache
+            record_of[count] = VICTIM_REJECTED;
+        } else {
+            records[writes] = (cas_record_t){node->key, node->value, node->size};
+            record_of[count] = (int)writes++;
+        }
+        freed += node->size;
+        count++;
+    }
+    if (count == 0) {
+        log_error("No tail element found in partition %d", partition_index);
+        return -1;
+    }
+
+    if (writes > 0) {
+        log_debug("Moving %zu keys from memory partition %d to disk", writes, partition_index);
+        if (cache->accounting_only) {
+            for (size_t i = 0; i < writes; i++) {
+                results[i] = lru_cache_put(cache->disk_index, records[i].key, NULL,
+                                           records[i].size) == 0 ? 0 : -1;
+            }
+        } else {
+            cas_put_batch(cache->cas_registry, writes, records, results);
+        }
+        STAT_INC(cache, demote_batches);
+    }
+
+    /* dalla coda, fino alla prima scrittura fallita: le chiavi successive restano in memoria
+     * (se scritte, con una copia pulita su disco) */
+    size_t removed = 0;
+    for (; removed < count; removed++) {
+        lru_node_t *victim = victims[removed];
+        int record = record_of[removed];
+        if (record >= 0 && results[record] != 0) {
+            log_error("Failed to write key '%s' to disk storage, error: %d", victim->key,
+                      results[record]);
+            break;
+        }
+        if (record == VICTIM_REJECTED) {
+            log_debug("Key '%s' not admitted to disk, dropping it", victim->key);
+            notify(cache, POD_CACHE_EVENT_DELETE, victim->key, NULL, 0);
+            STAT_INC(cache, disk_rejections);
+        } else {
+            notify(cache, POD_CACHE_EVENT_DEMOTE, victim->key, NULL, 0);
+            STAT_INC(cache, demotions);
+            if (record == VICTIM_CLEAN) STAT_INC(cache, clean_demotions);
+        }
+        lru_cache_remove_tail(partition);
+    }
+    return removed > 0 ? 0 : -1;
+}
+
+// byte da liberare perché value_size entri nella partizione (lru_cache_put vuole margine)
+static size_t room_needed(const lru_cache_t *partition, size_t value_size) {
+    size_t wanted = partition->current_bytes_size + value_size + 1;
+    return wanted > partition->max_bytes_capacity ? wanted - partition->max_bytes_capacity : 1;
+}
+
+/* legge la chiave dal disco e la riporta in memoria; il chiamante tiene il mutex della
+ * partizione */
+static int promote_from_disk(pod_cache_t *cache, int partition_index, const char *key,
+                             void **out_value, size_t *out_value_size) {
+    if (cache->accounting_only) {
+        if (lru_cache_get(cache->disk_index, key, out_value, out_value_size) != 0) return -1;
+    } else if (cas_get(cache->cas_registry, key, out_value, out_value_size) != 0) {
+        return -1;
+    }
+
+    log_info("Key '%s' found in disk storage, promoting to memory", key);
+
+    // trovato su disco, sposto nella cache in-memory
+    lru_cache_t *partition = cache->partitions[partition_index];
+    int put_result = lru_cache_put(partition, key, *out_value, *out_value_size);
+    /* partizione piena: si libera spazio come per una put. Le chiavi promosse e non modificate
+     * escono senza scritture, quelle che oscillano tra i tier non costano I/O */
+    while (put_result == -900 && *out_value_size < partition->max_bytes_capacity &&
+           lru_cache_get_tail_node(partition)) {
+        if (demote_batch(cache, partition_index, room_needed(partition, *out_value_size)) != 0) {
+            break;
+        }
+        put_result = lru_cache_put(partition, key, *out_value, *out_value_size);
+    }
+    if (put_result < 0) {
+        // la copia su disco resta l'unica, non va rimossa
+        log_warn("Failed to promote key '%s' to memory partition %d, but returning disk value",
+                 key, partition_index);
+        return 0;
+    }
+    STAT_INC(cache, promotions);
+    notify(cache, POD_CACHE_EVENT_PROMOTE, key, *out_value, *out_value_size);
+    log_debug("Successfully promoted key '%s' to memory partition %d", key, partition_index);
+
+    /* la copia su disco resta: finché la chiave non viene modificata (put_locked e evict la
+     * rimuovono) una nuova demotion non deve riscriverla */
+    return 0;
+}
+
+/* inserisce la chiave nella partizione, spostando su disco la coda finché non c'è spazio;
+ * il chiamante tiene il mutex della partizione */
+static int put_locked(pod_cache_t *cache, int partition_index, const char *key, const void *value,
+                      size_t value_size) {
+    lru_cache_t *partition = cache->partitions[partition_index];
+    // non entrerebbe nemmeno con la partizione vuota: nessuna demotion, il valore precedente resta
+    if (value_size >= partition->max_bytes_capacity) {
+        log_error("Value of key '%s' (%zu bytes) larger than memory partition %d", key,
+                  value_size, partition_index);
+        return -1;
+    }
+    /* la copia su disco di un valore precedente non è più valida. Rimossa prima dell'evento
+     * PUT, così una rimozione per budget della stessa chiave non può arrivare dopo */
+    evict_from_disk(cache, key);
+    int put_response = lru_cache_put(partition, key, (void *)value, value_size);
+    if (put_response == -1) {
+        log_error("Failed to put key '%s' in memory partition %d", key, partition_index);
+        return -1;
+    }
+    if (put_response == -900) {
+        log_info("Partition %d full, moving tail elements to disk storage", partition_index);
+        // libero spazio finché il nuovo valore non entra nella partizione
+        bool resident = lru_cache_contains(partition, key);
+        bool demoted_self = false;
+        while (put_response == -900) {
+            if (demote_batch(cache, partition_index, room_needed(partition, value_size)) != 0) {
+                return -1;
+            }
+            if (resident && !demoted_self) demoted_self = !lru_cache_contains(partition, key);
+            put_response = lru_cache_put(partition, key, (void *)value, value_size);
+        }
+        if (put_response < 0) {
+            log_error("Failed to put key '%s' after freeing space in partition %d", key,
+                      partition_index);
+            return -1;
+        }
+        /* la chiave era in coda ed è uscita con il valore precedente: quella copia su disco
+         * sembrerebbe pulita alla prossima demotion e il nuovo valore andrebbe perso */
+        if (demoted_self) evict_from_disk(cache, key);
+        log_info("Successfully stored key '%s' in partition %d after disk eviction", key,
+                 partition_index);
+        notify(cache, POD_CACHE_EVENT_PUT, key, value, value_size);
+        return partition_index;
+    }
+
+    log_debug("Successfully stored key '%s' in partition %d", key, partition_index);
+    notify(cache, POD_CACHE_EVENT_PUT, key, value, value_size);
+    return partition_index;
+}
+
+/* cerca la chiave in memoria e poi su disco e la blocca nell'handle; il chiamante tiene il
+ * mutex della partizione */
+static int borrow_locked(pod_cache_t *cache, int partition_index, const char *key,
+                         pod_cache_handle_t *handle) {
+    lru_cache_t *partition = cache->partitions[partition_index];
+    handle->value = NULL;
+    handle->size = 0;
+    record_read(cache, partition_index, key);
+
+    if (lru_cache_borrow(partition, key, &handle->value, &handle->size) == 0) {
+        STAT_INC(cache, memory_hits);
+        return 0;
+    }
+
+    void *disk_value = NULL;
+    size_t disk_size = 0;
+    if (promote_from_disk(cache, partition_index, key, &disk_value, &disk_size) != 0) {
+        STAT_INC(cache, misses);
+        return -100;
+    }
+    STAT_INC(cache, disk_hits);
+
+    // promossa: il valore in memoria è quello da bloccare, la copia letta da disco non serve
+    if (lru_cache_borrow(partition, key, &handle->value, &handle->size) == 0) {
+        free(disk_value);
+        return 0;
+    }
+    if (cache->accounting_only) {
+        handle->size = disk_size;
+        return 0;
+    }
+
+    // promozione fallita: l'handle tiene una copia privata con lo stesso formato
+    void *copy = lru_value_alloc(disk_size);
+    if (!copy) {
+        free(disk_value);
+        return -1;
+    }
+    memcpy(copy, disk_value, disk_size);
+    free(disk_value);
+    handle->value = copy;
+    handle->size = disk_size;
+    return 0;
+}
+
+/* miss nei tier locali: chiede la chiave al loader e la inserisce in memoria. Single-flight:
+ * se la stessa chiave è già in caricamento si aspetta il risultato del primo, senza una
+ * seconda chiamata. 0 se la chiave è in cache, -100 se il loader non l'ha trovata o se è stata
+ * cancellata durante il caricamento */
+static int load_missing(pod_cache_t *cache, const char *key) {
+    pthread_mutex_lock(&cache->flight_mutex);
+    pod_cache_flight_t *flight = cache->flights;
+    while (flight && strcmp(flight->key, key) != 0) flight = flight->next;
+    if (flight) {
+        flight->waiters++;
+        while (!flight->done) pthread_cond_wait(&cache->flight_cond, &cache->flight_mutex);
+        int result = flight->result;
+        // l'ultimo ad andarsene libera il record, già tolto dalla lista
+        if (--flight->waiters == 0) free(flight);
+        pthread_mutex_unlock(&cache->flight_mutex);
+        return result;
+    }
+
+    size_t key_len = strlen(key);
+    flight = malloc(sizeof(pod_cache_flight_t) + key_len + 1);
+    if (!flight) {
+        pthread_mutex_unlock(&cache->flight_mutex);
+        return -1;
+    }
+    memcpy(flight->key, key, key_len + 1);
+    flight->waiters = 0;
+    flight->done = false;
+    flight->stale = false;
+    flight->next = cache->flights;
+    cache->flights = flight;
+    pthread_mutex_unlock(&cache->flight_mutex);
+
+    int result = -100;
+    void *value = NULL;
+    size_t size = 0;
+    if (cache->loader(key, &value, &size, cache->loader_ctx) == 0) {
+        result = insert_loaded(cache, flight, value, size);
+        free(value);
+    }
+
+    pthread_mutex_lock(&cache->flight_mutex);
+    for (pod_cache_flight_t **it = &cache->flights; *it; it = &(*it)->next) {
+        if (*it == flight) {
+            *it = flight->next;
+            break;
+        }
+    }
+    flight->result = result;
+    flight->done = true;
+    bool release = flight->waiters == 0;
+    pthread_cond_broadcast(&cache->flight_cond);
+    pthread_mutex_unlock(&cache->flight_mutex);
+    if (release) free(flight);
+    return result;
+}
+
+/* inserisce il valore del loader solo se la chiave è ancora assente: una SET arrivata durante
+ * il caricamento ha un valore più recente, una DEL (o una FLUSHALL) ha marcato il caricamento
+ * come stale. Il controllo e l'inserimento avvengono con la partizione bloccata, come le
+ * scritture. 0 se la chiave è in cache (inserita ora o già presente), -100 se è stata
+ * cancellata */
+static int insert_loaded(pod_cache_t *cache, pod_cache_flight_t *flight, const void *value,
+                         size_t size) {
+    const char *key = flight->key;
+    int partition_index = get_partition(hash(key), cache->partition_count);
+    lru_cache_t *partition = cache->partitions[partition_index];
+
+    pthread_mutex_lock(&partition->mutex);
+    pthread_mutex_lock(&cache->flight_mutex);
+    bool stale = flight->stale;
+    pthread_mutex_unlock(&cache->flight_mutex);
+
+    int result = 0;
+    if (stale) {
+        result = -100;
+    } else if (!lru_cache_contains(partition, key) &&
+               !(cache->accounting_only ? lru_cache_contains(cache->disk_index, key)
+                                        : cas_contains(cache->cas_registry, key))) {
+        if (put_locked(cache, partition_index, key, value, size) < 0) {
+            result = -1;
+        } else {
+            STAT_INC(cache, loader_hits);
+        }
+    }
+    pthread_mutex_unlock(&partition->mutex);
+    notify_dropped(cache);
+    return result;
+}
+
+/* marca come stale i caricamenti in corso della chiave, con la sua partizione bloccata così non
+ * si intreccia con insert_loaded. Con key NULL tutti, prima di svuotare le partizioni */
+static void cancel_loads(pod_cache_t *cache, const char *key) {
+    if (!cache->loader) return;
+    pthread_mutex_lock(&cache->flight_mutex);
+    for (pod_cache_flight_t *flight = cache->flights; flight; flight = flight->next) {
+        if (!key || strcmp(flight->key, key) == 0) flight->stale = true;
+    }
+    pthread_mutex_unlock(&cache->flight_mutex);
+}
+
+// 0 se la chiave era su disco ed è stata rimossa, -1 altrimenti
+static int evict_from_disk(pod_cache_t *cache, const char *key) {
+    if (cache->accounting_only) return lru_cache_evict(cache->disk_index, key) == 0 ? 0 : -1;
+    // tier su disco vuoto: niente hash della chiave né lock del registry
+    if (__atomic_load_n(&cache->cas_registry->entries_count, __ATOMIC_RELAXED) == 0) return -1;
+    return cas_evict(key, cache->cas_registry);
+}
+
+/* on_drop del registry, con il suo mutex bloccato e spesso dal thread di un'altra partizione:
+ * la chiave viene solo messa da parte, l'evento parte da notify_dropped */
+static void disk_dropped(const char *key, void *ctx) {
+    pod_cache_t *cache = ctx;
+    size_t key_len = strlen(key);
+    pod_cache_dropped_t *dropped = malloc(sizeof(pod_cache_dropped_t) + key_len + 1);
+    if (!dropped) return;
+    memcpy(dropped->key, key, key_len + 1);
+    pthread_mutex_lock(&cache->drop_mutex);
+    dropped->next = cache->dropped;
+    cache->dropped = dropped;
+    pthread_mutex_unlock(&cache->drop_mutex);
+}
+
+/* DELETE per le chiavi rimosse dal disco, con il mutex della loro partizione come ogni altro
+ * evento: se nel frattempo la chiave è tornata in memoria (SET, promozione) non è più persa e
+ * l'evento non parte. Chiamata senza lock, dopo le operazioni che possono spostare su disco */
+static void notify_dropped(pod_cache_t *cache) {
+    if (!__atomic_load_n(&cache->dropped, __ATOMIC_RELAXED)) return;
+
+    pthread_mutex_lock(&cache->drop_mutex);
+    pod_cache_dropped_t *dropped = cache->dropped;
+    cache->dropped = NULL;
+    pthread_mutex_unlock(&cache->drop_mutex);
+
+    while (dropped) {
+        pod_cache_dropped_t *next = dropped->next;
+        lru_cache_t *partition =
+            cache->partitions[get_partition(hash(dropped->key), cache->partition_count)];
+        pthread_mutex_lock(&partition->mutex);
+        if (!lru_cache_contains(partition, dropped->key) &&
+            !cas_contains(cache->cas_registry, dropped->key)) {
+            notify(cache, POD_CACHE_EVENT_DELETE, dropped->key, NULL, 0);
+        }
+        pthread_mutex_unlock(&partition->mutex);
+        free(dropped);
+        dropped = next;
+    }
+}
+
+// il chiamante tiene il mutex della partizione, che protegge anche il suo sketch
+static void record_read(pod_cache_t *cache, int partition_index, const char *key) {
+    if (cache->sketches) freq_sketch_add(&cache->sketches[partition_index], hash64(key));
+}
+
+static bool admit_to_disk(pod_cache_t *cache, int partition_index, const char *key) {
+    if (cache->disk_admission == 0) return true;
+    return freq_sketch_estimate(&cache->sketches[partition_index], hash64(key)) >=
+           cache->disk_admission;
+}
+
+/* la chiave in memoria ha ancora una copia valida su disco (promossa e non più modificata);
+ * se sì la copia diventa la più recente, come dopo una scrittura */
+static bool disk_copy_valid(pod_cache_t *cache, const char *key) {
+    if (cache->accounting_only) return lru_cache_contains(cache->disk_index, key);
+    if (__atomic_load_n(&cache->cas_registry->entries_count, __ATOMIC_RELAXED) == 0) return false;
+    return cas_touch(cache->cas_registry, key);
+}
@@ -0,0 +1,707 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/replication.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+#include "../include/resp_parser.h"
+
+#define REPL_CHUNK (64 * 1024)           // byte inviati per ogni lettura del backlog
+#define REPL_SNAPSHOT_FLUSH (64 * 1024)  // lo snapshot viene inviato a blocchi
+#define REPL_ACK_INTERVAL_MS 1000
+#define REPL_RETRY_MS 500
+#define REPL_MAX_BUFFER (4 * MAX_STR_LEN)
+
+typedef enum {
+    REPL_STATE_CONNECT, // in attesa di collegarsi al primary
+    REPL_STATE_SYNC,    // snapshot in corso
+    REPL_STATE_CONNECTED,
+} repl_state_e;
+
+typedef struct {
+    bool used;
+    char peer[64];
+    uint64_t ack_offset;
+} replica_slot_t;
+
+/* primary: backlog circolare. backlog_start..backlog_end sono offset assoluti, nel buffer
+ * restano gli ultimi backlog_size byte */
+static pthread_mutex_t backlog_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t backlog_cond = PTHREAD_COND_INITIALIZER;
+static char *backlog = NULL;
+static size_t backlog_size = 0;
+static size_t configured_backlog_size = (size_t)REPL_DEFAULT_BACKLOG_MB * 1024 * 1024;
+static uint64_t backlog_start = 0;
+static uint64_t backlog_end = 0;
+static int backlog_active = 0;  // letto senza lock dal listener
+static int snapshots_running = 0;
+static char replid[REPL_ID_SIZE + 1];
+static replica_slot_t replicas[REPL_MAX_REPLICAS];
+
+// replica
+static pthread_t replica_thread_id;
+static bool replica_started = false;
+static char primary_host[256];
+static int primary_port = 0;
+static char primary_replid[REPL_ID_SIZE + 1] = "?";
+static uint64_t replica_offset = 0;
+static int replica_state = REPL_STATE_CONNECT;
+
+static volatile int repl_stopping = 0;
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static void repl_listener(pod_cache_event_e event, const char *key, const void *value,
+                          size_t size, void *ctx);
+static void backlog_write(const void *data, size_t len);
+static int backlog_enable(void);
+static int send_all(int socket_fd, const void *data, size_t len);
+static int send_snapshot(pod_cache_t *cache, int socket_fd, uint64_t *keys);
+static int stream_backlog(int socket_fd, int slot, uint64_t offset);
+static int register_replica(const char *peer);
+static void read_acks(int socket_fd, int slot, char *buffer, size_t *used, size_t capacity);
+static void *replica_thread(void *arg);
+static int connect_primary(void);
+static int replica_session(pod_cache_t *cache, int socket_fd);
+static void apply_command(pod_cache_t *cache, resp_command_t *cmd);
+static uint64_t now_ms(void);
+
+/* =============================================
+ * primary
+ * ============================================= */
+
+int repl_init(pod_cache_t *cache, size_t size) {
+    if (size > 0) configured_backlog_size = size;
+    return pod_cache_add_listener(cache, repl_listener, NULL);
+}
+
+int repl_serve_replica(pod_cache_t *cache, int socket_fd, const char *peer, const char *id,
+                       const char *offset_str) {
+    if (backlog_enable() != 0) {
+        send_all(socket_fd, "-ERR replication backlog unavailable\r\n", 38);
+        return -1;
+    }
+    int slot = register_replica(peer);
+    if (slot < 0) {
+        send_all(socket_fd, "-ERR too many replicas\r\n", 24);
+        return -1;
+    }
+
+    char *endptr;
+    errno = 0;
+    unsigned long long requested = strtoull(offset_str, &endptr, 10);
+    bool valid_offset = errno == 0 && *endptr == '\0' && offset_str[0] != '-';
+
+    char line[128];
+    uint64_t offset;
+    pthread_mutex_lock(&backlog_mutex);
+    bool partial = valid_offset && strcmp(id, replid) == 0 && requested >= backlog_start &&
+                   requested <= backlog_end;
+    pthread_mutex_unlock(&backlog_mutex);
+
+    int result = 0;
+    if (partial) {
+        offset = requested;
+        int len = snprintf(line, sizeof(line), "+CONTINUE %s\r\n", replid);
+        result = send_all(socket_fd, line, (size_t)len);
+        log_info("Replica %s: partial resync from offset %llu", peer, requested);
+    } else {
+        /* le promozioni vanno nel backlog finché lo snapshot è in corso: una chiave che passa
+         * dal disco alla memoria durante la visita non viene persa */
+        __atomic_add_fetch(&snapshots_running, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_lock(&backlog_mutex);
+        offset = backlog_end;
+        pthread_mutex_unlock(&backlog_mutex);
+
+        int len = snprintf(line, sizeof(line), "+FULLRESYNC %s %llu\r\n", replid,
+                           (unsigned long long)offset);
+        uint64_t keys = 0;
+        log_info("Replica %s: full resync, snapshot at offset %llu", peer,
+                 (unsigned long long)offset);
+        result = send_all(socket_fd, line, (size_t)len);
+        if (result >= 0) result = send_snapshot(cache, socket_fd, &keys);
+        __atomic_sub_fetch(&snapshots_running, 1, __ATOMIC_SEQ_CST);
+        if (result >= 0) {
+            len = snprintf(line, sizeof(line), "+SNAPSHOT-END %llu\r\n", (unsigned long long)keys);
+            result = send_all(socket_fd, line, (size_t)len);
+            log_info("Replica %s: snapshot sent, %llu keys", peer, (unsigned long long)keys);
+        }
+    }
+
+    if (result >= 0) stream_backlog(socket_fd, slot, offset);
+
+    pthread_mutex_lock(&backlog_mutex);
+    replicas[slot].used = false;
+    pthread_mutex_unlock(&backlog_mutex);
+    log_info("Replica %s: disconnected", peer);
+    return -1;
+}
+
+/* =============================================
+ * replica
+ * ============================================= */
+
+int repl_start_replica(pod_cache_t *cache, const char *host, int port) {
+    if (!cache || !host || replica_started) return -1;
+    snprintf(primary_host, sizeof(primary_host), "%s", host);
+    primary_port = port;
+    if (pthread_create(&replica_thread_id, NULL, replica_thread, cache) != 0) {
+        log_error("Failed to create replication thread");
+        return -1;
+    }
+    replica_started = true;
+    log_info("Replica of %s:%d", host, port);
+    return 0;
+}
+
+bool repl_is_replica(void) { return replica_started; }
+
+int repl_format_role(char *buffer, size_t size) {
+    int len;
+    if (replica_started) {
+        static const char *states[] = {"connect", "sync", "connected"};
+        const char *state = states[__atomic_load_n(&replica_state, __ATOMIC_RELAXED)];
+        len = snprintf(buffer, size, "*5\r\n$5\r\nslave\r\n$%zu\r\n%s\r\n:%d\r\n$%zu\r\n%s\r\n:%llu\r\n",
+                       strlen(primary_host), primary_host, primary_port, strlen(state), state,
+                       (unsigned long long)__atomic_load_n(&replica_offset, __ATOMIC_RELAXED));
+        return len >= 0 && (size_t)len < size ? len : -1;
+    }
+
+    pthread_mutex_lock(&backlog_mutex);
+    int count = 0;
+    for (int i = 0; i < REPL_MAX_REPLICAS; i++) {
+        if (replicas[i].used) count++;
+    }
+    len = snprintf(buffer, size, "*3\r\n$6\r\nmaster\r\n:%llu\r\n*%d\r\n",
+                   (unsigned long long)backlog_end, count);
+    for (int i = 0; i < REPL_MAX_REPLICAS && len >= 0 && (size_t)len < size; i++) {
+        if (!replicas[i].used) continue;
+        char ack[24];
+        snprintf(ack, sizeof(ack), "%llu", (unsigned long long)replicas[i].ack_offset);
+        len += snprintf(buffer + len, size - (size_t)len, "*2\r\n$%zu\r\n%s\r\n$%zu\r\n%s\r\n",
+                        strlen(replicas[i].peer), replicas[i].peer, strlen(ack), ack);
+    }
+    pthread_mutex_unlock(&backlog_mutex);
+    return len >= 0 && (size_t)len < size ? len : -1;
+}
+
+void repl_shutdown(void) {
+    repl_stopping = 1;
+    pthread_mutex_lock(&backlog_mutex);
+    pthread_cond_broadcast(&backlog_cond);
+    pthread_mutex_unlock(&backlog_mutex);
+    if (replica_started) {
+        pthread_join(replica_thread_id, NULL);
+        replica_started = false;
+    }
+}
+
+/* =============================================
+ * static functions implementation
+ * ============================================= */
+
+/* chiamato con la partizione bloccata: le modifiche di una chiave entrano nel backlog
+ * nell'ordine in cui sono state applicate */
+static void repl_listener(pod_cache_event_e event, const char *key, const void *value,
+                          size_t size, void *ctx) {
+    (void)ctx;
+    if (!__atomic_load_n(&backlog_active, __ATOMIC_ACQUIRE)) return;
+    if (event == POD_CACHE_EVENT_DEMOTE) return;
+    if (event == POD_CACHE_EVENT_PROMOTE &&
+        __atomic_load_n(&snapshots_running, __ATOMIC_SEQ_CST) == 0) {
+        return;
+    }
+
+    char header[64];
+    size_t key_len = strlen(key);
+    pthread_mutex_lock(&backlog_mutex);
+    if (event == POD_CACHE_EVENT_DELETE) {
+        int len = snprintf(header, sizeof(header), "*2\r\n$3\r\nDEL\r\n$%zu\r\n", key_len);
+        backlog_write(header, (size_t)len);
+        backlog_write(key, key_len);
+        backlog_write("\r\n", 2);
+    } else if (value) {
+        int len = snprintf(header, sizeof(header), "*3\r\n$3\r\nSET\r\n$%zu\r\n", key_len);
+        backlog_write(header, (size_t)len);
+        backlog_write(key, key_len);
+        len = snprintf(header, sizeof(header), "\r\n$%zu\r\n", size);
+        backlog_write(header, (size_t)len);
+        backlog_write(value, size);
+        backlog_write("\r\n", 2);
+    }
+    pthread_cond_broadcast(&backlog_cond);
+    pthread_mutex_unlock(&backlog_mutex);
+}
+
+// il chiamante tiene backlog_mutex
+static void backlog_write(const void *data, size_t len) {
+    const char *src = data;
+    while (len > 0) {
+        size_t pos = (size_t)(backlog_end % backlog_size);
+        size_t chunk = backlog_size - pos < len ? backlog_size - pos : len;
+        memcpy(backlog + pos, src, chunk);
+        src += chunk;
+        len -= chunk;
+        backlog_end += chunk;
+    }
+    if (backlog_end - backlog_start > backlog_size) backlog_start = backlog_end - backlog_size;
+}
+
+// il backlog nasce con la prima replica: senza repliche le scritture non pagano nulla
+static int backlog_enable(void) {
+    pthread_mutex_lock(&backlog_mutex);
+    if (!backlog) {
+        backlog = malloc(configured_backlog_size);
+        if (!backlog) {
+            pthread_mutex_unlock(&backlog_mutex);
+            return -1;
+        }
+        backlog_size = configured_backlog_size;
+
+        // replid casuale: una replica di un'istanza precedente non può fare resync parziale
+        unsigned char random[REPL_ID_SIZE / 2];
+        FILE *fp = fopen("/dev/urandom", "rb");
+        if (!fp || fread(random, 1, sizeof(random), fp) != sizeof(random)) {
+            srand((unsigned)time(NULL) ^ (unsigned)getpid());
+            for (size_t i = 0; i < sizeof(random); i++) {
+                random[i] = (unsigned char)rand();
+            }
+        }
+        if (fp) fclose(fp);
+        for (size_t i = 0; i < sizeof(random); i++) {
+            sprintf(replid + i * 2, "%02x", random[i]);
+        }
+        __atomic_store_n(&backlog_active, 1, __ATOMIC_RELEASE);
+        log_info("Replication backlog enabled: %zu bytes, replid %s", backlog_size, replid);
+    }
+    pthread_mutex_unlock(&backlog_mutex);
+    return 0;
+}
+
+static int send_all(int socket_fd, const void *data, size_t len) {
+    const char *src = data;
+    size_t sent = 0;
+    while (sent < len) {
+        ssize_t n = send(socket_fd, src + sent, len - sent, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        sent += (size_t)n;
+    }
+    return (int)sent;
+}
+
+typedef struct {
+    int socket_fd;
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    uint64_t keys;
+    int error;
+} snapshot_writer_t;
+
+static int snapshot_flush(snapshot_writer_t *writer) {
+    if (writer->used > 0 && send_all(writer->socket_fd, writer->buffer, writer->used) < 0) {
+        writer->error = 1;
+        return -1;
+    }
+    writer->used = 0;
+    return 0;
+}
+
+// accoda un SET allo snapshot e lo invia a blocchi di 64 KB; mai con una partizione bloccata
+static int snapshot_visit(const char *key, const void *value, size_t size, void *ctx) {
+    snapshot_writer_t *writer = ctx;
+    if (!value) return 0;
+
+    size_t key_len = strlen(key);
+    size_t needed = key_len + size + 64;
+    if (writer->used + needed > writer->capacity) {
+        if (snapshot_flush(writer) != 0) return 1;
+        if (needed > writer->capacity) {
+            char *grown = realloc(writer->buffer, needed);
+            if (!grown) {
+                writer->error = 1;
+                return 1;
+            }
+            writer->buffer = grown;
+            writer->capacity = needed;
+        }
+    }
+    char *dst = writer->buffer + writer->used;
+    int len = sprintf(dst, "*3\r\n$3\r\nSET\r\n$%zu\r\n", key_len);
+    memcpy(dst + len, key, key_len);
+    len += (int)key_len;
+    len += sprintf(dst + len, "\r\n$%zu\r\n", size);
+    memcpy(dst + len, value, size);
+    len += (int)size;
+    memcpy(dst + len, "\r\n", 2);
+    writer->used += (size_t)len + 2;
+    writer->keys++;
+    if (writer->used >= REPL_SNAPSHOT_FLUSH && snapshot_flush(writer) != 0) return 1;
+    return 0;
+}
+
+typedef struct {
+    char **keys;
+    size_t count;
+    size_t capacity;
+} snapshot_keys_t;
+
+// visita della memoria, con la partizione bloccata: solo una copia del nome della chiave
+static int collect_key(const char *key, const void *value, size_t size, void *ctx) {
+    (void)value;
+    (void)size;
+    snapshot_keys_t *list = ctx;
+    if (list->count == list->capacity) {
+        size_t capacity = list->capacity ? list->capacity * 2 : 1024;
+        char **grown = realloc(list->keys, capacity * sizeof(char *));
+        if (!grown) return 1;
+        list->keys = grown;
+        list->capacity = capacity;
+    }
+    list->keys[list->count] = strdup(key);
+    if (!list->keys[list->count]) return 1;
+    list->count++;
+    return 0;
+}
+
+/* prima la memoria, poi il disco: una chiave spostata su disco dopo la visita della sua
+ * partizione viene vista sul disco, una promossa finisce nel backlog. Le chiavi in memoria
+ * vengono elencate con la partizione bloccata, i valori letti uno alla volta con borrow:
+ * una replica lenta rallenta solo il proprio snapshot, non le GET/SET sulla partizione. Una
+ * chiave modificata o rimossa dopo l'elenco viene inviata col valore corrente o saltata, il
+ * backlog porta comunque la modifica */
+static int send_snapshot(pod_cache_t *cache, int socket_fd, uint64_t *keys) {
+    snapshot_writer_t writer = {.socket_fd = socket_fd, .capacity = REPL_SNAPSHOT_FLUSH * 2};
+    snapshot_keys_t list = {0};
+    writer.buffer = malloc(writer.capacity);
+    if (!writer.buffer) return -1;
+
+    if (pod_cache_foreach(cache, collect_key, &list) != 0) writer.error = 1;
+    for (size_t i = 0; i < list.count; i++) {
+        pod_cache_handle_t handle;
+        if (!writer.error && pod_cache_borrow(cache, list.keys[i], &handle) == 0) {
+            snapshot_visit(list.keys[i], handle.value, handle.size, &writer);
+            pod_cache_release(&handle);
+        }
+        free(list.keys[i]);
+    }
+    free(list.keys);
+    if (!writer.error) pod_cache_foreach_disk(cache, snapshot_visit, &writer);
+    if (!writer.error) snapshot_flush(&writer);
+
+    free(writer.buffer);
+    *keys = writer.keys;
+    return writer.error ? -1 : 0;
+}
+
+static int stream_backlog(int socket_fd, int slot, uint64_t offset) {
+    char *chunk = malloc(REPL_CHUNK);
+    char acks[256];
+    size_t acks_used = 0;
+    if (!chunk) return -1;
+
+    int result = 0;
+    while (!repl_stopping) {
+        pthread_mutex_lock(&backlog_mutex);
+        if (offset == backlog_end) {
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += 1;
+            pthread_cond_timedwait(&backlog_cond, &backlog_mutex, &deadline);
+        }
+        if (offset < backlog_start) {
+            // la replica è rimasta indietro più della dimensione del backlog
+            pthread_mutex_unlock(&backlog_mutex);
+            log_warn("Replica %s: fell behind the backlog, dropping it", replicas[slot].peer);
+            result = -1;
+            break;
+        }
+        size_t len = (size_t)(backlog_end - offset);
+        if (len > REPL_CHUNK) len = REPL_CHUNK;
+        size_t pos = (size_t)(offset % backlog_size);
+        size_t first = backlog_size - pos < len ? backlog_size - pos : len;
+        memcpy(chunk, backlog + pos, first);
+        memcpy(chunk + first, backlog, len - first);
+        pthread_mutex_unlock(&backlog_mutex);
+
+        if (len > 0) {
+            if (send_all(socket_fd, chunk, len) < 0) {
+                result = -1;
+                break;
+            }
+            offset += len;
+        }
+
+        // ACK della replica o connessione chiusa
+        struct pollfd pfd = {.fd = socket_fd, .events = POLLIN};
+        if (poll(&pfd, 1, 0) > 0) {
+            if (pfd.revents & (POLLHUP | POLLERR)) break;
+            ssize_t n = recv(socket_fd, acks + acks_used, sizeof(acks) - acks_used - 1, 0);
+            if (n <= 0) break;
+            acks_used += (size_t)n;
+            read_acks(socket_fd, slot, acks, &acks_used, sizeof(acks));
+        }
+    }
+    free(chunk);
+    return result;
+}
+
+static int register_replica(const char *peer) {
+    pthread_mutex_lock(&backlog_mutex);
+    for (int i = 0; i < REPL_MAX_REPLICAS; i++) {
+        if (!replicas[i].used) {
+            replicas[i].used = true;
+            replicas[i].ack_offset = 0;
+            snprintf(replicas[i].peer, sizeof(replicas[i].peer), "%s", peer ? peer : "?");
+            pthread_mutex_unlock(&backlog_mutex);
+            return i;
+        }
+    }
+    pthread_mutex_unlock(&backlog_mutex);
+    return -1;
+}
+
+static void read_acks(int socket_fd, int slot, char *buffer, size_t *used, size_t capacity) {
+    (void)socket_fd;
+    size_t processed = 0;
+    while (processed < *used) {
+        resp_command_t cmd;
+        int consumed = resp_parse(buffer + processed, *used - processed, &cmd);
+        if (consumed <= 0) {
+            if (consumed < 0) processed = *used; // spazzatura: la scarto
+            break;
+        }
+        if (cmd.arg_count >= 2 && strcasecmp(cmd.command, "REPLCONF") == 0 &&
+            strcasecmp(cmd.args[0], "ACK") == 0) {
+            uint64_t ack = strtoull(cmd.args[1], NULL, 10);
+            pthread_mutex_lock(&backlog_mutex);
+            replicas[slot].ack_offset = ack;
+            pthread_mutex_unlock(&backlog_mutex);
+        }
+        resp_command_free(&cmd);
+        processed += (size_t)consumed;
+    }
+    memmove(buffer, buffer + processed, *used - processed);
+    *used -= processed;
+    if (*used >= capacity - 1) *used = 0;
+}
+
+static void *replica_thread(void *arg) {
+    pod_cache_t *cache = arg;
+    while (!repl_stopping) {
+        __atomic_store_n(&replica_state, REPL_STATE_CONNECT, __ATOMIC_RELAXED);
+        int socket_fd = connect_primary();
+        if (socket_fd >= 0) {
+            replica_session(cache, socket_fd);
+            close(socket_fd);
+        }
+        if (repl_stopping) break;
+        usleep(REPL_RETRY_MS * 1000);
+    }
+    return NULL;
+}
+
+static int connect_primary(void) {
+    char port[16];
+    snprintf(port, sizeof(port), "%d", primary_port);
+    struct addrinfo hints = {.ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM};
+    struct addrinfo *result = NULL;
+    if (getaddrinfo(primary_host, port, &hints, &result) != 0) {
+        log_warn("Replication: cannot resolve %s", primary_host);
+        return -1;
+    }
+
+    int socket_fd = -1;
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+        socket_fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (socket_fd < 0) continue;
+        if (connect(socket_fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        close(socket_fd);
+        socket_fd = -1;
+    }
+    freeaddrinfo(result);
+    if (socket_fd < 0) {
+        log_debug("Replication: cannot connect to %s:%d", primary_host, primary_port);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return socket_fd;
+}
+
+// riga +... terminata da \r\n all'inizio del buffer: lunghezza compresa \r\n, 0 se incompleta
+static size_t status_line(const char *buffer, size_t used) {
+    for (size_t i = 1; i < used; i++) {
+        if (buffer[i - 1] == '\r' && buffer[i] == '\n') return i + 1;
+    }
+    return 0;
+}
+
+static int replica_session(pod_cache_t *cache, int socket_fd) {
+    char request[128];
+    const char *offset = strcmp(primary_replid, "?") == 0 ? "-1" : NULL;
+    char offset_buf[24];
+    if (!offset) {
+        snprintf(offset_buf, sizeof(offset_buf), "%llu", (unsigned long long)replica_offset);
+        offset = offset_buf;
+    }
+    int len = snprintf(request, sizeof(request), "*3\r\n$5\r\nPSYNC\r\n$%zu\r\n%s\r\n$%zu\r\n%s\r\n",
+                       strlen(primary_replid), primary_replid, strlen(offset), offset);
+    if (send_all(socket_fd, request, (size_t)len) < 0) return -1;
+
+    size_t capacity = REPL_CHUNK * 2;
+    char *buffer = malloc(capacity);
+    if (!buffer) return -1;
+    size_t used = 0;
+    bool handshake = true;
+    bool snapshot = false;
+    uint64_t last_ack = now_ms();
+
+    __atomic_store_n(&replica_state, REPL_STATE_SYNC, __ATOMIC_RELAXED);
+    while (!repl_stopping) {
+        struct pollfd pfd = {.fd = socket_fd, .events = POLLIN};
+        int ready = poll(&pfd, 1, REPL_ACK_INTERVAL_MS);
+        if (ready < 0 && errno != EINTR) break;
+
+        if (ready > 0) {
+            if (used == capacity) {
+                if (capacity >= REPL_MAX_BUFFER) {
+                    log_error("Replication: command too large, resyncing");
+                    strcpy(primary_replid, "?");
+                    break;
+                }
+                char *grown = realloc(buffer, capacity * 2);
+                if (!grown) break;
+                buffer = grown;
+                capacity *= 2;
+            }
+            ssize_t n = recv(socket_fd, buffer + used, capacity - used, 0);
+            if (n <= 0) break;
+            used += (size_t)n;
+        }
+
+        size_t processed = 0;
+        bool failed = false;
+        while (processed < used) {
+            char *data = buffer + processed;
+            size_t available = used - processed;
+
+            if (data[0] == '+' || data[0] == '-') {
+                size_t line_len = status_line(data, available);
+                if (line_len == 0) break;
+                data[line_len - 2] = '\0';
+                if (handshake && strncmp(data, "+FULLRESYNC ", 12) == 0) {
+                    char id[REPL_ID_SIZE + 1];
+                    unsigned long long start;
+                    if (sscanf(data + 12, "%40s %llu", id, &start) != 2) {
+                        failed = true;
+                        break;
+                    }
+                    log_info("Replication: full resync from %s:%d", primary_host, primary_port);
+                    // lo snapshot sostituisce tutto il contenuto della replica
+                    pod_cache_clear(cache);
+                    strcpy(primary_replid, id);
+                    __atomic_store_n(&replica_offset, (uint64_t)start, __ATOMIC_RELAXED);
+                    snapshot = true;
+                } else if (handshake && strncmp(data, "+CONTINUE", 9) == 0) {
+                    log_info("Replication: partial resync from offset %llu",
+                             (unsigned long long)replica_offset);
+                    __atomic_store_n(&replica_state, REPL_STATE_CONNECTED, __ATOMIC_RELAXED);
+                } else if (snapshot && strncmp(data, "+SNAPSHOT-END", 13) == 0) {
+                    log_info("Replication: snapshot loaded (%s keys)", data + 14);
+                    snapshot = false;
+                    __atomic_store_n(&replica_state, REPL_STATE_CONNECTED, __ATOMIC_RELAXED);
+                } else if (data[0] == '-') {
+                    log_error("Replication: primary replied %s", data);
+                    failed = true;
+                    break;
+                }
+                handshake = false;
+                processed += line_len;
+                continue;
+            }
+
+            resp_command_t cmd;
+            int consumed = resp_parse(data, available, &cmd);
+            if (consumed == 0) break;
+            if (consumed < 0) {
+                log_error("Replication: protocol error, resyncing");
+                strcpy(primary_replid, "?");
+                failed = true;
+                break;
+            }
+            apply_command(cache, &cmd);
+            resp_command_free(&cmd);
+            processed += (size_t)consumed;
+            // l'offset conta solo lo stream del backlog, non lo snapshot
+            if (!snapshot) {
+                __atomic_add_fetch(&replica_offset, (uint64_t)consumed, __ATOMIC_RELAXED);
+            }
+        }
+        memmove(buffer, buffer + processed, used - processed);
+        used -= processed;
+        if (failed) break;
+
+        if (!handshake && !snapshot && now_ms() - last_ack >= REPL_ACK_INTERVAL_MS) {
+            char ack[24];
+            char message[96];
+            snprintf(ack, sizeof(ack), "%llu", (unsigned long long)replica_offset);
+            len = snprintf(message, sizeof(message),
+                           "*3\r\n$8\r\nREPLCONF\r\n$3\r\nACK\r\n$%zu\r\n%s\r\n", strlen(ack), ack);
+            if (send_all(socket_fd, message, (size_t)len) < 0) break;
+            last_ack = now_ms();
+        }
+    }
+
+    // uno snapshot interrotto non può essere ripreso: alla prossima connessione serve un full
+    if (snapshot || handshake) strcpy(primary_replid, "?");
+    free(buffer);
+    log_warn("Replication: disconnected from %s:%d", primary_host, primary_port);
+    return 0;
+}
+
+static void apply_command(pod_cache_t *cache, resp_command_t *cmd) {
+    switch (resp_decode_command(cmd->command)) {
+    case RESP_SET:
+        if (cmd->arg_count >= 2) {
+            if (pod_cache_put(cache, cmd->args[0], cmd->args[1], strlen(cmd->args[1])) < 0) {
+                log_warn("Replication: failed to apply SET %s", cmd->args[0]);
+            }
+        }
+        break;
+    case RESP_DEL:
+        if (cmd->arg_count >= 1) pod_cache_evict(cache, cmd->args[0]);
+        break;
+    default:
+        break;
+    }
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
@@ -75,8 +75,9 @@ static parse_result_t read_integer(buffer_t *buf, int *result) {
     return PARSE_OK;
 }
 
-// Alloca e copia una stringa
-static char* strndup_safe(const char *src, size_t len) {
+// Alloca e copia una stringa (dall'arena se presente)
+static char* strndup_safe(const char *src, size_t len, arena_t *arena) {
+    if (arena) return arena_strndup(arena, src, len);
     char *dest = malloc(len + 1);
     if (!dest) return NULL;
 
@@ -86,7 +87,9 @@ static char* strndup_safe(const char *src, size_t len) {
 }
 
 // Legge una bulk string
-static parse_result_t read_bulk_string(buffer_t *buf, char **result) {
+static parse_result_t read_bulk_string(buffer_t *buf, char **result, arena_t *arena) {
+    // il comando può essere spezzato tra due recv() proprio prima di un elemento
+    if (!buffer_has_bytes(buf, 1)) return PARSE_INCOMPLETE;
     if (buffer_peek(buf) != '$') return PARSE_ERROR;
 
     buffer_skip(buf, 1); // Salta '$'
@@ -107,17 +110,15 @@ static parse_result_t read_bulk_string(buffer_t *buf, char **result) {
     if (!buffer_has_bytes(buf, str_len + 2)) return PARSE_INCOMPLETE;
 
     // Alloca e copia i dati
-    *result = strndup_safe(buf->data + buf->pos, str_len);
-    if (!*result) return PARSE_ERROR;
-
     // Verifica CRLF finale
     if (buf->data[buf->pos + str_len] != '\r' ||
         buf->data[buf->pos + str_len + 1] != '\n') {
-        free(*result);
-        *result = NULL;
         return PARSE_ERROR;
     }
 
+    *result = strndup_safe(buf->data + buf->pos, str_len, arena);
+    if (!*result) return PARSE_ERROR;
+
     buffer_skip(buf, str_len + 2);
     return PARSE_OK;
 }
@@ -132,8 +133,8 @@ static void free_string_array(char **strings, int count) {
     free(strings);
 }
 
-// Parsing principale
-int resp_parse(const char *data, size_t len, resp_command_t *out) {
+// Parsing principale: con arena tutte le allocazioni vengono dall'arena
+static int parse(const char *data, size_t len, resp_command_t *out, arena_t *arena) {
     if (!data || !out || len < MIN_BUFFER_SIZE) {
         return len < MIN_BUFFER_SIZE ? PARSE_INCOMPLETE : PARSE_ERROR;
     }
@@ -154,24 +155,31 @@ int resp_parse(const char *data, size_t len, resp_command_t *out) {
     if (num_elements <= 0 || num_elements > MAX_ARGS) return PARSE_ERROR;
 
     // Alloca array per tutti gli elementi
-    char **elements = calloc(num_elements, sizeof(char*));
+    char **elements = arena ? arena_alloc(arena, num_elements * sizeof(char *))
+                            : calloc(num_elements, sizeof(char *));
     if (!elements) return PARSE_ERROR;
 
     // Legge tutti gli elementi
     for (int i = 0; i < num_elements; i++) {
-        res = read_bulk_string(&buf, &elements[i]);
+        res = read_bulk_string(&buf, &elements[i], arena);
         if (res != PARSE_OK) {
-            free_string_array(elements, i); // Libera solo quelli letti
+            if (!arena) free_string_array(elements, i); // Libera solo quelli letti
             return res;
         }
     }
 
     // Assegna comando (primo elemento)
     out->command = elements[0];
+    out->arg_count = num_elements - 1;
+
+    // nell'arena gli argomenti restano nello stesso array, senza copia
+    if (arena) {
+        out->args = out->arg_count > 0 ? elements + 1 : NULL;
+        return (int)buf.pos;
+    }
 
     // Assegna argomenti (resto degli elementi)
     if (num_elements > 1) {
-        out->arg_count = num_elements - 1;
         out->args = malloc(out->arg_count * sizeof(char*));
         if (!out->args) {
             free_string_array(elements, num_elements);
@@ -185,6 +193,14 @@ int resp_parse(const char *data, size_t len, resp_command_t *out) {
     return (int)buf.pos; // Byte consumati
 }
 
+int resp_parse(const char *data, size_t len, resp_command_t *out) {
+    return parse(data, len, out, NULL);
+}
+
+int resp_parse_arena(const char *data, size_t len, resp_command_t *out, arena_t *arena) {
+    return parse(data, len, out, arena);
+}
+
 void resp_command_free(resp_command_t *cmd) {
     if (!cmd) return;
 
@@ -194,45 +210,126 @@ void resp_command_free(resp_command_t *cmd) {
     *cmd = (resp_command_t){0}; // Reset completo
 }
 
-// Lookup table per comandi (più efficiente di strcasecmp multipli)
-static const struct {
-    const char *name;
-    resp_command_e value;
-} command_table[] = {
-    {"PING", RESP_PING},
-    {"QUIT", RESP_QUIT},
-    {"SET", RESP_SET},
-    {"GET", RESP_GET},
-    {"DEL", RESP_DEL},
-    {"CLIENT", RESP_CLIENT},
-    { "INCR", RESP_INCR},
-    {NULL, RESP_UNKNOW}
+// metadati per comando: arity e chiave come in Redis (PEERGET è servito solo localmente)
+static const resp_command_info_t command_info[RESP_COMMAND_COUNT] = {
+    [RESP_PING] = {"PING", -1, 0, 0},
+    [RESP_QUIT] = {"QUIT", -1, 0, 0},
+    [RESP_SET] = {"SET", -3, RESP_CMD_WRITE, 1},
+    [RESP_GET] = {"GET", 2, 0, 1},
+    [RESP_DEL] = {"DEL", -2, RESP_CMD_WRITE, 1},
+    [RESP_UNLINK] = {"UNLINK", -2, RESP_CMD_WRITE, 1},
+    [RESP_CLIENT] = {"CLIENT", -2, 0, 0},
+    [RESP_INCR] = {"INCR", 2, RESP_CMD_WRITE, 1},
+    [RESP_HELLO] = {"HELLO", -1, 0, 0},
+    [RESP_PSYNC] = {"PSYNC", -3, 0, 0},
+    [RESP_REPLCONF] = {"REPLCONF", -1, 0, 0},
+    [RESP_ROLE] = {"ROLE", 1, 0, 0},
+    [RESP_CLUSTER] = {"CLUSTER", -2, 0, 0},
+    [RESP_ASKING] = {"ASKING", 1, 0, 0},
+    [RESP_MIGRATE] = {"MIGRATE", -6, 0, 0},
+    [RESP_PEERGET] = {"PEERGET", 2, 0, 0},
 };
 
-// Converte stringa a maiuscolo in-place (per confronto)
-static void str_toupper(char *str) {
-    for (; *str; str++) {
-        *str = toupper((unsigned char)*str);
+// il resto del nome (lunghezza già verificata) è upper, senza distinguere maiuscole
+static bool name_is(const char *name, const char *upper) {
+    for (; *upper; name++, upper++) {
+        char c = *name;
+        if (c >= 'a' && c <= 'z') c = (char)(c - 'a' + 'A');
+        if (c != *upper) return false;
     }
+    return true;
 }
 
-resp_command_e resp_decode_command(const char *command) {
-    if (!command) return RESP_UNKNOW;
-
-    // Copia e converte a maiuscolo per confronto
-    size_t len = strlen(command);
-    if (len > 32) return RESP_UNKNOW; // Comando troppo lungo
+#define MATCH(upper, command) return name_is(name, upper) ? (command) : RESP_UNKNOW
 
-    char upper_cmd[33];
-    strcpy(upper_cmd, command);
-    str_toupper(upper_cmd);
+resp_command_e resp_decode_command(const char *name) {
+    if (!name) return RESP_UNKNOW;
 
-    // Cerca nella lookup table
-    for (int i = 0; command_table[i].name; i++) {
-        if (strcmp(upper_cmd, command_table[i].name) == 0) {
-            return command_table[i].value;
+    // un nuovo comando va aggiunto qui e in command_info
+    size_t len = strnlen(name, 9);
+    char first = (char)(name[0] & ~0x20); // maiuscola per le lettere
+    switch (len) {
+    case 3:
+        switch (first) {
+        case 'S': MATCH("SET", RESP_SET);
+        case 'G': MATCH("GET", RESP_GET);
+        case 'D': MATCH("DEL", RESP_DEL);
         }
+        break;
+    case 4:
+        switch (first) {
+        case 'P': MATCH("PING", RESP_PING);
+        case 'Q': MATCH("QUIT", RESP_QUIT);
+        case 'I': MATCH("INCR", RESP_INCR);
+        case 'R': MATCH("ROLE", RESP_ROLE);
+        }
+        break;
+    case 5:
+        switch (first) {
+        case 'H': MATCH("HELLO", RESP_HELLO);
+        case 'P': MATCH("PSYNC", RESP_PSYNC);
+        }
+        break;
+    case 6:
+        switch (first) {
+        case 'C': MATCH("CLIENT", RESP_CLIENT);
+        case 'U': MATCH("UNLINK", RESP_UNLINK);
+        case 'A': MATCH("ASKING", RESP_ASKING);
+        }
+        break;
+    case 7:
+        switch (first) {
+        case 'C': MATCH("CLUSTER", RESP_CLUSTER);
+        case 'M': MATCH("MIGRATE", RESP_MIGRATE);
+        case 'P': MATCH("PEERGET", RESP_PEERGET);
+        }
+        break;
+    case 8:
+        if (first == 'R') MATCH("REPLCONF", RESP_REPLCONF);
+        break;
     }
-
     return RESP_UNKNOW;
-}
\ No newline at end of file
+}
+
+#undef MATCH
+
+const resp_command_info_t *resp_command_info(resp_command_e command) {
+    if ((unsigned)command >= RESP_COMMAND_COUNT || !command_info[command].name) return NULL;
+    return &command_info[command];
+}
+
+// coppie di cifre "00".."99": due cifre per divisione
+static const char digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+size_t resp_encode_integer(char *out, char prefix, long long value) {
+    // in unsigned: anche LLONG_MIN ha un valore assoluto rappresentabile
+    unsigned long long n = value < 0 ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+    unsigned digits = 1;
+    for (unsigned long long limit = 10; digits < 20 && n >= limit; limit *= 10) digits++;
+
+    size_t len = 0;
+    out[len++] = prefix;
+    if (value < 0) out[len++] = '-';
+    len += digits;
+
+    // cifre scritte da destra, direttamente in out
+    char *p = out + len;
+    while (n >= 100) {
+        unsigned idx = (unsigned)(n % 100) * 2;
+        n /= 100;
+        *--p = digit_pairs[idx + 1];
+        *--p = digit_pairs[idx];
+    }
+    if (n >= 10) {
+        *--p = digit_pairs[n * 2 + 1];
+        *--p = digit_pairs[n * 2];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    out[len++] = '\r';
+    out[len++] = '\n';
+    return len;
+}
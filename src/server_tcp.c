@@ -5,33 +5,58 @@
  * License: AGPL 3
  */
 
+#define _GNU_SOURCE // accept4
 #include "server_tcp.h"
 #include <arpa/inet.h>
 #include <errno.h>
 #include <netinet/in.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "clogger.h"
+#include "cluster.h"
+#include "peer.h"
 #include "pod_cache.h"
 #include "resp_parser.h"
+#include "replication.h"
+#include "trace.h"
 
 static server_state_t g_server = {0};
 
 // Forward declarations
 static void cleanup_server(void);
 static int setup_server_socket(int port);
+static int setup_unix_socket(const char *path, mode_t perm);
+static void accept_clients(int listen_fd, bool is_unix);
+static void start_client(int client_fd, struct sockaddr_in *addr);
+static bool admit_client(int client_fd);
+static int setup_connection_limits(void);
+static void idle_timer_start(client_ctx_t *client);
+static void idle_timer_stop(client_ctx_t *client);
+static void idle_expired(timer_entry_t *entry, void *ctx);
+static void *idle_reaper(void *arg);
+static uint64_t monotonic_seconds(void);
 static void *client_handler_thread(void *arg);
-static int send_formatted_response(int socket_fd, const char *format, ...);
-static int send_integer_response(int socket_fd, long val);
-static int send_ok_response(int socket_fd, const char *message);
-static int send_error_response(int socket_fd, const char *error);
-static int send_bulk_string_response(int socket_fd, const char *str);
+static int send_formatted_response(client_ctx_t *client, const char *format, ...);
+static int send_integer_response(client_ctx_t *client, long val);
+static int send_ok_response(client_ctx_t *client, const char *message);
+static int send_error_response(client_ctx_t *client, const char *error);
+static int send_bulk_string_response(client_ctx_t *client, const char *str);
+static int send_bulk_value_response(client_ctx_t *client, pod_cache_handle_t *handle);
+static int send_parts(client_ctx_t *client, const char *prefix, size_t prefix_len,
+                      const char *body, size_t body_len);
 static int handle_ping(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
 static int handle_set(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
 static int handle_get(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
@@ -39,7 +64,27 @@ static int handle_quit(client_ctx_t *client, pod_cache_t *cache, resp_command_t
 static int handle_client_cmd(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
 static int handle_incr(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
 static int handle_del(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_hello(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_psync(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_replconf(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_role(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int setup_replication(pod_cache_t *cache);
+static int handle_cluster(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_asking(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int handle_migrate(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int send_owned_reply(client_ctx_t *client, char *reply, size_t len);
+static int parse_slot(const char *value);
+static int setup_cluster(pod_cache_t *cache);
+static int handle_peerget(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static int setup_peers(pod_cache_t *cache);
+static int handle_client_tracking(client_ctx_t *client, resp_command_t *cmd);
+static int send_invalidations(client_ctx_t *client);
+static int queue_reply(client_ctx_t *client, const char *data, size_t len);
+static int wait_readable(client_ctx_t *client);
+static void tracking_listener(pod_cache_event_e event, const char *key, const void *value,
+                              size_t size, void *ctx);
 static int dispatch_command(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd);
+static void trace_command(resp_command_e cmd_type, const resp_command_t *cmd);
 static void buffer_init(command_buffer_t *buf);
 static bool buffer_append(command_buffer_t *buf, const void *data, size_t len);
 static void buffer_consume(command_buffer_t *buf, size_t bytes);
@@ -47,7 +92,11 @@ static client_ctx_t *create_client_context(int socket_fd, struct sockaddr_in *ad
 static void destroy_client_context(client_ctx_t *client);
 static void *client_handler_thread(void *arg);
 static int get_env_int(const char *env_name, int default_value, int min_val, int max_val);
+static mode_t get_env_mode(const char *env_name, mode_t default_value);
 static int get_server_port(void);
+static int setup_shm_index(pod_cache_t *cache, const char *name);
+static void shm_index_listener(pod_cache_event_e event, const char *key, const void *value,
+                               size_t size, void *ctx);
 static pod_cache_t *initialize_cache(void);
 static void signal_handler(int sig);
 static int setup_server_socket(int port);
@@ -55,17 +104,24 @@ static void cleanup_server(void);
 static void setup_signal_handlers(void);
 static void *display_cache_status(void *args);
 
-// Command dispatch table
-static const command_handler_t command_handlers[] = {
-    {RESP_PING, "PING", handle_ping},
-    {RESP_SET, "SET", handle_set},
-    {RESP_GET, "GET", handle_get},
-    {RESP_QUIT, "QUIT", handle_quit},
-    {RESP_CLIENT, "CLIENT", handle_client_cmd},
-    {RESP_INCR, "INCR", handle_incr},
-    {RESP_DEL, "DEL", handle_del},
-    {RESP_UNLINK, "UNLINK", handle_del},
-    {RESP_UNKNOW, NULL, NULL} // Sentinel
+// Command dispatch table, indicizzata per comando (metadati in resp_command_info)
+static const command_handler_fn command_handlers[RESP_COMMAND_COUNT] = {
+    [RESP_PING] = handle_ping,
+    [RESP_SET] = handle_set,
+    [RESP_GET] = handle_get,
+    [RESP_QUIT] = handle_quit,
+    [RESP_CLIENT] = handle_client_cmd,
+    [RESP_INCR] = handle_incr,
+    [RESP_DEL] = handle_del,
+    [RESP_UNLINK] = handle_del,
+    [RESP_HELLO] = handle_hello,
+    [RESP_PSYNC] = handle_psync,
+    [RESP_REPLCONF] = handle_replconf,
+    [RESP_ROLE] = handle_role,
+    [RESP_CLUSTER] = handle_cluster,
+    [RESP_ASKING] = handle_asking,
+    [RESP_MIGRATE] = handle_migrate,
+    [RESP_PEERGET] = handle_peerget,
 };
 
 /* public function implementation */
@@ -76,7 +132,10 @@ int tcp_server_start(void) {
     // Initialize server state
     g_server.running = 1;
     g_server.socket_fd = -1;
+    g_server.unix_fd = -1;
+    g_server.unix_path[0] = '\0';
     g_server.cache = NULL;
+    g_server.shm = NULL;
     log_debug("Server state initialized");
 
     // Setup cleanup handler
@@ -86,6 +145,12 @@ int tcp_server_start(void) {
 
     log_info("PodCache Server v1.0.0 - Initializing...");
 
+    // cattura opzionale del workload per replay e simulazioni offline
+    const char *trace_path = getenv("PODCACHE_TRACE_FILE");
+    if (trace_path && trace_open(trace_path) != 0) {
+        log_warn("Workload trace capture disabled");
+    }
+
     // Initialize cache
     g_server.cache = initialize_cache();
 
@@ -95,6 +160,37 @@ int tcp_server_start(void) {
     }
     //log_info("Cache initialized successfully");
 
+    // limiti della coda di uscita: un client che non legge non può trattenere memoria all'infinito
+    g_server.output_limits = (client_output_limits_t){
+        .hard_limit = MB_TO_BYTES(get_env_int("PODCACHE_CLIENT_OUTPUT_HARD_MB",
+                                              CLIENT_OUTPUT_DEFAULT_HARD_MB, 0, 65536)),
+        .soft_limit = MB_TO_BYTES(get_env_int("PODCACHE_CLIENT_OUTPUT_SOFT_MB",
+                                              CLIENT_OUTPUT_DEFAULT_SOFT_MB, 0, 65536)),
+        .soft_seconds = get_env_int("PODCACHE_CLIENT_OUTPUT_SOFT_SECONDS",
+                                    CLIENT_OUTPUT_DEFAULT_SOFT_SECONDS, 0, 86400),
+    };
+
+    // client-side caching: le modifiche alle chiavi diventano invalidazioni per i client
+    int tracking_max_keys =
+        get_env_int("PODCACHE_TRACKING_MAX_KEYS", TRACKING_DEFAULT_MAX_KEYS, 1, 100000000);
+    if (tracking_init((size_t)tracking_max_keys) != 0 ||
+        pod_cache_add_listener(g_server.cache, tracking_listener, NULL) != 0) {
+        log_error("Failed to initialize client tracking");
+        return EXIT_FAILURE;
+    }
+
+    if (setup_replication(g_server.cache) != 0) return EXIT_FAILURE;
+    if (setup_cluster(g_server.cache) != 0) return EXIT_FAILURE;
+    if (setup_peers(g_server.cache) != 0) return EXIT_FAILURE;
+
+    // indice in memoria condivisa per le letture dei processi nello stesso pod
+    const char *shm_name = getenv("PODCACHE_SHM_NAME");
+    if (shm_name && *shm_name && setup_shm_index(g_server.cache, shm_name) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (setup_connection_limits() != 0) return EXIT_FAILURE;
+
     pthread_t thread_cache_status;
     if (pthread_create(&thread_cache_status, NULL, display_cache_status, g_server.cache) != 0) {
         log_error("Failed to create cache status monitoring thread");
@@ -113,76 +209,49 @@ int tcp_server_start(void) {
     }
 
     log_info("Server successfully bound and listening on port %d", port);
+
+    // socket Unix opzionale per i client nello stesso pod: stesso protocollo, niente stack TCP
+    const char *unix_path = getenv("PODCACHE_UNIX_SOCKET");
+    if (unix_path && *unix_path) {
+        mode_t perm = get_env_mode("PODCACHE_UNIX_SOCKET_PERM", DEFAULT_UNIX_PERM);
+        g_server.unix_fd = setup_unix_socket(unix_path, perm);
+        if (g_server.unix_fd == -1) {
+            log_error("Failed to setup unix socket %s", unix_path);
+            return EXIT_FAILURE;
+        }
+        snprintf(g_server.unix_path, sizeof(g_server.unix_path), "%s", unix_path);
+        log_info("Server listening on unix socket %s (mode %o)", unix_path, (unsigned)perm);
+    }
+
     log_info("Server ready to accept client connections");
 
-    // Main accept loop
+    // Main accept loop: il timeout di poll permette di vedere running anche se il segnale
+    // arriva a un thread client
     while (g_server.running) {
-        struct sockaddr_in client_addr;
-        socklen_t addr_len = sizeof(client_addr);
-
-        log_debug("Waiting for client connection...");
-        int client_fd = accept(g_server.socket_fd, (struct sockaddr *)&client_addr, &addr_len);
+        struct pollfd listeners[2];
+        bool is_unix[2] = {false, true};
+        nfds_t count = 0;
+        listeners[count++] = (struct pollfd){.fd = g_server.socket_fd, .events = POLLIN};
+        if (g_server.unix_fd >= 0) {
+            listeners[count++] = (struct pollfd){.fd = g_server.unix_fd, .events = POLLIN};
+        }
 
-        if (client_fd == -1) {
-            if (!g_server.running) {
-                // Server is shutting down, this is expected
-                log_debug("Accept interrupted due to server shutdown");
-                break;
-            }
-            if (errno == EINTR) {
-                // Interrupted by signal, check if server should continue
-                log_debug("Accept interrupted by signal");
-                continue;
-            }
-            if (errno == EBADF || errno == ENOTSOCK) {
+        int ready = poll(listeners, count, 1000);
+        if (ready < 0) {
+            if (!g_server.running) break;
+            if (errno == EINTR) continue;
+            log_error("Failed to wait for client connections: %s", strerror(errno));
+            break;
+        }
+        for (nfds_t i = 0; i < count && g_server.running; i++) {
+            if (listeners[i].revents & POLLNVAL) {
                 // Socket was closed, probably due to shutdown
-                log_debug("Accept failed: socket closed during shutdown");
+                log_debug("Listener closed during shutdown");
+                g_server.running = 0;
                 break;
             }
-            log_error("Failed to accept client connection: %s", strerror(errno));
-            continue;
-        }
-
-        // Log client connection
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        log_info("New client connected from %s:%d (fd: %d)", client_ip, ntohs(client_addr.sin_port),
-                 client_fd);
-
-        // Create client context
-        client_ctx_t *client = create_client_context(client_fd, &client_addr);
-        if (!client) {
-            log_error("Failed to create client context for client %s:%d", client_ip,
-                      ntohs(client_addr.sin_port));
-            close(client_fd);
-            continue;
+            if (listeners[i].revents & POLLIN) accept_clients(listeners[i].fd, is_unix[i]);
         }
-        log_debug("Created client context for client ID: %s", client->client_id);
-
-        // Create thread parameters
-        server_thread_params_t *params = malloc(sizeof(server_thread_params_t));
-        if (!params) {
-            log_error("Failed to allocate thread parameters for client %s", client->client_id);
-            destroy_client_context(client);
-            continue;
-        }
-
-        params->client_ctx = client;
-        params->cache = g_server.cache;
-
-        // Create client thread
-        pthread_t thread_id;
-        if (pthread_create(&thread_id, NULL, client_handler_thread, params) != 0) {
-            log_error("Failed to create handler thread for client %s", client->client_id);
-            destroy_client_context(client);
-            free(params);
-            continue;
-        }
-
-        log_debug("Created handler thread for client %s", client->client_id);
-
-        // Detach thread for automatic cleanup
-        pthread_detach(thread_id);
     }
 
     log_info("Server shutting down...");
@@ -209,43 +278,114 @@ static void *display_cache_status(void *args) {
             log_info("Partition %d: %.2f MB used / %.2f MB total (%.1f%%)", i, used_mb, total_mb,
                      usage_percent);
         }
+        pod_cache_stats_t stats;
+        pod_cache_get_stats(cache, &stats);
+        log_info("Hits: memory %llu, disk %llu, misses %llu; demotions %llu (%llu clean), "
+                 "promotions %llu",
+                 (unsigned long long)stats.memory_hits, (unsigned long long)stats.disk_hits,
+                 (unsigned long long)stats.misses, (unsigned long long)stats.demotions,
+                 (unsigned long long)stats.clean_demotions, (unsigned long long)stats.promotions);
+        if (stats.disk_capacity > 0) {
+            log_info("Disk tier: %.2f MB used / %.2f MB, %llu keys dropped",
+                     BYTES_TO_MB(stats.disk_bytes), BYTES_TO_MB(stats.disk_capacity),
+                     (unsigned long long)stats.disk_drops);
+        }
+        if (stats.demote_batches > 0) {
+            log_info("Disk writes: %llu batches, %llu syncs",
+                     (unsigned long long)stats.demote_batches,
+                     (unsigned long long)stats.disk_syncs);
+        }
+        if (cache->disk_admission > 0) {
+            log_info("Disk admission: %llu keys rejected",
+                     (unsigned long long)stats.disk_rejections);
+        }
+        if (stats.loader_hits > 0) {
+            peer_stats_t peer;
+            peer_get_stats(&peer);
+            log_info("Peer fill: %llu keys loaded, %llu requests, %llu errors, %llu skipped",
+                     (unsigned long long)stats.loader_hits, (unsigned long long)peer.requests,
+                     (unsigned long long)peer.errors, (unsigned long long)peer.skipped);
+        }
+        log_info("Connections: %d open (max %d), %llu rejected, %llu closed idle",
+                 __atomic_load_n(&g_server.connections, __ATOMIC_RELAXED),
+                 g_server.max_connections,
+                 (unsigned long long)__atomic_load_n(&g_server.rejected, __ATOMIC_RELAXED),
+                 (unsigned long long)__atomic_load_n(&g_server.idle_closed, __ATOMIC_RELAXED));
         log_info("=== End Cache Status ===");
     }
 }
 
-static int send_formatted_response(int socket_fd, const char *format, ...) {
+// le risposte vengono accodate e inviate dal thread del client (vedi client_output.h)
+static int send_formatted_response(client_ctx_t *client, const char *format, ...) {
     char buffer[BUFFER_SIZE];
 
     va_list args;
     va_start(args, format);
     int len = vsnprintf(buffer, sizeof(buffer), format, args);
     va_end(args);
+    if (len < 0) return -1;
+    if (len < BUFFER_SIZE) return queue_reply(client, buffer, (size_t)len);
 
-    if (len >= BUFFER_SIZE) {
+    // risposta più grande del buffer sullo stack
+    char *large = arena_alloc(&client->arena, (size_t)len + 1);
+    if (!large) {
         log_error("Response too large to send");
         return -1;
     }
-
-    return send(socket_fd, buffer, len, MSG_NOSIGNAL);
+    va_start(args, format);
+    vsnprintf(large, (size_t)len + 1, format, args);
+    va_end(args);
+    return queue_reply(client, large, (size_t)len);
 }
 
-static int send_integer_response(int socket_fd, long val) {
-    return send_formatted_response(socket_fd, ":%lu\r\n", val);
+/* le risposte frequenti non passano da vsnprintf: letterali condivisi (RESP_OK, RESP_NIL),
+ * interi codificati a mano e parti copiate una volta sola nella coda di uscita */
+static int send_integer_response(client_ctx_t *client, long val) {
+    char buffer[RESP_INTEGER_MAX_LEN];
+    return queue_reply(client, buffer, resp_encode_integer(buffer, ':', val));
 }
 
-static int send_ok_response(int socket_fd, const char *message) {
-    return send_formatted_response(socket_fd, "+%s\r\n", message ?: "OK");
+static int send_ok_response(client_ctx_t *client, const char *message) {
+    if (!message) return queue_reply(client, RESP_LITERAL(RESP_OK));
+    return send_parts(client, "+", 1, message, strlen(message));
 }
 
-static int send_error_response(int socket_fd, const char *error) {
-    return send_formatted_response(socket_fd, "-ERR %s\r\n", error);
+static int send_error_response(client_ctx_t *client, const char *error) {
+    return send_parts(client, "-ERR ", 5, error, strlen(error));
 }
 
-static int send_bulk_string_response(int socket_fd, const char *str) {
-    if (!str) return send_formatted_response(socket_fd, "$-1\r\n");
+static int send_bulk_string_response(client_ctx_t *client, const char *str) {
+    if (!str) return queue_reply(client, RESP_LITERAL(RESP_NIL));
 
     size_t len = strlen(str);
-    return send_formatted_response(socket_fd, "$%zu\r\n%s\r\n", len, str);
+    char header[RESP_INTEGER_MAX_LEN];
+    return send_parts(client, header, resp_encode_integer(header, '$', (long long)len), str, len);
+}
+
+// <prefix><body>\r\n come un'unica risposta contigua
+static int send_parts(client_ctx_t *client, const char *prefix, size_t prefix_len,
+                      const char *body, size_t body_len) {
+    struct iovec parts[3] = {
+        {.iov_base = (void *)prefix, .iov_len = prefix_len},
+        {.iov_base = (void *)body, .iov_len = body_len},
+        {.iov_base = RESP_CRLF, .iov_len = 2},
+    };
+    if (client_output_writev(&client->output, parts, 3) != 0) return -1;
+    return (int)(prefix_len + body_len + 2);
+}
+
+/* header, valore e terminatore: il valore resta in cache fino all'invio, senza copia (un
+ * iovec separato dall'header). Prende il possesso di handle */
+static int send_bulk_value_response(client_ctx_t *client, pod_cache_handle_t *handle) {
+    char header[RESP_INTEGER_MAX_LEN];
+    size_t header_len = resp_encode_integer(header, '$', (long long)handle->size);
+
+    if (queue_reply(client, header, header_len) < 0) {
+        pod_cache_release(handle);
+        return -1;
+    }
+    if (client_output_write_value(&client->output, handle) != 0) return -1;
+    return queue_reply(client, RESP_LITERAL(RESP_CRLF));
 }
 
 // === COMMAND HANDLERS ===
@@ -254,39 +394,48 @@ static int handle_ping(client_ctx_t *client, pod_cache_t *cache, resp_command_t
     (void)cache;
     (void)cmd; // Unused parameters
     log_debug("Client %s: PING command received", client->client_id);
-    return send_ok_response(client->socket, "PONG");
+    return queue_reply(client, RESP_LITERAL(RESP_PONG));
 }
 
 static int handle_incr(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     if (cmd->arg_count < 1) {
         log_warn("Client %s: INCR command with invalid arguments (count: %d)", client->client_id,
                  cmd->arg_count);
-        return send_error_response(client->socket, "wrong number of arguments for 'INCR' command");
+        return send_error_response(client, "wrong number of arguments for 'INCR' command");
     }
 
     const char *key = cmd->args[0];
     log_debug("Client %s: INCR request for key '%s'", client->client_id, key);
 
-    void *value = NULL;
-    size_t value_size = 0;
-
-    int result = pod_cache_get(cache, key, &value, &value_size);
-    if (result != 0) {
+    // il valore viene letto in prestito, senza copia
+    pod_cache_handle_t handle;
+    if (pod_cache_borrow(cache, key, &handle) != 0) {
         // chiave non presente, la memorizzo nuova con valore 1
         log_debug("Client %s: INCR key '%s' - not found, initializing to 1", client->client_id,
                   key);
         pod_cache_put(cache, key, "1", 1);
-        return send_integer_response(client->socket, 1);
+        return send_integer_response(client, 1);
     }
 
+    // il valore in cache non è terminato da '\0'
+    char number[24];
+    size_t value_size = handle.size;
+    if (value_size == 0 || value_size >= sizeof(number)) {
+        pod_cache_release(&handle);
+        log_warn("Client %s: INCR key '%s' - value is not a valid integer", client->client_id, key);
+        return send_error_response(client, "value is not an integer or out of range");
+    }
+    memcpy(number, handle.value, value_size);
+    number[value_size] = '\0';
+    pod_cache_release(&handle);
+
     char *endptr;
     errno = 0;
-    long val = strtol(value, &endptr, 10);
+    long val = strtol(number, &endptr, 10);
 
     if (errno != 0 || *endptr != '\0') {
         log_warn("Client %s: INCR key '%s' - value is not a valid integer", client->client_id, key);
-        free(value);
-        return send_error_response(client->socket, "value is not an integer or out of range");
+        return send_error_response(client, "value is not an integer or out of range");
     }
 
     val++;
@@ -295,15 +444,14 @@ static int handle_incr(client_ctx_t *client, pod_cache_t *cache, resp_command_t
 
     log_debug("Client %s: INCR key '%s' - incremented to %ld", client->client_id, key, val);
     pod_cache_put(cache, key, buffer, strlen(buffer));
-    free(value);
-    return send_integer_response(client->socket, val);
+    return send_integer_response(client, val);
 }
 
 static int handle_del(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     if (cmd->arg_count < 1) {
         log_warn("Client %s: DEL command with invalid arguments (count: %d)", client->client_id,
                  cmd->arg_count);
-        return send_error_response(client->socket,
+        return send_error_response(client,
                                    "wrong number of arguments for 'DEL' or 'UNLINK' command");
     }
 
@@ -314,18 +462,18 @@ static int handle_del(client_ctx_t *client, pod_cache_t *cache, resp_command_t *
     if (evict_result != -1) {
         log_info("Client %s: DEL key '%s' - %s", client->client_id, key,
                  evict_result == 1 ? "deleted" : "not found");
-        return send_integer_response(client->socket, evict_result);
+        return send_integer_response(client, evict_result);
     }
 
     log_error("Client %s: DEL key '%s' - error occurred", client->client_id, key);
-    return send_error_response(client->socket, "error");
+    return send_error_response(client, "error");
 }
 
 static int handle_set(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     if (cmd->arg_count < 2) {
         log_warn("Client %s: SET command with invalid arguments (count: %d)", client->client_id,
                  cmd->arg_count);
-        return send_error_response(client->socket, "wrong number of arguments for 'SET' command");
+        return send_error_response(client, "wrong number of arguments for 'SET' command");
     }
 
     const char *key = cmd->args[0];
@@ -339,72 +487,471 @@ static int handle_set(client_ctx_t *client, pod_cache_t *cache, resp_command_t *
     if (result < 0) {
         log_warn("Client %s: SET failed for key '%s' - error code: %d", client->client_id, key,
                  result);
-        return send_error_response(client->socket, "failed to store value");
+        return send_error_response(client, "failed to store value");
     }
 
     log_info("Client %s: SET successful - key='%s', stored in partition=%d", client->client_id, key,
              result);
-    return send_ok_response(client->socket, NULL);
+    return send_ok_response(client, NULL);
 }
 
 static int handle_get(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     if (cmd->arg_count < 1) {
         log_warn("Client %s: GET command with invalid arguments (count: %d)", client->client_id,
                  cmd->arg_count);
-        return send_error_response(client->socket, "wrong number of arguments for 'GET' command");
+        return send_error_response(client, "wrong number of arguments for 'GET' command");
     }
 
     const char *key = cmd->args[0];
     log_debug("Client %s: GET request for key '%s'", client->client_id, key);
 
-    void *value = NULL;
-    size_t value_size = 0;
+    // registrata prima della lettura: una modifica concorrente produce comunque l'invalidazione
+    if (client->tracking) tracking_remember(client->tracking, key);
 
-    int result = pod_cache_get(cache, key, &value, &value_size);
+    pod_cache_handle_t handle;
+    int result = pod_cache_borrow(cache, key, &handle);
     if (result != 0) {
         log_debug("Client %s: GET key '%s' - not found", client->client_id, key);
-        return send_bulk_string_response(client->socket, NULL); // Not found
+        if (client->resp_version == 3) return queue_reply(client, RESP_LITERAL(RESP3_NULL));
+        return send_bulk_string_response(client, NULL); // Not found
     }
 
     log_debug("Client %s: GET key '%s' - found, size: %zu bytes", client->client_id, key,
-              value_size);
-    int send_result = send_bulk_string_response(client->socket, (char *)value);
-    free(value);
+              handle.size);
+    // il valore resta bloccato in cache fino all'invio, nessuna copia
+    return send_bulk_value_response(client, &handle);
+}
 
-    return send_result;
+// GET richiesto da un altro pod: servito solo dai tier locali, senza interrogare i peer
+static int handle_peerget(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    peer_set_local_only(true);
+    int result = handle_get(client, cache, cmd);
+    peer_set_local_only(false);
+    return result;
 }
 
 static int handle_quit(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     (void)cache;
     (void)cmd; // Unused parameters
     log_info("Client %s: QUIT command received, disconnecting", client->client_id);
-    send_ok_response(client->socket, "BYE");
+    send_ok_response(client, "BYE");
     return -1; // Signal client disconnect
 }
 
-/* handler per gestire il coment CLIENT (jedis), non viene gestito e quindi restituimo sempre +OK */
+/* handler per il comando CLIENT: ID e TRACKING sono gestiti, gli altri sottocomandi (SETNAME,
+ * SETINFO di jedis...) vengono ignorati e restituiscono sempre +OK */
 static int handle_client_cmd(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     (void)cache; // Unused parameter
 
     log_debug("Client %s: CLIENT command received", client->client_id);
+    if (cmd->arg_count >= 1 && strcasecmp(cmd->args[0], "ID") == 0) {
+        return send_integer_response(client, (long)client->id);
+    }
+    if (cmd->arg_count >= 1 && strcasecmp(cmd->args[0], "TRACKING") == 0) {
+        return handle_client_tracking(client, cmd);
+    }
     // rispondiamo sempre +OK
-    return send_ok_response(client->socket, NULL);
+    return send_ok_response(client, NULL);
+}
+
+/* CLIENT TRACKING ON|OFF [BCAST] [PREFIX p ...] [NOLOOP]: le invalidazioni sono push RESP3,
+ * quindi serve HELLO 3 (REDIRECT verso una connessione RESP2 richiederebbe il pub/sub) */
+static int handle_client_tracking(client_ctx_t *client, resp_command_t *cmd) {
+    if (cmd->arg_count < 2) {
+        return send_error_response(client,
+                                   "wrong number of arguments for 'CLIENT TRACKING' command");
+    }
+
+    if (strcasecmp(cmd->args[1], "OFF") == 0) {
+        tracking_disable(client->tracking);
+        client->tracking = NULL;
+        return send_ok_response(client, NULL);
+    }
+    if (strcasecmp(cmd->args[1], "ON") != 0) {
+        return send_error_response(client, "syntax error");
+    }
+    if (client->resp_version != 3) {
+        return send_error_response(client,
+                                   "CLIENT TRACKING requires RESP3, switch with HELLO 3");
+    }
+
+    tracking_options_t options = {0};
+    for (int i = 2; i < cmd->arg_count; i++) {
+        const char *option = cmd->args[i];
+        if (strcasecmp(option, "BCAST") == 0) {
+            options.bcast = true;
+        } else if (strcasecmp(option, "NOLOOP") == 0) {
+            options.noloop = true;
+        } else if (strcasecmp(option, "PREFIX") == 0 && i + 1 < cmd->arg_count) {
+            if (options.prefix_count == TRACKING_MAX_PREFIXES) {
+                return send_error_response(client, "too many prefixes");
+            }
+            options.prefixes[options.prefix_count++] = cmd->args[++i];
+        } else if (strcasecmp(option, "REDIRECT") == 0 || strcasecmp(option, "OPTIN") == 0 ||
+                   strcasecmp(option, "OPTOUT") == 0) {
+            return send_error_response(client, "tracking option not supported");
+        } else {
+            return send_error_response(client, "syntax error");
+        }
+    }
+    if (options.prefix_count > 0 && !options.bcast) {
+        return send_error_response(client,
+                                   "PREFIX option requires BCAST mode to be enabled");
+    }
+
+    tracking_client_t *tracking = tracking_enable(client->id, &options);
+    if (!tracking) return send_error_response(client, "failed to enable tracking");
+    client->tracking = tracking;
+    log_info("Client %s: tracking enabled (%s, %d prefixes%s)", client->client_id,
+             options.bcast ? "bcast" : "default", options.prefix_count,
+             options.noloop ? ", noloop" : "");
+    return send_ok_response(client, NULL);
+}
+
+/* HELLO [protover [AUTH user pass] [SETNAME name]]: sceglie RESP2 o RESP3. AUTH e SETNAME
+ * vengono ignorati, il server non ha autenticazione */
+static int handle_hello(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    (void)cache;
+
+    if (cmd->arg_count >= 1) {
+        char *endptr;
+        long version = strtol(cmd->args[0], &endptr, 10);
+        if (*endptr != '\0' || (version != 2 && version != 3)) {
+            return send_formatted_response(client,
+                                           "-NOPROTO unsupported protocol version\r\n");
+        }
+        client->resp_version = (int)version;
+        if (version == 2 && client->tracking) {
+            // una connessione RESP2 non può ricevere i push di invalidazione
+            tracking_disable(client->tracking);
+            client->tracking = NULL;
+        }
+    }
+    log_debug("Client %s: HELLO, protocol RESP%d", client->client_id, client->resp_version);
+
+    // RESP3 risponde con una mappa, RESP2 con un array di coppie chiave/valore
+    return send_formatted_response(client,
+                                   "%s\r\n$6\r\nserver\r\n$8\r\npodcache\r\n"
+                                   "$7\r\nversion\r\n$5\r\n1.0.0\r\n"
+                                   "$5\r\nproto\r\n:%d\r\n$2\r\nid\r\n:%llu\r\n"
+                                   "$4\r\nmode\r\n%s\r\n"
+                                   "$4\r\nrole\r\n%s\r\n"
+                                   "$7\r\nmodules\r\n*0\r\n",
+                                   client->resp_version == 3 ? "%7" : "*14", client->resp_version,
+                                   (unsigned long long)client->id,
+                                   cluster_enabled() ? "$7\r\ncluster" : "$10\r\nstandalone",
+                                   repl_is_replica() ? "$7\r\nreplica" : "$6\r\nmaster");
+}
+
+/* PSYNC <replid> <offset>: la connessione diventa il canale di replica verso questo client e
+ * viene chiusa quando la replica si disconnette */
+static int handle_psync(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    if (cmd->arg_count < 2) {
+        return send_error_response(client, "wrong number of arguments for 'PSYNC' command");
+    }
+    log_info("Client %s: PSYNC %s %s", client->client_id, cmd->args[0], cmd->args[1]);
+    // da qui il modulo di replica scrive direttamente sul socket; una replica non è mai inattiva
+    __atomic_store_n(&client->no_timeout, true, __ATOMIC_RELAXED);
+    if (client_output_drain(&client->output, CLOSE_DRAIN_MS) != 0) return -1;
+    return repl_serve_replica(cache, client->socket, client->client_id, cmd->args[0],
+                              cmd->args[1]);
+}
+
+// REPLCONF listening-port/capa inviati dalle repliche Redis: accettati e ignorati
+static int handle_replconf(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    (void)cache;
+    (void)cmd;
+    return send_ok_response(client, NULL);
+}
+
+static int handle_role(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    (void)cache;
+    (void)cmd;
+    char buffer[BUFFER_SIZE];
+    int len = repl_format_role(buffer, sizeof(buffer));
+    if (len < 0) return send_error_response(client, "role too large");
+    return queue_reply(client, buffer, (size_t)len);
+}
+
+/* CLUSTER <sottocomando>: topologia (SLOTS, SHARDS, NODES, INFO, MYID), indice delle chiavi
+ * per slot e comandi di amministrazione (MEET, SETSLOT) usati per la migrazione */
+static int handle_cluster(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    (void)cache;
+    if (!cluster_enabled()) {
+        return send_error_response(client, "This instance has cluster support disabled");
+    }
+    if (cmd->arg_count < 1) {
+        return send_error_response(client,
+                                   "wrong number of arguments for 'CLUSTER' command");
+    }
+
+    const char *sub = cmd->args[0];
+    char *reply = NULL;
+    size_t len = 0;
+    if (strcasecmp(sub, "SLOTS") == 0) {
+        reply = cluster_format_slots(&len);
+        return send_owned_reply(client, reply, len);
+    }
+    if (strcasecmp(sub, "SHARDS") == 0) {
+        reply = cluster_format_shards(client->resp_version == 3, &len);
+        return send_owned_reply(client, reply, len);
+    }
+    if (strcasecmp(sub, "NODES") == 0) {
+        reply = cluster_format_nodes(&len);
+        return send_owned_reply(client, reply, len);
+    }
+    if (strcasecmp(sub, "INFO") == 0) {
+        reply = cluster_format_info(&len);
+        return send_owned_reply(client, reply, len);
+    }
+    if (strcasecmp(sub, "MYID") == 0) {
+        return send_bulk_string_response(client, cluster_myid());
+    }
+    if (strcasecmp(sub, "KEYSLOT") == 0 && cmd->arg_count == 2) {
+        return send_integer_response(client,
+                                     cluster_keyslot(cmd->args[1], strlen(cmd->args[1])));
+    }
+
+    int slot = cmd->arg_count >= 2 ? parse_slot(cmd->args[1]) : -1;
+    if (strcasecmp(sub, "COUNTKEYSINSLOT") == 0 && cmd->arg_count == 2) {
+        if (slot < 0) return send_error_response(client, "Invalid slot");
+        return send_integer_response(client, (long)cluster_count_keys_in_slot(slot));
+    }
+    if (strcasecmp(sub, "GETKEYSINSLOT") == 0 && cmd->arg_count == 3) {
+        char *endptr;
+        long max = strtol(cmd->args[2], &endptr, 10);
+        if (slot < 0 || *endptr != '\0' || max < 0) {
+            return send_error_response(client, "Invalid slot or number of keys");
+        }
+        char **keys;
+        int count = cluster_get_keys_in_slot(slot, (size_t)max, &keys);
+        if (count < 0) return send_error_response(client, "out of memory");
+
+        size_t capacity = 32;
+        for (int i = 0; i < count; i++) capacity += strlen(keys[i]) + 32;
+        reply = malloc(capacity);
+        size_t used = 0;
+        if (reply) {
+            used += (size_t)sprintf(reply, "*%d\r\n", count);
+            for (int i = 0; i < count; i++) {
+                used += (size_t)sprintf(reply + used, "$%zu\r\n%s\r\n", strlen(keys[i]), keys[i]);
+            }
+        }
+        for (int i = 0; i < count; i++) free(keys[i]);
+        free(keys);
+        return send_owned_reply(client, reply, used);
+    }
+    if (strcasecmp(sub, "SETSLOT") == 0 && cmd->arg_count >= 3) {
+        if (slot < 0) return send_error_response(client, "Invalid or out of range slot");
+        const char *error = NULL;
+        if (cluster_setslot(slot, cmd->args[2], cmd->arg_count >= 4 ? cmd->args[3] : NULL,
+                            &error) != 0) {
+            return send_formatted_response(client, "-%s\r\n", error);
+        }
+        return send_ok_response(client, NULL);
+    }
+    if (strcasecmp(sub, "MEET") == 0 && cmd->arg_count >= 3) {
+        char *endptr;
+        long port = strtol(cmd->args[2], &endptr, 10);
+        if (*endptr != '\0' || port < 1 || port > 65535) {
+            return send_error_response(client, "Invalid node address specified");
+        }
+        if (cluster_meet(cmd->args[1], (int)port) != 0) {
+            return send_error_response(client, "too many nodes");
+        }
+        return send_ok_response(client, NULL);
+    }
+    return send_error_response(client, "unknown CLUSTER subcommand or wrong arguments");
+}
+
+static int handle_asking(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    (void)cache;
+    (void)cmd;
+    client->asking = true;
+    return send_ok_response(client, NULL);
+}
+
+/* MIGRATE host port key|"" db timeout [COPY] [REPLACE] [KEYS key ...]: le chiavi vengono
+ * scritte sul nodo di destinazione sempre con sostituzione; db è ignorato */
+static int handle_migrate(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
+    if (cmd->arg_count < 5) {
+        return send_error_response(client,
+                                   "wrong number of arguments for 'MIGRATE' command");
+    }
+
+    char *endptr;
+    long port = strtol(cmd->args[1], &endptr, 10);
+    if (*endptr != '\0' || port < 1 || port > 65535) {
+        return send_error_response(client, "Invalid port");
+    }
+    long timeout_ms = strtol(cmd->args[4], &endptr, 10);
+    if (*endptr != '\0' || timeout_ms < 0) {
+        return send_error_response(client, "Invalid timeout");
+    }
+    if (timeout_ms == 0) timeout_ms = 1000;
+
+    bool copy = false;
+    char **keys = &cmd->args[2];
+    int count = cmd->args[2][0] ? 1 : 0;
+    for (int i = 5; i < cmd->arg_count; i++) {
+        if (strcasecmp(cmd->args[i], "COPY") == 0) {
+            copy = true;
+        } else if (strcasecmp(cmd->args[i], "REPLACE") == 0) {
+            continue;
+        } else if (strcasecmp(cmd->args[i], "KEYS") == 0 && count == 0) {
+            keys = &cmd->args[i + 1];
+            count = cmd->arg_count - i - 1;
+            break;
+        } else {
+            return send_error_response(client, "syntax error");
+        }
+    }
+
+    int moved = cluster_migrate(cache, cmd->args[0], (int)port, keys, count, copy,
+                                (int)timeout_ms);
+    if (moved == CLUSTER_MIGRATE_REFUSED) {
+        return send_error_response(client, "Target instance replied with error");
+    }
+    if (moved < 0) {
+        return send_formatted_response(client,
+                                       "-IOERR error or timeout connecting to the client\r\n");
+    }
+    log_info("Client %s: MIGRATE %d/%d keys to %s:%ld", client->client_id, moved, count,
+             cmd->args[0], port);
+    return send_ok_response(client, moved > 0 ? "OK" : "NOKEY");
+}
+
+// invia una risposta allocata dal modulo cluster e la libera
+static int send_owned_reply(client_ctx_t *client, char *reply, size_t len) {
+    if (!reply) return send_error_response(client, "out of memory");
+    int result = queue_reply(client, reply, len);
+    free(reply);
+    return result;
+}
+
+static int parse_slot(const char *value) {
+    char *endptr;
+    long slot = strtol(value, &endptr, 10);
+    if (*endptr != '\0' || endptr == value || slot < 0 || slot >= CLUSTER_SLOTS) return -1;
+    return (int)slot;
+}
+
+/* invia le invalidazioni accodate come push RESP3 >2 "invalidate" [chiavi]; se la coda è
+ * traboccata il client riceve un null e deve svuotare tutta la sua cache */
+static int send_invalidations(client_ctx_t *client) {
+    char **keys;
+    size_t count;
+    bool flush_all;
+    tracking_drain(client->tracking, &keys, &count, &flush_all);
+    if (count == 0 && !flush_all) return 0;
+
+    size_t capacity = 64;
+    for (size_t i = 0; i < count; i++) {
+        capacity += strlen(keys[i]) + 32;
+    }
+    char *buffer = arena_alloc(&client->arena, capacity);
+    if (!buffer) {
+        tracking_free_keys(keys, count);
+        return -1;
+    }
+
+    size_t len = (size_t)sprintf(buffer, ">2\r\n$10\r\ninvalidate\r\n");
+    if (flush_all) {
+        len += (size_t)sprintf(buffer + len, "_\r\n");
+    } else {
+        len += (size_t)sprintf(buffer + len, "*%zu\r\n", count);
+        for (size_t i = 0; i < count; i++) {
+            len += (size_t)sprintf(buffer + len, "$%zu\r\n%s\r\n", strlen(keys[i]), keys[i]);
+        }
+    }
+    log_debug("Client %s: sending %zu invalidations%s", client->client_id, count,
+              flush_all ? " (flush all)" : "");
+
+    int result = queue_reply(client, buffer, len);
+    tracking_free_keys(keys, count);
+    return result;
+}
+
+static int queue_reply(client_ctx_t *client, const char *data, size_t len) {
+    if (client_output_write(&client->output, data, len) != 0) return -1;
+    return (int)len;
+}
+
+static void tracking_listener(pod_cache_event_e event, const char *key, const void *value,
+                              size_t size, void *ctx) {
+    (void)value;
+    (void)size;
+    (void)ctx;
+    // demotion e promozione spostano la chiave tra i tier senza cambiarne il valore
+    if (event == POD_CACHE_EVENT_PUT || event == POD_CACHE_EVENT_DELETE) tracking_invalidate(key);
 }
 
 static int dispatch_command(client_ctx_t *client, pod_cache_t *cache, resp_command_t *cmd) {
     resp_command_e cmd_type = resp_decode_command(cmd->command);
+    if (trace_enabled()) trace_command(cmd_type, cmd);
 
-    log_debug("Client %s: Dispatching command '%s'", client->client_id, cmd->command);
+    const resp_command_info_t *info = resp_command_info(cmd_type);
+    if (!info || !command_handlers[cmd_type]) {
+        log_warn("Client %s: Unknown command '%s'", client->client_id, cmd->command);
+        return send_error_response(client, "unknown command");
+    }
+    int argc = cmd->arg_count + 1; // arity comprende il nome del comando
+    if ((info->arity > 0 && argc != info->arity) || (info->arity < 0 && argc < -info->arity)) {
+        log_warn("Client %s: %s command with invalid arguments (count: %d)", client->client_id,
+                 info->name, cmd->arg_count);
+        char error[MAX_ERROR_MSG];
+        snprintf(error, sizeof(error), "wrong number of arguments for '%s' command", info->name);
+        return send_error_response(client, error);
+    }
 
-    for (const command_handler_t *handler = command_handlers; handler->name; handler++) {
-        if (handler->type == cmd_type) {
-            log_debug("Client %s: Found handler for command '%s'", client->client_id, cmd->command);
-            return handler->handler(client, cache, cmd);
+    // una replica riceve le modifiche solo dal primary
+    if ((info->flags & RESP_CMD_WRITE) && repl_is_replica()) {
+        return send_formatted_response(
+            client, "-READONLY You can't write against a read only replica.\r\n");
+    }
+
+    // ASKING vale solo per il comando che lo segue
+    bool asking = client->asking;
+    client->asking = false;
+    if (info->first_key > 0 && cluster_enabled()) {
+        int slot;
+        char target[320];
+        const char *key = cmd->args[info->first_key - 1];
+        switch (cluster_route(key, asking, &slot, target, sizeof(target))) {
+        case CLUSTER_ROUTE_MOVED:
+            return send_formatted_response(client, "-MOVED %d %s\r\n", slot, target);
+        case CLUSTER_ROUTE_ASK:
+            return send_formatted_response(client, "-ASK %d %s\r\n", slot, target);
+        case CLUSTER_ROUTE_DOWN:
+            return send_formatted_response(client,
+                                           "-CLUSTERDOWN Hash slot not served\r\n");
+        case CLUSTER_ROUTE_LOCAL:
+            break;
         }
     }
 
-    log_warn("Client %s: Unknown command '%s'", client->client_id, cmd->command);
-    return send_error_response(client->socket, "unknown command");
+    log_debug("Client %s: Dispatching command '%s'", client->client_id, info->name);
+    return command_handlers[cmd_type](client, cache, cmd);
+}
+
+static void trace_command(resp_command_e cmd_type, const resp_command_t *cmd) {
+    const char *key = NULL;
+    size_t value_size = 0;
+
+    switch (cmd_type) {
+    case RESP_SET:
+        if (cmd->arg_count > 1 && cmd->args[1]) value_size = strlen(cmd->args[1]);
+        // fallthrough
+    case RESP_GET:
+    case RESP_DEL:
+    case RESP_UNLINK:
+    case RESP_INCR:
+        if (cmd->arg_count > 0) key = cmd->args[0];
+        break;
+    default:
+        break;
+    }
+    trace_record(cmd_type, key, value_size);
 }
 
 // === CLIENT HANDLING ===
@@ -434,14 +981,113 @@ static void buffer_consume(command_buffer_t *buf, size_t bytes) {
     buf->used -= bytes;
 }
 
+/* accetta le connessioni in attesa, fino a ACCEPT_BATCH per risveglio: durante una tempesta
+ * di riconnessioni la coda di listen si svuota senza un giro di poll per ogni client */
+static void accept_clients(int listen_fd, bool is_unix) {
+    for (int i = 0; i < ACCEPT_BATCH && g_server.running; i++) {
+        struct sockaddr_in client_addr = {0};
+        socklen_t addr_len = sizeof(client_addr);
+
+        // per un socket Unix l'indirizzo del peer non serve (e non è un sockaddr_in)
+        int client_fd = is_unix ? accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC)
+                                : accept4(listen_fd, (struct sockaddr *)&client_addr, &addr_len,
+                                          SOCK_CLOEXEC);
+        if (client_fd == -1) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (g_server.running && errno != EAGAIN && errno != EWOULDBLOCK) {
+                log_error("Failed to accept client connection: %s", strerror(errno));
+            }
+            return;
+        }
+        if (!admit_client(client_fd)) continue;
+        start_client(client_fd, is_unix ? NULL : &client_addr);
+    }
+}
+
+/* oltre max_connections la connessione riceve un errore e viene chiusa subito, come fa Redis:
+ * il client vede il motivo invece di un timeout e il server non crea altri thread */
+static bool admit_client(int client_fd) {
+    int open = __atomic_add_fetch(&g_server.connections, 1, __ATOMIC_RELAXED);
+    if (g_server.max_connections == 0 || open <= g_server.max_connections) return true;
+
+    __atomic_sub_fetch(&g_server.connections, 1, __ATOMIC_RELAXED);
+    static const char reply[] = "-ERR max number of clients reached\r\n";
+    ssize_t sent = send(client_fd, reply, sizeof(reply) - 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    (void)sent;
+    close(client_fd);
+
+    // un avviso al secondo al massimo, il totale è nel report periodico
+    static time_t last_warning = 0;
+    uint64_t rejected = __atomic_add_fetch(&g_server.rejected, 1, __ATOMIC_RELAXED);
+    time_t now = time(NULL);
+    if (now != last_warning) {
+        last_warning = now;
+        log_warn("Max connections (%d) reached, rejecting clients (%llu so far)",
+                 g_server.max_connections, (unsigned long long)rejected);
+    }
+    return false;
+}
+
+static void start_client(int client_fd, struct sockaddr_in *addr) {
+    // Create client context
+    client_ctx_t *client = create_client_context(client_fd, addr);
+    if (!client) {
+        log_error("Failed to create client context (fd: %d)", client_fd);
+        close(client_fd);
+        __atomic_sub_fetch(&g_server.connections, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    log_info("New client connected from %s (fd: %d)", client->client_id, client_fd);
+
+    // Create thread parameters
+    server_thread_params_t *params = malloc(sizeof(server_thread_params_t));
+    if (!params) {
+        log_error("Failed to allocate thread parameters for client %s", client->client_id);
+        destroy_client_context(client);
+        return;
+    }
+
+    params->client_ctx = client;
+    params->cache = g_server.cache;
+
+    // Create client thread
+    pthread_t thread_id;
+    if (pthread_create(&thread_id, NULL, client_handler_thread, params) != 0) {
+        log_error("Failed to create handler thread for client %s", client->client_id);
+        destroy_client_context(client);
+        free(params);
+        return;
+    }
+
+    log_debug("Created handler thread for client %s", client->client_id);
+
+    // Detach thread for automatic cleanup
+    pthread_detach(thread_id);
+}
+
 static client_ctx_t *create_client_context(int socket_fd, struct sockaddr_in *addr) {
+    static unsigned long unix_clients = 0;
+    static uint64_t next_client_id = 0;
+
     client_ctx_t *client = calloc(1, sizeof(client_ctx_t));
     if (!client) return NULL;
 
     client->socket = socket_fd;
+    client_output_init(&client->output, socket_fd, &g_server.output_limits);
+    arena_init(&client->arena);
+    client->id = __atomic_add_fetch(&next_client_id, 1, __ATOMIC_RELAXED);
+    client->resp_version = 2;
+    if (!addr) {
+        // client sul socket Unix: nessun indirizzo, solo un progressivo
+        unsigned long id = __atomic_add_fetch(&unix_clients, 1, __ATOMIC_RELAXED);
+        snprintf(client->client_id, sizeof(client->client_id), "unix#%lu", id);
+        return client;
+    }
     client->addr = *addr;
 
-    snprintf(client->client_id, sizeof(client->client_id), "%s:%d", inet_ntoa(addr->sin_addr),
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &addr->sin_addr, client_ip, sizeof(client_ip));
+    snprintf(client->client_id, sizeof(client->client_id), "%s:%d", client_ip,
              ntohs(addr->sin_port));
 
     return client;
@@ -450,10 +1096,15 @@ static client_ctx_t *create_client_context(int socket_fd, struct sockaddr_in *ad
 static void destroy_client_context(client_ctx_t *client) {
     if (!client) return;
 
+    tracking_disable(client->tracking);
+    client_output_free(&client->output);
+    arena_destroy(&client->arena);
     if (client->socket >= 0) {
         close(client->socket);
     }
     free(client);
+    // il posto occupato da admit_client torna libero
+    __atomic_sub_fetch(&g_server.connections, 1, __ATOMIC_RELAXED);
 }
 
 static void *client_handler_thread(void *arg) {
@@ -465,19 +1116,27 @@ static void *client_handler_thread(void *arg) {
     buffer_init(&cmd_buf);
 
     char recv_buffer[BUFFER_SIZE];
-    ssize_t bytes_received;
+    ssize_t bytes_received = 0;
 
     log_info("Client %s: Connection established, handler thread started", client->client_id);
-
-    while (g_server.running &&
-           (bytes_received = recv(client->socket, recv_buffer, sizeof(recv_buffer), 0)) > 0) {
+    // le modifiche fatte da questo thread appartengono al client (NOLOOP)
+    tracking_set_current_client(client->id);
+    idle_timer_start(client);
+
+    while (g_server.running && wait_readable(client) == 0) {
+        bytes_received = recv(client->socket, recv_buffer, sizeof(recv_buffer), MSG_DONTWAIT);
+        if (bytes_received < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+        if (bytes_received <= 0) break;
+        // basta una store: il timer viene rinviato solo quando scade (vedi idle_expired)
+        __atomic_store_n(&client->last_active, __atomic_load_n(&g_server.clock, __ATOMIC_RELAXED),
+                         __ATOMIC_RELAXED);
 
         log_debug("Client %s: Received %zd bytes", client->client_id, bytes_received);
 
         // Check for buffer overflow
         if (!buffer_append(&cmd_buf, recv_buffer, bytes_received)) {
             log_error("Client %s: Command buffer overflow, resetting buffer", client->client_id);
-            send_error_response(client->socket, "command too long");
+            send_error_response(client, "command too long");
             buffer_init(&cmd_buf); // Reset buffer
             continue;
         }
@@ -487,7 +1146,8 @@ static void *client_handler_thread(void *arg) {
         while (processed < cmd_buf.used) {
             resp_command_t cmd;
 
-            int consumed = resp_parse(cmd_buf.buffer + processed, cmd_buf.used - processed, &cmd);
+            int consumed = resp_parse_arena(cmd_buf.buffer + processed,
+                                            cmd_buf.used - processed, &cmd, &client->arena);
 
             if (consumed > 0) {
                 // Command parsed successfully
@@ -495,7 +1155,6 @@ static void *client_handler_thread(void *arg) {
                           cmd.command, consumed);
 
                 int result = dispatch_command(client, cache, &cmd);
-                resp_command_free(&cmd);
 
                 if (result < 0) {
                     log_debug("Client %s: Command returned disconnect signal", client->client_id);
@@ -513,7 +1172,7 @@ static void *client_handler_thread(void *arg) {
             } else {
                 // Parse error
                 log_error("Client %s: Protocol parse error, discarding buffer", client->client_id);
-                send_error_response(client->socket, "protocol error");
+                send_error_response(client, "protocol error");
                 processed = cmd_buf.used; // Discard all data
                 break;
             }
@@ -521,6 +1180,14 @@ static void *client_handler_thread(void *arg) {
 
         // Remove processed data from buffer
         buffer_consume(&cmd_buf, processed);
+        trace_flush_thread();
+
+        // le invalidazioni seguono le risposte ai comandi che le hanno lette
+        if (client->tracking && send_invalidations(client) < 0) goto cleanup;
+        // quello che il socket non accetta ora viene inviato quando torna scrivibile
+        if (client_output_flush(&client->output) < 0) goto cleanup;
+        // comandi e allocazioni degli handler del batch non servono più
+        arena_reset(&client->arena);
     }
 
     if (bytes_received < 0 && errno != ECONNRESET) {
@@ -530,12 +1197,45 @@ static void *client_handler_thread(void *arg) {
     }
 
 cleanup:
+    trace_flush_thread();
+    // ultime risposte (QUIT, errori): non dopo un limite superato
+    client_output_drain(&client->output, CLOSE_DRAIN_MS);
     log_info("Client %s: Disconnected, cleaning up resources", client->client_id);
+    idle_timer_stop(client);
     destroy_client_context(client);
     free(params);
     return NULL;
 }
 
+/* aspetta che il socket abbia dati (o sia chiuso): nel frattempo invia la coda di uscita
+ * quando il socket torna scrivibile e, con il tracking, le invalidazioni appena arrivano.
+ * 0 quando il socket è leggibile, -1 se la connessione va chiusa */
+static int wait_readable(client_ctx_t *client) {
+    for (;;) {
+        bool writing = client_output_pending(&client->output) > 0;
+        struct pollfd fds[2] = {
+            {.fd = client->socket, .events = POLLIN | (writing ? POLLOUT : 0)},
+            {.fd = client->tracking ? tracking_wake_fd(client->tracking) : -1, .events = POLLIN},
+        };
+        // sopra il limite soft la coda va ricontrollata anche se il client non legge
+        int timeout = writing && client->output.soft_since ? 1000 : -1;
+        if (poll(fds, client->tracking ? 2 : 1, timeout) < 0) {
+            if (errno == EINTR) {
+                if (!g_server.running) return -1;
+                continue;
+            }
+            return -1;
+        }
+        if (writing && client_output_flush(&client->output) < 0) return -1;
+        if (client->tracking && (fds[1].revents & POLLIN)) {
+            if (send_invalidations(client) < 0) return -1;
+            arena_reset(&client->arena);
+            if (client_output_flush(&client->output) < 0) return -1;
+        }
+        if (fds[0].revents & ~POLLOUT) return 0;
+    }
+}
+
 // === SERVER CONFIGURATION ===
 
 static int get_env_int(const char *env_name, int default_value, int min_val, int max_val) {
@@ -554,6 +1254,21 @@ static int get_env_int(const char *env_name, int default_value, int min_val, int
     return (int)val;
 }
 
+// permessi in ottale, come per chmod
+static mode_t get_env_mode(const char *env_name, mode_t default_value) {
+    const char *env_str = getenv(env_name);
+    if (!env_str) return default_value;
+
+    char *endptr;
+    errno = 0;
+    long val = strtol(env_str, &endptr, 8);
+    if (errno != 0 || *endptr != '\0' || val < 0 || val > 0777) {
+        log_warn("Invalid value for %s: %s, using %o", env_name, env_str, (unsigned)default_value);
+        return default_value;
+    }
+    return (mode_t)val;
+}
+
 static int get_server_port(void) {
     return get_env_int("PODCACHE_SERVER_PORT", DEFAULT_PORT, 1024, 65535);
 }
@@ -572,6 +1287,51 @@ static pod_cache_t *initialize_cache(void) {
         return NULL;
     }
 
+    // budget del tier su disco: oltre, le chiavi meno recenti vengono rimosse dal volume
+    int disk_size_mb = get_env_int("PODCACHE_DISK_SIZE", 0, 0, 1048576);
+    if (disk_size_mb > 0) {
+        pod_cache_set_disk_capacity(cache, MB_TO_BYTES(disk_size_mb));
+        log_info("Disk tier limited to %d MB", disk_size_mb);
+    }
+
+    // demotion a gruppi e durabilità: una scrittura (e al più una sync) per gruppo di chiavi
+    int demote_batch = get_env_int("PODCACHE_DEMOTE_BATCH", POD_CACHE_DEMOTE_BATCH_KEYS, 1, 64);
+    int demote_batch_kb = get_env_int("PODCACHE_DEMOTE_BATCH_KB",
+                                      (int)(POD_CACHE_DEMOTE_BATCH_BYTES / 1024), 0, 1048576);
+    pod_cache_set_demote_batch(cache, (size_t)demote_batch, (size_t)demote_batch_kb * 1024);
+    const char *disk_sync = getenv("PODCACHE_DISK_SYNC");
+    if (disk_sync && strcasecmp(disk_sync, "batch") == 0) {
+        pod_cache_set_disk_sync(cache, CAS_SYNC_BATCH);
+        log_info("Disk tier synced once per demotion batch");
+    } else if (disk_sync && strcasecmp(disk_sync, "none") != 0) {
+        log_warn("Invalid value for PODCACHE_DISK_SYNC: %s, using none", disk_sync);
+    }
+
+    // motore di I/O del tier su disco: io_uring se disponibile, altrimenti un pool di thread
+    const char *disk_io = getenv("PODCACHE_DISK_IO");
+    if (disk_io && (strcasecmp(disk_io, "uring") == 0 || strcasecmp(disk_io, "threads") == 0)) {
+        disk_io_backend_e backend =
+            strcasecmp(disk_io, "uring") == 0 ? DISK_IO_URING : DISK_IO_THREADS;
+        if (pod_cache_set_disk_io(cache, backend) != 0) {
+            log_error("Disk I/O backend %s not available", disk_io);
+            pod_cache_destroy(cache);
+            return NULL;
+        }
+    } else if (disk_io && strcasecmp(disk_io, "auto") != 0) {
+        log_warn("Invalid value for PODCACHE_DISK_IO: %s, using auto", disk_io);
+    }
+    log_info("Disk I/O backend: %s", cas_io_backend(cache->cas_registry));
+
+    // filtro di ammissione: su disco solo le chiavi lette almeno N volte di recente
+    int disk_admission = get_env_int("PODCACHE_DISK_ADMISSION", 0, 0, FREQ_SKETCH_MAX);
+    if (disk_admission > 0) {
+        if (pod_cache_set_disk_admission(cache, (unsigned)disk_admission) != 0) {
+            pod_cache_destroy(cache);
+            return NULL;
+        }
+        log_info("Disk tier admits keys read at least %d times", disk_admission);
+    }
+
     log_info("Cache initialized successfully");
     return cache;
 }
@@ -591,6 +1351,10 @@ static void signal_handler(int sig) {
         close(g_server.socket_fd);
         g_server.socket_fd = -1;
     }
+    if (g_server.unix_fd >= 0) {
+        close(g_server.unix_fd);
+        g_server.unix_fd = -1;
+    }
 }
 
 static void setup_signal_handlers(void) {
@@ -616,7 +1380,8 @@ static void setup_signal_handlers(void) {
 static int setup_server_socket(int port) {
     log_debug("Setting up server socket on port %d", port);
 
-    int sock_fd = socket(AF_INET, SOCK_STREAM, 0);
+    // non bloccante: accept_clients svuota la coda fino a EAGAIN
+    int sock_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
     if (sock_fd == -1) {
         log_error("Failed to create socket: %s", strerror(errno));
         return -1;
@@ -645,17 +1410,262 @@ static int setup_server_socket(int port) {
     }
     log_debug("Socket bound to port %d successfully", port);
 
-    if (listen(sock_fd, MAX_PENDING_CONNS) == -1) {
-        log_error("Failed to listen with backlog %d: %s", MAX_PENDING_CONNS, strerror(errno));
+    if (listen(sock_fd, g_server.tcp_backlog) == -1) {
+        log_error("Failed to listen with backlog %d: %s", g_server.tcp_backlog, strerror(errno));
         close(sock_fd);
         return -1;
     }
-    log_debug("Socket is listening with backlog %d", MAX_PENDING_CONNS);
+    log_debug("Socket is listening with backlog %d", g_server.tcp_backlog);
 
     log_info("Server socket setup complete on port %d (fd: %d)", port, sock_fd);
     return sock_fd;
 }
 
+static int setup_unix_socket(const char *path, mode_t perm) {
+    struct sockaddr_un addr = {0};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        log_error("Unix socket path too long (max %zu): %s", sizeof(addr.sun_path) - 1, path);
+        return -1;
+    }
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+
+    // un socket rimasto da un'esecuzione precedente si rimuove solo se nessuno è in ascolto
+    struct stat st;
+    if (lstat(path, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            log_error("%s exists and is not a socket", path);
+            return -1;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0 && connect(probe, (struct sockaddr *)&addr, sizeof(addr)) == 0) {
+            log_error("Another server is already listening on %s", path);
+            close(probe);
+            return -1;
+        }
+        if (probe >= 0) close(probe);
+        log_warn("Removing stale unix socket %s", path);
+        unlink(path);
+    }
+
+    int sock_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (sock_fd == -1) {
+        log_error("Failed to create unix socket: %s", strerror(errno));
+        return -1;
+    }
+    if (bind(sock_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        log_error("Failed to bind unix socket %s: %s", path, strerror(errno));
+        close(sock_fd);
+        return -1;
+    }
+    // prima di listen nessun client può connettersi: i permessi valgono fin dall'inizio
+    if (chmod(path, perm) == -1) {
+        log_error("Failed to set permissions %o on %s: %s", (unsigned)perm, path, strerror(errno));
+        close(sock_fd);
+        unlink(path);
+        return -1;
+    }
+    if (listen(sock_fd, g_server.tcp_backlog) == -1) {
+        log_error("Failed to listen on unix socket %s: %s", path, strerror(errno));
+        close(sock_fd);
+        unlink(path);
+        return -1;
+    }
+    return sock_fd;
+}
+
+/* ogni istanza può servire repliche (il backlog nasce alla prima PSYNC); con
+ * PODCACHE_REPLICAOF=host:port diventa anche replica in sola lettura di un primary */
+static int setup_replication(pod_cache_t *cache) {
+    int backlog_mb = get_env_int("PODCACHE_REPL_BACKLOG", REPL_DEFAULT_BACKLOG_MB, 1, 1024);
+    if (repl_init(cache, MB_TO_BYTES(backlog_mb)) != 0) {
+        log_error("Failed to initialize replication");
+        return -1;
+    }
+
+    const char *replicaof = getenv("PODCACHE_REPLICAOF");
+    if (!replicaof || !*replicaof) return 0;
+
+    const char *colon = strrchr(replicaof, ':');
+    char host[256];
+    char *endptr;
+    long port = colon ? strtol(colon + 1, &endptr, 10) : 0;
+    if (!colon || *endptr != '\0' || port < 1 || port > 65535 ||
+        (size_t)(colon - replicaof) >= sizeof(host) || colon == replicaof) {
+        log_error("Invalid value for PODCACHE_REPLICAOF: %s (expected host:port)", replicaof);
+        return -1;
+    }
+    memcpy(host, replicaof, (size_t)(colon - replicaof));
+    host[colon - replicaof] = '\0';
+    return repl_start_replica(cache, host, (int)port);
+}
+
+/* PODCACHE_CLUSTER_NODES=host:port,... abilita la modalità cluster; la topologia modificata
+ * da MEET e SETSLOT viene salvata in PODCACHE_CLUSTER_CONFIG (default <FSROOT>nodes.conf) */
+static int setup_cluster(pod_cache_t *cache) {
+    const char *node_list = getenv("PODCACHE_CLUSTER_NODES");
+    if (!node_list || !*node_list) return 0;
+    if (repl_is_replica()) {
+        log_error("PODCACHE_CLUSTER_NODES and PODCACHE_REPLICAOF cannot be used together");
+        return -1;
+    }
+
+    char config_path[512];
+    const char *config = getenv("PODCACHE_CLUSTER_CONFIG");
+    if (config && *config) {
+        snprintf(config_path, sizeof(config_path), "%s", config);
+    } else {
+        const char *fsroot = getenv("PODCACHE_FSROOT");
+        snprintf(config_path, sizeof(config_path), "%snodes.conf", fsroot ? fsroot : "./");
+    }
+
+    if (cluster_init(node_list, getenv("PODCACHE_CLUSTER_ANNOUNCE"), get_server_port(),
+                     config_path) != 0 ||
+        pod_cache_add_listener(cache, cluster_key_listener, NULL) != 0) {
+        log_error("Failed to initialize cluster mode");
+        return -1;
+    }
+    return 0;
+}
+
+/* PODCACHE_PEERS=host:port,... abilita il peer fill: un miss locale viene chiesto al pod
+ * proprietario della chiave prima di rispondere nil */
+static int setup_peers(pod_cache_t *cache) {
+    const char *peer_list = getenv("PODCACHE_PEERS");
+    if (!peer_list || !*peer_list) return 0;
+
+    int timeout_ms =
+        get_env_int("PODCACHE_PEER_TIMEOUT_MS", PEER_DEFAULT_TIMEOUT_MS, 1, 10000);
+    int probes = get_env_int("PODCACHE_PEER_PROBES", PEER_DEFAULT_PROBES, 1, PEER_MAX_PEERS);
+    if (peer_init(peer_list, getenv("PODCACHE_PEER_SELF"), get_server_port(), timeout_ms,
+                  probes) != 0) {
+        log_error("Failed to initialize peer fill");
+        return -1;
+    }
+    pod_cache_set_loader(cache, peer_loader, NULL);
+    return 0;
+}
+
+/* limiti sulle connessioni: quante ne sono ammesse, la coda di listen e la chiusura di
+ * quelle inattive. Il thread dei timeout parte solo con PODCACHE_IDLE_TIMEOUT > 0 */
+static int setup_connection_limits(void) {
+    g_server.tcp_backlog =
+        get_env_int("PODCACHE_TCP_BACKLOG", DEFAULT_TCP_BACKLOG, 1, 65535);
+    g_server.max_connections =
+        get_env_int("PODCACHE_MAX_CONNECTIONS", DEFAULT_MAX_CONNECTIONS, 0, 1000000);
+    g_server.idle_timeout = get_env_int("PODCACHE_IDLE_TIMEOUT", 0, 0, 86400);
+    g_server.clock = monotonic_seconds();
+    log_info("Connections: max %d, backlog %d, idle timeout %d s", g_server.max_connections,
+             g_server.tcp_backlog, g_server.idle_timeout);
+    if (g_server.idle_timeout == 0) return 0;
+
+    pthread_mutex_init(&g_server.idle_mutex, NULL);
+    timer_wheel_init(&g_server.idle_wheel, g_server.clock);
+    pthread_t reaper;
+    if (pthread_create(&reaper, NULL, idle_reaper, NULL) != 0) {
+        log_error("Failed to create idle connection reaper thread");
+        return -1;
+    }
+    pthread_detach(reaper);
+    return 0;
+}
+
+static void idle_timer_start(client_ctx_t *client) {
+    if (g_server.idle_timeout == 0) return;
+    pthread_mutex_lock(&g_server.idle_mutex);
+    client->last_active = __atomic_load_n(&g_server.clock, __ATOMIC_RELAXED);
+    timer_wheel_add(&g_server.idle_wheel, &client->idle_timer,
+                    client->last_active + (uint64_t)g_server.idle_timeout);
+    pthread_mutex_unlock(&g_server.idle_mutex);
+}
+
+// dopo questa chiamata il thread dei timeout non tocca più il client
+static void idle_timer_stop(client_ctx_t *client) {
+    if (g_server.idle_timeout == 0) return;
+    pthread_mutex_lock(&g_server.idle_mutex);
+    timer_wheel_remove(&client->idle_timer);
+    pthread_mutex_unlock(&g_server.idle_mutex);
+}
+
+/* timer scaduto (con idle_mutex bloccato): se il client ha ricevuto comandi nel frattempo il
+ * timer viene rinviato alla nuova scadenza, altrimenti il socket viene chiuso in lettura e
+ * scrittura e il thread del client esce da poll e libera la connessione */
+static void idle_expired(timer_entry_t *entry, void *ctx) {
+    (void)ctx;
+    client_ctx_t *client = (client_ctx_t *)((char *)entry - offsetof(client_ctx_t, idle_timer));
+    uint64_t now = __atomic_load_n(&g_server.clock, __ATOMIC_RELAXED);
+    uint64_t deadline = __atomic_load_n(&client->last_active, __ATOMIC_RELAXED) +
+                        (uint64_t)g_server.idle_timeout;
+    if (__atomic_load_n(&client->no_timeout, __ATOMIC_RELAXED)) {
+        deadline = now + (uint64_t)g_server.idle_timeout;
+    }
+    if (deadline > now) {
+        timer_wheel_add(&g_server.idle_wheel, entry, deadline);
+        return;
+    }
+    log_info("Client %s: idle for %d seconds, closing connection", client->client_id,
+             g_server.idle_timeout);
+    __atomic_add_fetch(&g_server.idle_closed, 1, __ATOMIC_RELAXED);
+    shutdown(client->socket, SHUT_RDWR);
+}
+
+static void *idle_reaper(void *arg) {
+    (void)arg;
+    while (g_server.running) {
+        sleep(1);
+        uint64_t now = monotonic_seconds();
+        __atomic_store_n(&g_server.clock, now, __ATOMIC_RELAXED);
+        pthread_mutex_lock(&g_server.idle_mutex);
+        timer_wheel_advance(&g_server.idle_wheel, now, idle_expired, NULL);
+        pthread_mutex_unlock(&g_server.idle_mutex);
+    }
+    return NULL;
+}
+
+static uint64_t monotonic_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec;
+}
+
+static int setup_shm_index(pod_cache_t *cache, const char *name) {
+    int size_mb = get_env_int("PODCACHE_SHM_SIZE", DEFAULT_SHM_SIZE_MB, 1, 4096);
+    mode_t perm = get_env_mode("PODCACHE_SHM_PERM", DEFAULT_UNIX_PERM);
+
+    g_server.shm = shm_index_create(name, MB_TO_BYTES(size_mb), perm);
+    if (!g_server.shm) {
+        log_error("Failed to create shared memory index %s: %s", name, strerror(errno));
+        return -1;
+    }
+    if (pod_cache_add_listener(cache, shm_index_listener, g_server.shm) != 0) {
+        log_error("Failed to register shared memory index listener");
+        return -1;
+    }
+
+    shm_index_stats_t stats;
+    shm_index_get_stats(g_server.shm, &stats);
+    log_info("Shared memory index %s: %d MB, %u slots, %.1f MB arena (mode %o)", name, size_mb,
+             stats.slots, BYTES_TO_MB(stats.arena_bytes), (unsigned)perm);
+    return 0;
+}
+
+/* tiene l'indice allineato al tier in memoria: chiamato con la partizione bloccata, quindi
+ * pubblicazioni e rimozioni di una chiave arrivano nello stesso ordine delle modifiche */
+static void shm_index_listener(pod_cache_event_e event, const char *key, const void *value,
+                               size_t size, void *ctx) {
+    shm_index_t *index = ctx;
+    switch (event) {
+    case POD_CACHE_EVENT_PUT:
+    case POD_CACHE_EVENT_PROMOTE:
+        shm_index_publish(index, key, strlen(key), value, size);
+        break;
+    case POD_CACHE_EVENT_DELETE:
+    case POD_CACHE_EVENT_DEMOTE:
+        shm_index_remove(index, key, strlen(key));
+        break;
+    }
+}
+
 static void cleanup_server(void) {
     log_info("Server cleanup initiated...");
 
@@ -664,12 +1674,32 @@ static void cleanup_server(void) {
         close(g_server.socket_fd);
         g_server.socket_fd = -1;
     }
+    if (g_server.unix_fd >= 0) {
+        close(g_server.unix_fd);
+        g_server.unix_fd = -1;
+    }
+    if (g_server.unix_path[0]) {
+        unlink(g_server.unix_path);
+        g_server.unix_path[0] = '\0';
+    }
+
+    trace_close();
+    // il thread della replica applica comandi alla cache: va fermato prima di distruggerla
+    repl_shutdown();
 
     if (g_server.cache) {
         log_debug("Destroying cache instance");
         pod_cache_destroy(g_server.cache);
         g_server.cache = NULL;
     }
+    tracking_shutdown();
+    cluster_shutdown();
+    peer_shutdown();
+    if (g_server.shm) {
+        // i client che lo hanno mappato vedono il segmento non più valido
+        shm_index_destroy(g_server.shm);
+        g_server.shm = NULL;
+    }
 
     log_info("Server cleanup completed successfully");
 }
@@ -0,0 +1,375 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/shm_index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define SHM_MAX_PROBE 16       // slot visitati per chiave, uguale per writer e reader
+#define SHM_READ_RETRIES 8     // letture ripetute se il writer modifica lo slot
+#define SHM_INDEX_FRACTION 4   // 1/4 del segmento per gli slot, il resto è arena
+#define SHM_MAX_ENTRY_FRACTION 16
+
+enum { SLOT_EMPTY = 0, SLOT_LIVE = 1, SLOT_TOMBSTONE = 2 };
+
+/* il layout del segmento è condiviso tra processi: solo tipi a dimensione fissa */
+struct shm_index_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t alive;       // 0 dopo lo shutdown del server: i client devono riaprire
+    uint64_t map_size;
+    uint64_t slots_offset;
+    uint32_t slot_count;  // potenza di 2
+    uint32_t reserved;
+    uint64_t arena_offset;
+    uint64_t arena_size;
+    uint64_t head;        // posizione assoluta (monotona) della prossima scrittura nell'arena
+    uint64_t published;
+    uint64_t removed;
+    uint64_t too_large;
+};
+
+struct shm_index_slot {
+    uint32_t seq;   // dispari mentre il writer modifica lo slot
+    uint32_t state;
+    uint64_t hash;
+    uint64_t pos;   // posizione assoluta dell'entry nell'arena
+    uint64_t len;   // lunghezza dell'entry (header + chiave + valore, allineata a 8)
+};
+
+typedef struct {
+    uint32_t key_len;
+    uint32_t value_len;
+} shm_entry_t;
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static uint64_t shm_hash(const char *key, size_t key_len);
+static bool entry_alive(const shm_index_header_t *header, uint64_t pos);
+static bool entry_matches(const shm_index_t *index, const shm_index_slot_t *slot, uint64_t hash,
+                          const char *key, size_t key_len);
+static shm_index_slot_t *find_slot_locked(shm_index_t *index, uint64_t hash, const char *key,
+                                          size_t key_len, shm_index_slot_t **free_slot);
+static void slot_write(shm_index_slot_t *slot, uint32_t state, uint64_t hash, uint64_t pos,
+                       uint64_t len);
+
+/* =============================================
+ * server side
+ * ============================================= */
+
+shm_index_t *shm_index_create(const char *name, size_t size, mode_t perm) {
+    if (!name || name[0] != '/' || strlen(name) >= sizeof(((shm_index_t *)0)->name) ||
+        size < 1024 * 1024) {
+        return NULL;
+    }
+
+    shm_index_t *index = calloc(1, sizeof(shm_index_t));
+    if (!index) return NULL;
+
+    // un segmento rimasto da un'esecuzione precedente non è più valido
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, perm);
+    if (fd == -1) {
+        free(index);
+        return NULL;
+    }
+    // shm_open applica la umask: i permessi richiesti vanno impostati esplicitamente
+    if (fchmod(fd, perm) == -1 || ftruncate(fd, (off_t)size) == -1) {
+        close(fd);
+        shm_unlink(name);
+        free(index);
+        return NULL;
+    }
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        shm_unlink(name);
+        free(index);
+        return NULL;
+    }
+
+    uint32_t slot_count = 1024;
+    while ((uint64_t)slot_count * 2 * sizeof(shm_index_slot_t) <= size / SHM_INDEX_FRACTION) {
+        slot_count *= 2;
+    }
+
+    shm_index_header_t *header = base;
+    memset(header, 0, sizeof(*header));
+    header->version = SHM_INDEX_VERSION;
+    header->map_size = size;
+    header->slots_offset = 64;
+    header->slot_count = slot_count;
+    header->arena_offset = header->slots_offset + (uint64_t)slot_count * sizeof(shm_index_slot_t);
+    header->arena_offset = (header->arena_offset + 63) & ~(uint64_t)63;
+    header->arena_size = (size - header->arena_offset) & ~(uint64_t)7;
+
+    index->header = header;
+    index->slots = (shm_index_slot_t *)((char *)base + header->slots_offset);
+    index->arena = (unsigned char *)base + header->arena_offset;
+    index->map_size = size;
+    index->owner = 1;
+    snprintf(index->name, sizeof(index->name), "%s", name);
+    pthread_mutex_init(&index->write_mutex, NULL);
+
+    // il magic per ultimo: un client che apre il segmento troppo presto lo rifiuta
+    __atomic_store_n(&header->alive, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, SHM_INDEX_MAGIC, sizeof(header->magic));
+    return index;
+}
+
+int shm_index_publish(shm_index_t *index, const char *key, size_t key_len, const void *value,
+                      size_t value_len) {
+    if (!index || !index->owner || !key || (!value && value_len > 0)) return -1;
+    shm_index_header_t *header = index->header;
+
+    uint64_t len = (sizeof(shm_entry_t) + key_len + value_len + 7) & ~(uint64_t)7;
+    if (len > header->arena_size / SHM_MAX_ENTRY_FRACTION || key_len > UINT32_MAX) {
+        // la versione precedente non deve restare leggibile
+        shm_index_remove(index, key, key_len);
+        __atomic_add_fetch(&header->too_large, 1, __ATOMIC_RELAXED);
+        return -1;
+    }
+
+    uint64_t hash = shm_hash(key, key_len);
+    pthread_mutex_lock(&index->write_mutex);
+
+    shm_index_slot_t *free_slot = NULL;
+    shm_index_slot_t *slot = find_slot_locked(index, hash, key, key_len, &free_slot);
+    // tabella piena lungo la sequenza di probing: sostituisco lo slot di partenza
+    if (!slot) slot = free_slot ? free_slot : &index->slots[hash & (header->slot_count - 1)];
+
+    // le entry non attraversano la fine dell'arena: salto il resto del giro
+    uint64_t head = header->head;
+    uint64_t offset = head % header->arena_size;
+    if (offset + len > header->arena_size) head += header->arena_size - offset;
+    uint64_t pos = head;
+
+    /* prima avanza head, poi si scrive: un reader che copia un'entry sovrascritta se ne accorge
+     * rileggendo head dopo la copia */
+    __atomic_store_n(&header->head, pos + len, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    unsigned char *dst = index->arena + pos % header->arena_size;
+    shm_entry_t entry = {.key_len = (uint32_t)key_len, .value_len = (uint32_t)value_len};
+    memcpy(dst, &entry, sizeof(entry));
+    memcpy(dst + sizeof(entry), key, key_len);
+    if (value_len) memcpy(dst + sizeof(entry) + key_len, value, value_len);
+
+    slot_write(slot, SLOT_LIVE, hash, pos, len);
+    header->published++;
+    pthread_mutex_unlock(&index->write_mutex);
+    return 0;
+}
+
+void shm_index_remove(shm_index_t *index, const char *key, size_t key_len) {
+    if (!index || !index->owner || !key) return;
+
+    uint64_t hash = shm_hash(key, key_len);
+    pthread_mutex_lock(&index->write_mutex);
+    shm_index_slot_t *free_slot = NULL;
+    shm_index_slot_t *slot = find_slot_locked(index, hash, key, key_len, &free_slot);
+    if (slot) {
+        slot_write(slot, SLOT_TOMBSTONE, 0, 0, 0);
+        index->header->removed++;
+    }
+    pthread_mutex_unlock(&index->write_mutex);
+}
+
+void shm_index_get_stats(shm_index_t *index, shm_index_stats_t *out) {
+    if (!index || !out) return;
+    out->published = __atomic_load_n(&index->header->published, __ATOMIC_RELAXED);
+    out->removed = __atomic_load_n(&index->header->removed, __ATOMIC_RELAXED);
+    out->too_large = __atomic_load_n(&index->header->too_large, __ATOMIC_RELAXED);
+    out->arena_bytes = index->header->arena_size;
+    out->slots = index->header->slot_count;
+}
+
+void shm_index_destroy(shm_index_t *index) {
+    if (!index) return;
+    if (index->owner) {
+        // i client che hanno ancora il segmento mappato smettono di usarlo
+        __atomic_store_n(&index->header->alive, 0, __ATOMIC_RELEASE);
+        shm_unlink(index->name);
+        pthread_mutex_destroy(&index->write_mutex);
+    }
+    munmap(index->header, index->map_size);
+    free(index);
+}
+
+/* =============================================
+ * client side
+ * ============================================= */
+
+shm_index_t *shm_index_open(const char *name) {
+    if (!name) return NULL;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(shm_index_header_t)) {
+        close(fd);
+        return NULL;
+    }
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    shm_index_header_t *header = base;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (memcmp(header->magic, SHM_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SHM_INDEX_VERSION || header->map_size != (uint64_t)st.st_size ||
+        header->arena_offset + header->arena_size > header->map_size) {
+        munmap(base, (size_t)st.st_size);
+        errno = EPROTO;
+        return NULL;
+    }
+
+    shm_index_t *index = calloc(1, sizeof(shm_index_t));
+    if (!index) {
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    index->header = header;
+    index->slots = (shm_index_slot_t *)((char *)base + header->slots_offset);
+    index->arena = (unsigned char *)base + header->arena_offset;
+    index->map_size = (size_t)st.st_size;
+    snprintf(index->name, sizeof(index->name), "%s", name);
+    return index;
+}
+
+int shm_index_get(shm_index_t *index, const char *key, size_t key_len, void *buf,
+                  size_t buf_size, size_t *value_len) {
+    if (!index || !key || !value_len) return -1;
+    const shm_index_header_t *header = index->header;
+    if (!__atomic_load_n(&header->alive, __ATOMIC_ACQUIRE)) return -1;
+
+    uint64_t hash = shm_hash(key, key_len);
+    uint32_t mask = header->slot_count - 1;
+    uint64_t arena_size = header->arena_size;
+
+    for (uint32_t probe = 0; probe < SHM_MAX_PROBE; probe++) {
+        shm_index_slot_t *slot = &index->slots[(hash + probe) & mask];
+
+        for (int attempt = 0; attempt < SHM_READ_RETRIES; attempt++) {
+            uint32_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+            if (seq & 1) continue; // il writer sta modificando lo slot
+
+            uint32_t state = __atomic_load_n(&slot->state, __ATOMIC_RELAXED);
+            uint64_t slot_hash = __atomic_load_n(&slot->hash, __ATOMIC_RELAXED);
+            uint64_t pos = __atomic_load_n(&slot->pos, __ATOMIC_RELAXED);
+            uint64_t len = __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+
+            int result = 1; // 1 = prossimo slot
+            if (state == SLOT_EMPTY) {
+                result = -100;
+            } else if (state == SLOT_LIVE && slot_hash == hash && len >= sizeof(shm_entry_t) &&
+                       pos % arena_size + len <= arena_size) {
+                // i campi letti possono essere incoerenti: si controllano i limiti prima di usarli
+                const unsigned char *src = index->arena + pos % arena_size;
+                shm_entry_t entry;
+                memcpy(&entry, src, sizeof(entry));
+                if (entry.key_len == key_len &&
+                    sizeof(entry) + (uint64_t)entry.key_len + entry.value_len <= len &&
+                    memcmp(src + sizeof(entry), key, key_len) == 0) {
+                    *value_len = entry.value_len;
+                    if (entry.value_len > buf_size) {
+                        result = -2;
+                    } else {
+                        if (entry.value_len) {
+                            memcpy(buf, src + sizeof(entry) + key_len, entry.value_len);
+                        }
+                        result = 0;
+                    }
+                }
+            }
+
+            // la lettura vale solo se slot e arena non sono cambiati durante la copia
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) continue;
+            if (result == 0 || result == -2) {
+                uint64_t head = __atomic_load_n(&header->head, __ATOMIC_RELAXED);
+                if (pos + arena_size < head) return -100; // entry già sovrascritta
+                return result;
+            }
+            if (result == -100) return -100;
+            break;
+        }
+    }
+    return -100;
+}
+
+void shm_index_close(shm_index_t *index) { shm_index_destroy(index); }
+
+/* =============================================
+ * static functions implementation
+ * ============================================= */
+
+// FNV-1a 64: il client non dipende da hash_func
+static uint64_t shm_hash(const char *key, size_t key_len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < key_len; i++) {
+        h ^= (unsigned char)key[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static bool entry_alive(const shm_index_header_t *header, uint64_t pos) {
+    return pos + header->arena_size >= header->head;
+}
+
+static bool entry_matches(const shm_index_t *index, const shm_index_slot_t *slot, uint64_t hash,
+                          const char *key, size_t key_len) {
+    if (slot->state != SLOT_LIVE || slot->hash != hash) return false;
+    if (!entry_alive(index->header, slot->pos)) return false;
+    const unsigned char *src = index->arena + slot->pos % index->header->arena_size;
+    shm_entry_t entry;
+    memcpy(&entry, src, sizeof(entry));
+    return entry.key_len == key_len && memcmp(src + sizeof(entry), key, key_len) == 0;
+}
+
+/* slot che contiene la chiave (NULL se assente); in free_slot il primo slot riutilizzabile
+ * lungo la sequenza di probing. Il chiamante tiene write_mutex */
+static shm_index_slot_t *find_slot_locked(shm_index_t *index, uint64_t hash, const char *key,
+                                          size_t key_len, shm_index_slot_t **free_slot) {
+    uint32_t mask = index->header->slot_count - 1;
+    *free_slot = NULL;
+    for (uint32_t probe = 0; probe < SHM_MAX_PROBE; probe++) {
+        shm_index_slot_t *slot = &index->slots[(hash + probe) & mask];
+        if (slot->state == SLOT_EMPTY) {
+            if (!*free_slot) *free_slot = slot;
+            return NULL; // fine della sequenza: la chiave non c'è
+        }
+        if (entry_matches(index, slot, hash, key, key_len)) return slot;
+        // tombstone o entry sovrascritta dall'arena: riutilizzabile
+        bool stale = slot->state == SLOT_TOMBSTONE || !entry_alive(index->header, slot->pos);
+        if (stale && !*free_slot) *free_slot = slot;
+    }
+    return NULL;
+}
+
+static void slot_write(shm_index_slot_t *slot, uint32_t state, uint64_t hash, uint64_t pos,
+                       uint64_t len) {
+    uint32_t seq = slot->seq;
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&slot->state, state, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->hash, hash, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->pos, pos, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->len, len, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,81 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/timer_wheel.h"
+
+#include <stddef.h>
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static void run_slot(timer_wheel_t *wheel, timer_entry_t *head, uint64_t now,
+                     timer_expired_fn expired, void *ctx);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+void timer_wheel_init(timer_wheel_t *wheel, uint64_t now) {
+    for (int i = 0; i < TIMER_WHEEL_SLOTS; i++) {
+        wheel->slots[i].prev = wheel->slots[i].next = &wheel->slots[i];
+    }
+    wheel->now = now;
+}
+
+void timer_wheel_add(timer_wheel_t *wheel, timer_entry_t *entry, uint64_t expires) {
+    // già scaduto: nel primo slot che advance visiterà
+    if (expires <= wheel->now) expires = wheel->now + 1;
+    entry->expires = expires;
+    timer_entry_t *head = &wheel->slots[expires % TIMER_WHEEL_SLOTS];
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+void timer_wheel_remove(timer_entry_t *entry) {
+    if (!entry->next) return;
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+void timer_wheel_advance(timer_wheel_t *wheel, uint64_t now, timer_expired_fn expired, void *ctx) {
+    if (now <= wheel->now) return;
+    // dopo una pausa più lunga di un giro basta visitare ogni slot una volta
+    uint64_t tick = now - wheel->now > TIMER_WHEEL_SLOTS ? now - TIMER_WHEEL_SLOTS : wheel->now;
+    while (tick < now) {
+        wheel->now = ++tick;
+        run_slot(wheel, &wheel->slots[tick % TIMER_WHEEL_SLOTS], now, expired, ctx);
+    }
+}
+
+/* =============================================
+ * static functions
+ * ============================================= */
+
+static void run_slot(timer_wheel_t *wheel, timer_entry_t *head, uint64_t now,
+                     timer_expired_fn expired, void *ctx) {
+    if (head->next == head) return;
+
+    // la lista viene staccata: i timer reinseriti dal callback non vengono rivisitati
+    timer_entry_t pending = {.prev = head->prev, .next = head->next};
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head->prev = head->next = head;
+
+    while (pending.next != &pending) {
+        timer_entry_t *entry = pending.next;
+        timer_wheel_remove(entry);
+        if (entry->expires <= now) {
+            expired(entry, ctx);
+        } else {
+            // scade in un giro successivo
+            timer_wheel_add(wheel, entry, entry->expires);
+        }
+    }
+}
@@ -0,0 +1,177 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/trace.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+#include "../include/hash_func.h"
+
+#define TRACE_THREAD_BUFFER 256
+#define TRACE_FILE_BUFFER (1024 * 1024)
+
+static FILE *trace_fp = NULL;
+static volatile int trace_active = 0;
+static uint64_t trace_start_ns = 0;
+static pthread_mutex_t trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// ogni thread accumula i propri record e prende il lock solo per scriverli a blocchi
+static __thread trace_record_t thread_records[TRACE_THREAD_BUFFER];
+static __thread size_t thread_count = 0;
+
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* =============================================
+ * capture
+ * ============================================= */
+
+int trace_open(const char *path) {
+    if (!path) return -1;
+
+    pthread_mutex_lock(&trace_mutex);
+    if (trace_fp) {
+        pthread_mutex_unlock(&trace_mutex);
+        log_warn("Trace already open, ignoring %s", path);
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        pthread_mutex_unlock(&trace_mutex);
+        log_error("Failed to open trace file: %s", path);
+        return -1;
+    }
+    setvbuf(fp, NULL, _IOFBF, TRACE_FILE_BUFFER);
+
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    trace_header_t header = {0};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_VERSION;
+    header.record_size = sizeof(trace_record_t);
+    header.start_unix_ns = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+
+    if (fwrite(&header, sizeof(header), 1, fp) != 1) {
+        fclose(fp);
+        pthread_mutex_unlock(&trace_mutex);
+        log_error("Failed to write trace header: %s", path);
+        return -1;
+    }
+
+    trace_fp = fp;
+    trace_start_ns = monotonic_ns();
+    trace_active = 1;
+    pthread_mutex_unlock(&trace_mutex);
+
+    log_info("Workload trace capture enabled: %s", path);
+    return 0;
+}
+
+bool trace_enabled(void) { return trace_active != 0; }
+
+void trace_record(resp_command_e command, const char *key, size_t value_size) {
+    if (!trace_active) return;
+
+    trace_record_t *record = &thread_records[thread_count++];
+    record->timestamp_ns = monotonic_ns() - trace_start_ns;
+    record->key_hash = key ? hash64(key) : 0;
+    record->value_size = value_size > UINT32_MAX ? UINT32_MAX : (uint32_t)value_size;
+    record->command = (uint8_t)command;
+    memset(record->reserved, 0, sizeof(record->reserved));
+
+    if (thread_count == TRACE_THREAD_BUFFER) trace_flush_thread();
+}
+
+void trace_flush_thread(void) {
+    if (thread_count == 0) return;
+
+    pthread_mutex_lock(&trace_mutex);
+    if (trace_fp && fwrite(thread_records, sizeof(trace_record_t), thread_count, trace_fp) !=
+                        thread_count) {
+        log_error("Failed to write trace records, disabling capture");
+        trace_active = 0;
+    }
+    pthread_mutex_unlock(&trace_mutex);
+    thread_count = 0;
+}
+
+void trace_close(void) {
+    if (!trace_fp) return;
+
+    trace_flush_thread();
+
+    pthread_mutex_lock(&trace_mutex);
+    trace_active = 0;
+    fclose(trace_fp);
+    trace_fp = NULL;
+    pthread_mutex_unlock(&trace_mutex);
+    log_info("Workload trace capture closed");
+}
+
+/* =============================================
+ * reading
+ * ============================================= */
+
+int trace_file_open(trace_file_t *trace, const char *path) {
+    memset(trace, 0, sizeof(*trace));
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        log_error("Failed to open trace file: %s", path);
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(trace_header_t)) {
+        log_error("Trace file too small: %s", path);
+        close(fd);
+        return -1;
+    }
+
+    void *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        log_error("Failed to map trace file: %s", path);
+        return -1;
+    }
+
+    const trace_header_t *header = base;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != TRACE_VERSION || header->record_size != sizeof(trace_record_t)) {
+        log_error("Not a PodCache trace (or unsupported version): %s", path);
+        munmap(base, (size_t)st.st_size);
+        return -1;
+    }
+
+    trace->base = base;
+    trace->map_size = (size_t)st.st_size;
+    trace->header = header;
+    trace->records = (const trace_record_t *)((const char *)base + sizeof(trace_header_t));
+    // un record troncato in coda (server terminato durante una scrittura) viene ignorato
+    trace->count = (trace->map_size - sizeof(trace_header_t)) / sizeof(trace_record_t);
+    madvise(base, trace->map_size, MADV_SEQUENTIAL);
+    return 0;
+}
+
+void trace_file_close(trace_file_t *trace) {
+    if (trace->base) munmap(trace->base, trace->map_size);
+    memset(trace, 0, sizeof(*trace));
+}
@@ -0,0 +1,401 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+#include "../include/tracking.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/clogger.h"
+#include "../include/hash_func.h"
+
+#define TRACKING_INITIAL_BUCKETS 1024
+
+struct tracking_client {
+    uint64_t id;
+    bool bcast;
+    bool noloop;
+    int prefix_count;
+    char *prefixes[TRACKING_MAX_PREFIXES];
+    int wake_pipe[2];  // [0] letto dal thread del client, [1] scritto da chi accoda
+    char **pending;    // chiavi da invalidare, in ordine di modifica
+    size_t pending_count;
+    size_t pending_capacity;
+    bool flush_all;
+    struct tracking_client *next;
+};
+
+// chiave letta da almeno un client in modalità default
+typedef struct tracked_key {
+    struct tracked_key *next;  // catena del bucket
+    struct tracked_key *older; // ordine di inserimento: la più vecchia viene dimenticata per prima
+    struct tracked_key *newer;
+    uint32_t hash;
+    uint32_t client_count;
+    uint32_t client_capacity;
+    uint64_t *clients; // id dei client, risolti al momento dell'invalidazione
+    char key[];
+} tracked_key_t;
+
+// un solo mutex: la tabella, il registry dei client e le code sono modificati insieme
+static pthread_mutex_t tracking_mutex = PTHREAD_MUTEX_INITIALIZER;
+static tracked_key_t **buckets = NULL;
+static size_t bucket_count = 0;
+static size_t key_count = 0;
+static size_t max_keys = TRACKING_DEFAULT_MAX_KEYS;
+static tracked_key_t *oldest = NULL;
+static tracked_key_t *newest = NULL;
+static tracking_client_t *clients = NULL;
+static int active_clients = 0; // letto senza lock: nessun client, nessun lavoro sulle scritture
+static uint64_t stat_invalidations = 0;
+static uint64_t stat_evicted = 0;
+
+static __thread uint64_t current_client = 0;
+
+/* ======================================================
+ * forward declaration static functions
+ *  ====================================================== */
+static tracking_client_t *find_client(uint64_t id);
+static void enqueue(tracking_client_t *client, const char *key);
+static void clear_pending(tracking_client_t *client);
+static tracked_key_t *find_key(const char *key, uint32_t key_hash);
+static tracked_key_t *insert_key(const char *key, uint32_t key_hash);
+static void invalidate_key(tracked_key_t *entry, uint64_t origin);
+static void remove_key(tracked_key_t *entry);
+static int grow_buckets(void);
+static bool matches_prefix(const tracking_client_t *client, const char *key);
+
+/* =============================================
+ * public functions
+ * ============================================= */
+
+int tracking_init(size_t limit) {
+    pthread_mutex_lock(&tracking_mutex);
+    max_keys = limit > 0 ? limit : TRACKING_DEFAULT_MAX_KEYS;
+    if (!buckets) {
+        buckets = calloc(TRACKING_INITIAL_BUCKETS, sizeof(tracked_key_t *));
+        bucket_count = buckets ? TRACKING_INITIAL_BUCKETS : 0;
+    }
+    pthread_mutex_unlock(&tracking_mutex);
+    return buckets ? 0 : -1;
+}
+
+void tracking_shutdown(void) {
+    pthread_mutex_lock(&tracking_mutex);
+    while (oldest) {
+        remove_key(oldest);
+    }
+    free(buckets);
+    buckets = NULL;
+    bucket_count = 0;
+    pthread_mutex_unlock(&tracking_mutex);
+}
+
+tracking_client_t *tracking_enable(uint64_t client_id, const tracking_options_t *options) {
+    if (!options || options->prefix_count > TRACKING_MAX_PREFIXES) return NULL;
+
+    pthread_mutex_lock(&tracking_mutex);
+    tracking_client_t *client = find_client(client_id);
+    if (!client) {
+        client = calloc(1, sizeof(tracking_client_t));
+        if (!client || pipe(client->wake_pipe) == -1) {
+            pthread_mutex_unlock(&tracking_mutex);
+            free(client);
+            log_error("Failed to enable tracking for client %llu", (unsigned long long)client_id);
+            return NULL;
+        }
+        // chi accoda non deve mai bloccarsi su una pipe piena
+        fcntl(client->wake_pipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(client->wake_pipe[1], F_SETFL, O_NONBLOCK);
+        client->id = client_id;
+        client->next = clients;
+        clients = client;
+        __atomic_add_fetch(&active_clients, 1, __ATOMIC_RELAXED);
+    }
+
+    for (int i = 0; i < client->prefix_count; i++) {
+        free(client->prefixes[i]);
+    }
+    client->bcast = options->bcast;
+    client->noloop = options->noloop;
+    client->prefix_count = 0;
+    for (int i = 0; i < options->prefix_count; i++) {
+        char *prefix = strdup(options->prefixes[i]);
+        if (prefix) client->prefixes[client->prefix_count++] = prefix;
+    }
+    pthread_mutex_unlock(&tracking_mutex);
+    return client;
+}
+
+void tracking_disable(tracking_client_t *client) {
+    if (!client) return;
+
+    pthread_mutex_lock(&tracking_mutex);
+    for (tracking_client_t **it = &clients; *it; it = &(*it)->next) {
+        if (*it == client) {
+            *it = client->next;
+            break;
+        }
+    }
+    __atomic_sub_fetch(&active_clients, 1, __ATOMIC_RELAXED);
+    clear_pending(client);
+    pthread_mutex_unlock(&tracking_mutex);
+
+    // le chiavi della tabella che lo citano vengono ripulite alla loro invalidazione
+    for (int i = 0; i < client->prefix_count; i++) {
+        free(client->prefixes[i]);
+    }
+    free(client->pending);
+    close(client->wake_pipe[0]);
+    close(client->wake_pipe[1]);
+    free(client);
+}
+
+bool tracking_is_bcast(const tracking_client_t *client) { return client && client->bcast; }
+
+int tracking_wake_fd(const tracking_client_t *client) {
+    return client ? client->wake_pipe[0] : -1;
+}
+
+void tracking_remember(tracking_client_t *client, const char *key) {
+    if (!client || !key || client->bcast) return;
+
+    uint32_t key_hash = hash(key);
+    pthread_mutex_lock(&tracking_mutex);
+    tracked_key_t *entry = find_key(key, key_hash);
+    if (!entry) entry = insert_key(key, key_hash);
+    if (!entry) {
+        pthread_mutex_unlock(&tracking_mutex);
+        return;
+    }
+
+    for (uint32_t i = 0; i < entry->client_count; i++) {
+        if (entry->clients[i] == client->id) {
+            pthread_mutex_unlock(&tracking_mutex);
+            return;
+        }
+    }
+    if (entry->client_count == entry->client_capacity) {
+        uint32_t capacity = entry->client_capacity ? entry->client_capacity * 2 : 2;
+        uint64_t *grown = realloc(entry->clients, capacity * sizeof(uint64_t));
+        if (!grown) {
+            pthread_mutex_unlock(&tracking_mutex);
+            return;
+        }
+        entry->clients = grown;
+        entry->client_capacity = capacity;
+    }
+    entry->clients[entry->client_count++] = client->id;
+    pthread_mutex_unlock(&tracking_mutex);
+}
+
+void tracking_invalidate(const char *key) {
+    if (!key || __atomic_load_n(&active_clients, __ATOMIC_RELAXED) == 0) return;
+
+    uint32_t key_hash = hash(key);
+    pthread_mutex_lock(&tracking_mutex);
+    tracked_key_t *entry = buckets ? find_key(key, key_hash) : NULL;
+    if (entry) invalidate_key(entry, current_client);
+
+    for (tracking_client_t *client = clients; client; client = client->next) {
+        if (!client->bcast || (client->noloop && client->id == current_client)) continue;
+        if (matches_prefix(client, key)) enqueue(client, key);
+    }
+    pthread_mutex_unlock(&tracking_mutex);
+}
+
+void tracking_set_current_client(uint64_t client_id) { current_client = client_id; }
+
+void tracking_drain(tracking_client_t *client, char ***keys, size_t *count, bool *flush_all) {
+    pthread_mutex_lock(&tracking_mutex);
+    *keys = client->pending;
+    *count = client->pending_count;
+    *flush_all = client->flush_all;
+    client->pending = NULL;
+    client->pending_count = 0;
+    client->pending_capacity = 0;
+    client->flush_all = false;
+
+    char discard[64];
+    while (read(client->wake_pipe[0], discard, sizeof(discard)) > 0) {
+    }
+    pthread_mutex_unlock(&tracking_mutex);
+}
+
+void tracking_free_keys(char **keys, size_t count) {
+    if (!keys) return;
+    for (size_t i = 0; i < count; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+}
+
+void tracking_get_stats(tracking_stats_t *out) {
+    if (!out) return;
+    pthread_mutex_lock(&tracking_mutex);
+    out->tracked_keys = key_count;
+    out->tracking_clients = (uint64_t)active_clients;
+    out->invalidations = stat_invalidations;
+    out->evicted_keys = stat_evicted;
+    pthread_mutex_unlock(&tracking_mutex);
+}
+
+/* =============================================
+ * static functions implementation
+ * ============================================= */
+
+static tracking_client_t *find_client(uint64_t id) {
+    for (tracking_client_t *client = clients; client; client = client->next) {
+        if (client->id == id) return client;
+    }
+    return NULL;
+}
+
+static void wake(tracking_client_t *client) {
+    char byte = 1;
+    ssize_t written = write(client->wake_pipe[1], &byte, 1);
+    (void)written; // pipe piena: il client ha già una sveglia in sospeso
+}
+
+static void enqueue(tracking_client_t *client, const char *key) {
+    stat_invalidations++;
+    if (client->flush_all) return;
+
+    bool was_empty = client->pending_count == 0;
+    if (client->pending_count == TRACKING_MAX_PENDING) {
+        // client troppo lento: invece di crescere senza limite gli chiedo di svuotare tutto
+        clear_pending(client);
+        client->flush_all = true;
+        return;
+    }
+    if (client->pending_count == client->pending_capacity) {
+        size_t capacity = client->pending_capacity ? client->pending_capacity * 2 : 16;
+        char **grown = realloc(client->pending, capacity * sizeof(char *));
+        if (!grown) {
+            clear_pending(client);
+            client->flush_all = true;
+            wake(client);
+            return;
+        }
+        client->pending = grown;
+        client->pending_capacity = capacity;
+    }
+    char *copy = strdup(key);
+    if (!copy) {
+        clear_pending(client);
+        client->flush_all = true;
+        wake(client);
+        return;
+    }
+    client->pending[client->pending_count++] = copy;
+    if (was_empty) wake(client);
+}
+
+static void clear_pending(tracking_client_t *client) {
+    for (size_t i = 0; i < client->pending_count; i++) {
+        free(client->pending[i]);
+    }
+    client->pending_count = 0;
+}
+
+static tracked_key_t *find_key(const char *key, uint32_t key_hash) {
+    for (tracked_key_t *entry = buckets[key_hash & (bucket_count - 1)]; entry;
+         entry = entry->next) {
+        if (entry->hash == key_hash && strcmp(entry->key, key) == 0) return entry;
+    }
+    return NULL;
+}
+
+static tracked_key_t *insert_key(const char *key, uint32_t key_hash) {
+    if (!buckets) return NULL;
+
+    // tabella piena: la chiave più vecchia viene invalidata, i client la rileggeranno
+    while (key_count >= max_keys && oldest) {
+        invalidate_key(oldest, 0);
+        stat_evicted++;
+    }
+    if (key_count >= bucket_count && grow_buckets() != 0) return NULL;
+
+    size_t key_len = strlen(key);
+    tracked_key_t *entry = calloc(1, sizeof(tracked_key_t) + key_len + 1);
+    if (!entry) return NULL;
+    memcpy(entry->key, key, key_len + 1);
+    entry->hash = key_hash;
+
+    size_t bucket = key_hash & (bucket_count - 1);
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+
+    entry->older = newest;
+    if (newest) newest->newer = entry;
+    newest = entry;
+    if (!oldest) oldest = entry;
+    key_count++;
+    return entry;
+}
+
+// come Redis: dopo l'invalidazione la chiave non è più tracciata finché non viene riletta
+static void invalidate_key(tracked_key_t *entry, uint64_t origin) {
+    for (uint32_t i = 0; i < entry->client_count; i++) {
+        tracking_client_t *client = find_client(entry->clients[i]);
+        // client disconnesso o passato a BCAST
+        if (!client || client->bcast) continue;
+        if (client->noloop && client->id == origin) continue;
+        enqueue(client, entry->key);
+    }
+    remove_key(entry);
+}
+
+static void remove_key(tracked_key_t *entry) {
+    tracked_key_t **it = &buckets[entry->hash & (bucket_count - 1)];
+    while (*it != entry) {
+        it = &(*it)->next;
+    }
+    *it = entry->next;
+
+    if (entry->older) entry->older->newer = entry->newer;
+    else oldest = entry->newer;
+    if (entry->newer) entry->newer->older = entry->older;
+    else newest = entry->older;
+
+    key_count--;
+    free(entry->clients);
+    free(entry);
+}
+
+static int grow_buckets(void) {
+    size_t new_count = bucket_count * 2;
+    tracked_key_t **grown = calloc(new_count, sizeof(tracked_key_t *));
+    if (!grown) return -1;
+
+    for (size_t i = 0; i < bucket_count; i++) {
+        tracked_key_t *entry = buckets[i];
+        while (entry) {
+            tracked_key_t *next = entry->next;
+            size_t bucket = entry->hash & (new_count - 1);
+            entry->next = grown[bucket];
+            grown[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(buckets);
+    buckets = grown;
+    bucket_count = new_count;
+    return 0;
+}
+
+static bool matches_prefix(const tracking_client_t *client, const char *key) {
+    if (client->prefix_count == 0) return true; // BCAST senza PREFIX: tutte le chiavi
+    for (int i = 0; i < client->prefix_count; i++) {
+        if (strncmp(key, client->prefixes[i], strlen(client->prefixes[i])) == 0) return true;
+    }
+    return false;
+}
@@ -0,0 +1,130 @@
+#!/bin/bash
+
+# PodCache Cluster Test
+# Tre nodi sullo stesso host: mappa degli slot, redirect MOVED, migrazione online di uno
+# slot con redirect ASK durante lo spostamento e cambio di proprietario a fine migrazione.
+# I nodi hanno più partizioni (PODCACHE_PARTITIONS, default 4): le chiavi migrate stanno in
+# partizioni diverse.
+#
+# Usage: ./test_cluster.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Cluster Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORTS=(7001 7002 7003)
+NODES="127.0.0.1:7001,127.0.0.1:7002,127.0.0.1:7003"
+PARTITIONS="${PODCACHE_PARTITIONS:-4}"
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-cluster-XXXXXX")"
+PIDS=()
+SLOT=12182 # CLUSTER KEYSLOT foo, servito dal terzo nodo
+KEYS=40
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    for pid in "${PIDS[@]}"; do
+        kill -INT "$pid" 2>/dev/null || true
+    done
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    exit 1
+}
+
+# comandi RESP su /dev/tcp: ogni argomento "cmd arg ..." è un comando, tutti sulla stessa
+# connessione (serve per ASKING + comando); "" indica un argomento vuoto
+resp() {
+    local port="$1"
+    shift
+    local payload=""
+    for command in "$@"; do
+        read -r -a args <<< "$command"
+        payload+="*${#args[@]}\r\n"
+        for arg in "${args[@]}"; do
+            [ "$arg" = '""' ] && arg="" # argomento vuoto
+            payload+="\$${#arg}\r\n${arg}\r\n"
+        done
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf "%b" "$payload" >&3
+    timeout 0.3 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. Three nodes with $PARTITIONS partitions, slots split in equal parts${NC}"
+for port in "${PORTS[@]}"; do
+    mkdir -p "$WORK_DIR/$port"
+    PODCACHE_SIZE=1 PODCACHE_PARTITIONS=$PARTITIONS PODCACHE_SERVER_PORT=$port \
+        PODCACHE_FSROOT="$WORK_DIR/$port/" PODCACHE_CLUSTER_NODES=$NODES "$BUILD_DIR/podcache" > "$WORK_DIR/$port.log" 2>&1 &
+    PIDS+=($!)
+done
+sleep 0.5
+
+for port in "${PORTS[@]}"; do
+    resp $port "CLUSTER INFO" | grep -q "^cluster_state:ok" || fail "cluster state on $port"
+done
+[ "$(resp 7001 "CLUSTER SLOTS" | head -1)" = "*3" ] || fail "CLUSTER SLOTS should list 3 ranges"
+[ "$(resp 7001 "CLUSTER KEYSLOT foo")" = ":$SLOT" ] || fail "wrong slot for 'foo'"
+[ "$(resp 7001 "CLUSTER KEYSLOT {user1}.a")" = "$(resp 7001 "CLUSTER KEYSLOT {user1}.b")" ] || \
+    fail "hash tags not honoured"
+echo -e "${GREEN}Slot map and key slots as in Redis Cluster${NC}"
+
+echo -e "${YELLOW}2. MOVED redirects${NC}"
+[ "$(resp 7001 "SET foo bar")" = "-MOVED $SLOT 127.0.0.1:7003" ] || fail "no MOVED from 7001"
+[ "$(resp 7003 "SET foo bar")" = "+OK" ] || fail "SET on the owner"
+for i in $(seq 1 $KEYS); do
+    resp 7003 "SET {foo}$i value$i" > /dev/null
+done
+[ "$(resp 7003 "CLUSTER COUNTKEYSINSLOT $SLOT")" = ":$((KEYS + 1))" ] || fail "slot key count"
+echo -e "${GREEN}Keys served only by the slot owner${NC}"
+
+echo -e "${YELLOW}3. Online migration of slot $SLOT from 7003 to 7001${NC}"
+SOURCE_ID=$(resp 7003 "CLUSTER MYID" | tail -1)
+TARGET_ID=$(resp 7001 "CLUSTER MYID" | tail -1)
+[ "$(resp 7001 "CLUSTER SETSLOT $SLOT IMPORTING $SOURCE_ID")" = "+OK" ] || fail "IMPORTING"
+[ "$(resp 7003 "CLUSTER SETSLOT $SLOT MIGRATING $TARGET_ID")" = "+OK" ] || fail "MIGRATING"
+
+# un primo blocco di chiavi: durante la migrazione le chiavi spostate ricevono ASK
+BATCH=$(resp 7003 "CLUSTER GETKEYSINSLOT $SLOT 10" | grep -v '^[*$]' | tr '\n' ' ')
+R=$(resp 7003 "MIGRATE 127.0.0.1 7001 \"\" 0 1000 KEYS $BATCH"); [ "$R" = "+OK" ] || fail "MIGRATE: $R"
+MOVED_KEY=${BATCH%% *}
+[ "$(resp 7003 "GET $MOVED_KEY")" = "-ASK $SLOT 127.0.0.1:7001" ] || fail "no ASK for a moved key"
+resp 7001 "GET $MOVED_KEY" | grep -q "^-MOVED $SLOT 127.0.0.1:7003" || \
+    fail "target served the slot without ASKING"
+resp 7001 "ASKING" "GET $MOVED_KEY" | grep -q "^value\|^bar" || fail "ASKING + GET on the target"
+[ "$(resp 7003 "CLUSTER COUNTKEYSINSLOT $SLOT")" = ":$((KEYS + 1 - 10))" ] || \
+    fail "moved keys still on the source"
+
+while [ "$(resp 7003 "CLUSTER COUNTKEYSINSLOT $SLOT")" != ":0" ]; do
+    BATCH=$(resp 7003 "CLUSTER GETKEYSINSLOT $SLOT 10" | grep -v '^[*$]' | tr '\n' ' ')
+    resp 7003 "MIGRATE 127.0.0.1 7001 \"\" 0 1000 KEYS $BATCH" > /dev/null
+done
+for port in "${PORTS[@]}"; do
+    [ "$(resp $port "CLUSTER SETSLOT $SLOT NODE $TARGET_ID")" = "+OK" ] || fail "SETSLOT NODE on $port"
+done
+
+[ "$(resp 7003 "GET foo")" = "-MOVED $SLOT 127.0.0.1:7001" ] || fail "source still serves the slot"
+[ "$(resp 7001 "GET foo" | tail -1)" = "bar" ] || fail "foo lost in the migration"
+[ "$(resp 7001 "GET {foo}$KEYS" | tail -1)" = "value$KEYS" ] || fail "{foo}$KEYS lost"
+[ "$(resp 7001 "CLUSTER COUNTKEYSINSLOT $SLOT")" = ":$((KEYS + 1))" ] || fail "target key count"
+grep -q "^slots $SLOT $SLOT $TARGET_ID" "$WORK_DIR/7002/nodes.conf" || fail "topology not saved"
+echo -e "${GREEN}Slot migrated with all its keys${NC}"
+
+echo -e "${GREEN}All cluster checks passed${NC}"
@@ -0,0 +1,89 @@
+#!/bin/bash
+
+# PodCache Connection Limits Test
+# Oltre PODCACHE_MAX_CONNECTIONS un client riceve un errore e viene chiuso; le connessioni
+# inattive per PODCACHE_IDLE_TIMEOUT secondi vengono chiuse e liberano il posto.
+#
+# Usage: ./test_connections.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Connection Limits Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORT=6394
+MAX=3
+IDLE=2
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-conn-XXXXXX")"
+PID=""
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    [ -n "$PID" ] && kill -INT "$PID" 2>/dev/null || true
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    exit 1
+}
+
+PING='*1\r\n$4\r\nPING\r\n'
+
+# PING su una connessione aperta (descrittore fd), risposta senza \r
+ping_fd() {
+    printf "%b" "$PING" >&"$1"
+    local reply=""
+    read -r -t 1 reply <&"$1" || true
+    echo "${reply%$'\r'}"
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. Server with $MAX connections and ${IDLE}s idle timeout${NC}"
+PODCACHE_SERVER_PORT=$PORT PODCACHE_FSROOT="$WORK_DIR/" PODCACHE_MAX_CONNECTIONS=$MAX \
+    PODCACHE_IDLE_TIMEOUT=$IDLE "$BUILD_DIR/podcache" > "$WORK_DIR/server.log" 2>&1 &
+PID=$!
+sleep 0.5
+
+FDS=()
+for i in $(seq 1 $MAX); do
+    exec {fd}<>"/dev/tcp/127.0.0.1/$PORT"
+    FDS+=($fd)
+    [ "$(ping_fd $fd)" = "+PONG" ] || fail "connection $i not served"
+done
+echo -e "${GREEN}$MAX connections served${NC}"
+
+echo -e "${YELLOW}2. Connection over the limit rejected${NC}"
+exec {extra}<>"/dev/tcp/127.0.0.1/$PORT"
+REPLY=""
+read -r -t 1 REPLY <&"$extra" || true
+exec {extra}<&-
+[ "${REPLY%$'\r'}" = "-ERR max number of clients reached" ] || fail "got '$REPLY'"
+echo -e "${GREEN}Extra client rejected with an error${NC}"
+
+echo -e "${YELLOW}3. Idle connections closed, active one kept${NC}"
+for i in $(seq 1 $((IDLE * 2 + 2))); do
+    [ "$(ping_fd ${FDS[0]})" = "+PONG" ] || fail "active connection closed"
+    sleep 0.5
+done
+for fd in "${FDS[@]:1}"; do
+    [ -z "$(ping_fd $fd 2>/dev/null)" ] || fail "idle connection still open"
+done
+exec {extra}<>"/dev/tcp/127.0.0.1/$PORT"
+[ "$(ping_fd $extra)" = "+PONG" ] || fail "slot of idle connections not freed"
+echo -e "${GREEN}Idle connections reaped, new client admitted${NC}"
+
+echo -e "${GREEN}All connection limit checks passed${NC}"
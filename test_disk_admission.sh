@@ -0,0 +1,100 @@
+#!/bin/bash
+
+# PodCache Disk Admission Test
+# Con PODCACHE_DISK_ADMISSION le chiavi uscite dalla memoria finiscono su disco solo se sono
+# state lette: quelle scritte e mai rilette vengono scartate senza scritture su disco.
+#
+# Usage: ./test_disk_admission.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Disk Admission Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORT=6396
+KEYS=200
+HOT=5
+VALUE_SIZE=8000
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-admit-XXXXXX")"
+PID=""
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    [ -n "$PID" ] && kill -INT "$PID" 2>/dev/null || true
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    exit 1
+}
+
+# comandi RESP in pipeline su una connessione (un comando per argomento, parole separate da
+# spazi); stampa le risposte senza \r
+pipeline() {
+    local payload=""
+    for command in "$@"; do
+        local args=($command)
+        payload+="*${#args[@]}\r\n"
+        for arg in "${args[@]}"; do
+            payload+="\$${#arg}\r\n${arg}\r\n"
+        done
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$PORT"
+    printf "%b" "$payload" >&3
+    timeout 1 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+# il valore di keyN: N seguito da riempitivo fino a VALUE_SIZE byte
+value_of() {
+    local prefix="v$1-"
+    printf "%s%0*d" "$prefix" $((VALUE_SIZE - ${#prefix})) 0
+}
+
+disk_keys() {
+    find "$WORK_DIR" -name key.dat | wc -l
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. 1 MB memory tier, keys spilled to disk after one read${NC}"
+PODCACHE_SIZE=1 PODCACHE_DISK_ADMISSION=1 PODCACHE_SERVER_PORT=$PORT \
+    PODCACHE_FSROOT="$WORK_DIR/" \
+    "$BUILD_DIR/podcache" > "$WORK_DIR/server.log" 2>&1 &
+PID=$!
+sleep 0.5
+
+# le prime HOT chiavi vengono rilette subito, le altre mai
+COMMANDS=()
+for i in $(seq 1 $HOT); do
+    COMMANDS+=("SET key$i $(value_of $i)" "GET key$i")
+done
+for i in $(seq $((HOT + 1)) $KEYS); do
+    COMMANDS+=("SET key$i $(value_of $i)")
+done
+[ "$(pipeline "${COMMANDS[@]}" | grep -c '^+OK$')" = "$KEYS" ] || fail "SET rejected"
+
+ON_DISK=$(disk_keys)
+[ "$ON_DISK" = "$HOT" ] || fail "$ON_DISK keys on disk, expected the $HOT read ones"
+echo -e "${GREEN}Only the $HOT read keys written to disk${NC}"
+
+echo -e "${YELLOW}2. Read keys served from disk, one-hit wonders dropped${NC}"
+[ "$(pipeline "GET key1" | tail -1)" = "$(value_of 1)" ] || fail "key1 not served from disk"
+[ "$(pipeline "GET key$((HOT + 1))")" = "\$-1" ] || fail "unread key$((HOT + 1)) kept"
+[ "$(pipeline "GET key$KEYS" | tail -1)" = "$(value_of $KEYS)" ] || fail "newest key lost"
+echo -e "${GREEN}key1 promoted from disk, key$((HOT + 1)) dropped${NC}"
+
+echo -e "${GREEN}All disk admission checks passed${NC}"
@@ -0,0 +1,136 @@
+#!/bin/bash
+
+# PodCache Disk Budget Test
+# Con PODCACHE_DISK_SIZE il tier su disco resta nel budget: le chiavi spostate su disco meno
+# di recente vengono rimosse dal volume, le altre restano leggibili. SET e DEL non lasciano
+# copie vecchie su disco, una chiave promossa tiene la sua copia finché non viene modificata.
+# Le demotion sono scritte a gruppi, con una sync per gruppo (PODCACHE_DISK_SYNC=batch).
+# PODCACHE_DISK_IO=threads nell'ambiente ripete il test sul pool di thread invece di io_uring.
+#
+# Usage: ./test_disk_budget.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Disk Budget Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORT=6395
+KEYS=300
+VALUE_SIZE=8000
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-disk-XXXXXX")"
+PID=""
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    [ -n "$PID" ] && kill -INT "$PID" 2>/dev/null || true
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    exit 1
+}
+
+# comandi RESP in pipeline su una connessione (un comando per argomento, parole separate da
+# spazi); stampa le risposte senza \r
+pipeline() {
+    local payload=""
+    for command in "$@"; do
+        local args=($command)
+        payload+="*${#args[@]}\r\n"
+        for arg in "${args[@]}"; do
+            payload+="\$${#arg}\r\n${arg}\r\n"
+        done
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$PORT"
+    printf "%b" "$payload" >&3
+    timeout 1 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+# il valore di keyN: N seguito da riempitivo fino a VALUE_SIZE byte
+value_of() {
+    local prefix="v$1-"
+    printf "%s%0*d" "$prefix" $((VALUE_SIZE - ${#prefix})) 0
+}
+
+disk_keys() {
+    find "$WORK_DIR" -name key.dat | wc -l
+}
+
+# 0 se la chiave ha una copia su disco
+on_disk() {
+    for file in $(find "$WORK_DIR" -name key.dat); do
+        [ "$(cat "$file")" = "$1" ] && return 0
+    done
+    return 1
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. 1 MB memory tier, 1 MB disk budget, $KEYS values of $VALUE_SIZE bytes${NC}"
+PODCACHE_SIZE=1 PODCACHE_DISK_SIZE=1 PODCACHE_DISK_SYNC=batch PODCACHE_SERVER_PORT=$PORT \
+    PODCACHE_FSROOT="$WORK_DIR/" "$BUILD_DIR/podcache" > "$WORK_DIR/server.log" 2>&1 &
+PID=$!
+sleep 0.5
+
+COMMANDS=()
+for i in $(seq 1 $KEYS); do
+    COMMANDS+=("SET key$i $(value_of $i)")
+done
+[ "$(pipeline "${COMMANDS[@]}" | grep -c '^+OK$')" = "$KEYS" ] || fail "SET rejected"
+
+ON_DISK=$(disk_keys)
+USED_KB=$(du -sk "$WORK_DIR" | cut -f1)
+[ "$ON_DISK" -gt 0 ] || fail "nothing demoted to disk"
+# budget di 1 MB più il margine dei log e delle directory di base
+[ "$USED_KB" -lt 1400 ] || fail "disk tier over budget (${USED_KB} KB)"
+grep -q "synced once per demotion batch" "$WORK_DIR/server.log" || fail "disk sync policy ignored"
+grep -Eq "Disk I/O backend: (io_uring|threads)" "$WORK_DIR/server.log" || fail "no disk I/O backend"
+echo -e "${GREEN}$ON_DISK keys on disk, ${USED_KB} KB used${NC}"
+
+echo -e "${YELLOW}2. Oldest keys dropped, recent ones still served${NC}"
+[ "$(pipeline "GET key1")" = "\$-1" ] || fail "key1 should have been dropped"
+[ "$(pipeline "GET key$KEYS" | tail -1)" = "$(value_of $KEYS)" ] || fail "newest key lost"
+# una chiave ancora su disco: riletta (e promossa) dal disco
+DISK_KEY=$(cat "$(find "$WORK_DIR" -name key.dat | head -1)")
+[ "$(pipeline "GET $DISK_KEY" | tail -1)" = "$(value_of ${DISK_KEY#key})" ] ||
+    fail "$DISK_KEY not served from disk"
+echo -e "${GREEN}key1 dropped, $DISK_KEY served from disk${NC}"
+
+echo -e "${YELLOW}3. SET and DEL remove stale disk copies${NC}"
+pipeline "SET victim old" > /dev/null
+# spinge victim su disco
+COMMANDS=()
+for i in $(seq 1 140); do
+    COMMANDS+=("SET filler$i $(value_of $i)")
+done
+pipeline "${COMMANDS[@]}" > /dev/null
+pipeline "SET victim new" > /dev/null
+[ "$(pipeline "GET victim" | tail -1)" = "new" ] || fail "SET did not replace the disk copy"
+pipeline "DEL victim" > /dev/null
+[ "$(pipeline "GET victim")" = "\$-1" ] || fail "deleted key came back from disk"
+echo -e "${GREEN}No stale copies after SET and DEL${NC}"
+
+echo -e "${YELLOW}4. Promoted keys keep their disk copy until modified${NC}"
+DISK_KEY=$(cat "$(find "$WORK_DIR" -name key.dat | head -1)")
+[ "$(pipeline "GET $DISK_KEY" | tail -1)" = "$(value_of ${DISK_KEY#key})" ] ||
+    fail "$DISK_KEY not served from disk"
+on_disk "$DISK_KEY" || fail "disk copy of promoted $DISK_KEY removed"
+pipeline "SET $DISK_KEY changed" > /dev/null
+! on_disk "$DISK_KEY" || fail "stale disk copy of $DISK_KEY kept after SET"
+echo -e "${GREEN}$DISK_KEY promoted with its disk copy, copy removed by SET${NC}"
+
+echo -e "${GREEN}All disk budget checks passed${NC}"
@@ -0,0 +1,103 @@
+#!/bin/bash
+
+# PodCache Peer Fill Test
+# Tre pod con la stessa lista di peer: un pod vuoto serve le chiavi scritte sugli altri,
+# le tiene in locale dopo il primo miss e risponde subito nil quando i peer sono giù.
+#
+# Usage: ./test_peer_fill.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Peer Fill Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORTS=(6391 6392 6393)
+PEERS="127.0.0.1:6391,127.0.0.1:6392,127.0.0.1:6393"
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-peer-XXXXXX")"
+PIDS=()
+KEYS=30
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    for pid in "${PIDS[@]}"; do
+        kill -INT "$pid" 2>/dev/null || true
+    done
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    exit 1
+}
+
+# un comando RESP su /dev/tcp, risposta senza \r
+resp() {
+    local port="$1"
+    shift
+    local payload="*$#\r\n"
+    for arg in "$@"; do
+        payload+="\$${#arg}\r\n${arg}\r\n"
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf "%b" "$payload" >&3
+    timeout 0.3 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. Three pods sharing the same peer list${NC}"
+for port in "${PORTS[@]}"; do
+    mkdir -p "$WORK_DIR/$port"
+    PODCACHE_SIZE=1 PODCACHE_SERVER_PORT=$port PODCACHE_FSROOT="$WORK_DIR/$port/" \
+        PODCACHE_PEERS=$PEERS PODCACHE_PEER_PROBES=2 \
+        stdbuf -oL "$BUILD_DIR/podcache" > "$WORK_DIR/$port.log" 2>&1 &
+    PIDS+=($!)
+done
+sleep 0.5
+
+# chiavi scritte sui primi due pod: il terzo non ne ha nessuna
+for i in $(seq 1 $KEYS); do
+    port=${PORTS[$((i % 2))]}
+    [ "$(resp $port SET key$i value$i)" = "+OK" ] || fail "SET key$i on $port"
+done
+[ "$(resp 6393 PEERGET key1)" = "\$-1" ] || fail "PEERGET must only read local tiers"
+echo -e "${GREEN}Keys written on 6391 and 6392 only${NC}"
+
+echo -e "${YELLOW}2. Cold pod filled from its peers${NC}"
+for i in $(seq 1 $KEYS); do
+    [ "$(resp 6393 GET key$i | tail -1)" = "value$i" ] || fail "key$i not filled from peers"
+done
+[ "$(resp 6393 PEERGET key1 | tail -1)" = "value1" ] || fail "filled key not stored locally"
+[ "$(resp 6393 GET missing)" = "\$-1" ] || fail "missing key should be nil"
+echo -e "${GREEN}All $KEYS keys served by the cold pod${NC}"
+
+echo -e "${YELLOW}3. Peers down: local copies served, misses stay fast${NC}"
+kill -INT "${PIDS[0]}" "${PIDS[1]}"
+sleep 1.5
+for i in $(seq 1 $KEYS); do
+    [ "$(resp 6393 GET key$i | tail -1)" = "value$i" ] || fail "key$i lost with peers down"
+done
+START=$(date +%s%N)
+for i in $(seq 1 10); do
+    [ "$(resp 6393 GET missing$i)" = "\$-1" ] || fail "miss with peers down"
+done
+ELAPSED_MS=$(( ($(date +%s%N) - START) / 1000000 ))
+# ogni resp aspetta 0.3 s il timeout di lettura: il peer fill non deve aggiungere altro
+[ $ELAPSED_MS -lt 4500 ] || fail "misses too slow with peers down (${ELAPSED_MS} ms)"
+grep -q "unavailable, skipped" "$WORK_DIR/6393.log" || fail "down peers not detected"
+echo -e "${GREEN}Down peers skipped (10 misses in ${ELAPSED_MS} ms)${NC}"
+
+echo -e "${GREEN}All peer fill checks passed${NC}"
@@ -0,0 +1,197 @@
+#!/bin/bash
+
+# PodCache Replication Test
+# Primary e replica sullo stesso host: snapshot dei due tier, stream dei comandi,
+# replica in sola lettura e resync parziale dopo una breve disconnessione.
+# La disconnessione passa da un piccolo proxy TCP in python3 (saltata se manca).
+#
+# Usage: ./test_replication.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Replication Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PRIMARY_PORT=6383
+REPLICA_PORT=6384
+PROXY_PORT=6385
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-repl-XXXXXX")"
+PRIMARY_PID=""
+REPLICA_PID=""
+PROXY_PID=""
+KEYS=300
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    for pid in $REPLICA_PID $PRIMARY_PID; do
+        kill -INT "$pid" 2>/dev/null || true
+    done
+    # i job in background di uno script ignorano SIGINT
+    [ -n "$PROXY_PID" ] && kill "$PROXY_PID" 2>/dev/null || true
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    echo "--- replica log ---"
+    tail -20 "$WORK_DIR/replica.log" || true
+    exit 1
+}
+
+# comandi RESP su /dev/tcp: una connessione per chiamata, risposte lette fino al timeout
+resp() {
+    local port="$1"
+    shift
+    local payload="*$#\r\n"
+    for arg in "$@"; do
+        payload+="\$${#arg}\r\n${arg}\r\n"
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    printf "%b" "$payload" >&3
+    timeout 0.3 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+# un file di comandi inviato su una sola connessione (pipelining)
+resp_pipe() {
+    local port="$1" file="$2"
+    exec 3<>"/dev/tcp/127.0.0.1/$port"
+    cat "$file" >&3
+    timeout 2 cat <&3 > /dev/null || true
+    exec 3<&-
+}
+
+wait_connected() {
+    for _ in $(seq 1 50); do
+        if resp $REPLICA_PORT ROLE | grep -q "^connected$"; then return 0; fi
+        sleep 0.2
+    done
+    fail "replica did not reach the connected state"
+}
+
+start_server() {
+    local name="$1" port="$2"
+    shift 2
+    mkdir -p "$WORK_DIR/$name"
+    # stdout a righe: il test legge i log mentre il server gira
+    env PODCACHE_SIZE=1 PODCACHE_SERVER_PORT=$port PODCACHE_FSROOT="$WORK_DIR/$name/" "$@" \
+        stdbuf -oL "$BUILD_DIR/podcache" > "$WORK_DIR/$name.log" 2>&1 &
+    echo $!
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+echo -e "${YELLOW}1. Primary with ${KEYS} keys of 8 KB (1 MB cache, most keys on disk)${NC}"
+PRIMARY_PID=$(start_server primary $PRIMARY_PORT)
+sleep 0.5
+VALUE=$(head -c 8000 /dev/zero | tr '\0' 'x')
+: > "$WORK_DIR/load.resp"
+for i in $(seq 1 $KEYS); do
+    v="v$i-$VALUE"
+    printf '*3\r\n$3\r\nSET\r\n$%d\r\nkey%d\r\n$%d\r\n%s\r\n' $((3 + ${#i})) "$i" ${#v} "$v" \
+        >> "$WORK_DIR/load.resp"
+done
+resp_pipe $PRIMARY_PORT "$WORK_DIR/load.resp"
+
+echo -e "${YELLOW}2. Replica: full resync${NC}"
+if command -v python3 > /dev/null; then
+    # proxy replica -> primary: chiuderlo simula una disconnessione di rete
+    python3 - "$PROXY_PORT" "$PRIMARY_PORT" > /dev/null 2>&1 <<'EOF' &
+import socket, sys, threading
+listen = socket.socket()
+listen.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+listen.bind(("127.0.0.1", int(sys.argv[1])))
+listen.listen(4)
+def pipe(a, b):
+    try:
+        while True:
+            data = a.recv(65536)
+            if not data:
+                break
+            b.sendall(data)
+    except OSError:
+        pass
+    for s in (a, b):
+        try:
+            s.shutdown(socket.SHUT_RDWR)
+        except OSError:
+            pass
+while True:
+    client, _ = listen.accept()
+    upstream = socket.create_connection(("127.0.0.1", int(sys.argv[2])))
+    threading.Thread(target=pipe, args=(client, upstream), daemon=True).start()
+    threading.Thread(target=pipe, args=(upstream, client), daemon=True).start()
+EOF
+    PROXY_PID=$!
+    sleep 0.5
+    UPSTREAM_PORT=$PROXY_PORT
+else
+    echo "python3 not found: partial resync step will be skipped"
+    UPSTREAM_PORT=$PRIMARY_PORT
+fi
+REPLICA_PID=$(start_server replica $REPLICA_PORT PODCACHE_REPLICAOF=127.0.0.1:$UPSTREAM_PORT)
+wait_connected
+
+for i in 1 50 150 $KEYS; do
+    resp $REPLICA_PORT GET "key$i" | grep -q "^v$i-x" || fail "key$i missing on replica"
+done
+echo -e "${GREEN}Snapshot of memory and disk tiers loaded${NC}"
+
+echo -e "${YELLOW}3. Streamed writes${NC}"
+resp $PRIMARY_PORT SET streamed hello > /dev/null
+resp $PRIMARY_PORT INCR counter > /dev/null
+resp $PRIMARY_PORT DEL key1 > /dev/null
+sleep 0.3
+[ "$(resp $REPLICA_PORT GET streamed | tail -1)" = "hello" ] || fail "SET not replicated"
+[ "$(resp $REPLICA_PORT GET counter | tail -1)" = "1" ] || fail "INCR not replicated"
+[ "$(resp $REPLICA_PORT GET key1)" = "\$-1" ] || fail "DEL not replicated"
+resp $REPLICA_PORT SET streamed nope | grep -q "^-READONLY" || fail "replica accepted a write"
+resp $REPLICA_PORT HELLO | grep -A2 "^role$" | grep -q "^replica$" || fail "HELLO role on replica"
+resp $PRIMARY_PORT HELLO | grep -A2 "^role$" | grep -q "^master$" || fail "HELLO role on primary"
+echo -e "${GREEN}SET, INCR and DEL replicated, replica is read-only and says so in HELLO${NC}"
+
+if [ -n "$PROXY_PID" ]; then
+    echo -e "${YELLOW}4. Partial resync after a disconnection${NC}"
+    kill "$PROXY_PID"
+    sleep 0.3
+    resp $PRIMARY_PORT SET during-outage yes > /dev/null
+    python3 - "$PROXY_PORT" "$PRIMARY_PORT" > /dev/null 2>&1 <<'EOF' &
+import socket, sys, threading
+listen = socket.socket()
+listen.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+listen.bind(("127.0.0.1", int(sys.argv[1])))
+listen.listen(4)
+def pipe(a, b):
+    while True:
+        data = a.recv(65536)
+        if not data:
+            break
+        b.sendall(data)
+while True:
+    client, _ = listen.accept()
+    upstream = socket.create_connection(("127.0.0.1", int(sys.argv[2])))
+    threading.Thread(target=pipe, args=(client, upstream), daemon=True).start()
+    threading.Thread(target=pipe, args=(upstream, client), daemon=True).start()
+EOF
+    PROXY_PID=$!
+    sleep 2
+    wait_connected
+    grep -q "partial resync" "$WORK_DIR/replica.log" || fail "replica did a full resync"
+    [ "$(resp $REPLICA_PORT GET during-outage | tail -1)" = "yes" ] || \
+        fail "write made during the outage not replicated"
+    echo -e "${GREEN}Partial resync from the backlog${NC}"
+fi
+
+echo -e "${GREEN}All replication checks passed${NC}"
@@ -0,0 +1,212 @@
+#!/bin/bash
+
+# PodCache Client Tracking Test
+# Push di invalidazione RESP3 ricevuti da un client con CLIENT TRACKING: modalità default
+# (chiavi lette, una volta sola), limite della tabella, NOLOOP, BCAST con prefissi e flush
+# totale quando la coda del client supera TRACKING_MAX_PENDING durante un solo comando.
+#
+# Usage: ./test_tracking.sh [BUILD_DIR]
+
+set -e
+
+echo "=========================================="
+echo "    PodCache Client Tracking Test"
+echo "=========================================="
+
+TEST_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)"
+BUILD_DIR="${1:-$TEST_DIR/build}"
+PORT=6397
+MAX_KEYS=8
+FLOOD_KEYS=4500    # oltre TRACKING_MAX_PENDING (4096), da 2 byte ciascuna
+FILLERS=88         # con le chiavi flood: lasciano meno di BIG_SIZE - 9000 byte liberi nel MB
+FILLER_SIZE=11800
+BIG_SIZE=12000     # con il resto del recv precedente entra in MAX_COMMAND_SIZE (16 KB)
+WORK_DIR="$(mktemp -d "${TMPDIR:-/tmp}/podcache-tracking-XXXXXX")"
+PID=""
+
+# Colors for output
+RED='\033[0;31m'
+GREEN='\033[0;32m'
+YELLOW='\033[1;33m'
+NC='\033[0m' # No Color
+
+cleanup() {
+    echo -e "${YELLOW}Cleaning up...${NC}"
+    [ -n "$PID" ] && kill -INT "$PID" 2>/dev/null || true
+    sleep 1.5
+    rm -rf "$WORK_DIR"
+}
+
+trap cleanup EXIT INT TERM
+
+fail() {
+    echo -e "${RED}FAIL: $1${NC}"
+    echo "--- server log ---"
+    tail -20 "$WORK_DIR/server.log" || true
+    exit 1
+}
+
+# comandi RESP su /dev/tcp: una connessione per chiamata, risposte lette fino al timeout
+resp() {
+    local payload="*$#\r\n"
+    for arg in "$@"; do
+        payload+="\$${#arg}\r\n${arg}\r\n"
+    done
+    exec 3<>"/dev/tcp/127.0.0.1/$PORT"
+    printf "%b" "$payload" >&3
+    timeout 0.3 cat <&3 | tr -d '\r' || true
+    exec 3<&-
+}
+
+# la connessione con il tracking resta aperta su fd 4 per tutta la sezione
+track_open() {
+    exec 4<>"/dev/tcp/127.0.0.1/$PORT"
+    track HELLO 3 > /dev/null
+}
+
+track_close() {
+    exec 4<&-
+}
+
+# un comando sulla connessione con il tracking: stampa risposte e push arrivati entro il timeout
+track() {
+    local payload="*$#\r\n"
+    for arg in "$@"; do
+        payload+="\$${#arg}\r\n${arg}\r\n"
+    done
+    printf "%b" "$payload" >&4
+    track_read
+}
+
+# quello che è arrivato sulla connessione con il tracking, senza inviare nulla
+track_read() {
+    timeout "${1:-0.3}" cat <&4 | tr -d '\r' || true
+}
+
+# chiavi invalidate nei push ricevuti, una per riga (le lunghezze $N sono scartate)
+invalidated() {
+    awk '/^>2$/ { push = 1; next } push && /^[$*]/ { next } push && /^invalidate$/ { next }
+         push && /^[+:_-]/ { push = 0; next } push { print }'
+}
+
+[ -x "$BUILD_DIR/podcache" ] || { echo "podcache not found in $BUILD_DIR"; exit 1; }
+
+# un solo MB di memoria e ammissione su disco dopo una lettura: le chiavi mai lette che escono
+# dalla memoria vengono cancellate (e invalidate) invece di finire su disco
+PODCACHE_SIZE=1 PODCACHE_DISK_ADMISSION=1 PODCACHE_TRACKING_MAX_KEYS=$MAX_KEYS \
+    PODCACHE_SERVER_PORT=$PORT PODCACHE_FSROOT="$WORK_DIR/" \
+    "$BUILD_DIR/podcache" > "$WORK_DIR/server.log" 2>&1 &
+PID=$!
+sleep 0.5
+
+echo -e "${YELLOW}1. Tracking requires RESP3, PREFIX requires BCAST${NC}"
+resp CLIENT TRACKING ON | grep -q "requires RESP3" || fail "tracking enabled on RESP2"
+track_open
+track CLIENT TRACKING ON PREFIX user: | grep -q "requires BCAST" || \
+    fail "PREFIX accepted without BCAST"
+echo -e "${GREEN}Invalid tracking modes rejected${NC}"
+
+echo -e "${YELLOW}2. Default mode: keys read by the client, invalidated once${NC}"
+[ "$(track CLIENT TRACKING ON)" = "+OK" ] || fail "CLIENT TRACKING ON failed"
+resp SET user:1 a > /dev/null
+resp SET user:2 b > /dev/null
+resp SET other c > /dev/null
+track GET user:1 > /dev/null
+track GET user:2 > /dev/null
+
+# framing esatto del push: >2 "invalidate" [chiavi]
+resp SET user:1 changed > /dev/null
+timeout 0.3 cat <&4 > "$WORK_DIR/push.raw" || true
+printf '>2\r\n$10\r\ninvalidate\r\n*1\r\n$6\r\nuser:1\r\n' > "$WORK_DIR/push.expected"
+cmp -s "$WORK_DIR/push.raw" "$WORK_DIR/push.expected" || \
+    fail "unexpected push: $(od -c "$WORK_DIR/push.raw" | head -5)"
+
+resp SET user:1 again > /dev/null
+[ -z "$(track_read)" ] || fail "key invalidated twice without being read again"
+resp DEL user:2 > /dev/null
+[ "$(track_read | invalidated)" = "user:2" ] || fail "DEL not invalidated"
+resp SET other changed > /dev/null
+[ -z "$(track_read)" ] || fail "key never read was invalidated"
+echo -e "${GREEN}Read keys invalidated once, in RESP3 push framing${NC}"
+
+echo -e "${YELLOW}3. Own writes without NOLOOP, tracking table limit${NC}"
+track GET user:1 > /dev/null
+OUTPUT=$(track SET user:1 mine)
+echo "$OUTPUT" | grep -q "^+OK$" || fail "SET on the tracking connection failed"
+[ "$(echo "$OUTPUT" | invalidated)" = "user:1" ] || fail "own write not invalidated"
+
+for i in $(seq 0 $MAX_KEYS); do
+    resp SET t$i v > /dev/null
+    track GET t$i > /dev/null 2>&1
+done
+resp SET t0 changed > /dev/null
+resp SET t1 changed > /dev/null
+# t0 è uscita dalla tabella alla lettura di t$MAX_KEYS: l'invalidazione è arrivata allora
+[ "$(track_read | invalidated)" = "t1" ] || fail "t1 not invalidated after the table limit"
+track_close
+echo -e "${GREEN}Own writes invalidated, oldest key dropped at $MAX_KEYS tracked keys${NC}"
+
+echo -e "${YELLOW}4. NOLOOP: no invalidation for the client's own writes${NC}"
+track_open
+[ "$(track CLIENT TRACKING ON NOLOOP)" = "+OK" ] || fail "CLIENT TRACKING ON NOLOOP failed"
+track GET user:1 > /dev/null
+[ "$(track SET user:1 noloop)" = "+OK" ] || fail "own write invalidated with NOLOOP"
+track GET user:1 > /dev/null
+resp SET user:1 other > /dev/null
+[ "$(track_read | invalidated)" = "user:1" ] || fail "write of another client not invalidated"
+track_close
+echo -e "${GREEN}Only writes of other clients invalidated${NC}"
+
+echo -e "${YELLOW}5. BCAST with prefixes: no reads needed${NC}"
+track_open
+[ "$(track CLIENT TRACKING ON BCAST PREFIX user: PREFIX session: NOLOOP)" = "+OK" ] || \
+    fail "CLIENT TRACKING ON BCAST failed"
+resp SET user:9 x > /dev/null
+resp SET session:9 x > /dev/null
+resp SET other x > /dev/null
+[ "$(track_read | invalidated | tr '\n' ' ')" = "user:9 session:9 " ] || \
+    fail "BCAST invalidations wrong"
+[ "$(track SET user:9 mine)" = "+OK" ] || fail "own write invalidated with BCAST NOLOOP"
+track_close
+echo -e "${GREEN}Keys under the prefixes invalidated, other keys ignored${NC}"
+
+echo -e "${YELLOW}6. Flush all when the queue overflows${NC}"
+FILLER=$(printf "%0*d" $FILLER_SIZE 0)
+{
+    for i in $(seq 1 $FLOOD_KEYS); do
+        printf '*3\r\n$3\r\nSET\r\n$%d\r\nflood:%d\r\n$2\r\nab\r\n' $((6 + ${#i})) "$i"
+    done
+    # dopo le chiavi flood:, quindi più vicine alla testa della LRU
+    for i in $(seq 1 $FILLERS); do
+        printf '*3\r\n$3\r\nSET\r\n$%d\r\nfiller:%d\r\n$%d\r\n%s\r\n' \
+            $((7 + ${#i})) "$i" $FILLER_SIZE "$FILLER"
+    done
+} > "$WORK_DIR/flood.resp"
+exec 3<>"/dev/tcp/127.0.0.1/$PORT"
+cat "$WORK_DIR/flood.resp" >&3
+STORED=$(timeout 5 cat <&3 | tr -d '\r' | grep -c '^+OK$' || true)
+[ "$STORED" = "$((FLOOD_KEYS + FILLERS))" ] || fail "only $STORED flood keys stored"
+exec 3<&-
+# letta, flood:1 passa in testa alla LRU e finirebbe su disco: le altre restano mai lette
+[ "$(resp GET flood:1 | tail -1)" = "ab" ] || fail "flood keys evicted while filling the memory"
+
+# un solo SET sulla connessione stessa fa uscire dalla memoria tutte le chiavi flood:, mai
+# lette e quindi cancellate: più di TRACKING_MAX_PENDING invalidazioni prima che la
+# connessione possa inviarle
+track_open
+[ "$(track CLIENT TRACKING ON BCAST PREFIX flood:)" = "+OK" ] || \
+    fail "CLIENT TRACKING ON BCAST failed"
+{
+    printf '*3\r\n$3\r\nSET\r\n$3\r\nbig\r\n$%d\r\n' $BIG_SIZE
+    head -c $BIG_SIZE /dev/zero | tr '\0' 'x'
+    printf '\r\n'
+} >&4
+timeout 1 cat <&4 > "$WORK_DIR/flush.raw" || true
+printf '+OK\r\n>2\r\n$10\r\ninvalidate\r\n_\r\n' > "$WORK_DIR/flush.expected"
+cmp -s "$WORK_DIR/flush.raw" "$WORK_DIR/flush.expected" || \
+    fail "expected a null invalidation, got: $(head -c 200 "$WORK_DIR/flush.raw" | od -c | head -5)"
+track_close
+[ "$(resp GET flood:2)" = "\$-1" ] || fail "flood keys not dropped"
+echo -e "${GREEN}Overflowing queue replaced by a single flush-all push${NC}"
+
+echo -e "${GREEN}All client tracking checks passed${NC}"
@@ -0,0 +1,151 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+/* Test di regressione di pod_cache con partizioni minuscole: la posizione delle chiavi nella
+ * coda e le demotion sono deterministiche */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "clogger.h"
+#include "pod_cache.h"
+
+#define CHECK(cond, ...)                                                                       \
+    do {                                                                                       \
+        if (!(cond)) {                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                               \
+            fprintf(stderr, __VA_ARGS__);                                                      \
+            fprintf(stderr, "\n");                                                             \
+            return 1;                                                                          \
+        }                                                                                      \
+    } while (0)
+
+#define VALUE_SIZE 100
+
+static void put_filled(pod_cache_t *cache, const char *key, char fill, size_t size) {
+    char *value = malloc(size);
+    memset(value, fill, size);
+    pod_cache_put(cache, key, value, size);
+    free(value);
+}
+
+// 0 se la chiave ha il valore atteso (riempito con fill), letto da memoria o da disco
+static int value_is(pod_cache_t *cache, const char *key, char fill) {
+    void *value = NULL;
+    size_t size = 0;
+    if (pod_cache_get(cache, key, &value, &size) < 0) return -1;
+    int rc = size > 0 && ((char *)value)[0] == fill ? 0 : -1;
+    free(value);
+    return rc;
+}
+
+// partizione da 1000 byte con nove valori da 100 byte (k0 in coda), demotion una alla volta
+static pod_cache_t *full_cache(void) {
+    pod_cache_t *cache = pod_cache_create(1000, 1);
+    if (!cache) return NULL;
+    pod_cache_set_demote_batch(cache, 1, 0);
+    for (int i = 0; i < 9; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        put_filled(cache, key, 'a', VALUE_SIZE);
+    }
+    return cache;
+}
+
+// un valore più grande della partizione viene rifiutato senza svuotarla
+static int test_oversized_put(void) {
+    pod_cache_t *cache = full_cache();
+    CHECK(cache, "cannot create cache");
+    CHECK(pod_cache_set_disk_admission(cache, 3) == 0, "cannot enable admission");
+
+    char *big = calloc(1, 2000);
+    CHECK(pod_cache_put(cache, "big", big, 2000) < 0, "oversized value accepted");
+    free(big);
+
+    pod_cache_stats_t stats;
+    pod_cache_get_stats(cache, &stats);
+    CHECK(stats.demotions == 0 && stats.disk_rejections == 0, "partition emptied by a rejected put");
+    for (int i = 0; i < 9; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        CHECK(value_is(cache, key, 'a') == 0, "%s lost", key);
+    }
+    pod_cache_destroy(cache);
+    return 0;
+}
+
+/* aggiornamento della chiave in coda con la partizione piena: la demotion che fa spazio scrive
+ * il valore precedente, che non deve sopravvivere come copia pulita */
+static int test_update_of_tail_key(void) {
+    pod_cache_t *cache = full_cache();
+    CHECK(cache, "cannot create cache");
+
+    put_filled(cache, "k0", 'Z', VALUE_SIZE);
+    CHECK(value_is(cache, "k0", 'Z') == 0, "update of k0 lost");
+    // k0 torna in coda e viene spinta su disco dalle nuove chiavi
+    for (int i = 9; i < 20; i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "k%d", i);
+        put_filled(cache, key, 'b', VALUE_SIZE);
+    }
+    CHECK(value_is(cache, "k0", 'Z') == 0, "k0 served with its value before the update");
+    pod_cache_destroy(cache);
+    return 0;
+}
+
+/* loader che, mentre il valore "arriva dal peer", subisce una scrittura concorrente della stessa
+ * chiave: ctx è il valore ('S') da scrivere o NULL per cancellarla */
+static pod_cache_t *racing_cache;
+
+static int racing_loader(const char *key, void **value, size_t *size, void *ctx) {
+    if (ctx) put_filled(racing_cache, key, *(const char *)ctx, VALUE_SIZE);
+    else pod_cache_evict(racing_cache, key);
+    *value = malloc(VALUE_SIZE);
+    memset(*value, 'L', VALUE_SIZE);
+    *size = VALUE_SIZE;
+    return 0;
+}
+
+// una SET o una DEL arrivata durante il caricamento non viene sovrascritta dal loader
+static int test_load_does_not_overwrite(void) {
+    static const char set_fill = 'S';
+    pod_cache_t *cache = pod_cache_create(1000, 1);
+    CHECK(cache, "cannot create cache");
+    racing_cache = cache;
+
+    pod_cache_set_loader(cache, racing_loader, (void *)&set_fill);
+    CHECK(value_is(cache, "set", 'S') == 0, "loaded value overwrote a concurrent SET");
+
+    pod_cache_set_loader(cache, racing_loader, NULL);
+    void *value = NULL;
+    size_t size = 0;
+    CHECK(pod_cache_get(cache, "del", &value, &size) < 0, "loaded value resurrected a DEL");
+    pod_cache_set_loader(cache, NULL, NULL);
+    CHECK(pod_cache_get(cache, "del", &value, &size) < 0, "loaded value stored after a DEL");
+    pod_cache_destroy(cache);
+    return 0;
+}
+
+int main(void) {
+    clog_init(LOG_LEVEL_FATAL, NULL);
+    char root[] = "/tmp/podcache-test-XXXXXX";
+    if (!mkdtemp(root)) return 1;
+    char fsroot[64];
+    snprintf(fsroot, sizeof(fsroot), "%s/", root);
+    setenv("PODCACHE_FSROOT", fsroot, 1);
+
+    int failed = 0;
+    failed += test_oversized_put();
+    failed += test_update_of_tail_key();
+    failed += test_load_does_not_overwrite();
+
+    rmdir(root);
+    if (failed == 0) printf("All pod_cache tests passed\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,257 @@
+/**
+ * Project: PodCache
+ * Author: Carlo Di Giuseppe
+ * Date: 17/10/26
+ * License: AGPL 3
+ */
+
+/* Test dell'indice in memoria condivisa: un writer ripubblica le chiavi facendo girare l'arena
+ * molte volte mentre i reader (da una mappatura client, come un altro processo del pod)
+ * leggono proprio le chiavi le cui entry stanno per essere sovrascritte. Ogni valore si
+ * descrive da sé (chiave, versione, lunghezza, riempimento): una copia strappata dal seqlock o
+ * dal controllo di wraparound non passerebbe la verifica */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "shm_index.h"
+
+#define CHECK(cond, ...)                                                                       \
+    do {                                                                                       \
+        if (!(cond)) {                                                                         \
+            fprintf(stderr, "FAIL %s:%d: ", __func__, __LINE__);                               \
+            fprintf(stderr, __VA_ARGS__);                                                      \
+            fprintf(stderr, "\n");                                                             \
+            return 1;                                                                          \
+        }                                                                                      \
+    } while (0)
+
+#define SEGMENT_SIZE (1024 * 1024) // il minimo: l'arena gira spesso
+#define KEYS 48                    // più di quante ne stiano nell'arena
+#define AVERAGE_ENTRY 24600        // media di value_len più header e chiave
+#define PUBLISHES 5000
+#define MIN_SECONDS 1 // con una sola CPU i reader devono essere interrotti a metà copia
+#define YIELD_EVERY 8
+#define READERS 3
+#define OVERSIZED_EVERY 97
+#define OVERSIZED_LEN (96 * 1024) // oltre 1/16 dell'arena: mai pubblicato
+#define BUF_SIZE (128 * 1024)
+
+typedef struct {
+    uint32_t key_id;
+    uint32_t version;
+    uint32_t len;
+    uint32_t fill;
+} value_header_t;
+
+typedef struct {
+    shm_index_t *reader;
+    uint64_t published; // pubblicazioni fatte dal writer
+    uint32_t frontier;  // distanza dalla prossima chiave pubblicata di quella in sovrascrittura
+    int done;
+    uint64_t hits;
+    uint64_t errors;
+} shared_t;
+
+static void key_name(uint32_t key_id, char *key, size_t size) {
+    snprintf(key, size, "key:%u", key_id);
+}
+
+static size_t value_len(uint32_t key_id, uint32_t version) {
+    if (version % OVERSIZED_EVERY == OVERSIZED_EVERY - 1) return OVERSIZED_LEN;
+    // valori grandi: la copia è la parte più lunga di una lettura
+    return 8192 + (key_id * 7919u + version * 104729u) % 32768;
+}
+
+static void fill_value(unsigned char *value, uint32_t key_id, uint32_t version) {
+    value_header_t header = {key_id, version, (uint32_t)value_len(key_id, version),
+                             (key_id * 31u + version) & 0xff};
+    memcpy(value, &header, sizeof(header));
+    memset(value + sizeof(header), (int)header.fill, header.len - sizeof(header));
+}
+
+// 0 se il valore letto è intero e appartiene alla chiave
+static int value_valid(const unsigned char *value, size_t len, uint32_t key_id) {
+    value_header_t header;
+    if (len < sizeof(header)) return -1;
+    memcpy(&header, value, sizeof(header));
+    if (header.key_id != key_id || header.len != len || len == OVERSIZED_LEN) return -1;
+    if (len != value_len(key_id, header.version)) return -1;
+    if (header.fill != ((key_id * 31u + header.version) & 0xff)) return -1;
+    // a parole, così i reader passano il grosso del tempo a copiare invece che a verificare
+    uint64_t word = header.fill * 0x0101010101010101ULL;
+    size_t i = sizeof(header);
+    for (; i + sizeof(word) <= len; i += sizeof(word)) {
+        uint64_t got;
+        memcpy(&got, value + i, sizeof(got));
+        if (got != word) return -1;
+    }
+    for (; i < len; i++) {
+        if (value[i] != header.fill) return -1;
+    }
+    return 0;
+}
+
+static void *reader_thread(void *arg) {
+    shared_t *shared = arg;
+    unsigned char *buf = malloc(BUF_SIZE);
+    uint64_t hits = 0, errors = 0;
+    unsigned salt = 0;
+    while (!__atomic_load_n(&shared->done, __ATOMIC_ACQUIRE)) {
+        /* le chiavi ancora vive la cui entry sta subito dopo head: sono quelle che il writer
+         * sovrascrive mentre il reader le copia */
+        uint64_t published = __atomic_load_n(&shared->published, __ATOMIC_RELAXED);
+        uint32_t key_id = (uint32_t)((published + shared->frontier + salt++ % 16) % KEYS);
+        char key[32];
+        key_name(key_id, key, sizeof(key));
+        size_t len = 0;
+        int rc = shm_index_get(shared->reader, key, strlen(key), buf, BUF_SIZE, &len);
+        if (rc == 0) {
+            hits++;
+            if (value_valid(buf, len, key_id) != 0) errors++;
+        } else if (rc != -100) {
+            errors++;
+        }
+    }
+    __atomic_add_fetch(&shared->hits, hits, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&shared->errors, errors, __ATOMIC_RELAXED);
+    free(buf);
+    return NULL;
+}
+
+// un valore troppo grande per l'arena non viene pubblicato e nasconde la versione precedente
+static int test_oversized(shm_index_t *index, shm_index_t *reader) {
+    unsigned char *value = calloc(1, OVERSIZED_LEN);
+    CHECK(value, "out of memory");
+    size_t len = 0;
+    char buf[64];
+
+    CHECK(shm_index_publish(index, "big", 3, "small", 5) == 0, "small value not published");
+    CHECK(shm_index_get(reader, "big", 3, buf, sizeof(buf), &len) == 0 && len == 5,
+          "small value not readable");
+    CHECK(shm_index_publish(index, "big", 3, value, OVERSIZED_LEN) == -1,
+          "oversized value published");
+    CHECK(shm_index_get(reader, "big", 3, buf, sizeof(buf), &len) == -100,
+          "previous value still readable after an oversized publish");
+
+    shm_index_stats_t stats;
+    shm_index_get_stats(index, &stats);
+    CHECK(stats.too_large == 1, "too_large = %llu", (unsigned long long)stats.too_large);
+    free(value);
+    return 0;
+}
+
+/* una entry sovrascritta dall'arena non viene più servita, anche se il suo slot è ancora vivo e
+ * al suo posto c'è qualcosa che sembra un'entry della stessa chiave: i valori di riempimento
+ * ripetono ogni 16 byte un header {3, 64} seguito da "old". Tutte le entry sono lunghe un
+ * multiplo di 16 byte e l'arena un multiplo di 64, quindi la posizione di "old" cade su uno di
+ * questi header finti */
+static int test_wraparound(shm_index_t *index, shm_index_t *reader) {
+    shm_index_stats_t stats;
+    shm_index_get_stats(index, &stats);
+    // un'entry da 16 byte in testa: "old" non coincide con l'inizio di un'entry del giro dopo
+    CHECK(shm_index_publish(index, "p", 1, "padding", 7) == 0, "padding not published");
+    unsigned char value[4101]; // 8 + 3 + 4101 = 4112 byte
+    memset(value, 'o', sizeof(value));
+    CHECK(shm_index_publish(index, "old", 3, value, sizeof(value)) == 0, "old not published");
+
+    unsigned char filler[4064]; // 8 + 8 + 4064 = 4080 byte
+    uint32_t fake[2] = {3, 64};
+    for (size_t off = 0; off < sizeof(filler); off += 16) {
+        memcpy(filler + off, fake, sizeof(fake));
+        memcpy(filler + off + 8, "oldFAKE!", 8);
+    }
+    size_t written = 0;
+    for (int i = 0; written <= stats.arena_bytes + sizeof(filler); i++) {
+        char key[16];
+        snprintf(key, sizeof(key), "fill%04d", i);
+        CHECK(shm_index_publish(index, key, 8, filler, sizeof(filler)) == 0,
+              "filler not published");
+        written += 16 + sizeof(filler);
+    }
+    size_t len = 0;
+    CHECK(shm_index_get(reader, "old", 3, value, sizeof(value), &len) == -100,
+          "entry overwritten by the arena still served (%zu bytes)", len);
+    return 0;
+}
+
+static int test_concurrent_readers(shm_index_t *index, shm_index_t *reader) {
+    shm_index_stats_t stats;
+    shm_index_get_stats(index, &stats);
+    // l'arena contiene le ultime arena_bytes / AVERAGE_ENTRY pubblicazioni
+    shared_t shared = {.reader = reader,
+                       .frontier = KEYS - (uint32_t)(stats.arena_bytes / AVERAGE_ENTRY) - 8};
+    pthread_t readers[READERS];
+    for (int i = 0; i < READERS; i++) pthread_create(&readers[i], NULL, reader_thread, &shared);
+
+    unsigned char *value = malloc(OVERSIZED_LEN);
+    unsigned char *check = malloc(BUF_SIZE);
+    int failed = 0;
+    time_t start = time(NULL);
+    for (uint64_t n = 0; (n < PUBLISHES || time(NULL) - start <= MIN_SECONDS) && !failed; n++) {
+        uint32_t key_id = (uint32_t)(n % KEYS);
+        uint32_t version = (uint32_t)(n / KEYS);
+        char key[32];
+        key_name(key_id, key, sizeof(key));
+        fill_value(value, key_id, version);
+        size_t len = value_len(key_id, version);
+        int rc = shm_index_publish(index, key, strlen(key), value, len);
+        __atomic_store_n(&shared.published, n + 1, __ATOMIC_RELAXED);
+        if (n % YIELD_EVERY == 0) sched_yield();
+
+        size_t read_len = 0;
+        int get = shm_index_get(reader, key, strlen(key), check, BUF_SIZE, &read_len);
+        if (len == OVERSIZED_LEN) {
+            // niente pubblicazione, e la versione precedente non resta leggibile
+            if (rc != -1 || get != -100) failed = 1;
+        } else if (rc != 0 || get != 0 || read_len != len || memcmp(check, value, len) != 0) {
+            failed = 1;
+        }
+    }
+    __atomic_store_n(&shared.done, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < READERS; i++) pthread_join(readers[i], NULL);
+    free(check);
+    free(value);
+
+    shm_index_get_stats(index, &stats);
+    CHECK(!failed, "writer read back a wrong value");
+    CHECK(stats.published * AVERAGE_ENTRY > stats.arena_bytes * 100, "arena did not wrap enough");
+    CHECK(shared.hits > 0, "readers never hit");
+    CHECK(shared.errors == 0, "%llu torn or stale reads out of %llu hits",
+          (unsigned long long)shared.errors, (unsigned long long)shared.hits);
+    return 0;
+}
+
+typedef int (*shm_test_fn)(shm_index_t *index, shm_index_t *reader);
+
+// ogni test su un segmento nuovo: server e client nello stesso processo
+static int run_test(shm_test_fn test) {
+    char name[64];
+    snprintf(name, sizeof(name), "/podcache-test-%d", (int)getpid());
+    shm_index_t *index = shm_index_create(name, SEGMENT_SIZE, 0600);
+    CHECK(index, "cannot create shared memory segment %s", name);
+    shm_index_t *reader = shm_index_open(name);
+    if (!reader) shm_index_destroy(index);
+    CHECK(reader, "cannot open shared memory segment %s", name);
+
+    int failed = test(index, reader);
+    shm_index_close(reader);
+    shm_index_destroy(index);
+    return failed;
+}
+
+int main(void) {
+    int failed = 0;
+    failed += run_test(test_oversized);
+    failed += run_test(test_wraparound);
+    failed += run_test(test_concurrent_readers);
+
+    if (failed == 0) printf("All shm_index tests passed\n");
+    return failed ? 1 : 0;
+}